@@ -118,6 +118,13 @@ int AFILE_DetectFileType(const char *filename)
 			return AFILE_CART;
 		}
 		break;
+	case 'R':
+		/* WAV recording of a tape */
+		if (header[1] == 'I' && header[2] == 'F' && header[3] == 'F') {
+			fclose(fp);
+			return AFILE_CAS;
+		}
+		break;
 	case 0x96:
 		if (header[1] == 0x02) {
 			fclose(fp);
@@ -78,6 +78,9 @@
 #ifdef POKEYREC
 #include "pokeyrec.h"
 #endif
+#ifdef SHMEXPORT
+#include "shmexport.h"
+#endif
 #include "pia.h"
 #include "platform.h"
 #include "pokey.h"
@@ -90,7 +93,7 @@
 #include "colours.h"
 #include "screen.h"
 #endif
-#if defined(AUDIO_RECORDING) || defined(VIDEO_RECORDING)
+#if defined(AUDIO_RECORDING) || defined(VIDEO_RECORDING) || defined(SCREENSHOTS)
 #include "file_export.h"
 #endif
 #ifndef BASIC
@@ -589,6 +592,14 @@ int Atari800_Initialise(int *argc, char *argv[])
 			POKEYSND_stereo_enabled = FALSE;
 			Sound_desired.channels = 1;
 		}
+		else if (strcmp(argv[i], "-quad") == 0)
+			POKEYSND_quad_enabled = TRUE;
+		else if (strcmp(argv[i], "-noquad") == 0)
+			POKEYSND_quad_enabled = FALSE;
+		else if (strcmp(argv[i], "-quadout") == 0) {
+			POKEYSND_quad_enabled = TRUE;
+			Sound_desired.channels = 4;
+		}
 #endif /* STEREO_SOUND */
 		else if (strcmp(argv[i], "-turbo") == 0) {
 			Atari800_turbo = TRUE;
@@ -724,6 +735,9 @@ int Atari800_Initialise(int *argc, char *argv[])
 #ifdef STEREO_SOUND
 					Log_print("\t-stereo          Turn on emulation of two POKEYs");
 					Log_print("\t-nostereo        Turn off emulation of two POKEYs");
+					Log_print("\t-quad            Turn on emulation of four POKEYs, mixed to the sound channels");
+					Log_print("\t-noquad          Turn off emulation of four POKEYs");
+					Log_print("\t-quadout         Output four POKEYs to four sound channels");
 #endif
 					Log_print("\t-turbo           Run emulated Atari as fast as possible");
 					Log_print("\t-monitor         Start emulated Atari in the monitor");
@@ -778,6 +792,9 @@ int Atari800_Initialise(int *argc, char *argv[])
 #endif
 #ifdef POKEYREC
 		|| !POKEYREC_Initialise(argc, argv)
+#endif
+#ifdef SHMEXPORT
+		|| !SHMEXPORT_Initialise(argc, argv)
 #endif
 		|| !SIO_Initialise (argc, argv)
 		|| !CARTRIDGE_Initialise(argc, argv)
@@ -1038,6 +1055,9 @@ int Atari800_Exit(int run_monitor)
 #endif
 #ifdef POKEYREC
 		POKEYREC_Exit();
+#endif
+#ifdef SHMEXPORT
+		SHMEXPORT_Exit();
 #endif
 		Devices_Exit();
 #ifdef R_IO_DEVICE
@@ -1045,6 +1065,9 @@ int Atari800_Exit(int run_monitor)
 #endif
 #if defined(AUDIO_RECORDING) || defined(VIDEO_RECORDING)
 		File_Export_StopRecording();
+#endif
+#ifdef SCREENSHOTS
+		File_Export_FinishScreenshots();
 #endif
 		MONITOR_Exit();
 #ifdef SDL
@@ -1273,6 +1296,23 @@ static void basic_frame(void)
 #endif /* defined(BASIC) || defined(VERY_SLOW) || defined(CURSES_BASIC) */
 #endif /* LIBATARI800 */
 
+#if !defined(BASIC) && !defined(LIBATARI800) && !defined(BENCHMARK)
+/* Returns TRUE if a frame should be displayed while the emulator runs
+   faster than real time. */
+static int TurboDisplayDue(void)
+{
+	static double last_display_screen_time = 0.0;
+	static double const limit = 1.0 / 60.0; /* refresh every 1/60 s */
+	/* TODO Actually sync the limit with the display refresh rate. */
+	double cur_time = Util_time();
+	if (cur_time - last_display_screen_time > limit) {
+		last_display_screen_time = cur_time;
+		return TRUE;
+	}
+	return FALSE;
+}
+#endif
+
 void Atari800_Frame(void)
 {
 #ifndef BASIC
@@ -1333,6 +1373,8 @@ void Atari800_Frame(void)
 	VOTRAXSND_Frame(); /* for the Votrax */
 #endif
 	Devices_Frame();
+	SIO_Frame();
+	CASSETTE_Frame();
 #ifndef BASIC
 	INPUT_Frame();
 #endif
@@ -1341,7 +1383,13 @@ void Atari800_Frame(void)
 #ifdef BASIC
 	basic_frame();
 #else /* BASIC */
-	if (++refresh_counter >= Atari800_refresh_rate) {
+	if (++refresh_counter >= Atari800_refresh_rate
+#if !defined(LIBATARI800) && !defined(BENCHMARK)
+	    /* While the tape is fast-forwarded, only frames that get displayed
+	       are drawn. */
+	    && (!CASSETTE_fast_forward || TurboDisplayDue())
+#endif
+	   ) {
 		refresh_counter = 0;
 #ifdef USE_CURSES
 		curses_clear_screen();
@@ -1374,9 +1422,15 @@ void Atari800_Frame(void)
 #ifdef VIDEO_RECORDING
 	File_Export_WriteVideo();
 #endif
+#if defined(SCREENSHOTS) && !defined(BASIC)
+	Screen_ScreenshotBurstFrame();
+#endif
 #ifdef SOUND
 	Sound_Update();
 #endif
+#ifdef SHMEXPORT
+	SHMEXPORT_Frame();
+#endif
 #if defined(AUDIO_RECORDING) || defined(VIDEO_RECORDING)
 	/* multimedia stats are drawn here so they don't get recorded in the video */
 	Screen_DrawMultimediaStats();
@@ -1395,16 +1449,13 @@ void Atari800_Frame(void)
 #ifdef ALTERNATE_SYNC_WITH_HOST
 	if (refresh_counter == 0)
 #endif
-		if (Atari800_turbo) {
+		if (CASSETTE_fast_forward) {
+			/* Already limited when drawing the frame. */
+		}
+		else if (Atari800_turbo) {
 			/* No need to draw Atari frames with frequency higher than display
 			   refresh rate. */
-			static double last_display_screen_time = 0.0;
-			static double const limit = 1.0 / 60.0; /* refresh every 1/60 s */
-			/* TODO Actually sync the limit with the display refresh rate. */
-			double cur_time = Util_time();
-			if (cur_time - last_display_screen_time > limit)
-				last_display_screen_time = cur_time;
-			else
+			if (!TurboDisplayDue())
 				Atari800_display_screen = FALSE;
 		}
 		else
@@ -1555,7 +1606,9 @@ void Atari800_SetTVMode(int mode)
 #endif
 #ifdef SOUND
 		if (Sound_enabled)
-			POKEYSND_Init(POKEYSND_FREQ_17_EXACT, Sound_out.freq, Sound_out.channels, Sound_out.sample_size == 2 ? POKEYSND_BIT16 : 0);
+			POKEYSND_Init(POKEYSND_FREQ_17_EXACT, Sound_out.freq, Sound_out.channels,
+			              Sound_out.sample_size == 4 ? POKEYSND_FLOAT32 :
+			              Sound_out.sample_size == 2 ? POKEYSND_BIT16 : 0);
 #endif /* SOUND */
 	}
 }
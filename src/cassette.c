@@ -70,6 +70,14 @@ char CASSETTE_description[CASSETTE_DESCRIPTION_MAX];
 static int cassette_gapdelay = 0;	/* in ms, includes leader and all gaps */
 static int cassette_motor = 0;
 
+int CASSETTE_turbo = FALSE;
+int CASSETTE_fast_forward = FALSE;
+/* Frames left in which the emulation stays fast-forwarded after the tape
+   stopped playing, so short motor-off periods between records are passed
+   quickly too. */
+static int turbo_hold = 0;
+#define TURBO_HOLD_FRAMES 50
+
 int CASSETTE_hold_start_on_reboot = 0;
 int CASSETTE_hold_start = 0;
 int CASSETTE_press_space = 0;
@@ -106,6 +114,12 @@ int CASSETTE_ReadConfig(char *string, char *ptr)
 			return FALSE;
 		CASSETTE_write_protect = value;
 	}
+	else if (strcmp(string, "CASSETTE_TURBO") == 0) {
+		int value = Util_sscanbool(ptr);
+		if (value == -1)
+			return FALSE;
+		CASSETTE_turbo = value;
+	}
 	else return FALSE;
 	return TRUE;
 }
@@ -115,6 +129,7 @@ void CASSETTE_WriteConfig(FILE *fp)
 	fprintf(fp, "CASSETTE_FILENAME=%s\n", CASSETTE_filename);
 	fprintf(fp, "CASSETTE_LOADED=%d\n", CASSETTE_status != CASSETTE_STATUS_NONE);
 	fprintf(fp, "CASSETTE_WRITE_PROTECT=%d\n", CASSETTE_write_protect);
+	fprintf(fp, "CASSETTE_TURBO=%d\n", CASSETTE_turbo);
 }
 
 int CASSETTE_Initialise(int *argc, char *argv[])
@@ -148,11 +163,17 @@ int CASSETTE_Initialise(int *argc, char *argv[])
 		}
 		else if (strcmp(argv[i], "-tape-readonly") == 0)
 			protect = TRUE;
+		else if (strcmp(argv[i], "-tapeturbo") == 0)
+			CASSETTE_turbo = TRUE;
+		else if (strcmp(argv[i], "-notapeturbo") == 0)
+			CASSETTE_turbo = FALSE;
 		else {
 			if (strcmp(argv[i], "-help") == 0) {
 				Log_print("\t-tape <file>      Insert cassette image");
 				Log_print("\t-boottape <file>  Insert cassette image and boot it");
 				Log_print("\t-tape-readonly    Mark the attached cassette image as read-only");
+				Log_print("\t-tapeturbo        Fast-forward the emulation while the tape is playing");
+				Log_print("\t-notapeturbo      Play the tape in real time");
 			}
 			argv[j++] = argv[i];
 		}
@@ -265,6 +286,19 @@ unsigned int CASSETTE_GetSize(void)
 	return IMG_TAPE_GetSize(cassette_file);
 }
 
+unsigned int CASSETTE_GetTime(unsigned int position)
+{
+	if (cassette_file == NULL || position == 0)
+		return 0;
+	return IMG_TAPE_GetBlockTime(cassette_file, position - 1);
+}
+
+void CASSETTE_SeekTime(unsigned int time)
+{
+	if (cassette_file != NULL)
+		CASSETTE_Seek(IMG_TAPE_FindBlock(cassette_file, time) + 1);
+}
+
 void CASSETTE_Seek(unsigned int position)
 {
 	if (cassette_file != NULL) {
@@ -388,6 +422,17 @@ int CASSETTE_AddScanLine(void)
 		return CassetteRead(114);
 }
 
+void CASSETTE_Frame(void)
+{
+	if (CASSETTE_turbo && CASSETTE_readable && !CASSETTE_record)
+		turbo_hold = TURBO_HOLD_FRAMES;
+	else if (turbo_hold > 0 && (!CASSETTE_turbo || CASSETTE_status == CASSETTE_STATUS_NONE))
+		turbo_hold = 0;
+	else if (turbo_hold > 0)
+		turbo_hold--;
+	CASSETTE_fast_forward = turbo_hold > 0;
+}
+
 void CASSETTE_ResetPOKEY(void)
 {
 	/* Resetting POKEY stops any serial transmission. */
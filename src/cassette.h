@@ -35,6 +35,13 @@ extern int CASSETTE_hold_start;
 extern int CASSETTE_hold_start_on_reboot; /* preserve hold_start after reboot */
 extern int CASSETTE_press_space;
 
+/* If TRUE, the emulation runs as fast as possible while a tape is playing.
+   The tape timing is not changed, so custom loaders work as well. */
+extern int CASSETTE_turbo;
+/* Indicates that the tape is being played in turbo mode; set by
+   CASSETTE_Frame(). */
+extern int CASSETTE_fast_forward;
+
 /* Is cassette file write-protected? Don't change directly, use CASSETTE_ToggleWriteProtect(). */
 extern int CASSETTE_write_protect;
 /* Switches RO/RW. Fails with FALSE if the tape cannot be switched to RW. */
@@ -60,6 +67,8 @@ void CASSETTE_TapeMotor(int onoff);
 /* Advance the tape by a scanline. Return TRUE if a new byte has been loaded
    and POKEY_SERIN must be updated. */
 int CASSETTE_AddScanLine(void);
+/* Updates CASSETTE_fast_forward; call once per frame. */
+void CASSETTE_Frame(void);
 /* Reset cassette serial transmission; call when resseting POKEY by SKCTL. */
 void CASSETTE_ResetPOKEY(void);
 
@@ -67,6 +76,12 @@ void CASSETTE_ResetPOKEY(void);
 unsigned int CASSETTE_GetSize(void);
 /* Return current position (block number) of the mounted tape (counted from 1). */
 unsigned int CASSETTE_GetPosition(void);
+/* Return time in ms from the start of the tape to the start of block
+   POSITION (counted from 1). POSITION past the last block gives the length
+   of the whole tape. */
+unsigned int CASSETTE_GetTime(unsigned int position);
+/* Position the tape at the block that is played TIME ms after its start. */
+void CASSETTE_SeekTime(unsigned int time);
 
 /* --- Functions used by patched SIO --- */
 /* -- SIO_Handler() -- */
@@ -35,6 +35,7 @@
 #include "memory.h"
 #include "pbi.h"
 #include "rtime.h"
+#include "sio.h"
 #include "sysrom.h"
 #ifdef XEP80_EMULATION
 #include "xep80.h"
@@ -198,6 +199,9 @@ int CFG_LoadConfig(const char *alternate_config_filename)
 			else if (strcmp(string, "ENABLE_SIO_PATCH") == 0) {
 				ESC_enable_sio_patch = Util_sscanbool(ptr);
 			}
+			else if (strcmp(string, "ENABLE_SIO_ACCELERATION") == 0) {
+				SIO_accelerate = Util_sscanbool(ptr);
+			}
 			else if (strcmp(string, "ENABLE_SLOW_XEX_LOADING") == 0) {
 				BINLOAD_slow_xex_loading = Util_sscanbool(ptr);
 			}
@@ -220,6 +224,11 @@ int CFG_LoadConfig(const char *alternate_config_filename)
 #ifdef STEREO_SOUND
 				POKEYSND_stereo_enabled = Util_sscanbool(ptr);
 				Sound_desired.channels = POKEYSND_stereo_enabled ? 2 : 1;
+#endif /* STEREO_SOUND */
+			}
+			else if (strcmp(string, "QUAD_POKEY") == 0) {
+#ifdef STEREO_SOUND
+				POKEYSND_quad_enabled = Util_sscanbool(ptr);
 #endif /* STEREO_SOUND */
 			}
 			else if (strcmp(string, "SPEAKER_SOUND") == 0) {
@@ -425,6 +434,7 @@ int CFG_WriteConfig(void)
 
 	fprintf(fp, "DISABLE_BASIC=%d\n", Atari800_disable_basic);
 	fprintf(fp, "ENABLE_SIO_PATCH=%d\n", ESC_enable_sio_patch);
+	fprintf(fp, "ENABLE_SIO_ACCELERATION=%d\n", SIO_accelerate);
 	fprintf(fp, "ENABLE_SLOW_XEX_LOADING=%d\n", BINLOAD_slow_xex_loading);
 	fprintf(fp, "ENABLE_H_PATCH=%d\n", Devices_enable_h_patch);
 	fprintf(fp, "ENABLE_P_PATCH=%d\n", Devices_enable_p_patch);
@@ -436,6 +446,7 @@ int CFG_WriteConfig(void)
 	fprintf(fp, "ENABLE_NEW_POKEY=%d\n", POKEYSND_enable_new_pokey);
 #ifdef STEREO_SOUND
 	fprintf(fp, "STEREO_POKEY=%d\n", POKEYSND_stereo_enabled);
+	fprintf(fp, "QUAD_POKEY=%d\n", POKEYSND_quad_enabled);
 #endif
 #ifdef CONSOLE_SOUND
 	fprintf(fp, "SPEAKER_SOUND=%d\n", POKEYSND_console_sound_enabled);
@@ -41,6 +41,9 @@
 
 static AUDIO_OUT_t out;
 
+/* Size of a block; init_common() sets out.block_align to it */
+#define MAX_BLOCK_ALIGN 1024
+
 static ADPCMChannelStatus channel_status[2];
 
 static int samples_per_block;
@@ -105,19 +108,6 @@ static inline const SWORD clip_int16(int a)
 	else                      return a;
 }
 
-/* Clip a signed integer into the -(2^p),(2^p-1) range.
- * @param  a value to clip
- * @param  p bit position to clip at
- * @return clipped value
- */
-static inline const int clip_intp2(int a, int p)
-{
-	if (((unsigned)a + (1 << p)) & ~((2 << p) - 1))
-		return (a >> 31) ^ ((1 << p) - 1);
-	else
-		return a;
-}
-
 /**
  * Clip a signed integer value into the amin-amax range.
  * @param a value to clip
@@ -132,65 +122,149 @@ static inline const int clip(int a, int amin, int amax)
 	else               return a;
 }
 
-static inline UBYTE adpcm_ima_compress_sample(ADPCMChannelStatus *c, SWORD sample)
+/* Returns FFMIN(limit, a / step) for a >= 0 and limit 7 or 8. The
+   comparisons are independent of each other and need no branches, which are
+   mispredicted all the time on noise, nor the slow division instruction. */
+static inline int quantize(int a, int step, int limit)
 {
-	int delta  = sample - c->sample1;
-	int nibble = FFMIN(7, abs(delta) * 4 /
-					   adpcm_step_table[c->step]) + (delta < 0) * 8;
-	c->sample1 += ((adpcm_step_table[c->step] *
-						adpcm_yamaha_difflookup[nibble]) / 8);
-	c->sample1 = clip_int16(c->sample1);
-	c->step  = clip(c->step + adpcm_index_table[nibble], 0, 88);
-	return nibble;
+	int q = (a >= step) + (a >= step * 2) + (a >= step * 3) + (a >= step * 4)
+	      + (a >= step * 5) + (a >= step * 6) + (a >= step * 7);
+	if (limit > 7)
+		q += a >= step * 8;
+	return q;
 }
 
-static inline UBYTE adpcm_ms_compress_sample(ADPCMChannelStatus *c, SWORD sample)
+/* The compress functions encode COUNT samples of each of the NC (1 or 2)
+   interleaved channels into one nibble per byte of NIBBLES, in the same order.
+   A whole block is done in one call, so that the state stays in local
+   variables; the channels are encoded in the same loop, so that the processor
+   can work on both of them at once. They are inlined with constant NC. */
+
+static inline void ima_compress(ADPCMChannelStatus *c, int nc, const SWORD *samples, int count, UBYTE *nibbles)
 {
-	int predictor, nibble, bias;
+	int sample1[2];
+	int step_index[2];
+	int ch;
 
-	predictor = (((c->sample1) * (c->coeff1)) +
-				(( c->sample2) * (c->coeff2))) / 64;
+	for (ch = 0; ch < nc; ch++) {
+		sample1[ch] = c[ch].sample1;
+		step_index[ch] = c[ch].step;
+	}
 
-	nibble = sample - predictor;
-	if (nibble >= 0)
-		bias =  c->idelta / 2;
-	else
-		bias = -c->idelta / 2;
+	while (count-- > 0) {
+		for (ch = 0; ch < nc; ch++) {
+			int step = adpcm_step_table[step_index[ch]];
+			int delta = *samples++ - sample1[ch];
+			int sign = delta >> 31; /* -1 if negative */
+			int nibble = quantize(((delta ^ sign) - sign) * 4, step, 7) | (sign & 8);
 
-	nibble = (nibble + bias) / c->idelta;
-	nibble = clip_intp2(nibble, 3) & 0x0F;
+			sample1[ch] = clip_int16(sample1[ch] + (step * adpcm_yamaha_difflookup[nibble]) / 8);
+			step_index[ch] = clip(step_index[ch] + adpcm_index_table[nibble], 0, 88);
+			*nibbles++ = nibble;
+		}
+	}
 
-	predictor += ((nibble & 0x08) ? (nibble - 0x10) : nibble) * c->idelta;
+	for (ch = 0; ch < nc; ch++) {
+		c[ch].sample1 = sample1[ch];
+		c[ch].step = step_index[ch];
+	}
+}
 
-	c->sample2 = c->sample1;
-	c->sample1 = clip_int16(predictor);
+static inline void ms_compress(ADPCMChannelStatus *c, int nc, const SWORD *samples, int count, UBYTE *nibbles)
+{
+	int sample1[2];
+	int sample2[2];
+	int idelta[2];
+	int ch;
 
-	c->idelta = (adpcm_AdaptationTable[nibble] * c->idelta) >> 8;
-	if (c->idelta < 16)
-		c->idelta = 16;
+	for (ch = 0; ch < nc; ch++) {
+		sample1[ch] = c[ch].sample1;
+		sample2[ch] = c[ch].sample2;
+		idelta[ch] = c[ch].idelta;
+	}
 
-	return nibble;
+	while (count-- > 0) {
+		for (ch = 0; ch < nc; ch++) {
+			int predictor = (sample1[ch] * c[ch].coeff1 + sample2[ch] * c[ch].coeff2) / 64;
+			int error = *samples++ - predictor;
+			int sign = error >> 31; /* -1 if negative */
+			int value;
+
+			/* error / idelta rounded away from zero, within -8..7 */
+			value = quantize(((error ^ sign) - sign) + idelta[ch] / 2, idelta[ch], 8);
+			value = ((value - ((value >> 3) & ~sign)) ^ sign) - sign;
+
+			sample2[ch] = sample1[ch];
+			sample1[ch] = clip_int16(predictor + value * idelta[ch]);
+			idelta[ch] = (adpcm_AdaptationTable[value & 0x0F] * idelta[ch]) >> 8;
+			if (idelta[ch] < 16)
+				idelta[ch] = 16;
+			*nibbles++ = value & 0x0F;
+		}
+	}
+
+	for (ch = 0; ch < nc; ch++) {
+		c[ch].sample1 = sample1[ch];
+		c[ch].sample2 = sample2[ch];
+		c[ch].idelta = idelta[ch];
+	}
 }
 
-static inline UBYTE adpcm_yamaha_compress_sample(ADPCMChannelStatus *c, SWORD sample)
+static inline void yamaha_compress(ADPCMChannelStatus *c, int nc, const SWORD *samples, int count, UBYTE *nibbles)
 {
-	int nibble, delta;
+	int predictor[2];
+	int step[2];
+	int ch;
 
-	if (!c->step) {
-		c->predictor = 0;
-		c->step      = 127;
+	for (ch = 0; ch < nc; ch++) {
+		if (!c[ch].step) {
+			c[ch].predictor = 0;
+			c[ch].step      = 127;
+		}
+		predictor[ch] = c[ch].predictor;
+		step[ch] = c[ch].step;
 	}
 
-	delta = sample - c->predictor;
+	while (count-- > 0) {
+		for (ch = 0; ch < nc; ch++) {
+			int delta = *samples++ - predictor[ch];
+			int sign = delta >> 31; /* -1 if negative */
+			int nibble = quantize(((delta ^ sign) - sign) * 4, step[ch], 7) | (sign & 8);
 
-	nibble = FFMIN(7, abs(delta) * 4 / c->step) + (delta < 0) * 8;
+			predictor[ch] = clip_int16(predictor[ch] + (step[ch] * adpcm_yamaha_difflookup[nibble]) / 8);
+			step[ch] = clip((step[ch] * adpcm_yamaha_indexscale[nibble]) >> 8, 127, 24576);
+			*nibbles++ = nibble;
+		}
+	}
 
-	c->predictor += ((c->step * adpcm_yamaha_difflookup[nibble]) / 8);
-	c->predictor = clip_int16(c->predictor);
-	c->step = (c->step * adpcm_yamaha_indexscale[nibble]) >> 8;
-	c->step = clip(c->step, 127, 24576);
+	for (ch = 0; ch < nc; ch++) {
+		c[ch].predictor = predictor[ch];
+		c[ch].step = step[ch];
+	}
+}
 
-	return nibble;
+static void adpcm_ima_compress_samples(const SWORD *samples, int count, UBYTE *nibbles)
+{
+	if (out.num_channels == 2)
+		ima_compress(channel_status, 2, samples, count, nibbles);
+	else
+		ima_compress(channel_status, 1, samples, count, nibbles);
+}
+
+static void adpcm_ms_compress_samples(const SWORD *samples, int count, UBYTE *nibbles)
+{
+	if (out.num_channels == 2)
+		ms_compress(channel_status, 2, samples, count, nibbles);
+	else
+		ms_compress(channel_status, 1, samples, count, nibbles);
+}
+
+static void adpcm_yamaha_compress_samples(const SWORD *samples, int count, UBYTE *nibbles)
+{
+	if (out.num_channels == 2)
+		yamaha_compress(channel_status, 2, samples, count, nibbles);
+	else
+		yamaha_compress(channel_status, 1, samples, count, nibbles);
 }
 
 static int reserve_buffers(void)
@@ -213,7 +287,7 @@ static void init_common(int sample_rate, float fps, int sample_size, int num_cha
 	out.bits_per_sample = 4;
 	out.bitrate = sample_rate * num_channels * out.bits_per_sample;
 	out.num_channels = num_channels;
-	out.block_align = 1024;
+	out.block_align = MAX_BLOCK_ALIGN;
 	out.scale = 1000000;
 	out.rate = (int)(fps * 1000000);
 	out.length = 0;
@@ -287,10 +361,12 @@ static int ADPCM_CreateFrame(const UBYTE *source, int num_samples, UBYTE *buf, i
 	int i;
 	int j;
 	int ch;
-	int st;
+	int n;
 	int samples_consumed;
 	const SWORD *samples;
 	ADPCMChannelStatus *status;
+	/* nibbles of the block, interleaved like the samples */
+	UBYTE nibbles[MAX_BLOCK_ALIGN * 2];
 
 	buf_start = buf;
 	samples = (const SWORD *)leftover_samples;
@@ -302,7 +378,7 @@ static int ADPCM_CreateFrame(const UBYTE *source, int num_samples, UBYTE *buf, i
 	if (!source) {
 		/* we have reached the end of the file, so we need to flush the last frame.
 		   by filling the buffer with enough zeros to guarantee a full frame. */
-		num_samples = samples_per_block - (int)(leftover_samples_end - samples);
+		num_samples = samples_per_block * out.num_channels - (int)(leftover_samples_end - samples);
 		memset(leftover_samples_end, 0, num_samples * 2);
 	}
 	else if (num_samples > 0) {
@@ -314,14 +390,12 @@ static int ADPCM_CreateFrame(const UBYTE *source, int num_samples, UBYTE *buf, i
 	/* incoming samples have been added to the list of leftover samples; adjust
 	   total number of samples to reflect total size of leftover samples buffer */
 	num_samples = (int)(leftover_samples_end - samples);
-	if (num_samples < samples_per_block) {
+	if (num_samples < samples_per_block * out.num_channels) {
 		/* not enough samples to fill a block, so we have to wait until a
 		   subsequent call to this function fills the buffer full enough */
 		return 0;
 	}
 
-	st = out.num_channels == 2;
-
 	if (format_type == FORMAT_MS) { /* Microsoft ADPCM */
 		for (i = 0; i < out.num_channels; i++) {
 			int predictor = 0;
@@ -343,21 +417,22 @@ static int ADPCM_CreateFrame(const UBYTE *source, int num_samples, UBYTE *buf, i
 		for (i = 0; i < out.num_channels; i++)
 			PUT_LE_WORD(buf, channel_status[i].sample2);
 
-		for (i = 7 * out.num_channels; i < out.block_align; i++) {
-			int nibble;
-			nibble  = adpcm_ms_compress_sample(&channel_status[ 0], *samples++) << 4;
-			nibble |= adpcm_ms_compress_sample(&channel_status[st], *samples++);
-			*buf++  = nibble;
-		}
+		/* the first nibble of each byte is in the high bits; in stereo the
+		   left channel */
+		n = (out.block_align - 7 * out.num_channels) * 2;
+		adpcm_ms_compress_samples(samples, n / out.num_channels, nibbles);
+		for (i = 0; i < n; i += 2)
+			*buf++ = (nibbles[i] << 4) | nibbles[i + 1];
+		samples += n;
 	}
 	else if (format_type == FORMAT_YAMAHA) { /* Yamaha ADPCM */
-		int n = samples_per_block / 2;
-		for (n *= out.num_channels; n > 0; n--) {
-			int nibble;
-			nibble  = adpcm_yamaha_compress_sample(&channel_status[ 0], *samples++);
-			nibble |= adpcm_yamaha_compress_sample(&channel_status[st], *samples++) << 4;
-			*buf++  = nibble;
-		}
+		/* the first nibble of each byte is in the low bits; in stereo the
+		   left channel */
+		n = samples_per_block * out.num_channels;
+		adpcm_yamaha_compress_samples(samples, samples_per_block, nibbles);
+		for (i = 0; i < n; i += 2)
+			*buf++ = nibbles[i] | (nibbles[i + 1] << 4);
+		samples += n;
 	}
 	else { /* IMA ADPCM */
 		for (ch = 0; ch < out.num_channels; ch++) {
@@ -369,35 +444,22 @@ static int ADPCM_CreateFrame(const UBYTE *source, int num_samples, UBYTE *buf, i
 			*buf++ = status->step;
 			*buf++ = 0; /* unknown */
 		}
-        /* stereo: 4 bytes (8 samples) for left, 4 bytes for right */
-		/* 0 2 4 6 8 10 12 14 1 3 5 7 9 11 13 15 */
-		if (st) {
-			int blocks = (samples_per_block - 1) / 8;
-
-			for (i = 0; i < blocks; i++) {
-				for (ch = 0; ch < 2; ch++) {
-					status = &channel_status[ch];
-					for (j = 0; j < 16; j += 4) {
-						UBYTE nibble;
-
-						nibble = adpcm_ima_compress_sample(status, samples[ch + j]);
-						nibble |= adpcm_ima_compress_sample(status, samples[ch + j + 2]) << 4;
-						*buf++ = nibble;
-					}
+		/* Each channel is stored in groups of 4 bytes (8 samples), the
+		   first nibble of each byte in the low bits. Stereo alternates the
+		   groups of the left and right channels:
+		   0 2 4 6 8 10 12 14 1 3 5 7 9 11 13 15 */
+		n = samples_per_block - 1;
+		adpcm_ima_compress_samples(samples, n, nibbles);
+		for (i = 0; i < n; i += 8) {
+			for (ch = 0; ch < out.num_channels; ch++) {
+				const UBYTE *p = nibbles + i * out.num_channels + ch;
+				for (j = 0; j < 4; j++) {
+					*buf++ = p[0] | (p[out.num_channels] << 4);
+					p += 2 * out.num_channels;
 				}
-				samples += 16;
-			}
-		}
-		else {
-			status = &channel_status[0];
-			for (i = 0; i < samples_per_block - 1; i+=2) {
-				UBYTE nibble;
-
-				nibble = adpcm_ima_compress_sample(status, *samples++);
-				nibble |= adpcm_ima_compress_sample(status, *samples++) << 4;
-				*buf++ = nibble;
 			}
 		}
+		samples += n * out.num_channels;
 	}
 
 	samples_consumed = (int)(samples - leftover_samples);
@@ -432,7 +494,7 @@ static int ADPCM_AnotherFrame(void)
 		update_rate();
 		return (int)(leftover_samples_end - leftover_samples) > 0;
 	}
-	return (int)(leftover_samples_end - leftover_samples) >= samples_per_block;
+	return (int)(leftover_samples_end - leftover_samples) >= samples_per_block * out.num_channels;
 }
 
 static int ADPCM_Flush(float duration)
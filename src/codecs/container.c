@@ -25,6 +25,7 @@
 
 /* This file is compiled when AUDIO_RECORDING or VIDEO_RECORDING is defined. */
 
+#include "config.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include "screen.h"
@@ -43,6 +44,11 @@
 #ifdef VIDEO_RECORDING
 #include "codecs/video.h"
 #include "codecs/container_avi.h"
+#include "codecs/container_y4m.h"
+#include "codecs/video_yuv.h"
+#ifdef AUDIO_RECORDING
+#include "codecs/audio_pcm.h"
+#endif
 #endif
 
 /* Global pointer to current multimedia container, or NULL if one has not been
@@ -53,7 +59,7 @@ CONTAINER_t *container = NULL;
 /* Global variable containing the amount of bytes written to the currently open
    container. This value is updated as the container adds video and audio
    frames, so may be used during the creation of the file */
-ULONG byteswritten;
+CONTAINER_OFFSET_t byteswritten;
 
 /* Global variable containing the number of video frames processed during the
    creation of the multimedia file. This is updated even when audio-only files
@@ -78,6 +84,7 @@ static CONTAINER_t *known_containers[] = {
 #endif
 #ifdef VIDEO_RECORDING
 	&Container_AVI,
+	&Container_Y4M,
 #endif
 	NULL,
 };
@@ -115,6 +122,19 @@ static CONTAINER_t *match_container(const char *id)
 	return found;
 }
 
+void CONTAINER_AddOffset(CONTAINER_OFFSET_t *offset, ULONG size)
+{
+	ULONG low = offset->low + size;
+	if (low < offset->low)
+		offset->high++;
+	offset->low = low;
+}
+
+ULONG CONTAINER_OffsetKB(const CONTAINER_OFFSET_t *offset)
+{
+	return (offset->high << 22) | (offset->low >> 10);
+}
+
 
 /* Convenience function to check if container type is supported. */
 int CONTAINER_IsSupported(const char *filename)
@@ -159,7 +179,7 @@ int CONTAINER_Open(const char *filename)
 
 		/* initialize variables common to all containers */
 		fps = Atari800_tv_mode == Atari800_TV_PAL ? Atari800_FPS_PAL : Atari800_FPS_NTSC;
-		byteswritten = 0;
+		byteswritten.low = byteswritten.high = 0;
 
 		keyframe_count = 0; /* force first frame to be keyframe */
 
@@ -175,8 +195,18 @@ int CONTAINER_Open(const char *filename)
 		smallest_audio_frame = 0xffffffff;
 		largest_audio_frame = 0;
 
+#ifdef VIDEO_RECORDING
+		if (container == &Container_Y4M) {
+			/* The stream is for external encoders, so it holds raw frames,
+			   with raw samples beside it. */
+			video_codec = &Video_Codec_YUV;
+#ifdef AUDIO_RECORDING
+			audio_codec = &Audio_Codec_PCM;
+#endif
+		}
+#endif
 #ifdef AUDIO_RECORDING
-		if (Sound_enabled) {
+		if (Sound_enabled && container->audio_frame) {
 			if (!CODECS_AUDIO_Init()) {
 				/* error message set in codec */
 				Log_print(FILE_EXPORT_error_message);
@@ -218,7 +248,7 @@ int CONTAINER_Open(const char *filename)
 #endif
 		fp = fopen(filename, "wb");
 		if (fp) {
-			if (!container->prepare(fp)) {
+			if (!container->prepare(fp, filename)) {
 				/* error message set in container */
 				Log_print(FILE_EXPORT_error_message);
 				fclose(fp);
@@ -291,7 +321,7 @@ int CONTAINER_AddAudioSamples(const UBYTE *buf, int num_samples)
 			num_samples = 0;
 
 			/* update statistics */
-			byteswritten += size;
+			CONTAINER_AddOffset(&byteswritten, size);
 			audio_frame_count++;
 			total_audio_size += size;
 		}
@@ -312,10 +342,36 @@ int CONTAINER_AddAudioSamples(const UBYTE *buf, int num_samples)
 #endif
 
 #ifdef VIDEO_RECORDING
-int CONTAINER_AddVideoFrame(void)
+/* Adds the encoded video frame BUF of SIZE bytes to the file. */
+static int add_video_frame(const UBYTE *buf, int size, int is_keyframe)
 {
-	int size;
 	int result;
+
+	result = container->video_frame(fp, buf, size, is_keyframe);
+	if (result) {
+		/* update statistics */
+		CONTAINER_AddOffset(&byteswritten, size);
+		video_frame_count++;
+		total_video_size += size;
+		if (size < smallest_video_frame) {
+			smallest_video_frame = size;
+		}
+		if (size > largest_video_frame) {
+			largest_video_frame = size;
+		}
+
+		result = container->size_check(ftell(fp));
+		if (!result) {
+			Log_print("%s maximum file size reached, closing file", container->container_id);
+		}
+	}
+
+	return result;
+}
+
+int CONTAINER_AddVideoFrame(UBYTE *screen)
+{
+	int size;
 	int is_keyframe;
 
 	if (!fp || !video_codec) return 0;
@@ -336,32 +392,33 @@ int CONTAINER_AddVideoFrame(void)
 		is_keyframe = TRUE;
 	}
 
-	size = video_codec->frame((UBYTE *)Screen_atari, is_keyframe, video_buffer, video_buffer_size);
+	size = video_codec->frame(screen, is_keyframe, video_buffer, video_buffer_size);
 	if (size < 0) {
 		/* failed creating video frame; force close of file */
 		Log_print("video codec %s failed encoding frame", video_codec->codec_id);
 		return 0;
 	}
-	result = container->video_frame(fp, video_buffer, size, is_keyframe);
-	if (result) {
-		/* update statistics */
-		byteswritten += size;
-		video_frame_count++;
-		total_video_size += size;
-		if (size < smallest_video_frame) {
-			smallest_video_frame = size;
-		}
-		if (size > largest_video_frame) {
-			largest_video_frame = size;
-		}
+	return add_video_frame(video_buffer, size, is_keyframe);
+}
 
-		result = container->size_check(ftell(fp));
-		if (!result) {
-			Log_print("%s maximum file size reached, closing file", container->container_id);
-		}
-	}
+int CONTAINER_VideoFramesIndependent(void)
+{
+	return fp && video_codec && !video_codec->uses_interframes;
+}
 
-	return result;
+int CONTAINER_EncodeVideoFrame(UBYTE *screen, UBYTE *buf, int bufsize)
+{
+	int size = video_codec->frame(screen, TRUE, buf, bufsize);
+	if (size < 0)
+		Log_print("video codec %s failed encoding frame", video_codec->codec_id);
+	return size;
+}
+
+int CONTAINER_AddEncodedVideoFrame(const UBYTE *buf, int size)
+{
+	if (!fp || !video_codec) return 0;
+
+	return add_video_frame(buf, size, TRUE);
 }
 #endif
 
@@ -400,7 +457,7 @@ int CONTAINER_Close(int file_ok)
 		else {
 			/* success, print out stats */
 			seconds = (int)(video_frame_count / fps);
-			size = byteswritten / 1024;
+			size = CONTAINER_OffsetKB(&byteswritten);
 			if (size > 1024 * 1024) {
 				size /= 1024;
 				mega = TRUE;
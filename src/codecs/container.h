@@ -3,8 +3,9 @@
 
 #include "atari.h"
 
-/* Prepare a file for writing video and audio frames */
-typedef int (*CONTAINER_Prepare)(FILE *fp);
+/* Prepare a file for writing video and audio frames. FILENAME is the name the
+   file FP was opened with. */
+typedef int (*CONTAINER_Prepare)(FILE *fp, const char *filename);
 
 /* Save the audio samples to the container */
 typedef int (*CONTAINER_SaveAudioFrame)(FILE *fp, const UBYTE *buf, int bufsize);
@@ -32,8 +33,14 @@ typedef struct {
    that's lower than 4GB */
 #define MAX_RIFF_FILE_SIZE (0xfff00000)
 
+/* Offset or size in a file, in 64 bits: AVI files grow past 4GB. */
+typedef struct {
+	ULONG low;
+	ULONG high;
+} CONTAINER_OFFSET_t;
+
 /* number of bytes written to the currently open multimedia file */
-extern ULONG byteswritten;
+extern CONTAINER_OFFSET_t byteswritten;
 
 /* These variables are needed for statistics and on-screen information display. */
 extern ULONG video_frame_count;
@@ -43,13 +50,29 @@ extern char description[32];
 /* Currently open container */
 extern CONTAINER_t *container;
 
+/* Adds SIZE to OFFSET. */
+void CONTAINER_AddOffset(CONTAINER_OFFSET_t *offset, ULONG size);
+/* Returns OFFSET in kilobytes. */
+ULONG CONTAINER_OffsetKB(const CONTAINER_OFFSET_t *offset);
+
 int CONTAINER_IsSupported(const char *filename);
 int CONTAINER_Open(const char *filename);
 #ifdef AUDIO_RECORDING
 int CONTAINER_AddAudioSamples(const UBYTE *buf, int num_samples);
 #endif
 #ifdef VIDEO_RECORDING
-int CONTAINER_AddVideoFrame(void);
+/* Adds SCREEN, in the layout of Screen_atari, as the next video frame. */
+int CONTAINER_AddVideoFrame(UBYTE *screen);
+/* Returns TRUE if the video codec encodes every frame on its own. Such
+   frames may be encoded with CONTAINER_EncodeVideoFrame() in any order, by
+   several threads at once, and then added in order with
+   CONTAINER_AddEncodedVideoFrame(). */
+int CONTAINER_VideoFramesIndependent(void);
+/* Encodes SCREEN into BUF, which must hold video_buffer_size bytes.
+   Returns the size of the encoded frame, or -1 on error. */
+int CONTAINER_EncodeVideoFrame(UBYTE *screen, UBYTE *buf, int bufsize);
+/* Adds the encoded frame BUF of SIZE bytes as the next video frame. */
+int CONTAINER_AddEncodedVideoFrame(const UBYTE *buf, int size);
 #endif
 int CONTAINER_Close(int file_ok);
 
@@ -24,8 +24,10 @@
 
 /* This file is only compiled when VIDEO_RECORDING is defined. */
 
+#include "config.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "file_export.h"
 #include "colours.h"
 #include "util.h"
@@ -46,30 +48,41 @@
 static ULONG size_riff;
 static ULONG size_movi;
 
-/* AVI files using the version 1.0 indexes ('idx1') have a 32 bit limit, which
-   limits file size to 4GB. Some media players may fail to play videos greater
-   than 2GB because of their incorrect use of signed rather than unsigned 32 bit
-   values.
-
-   The maximum recording duration depends mostly on the complexity of the video.
-   The audio is saved as raw PCM samples which doesn't vary per frame. On NTSC
-   at 60Hz using 16 bit samples, this will be just under 1500 bytes per frame.
-
-   The size of each encoded video frame depends on the complexity the screen
-   image. The RLE compression is based on scan lines, and performs best when
-   neighboring pixels on the scan line are the same color. Due to overhead in
-   the compression sceme itself, the best it can do is about 1500 bytes on a
+/* AVI files using only the version 1.0 indexes ('idx1') have a 32 bit limit,
+   which limits file size to 4GB. Some media players may fail to play videos
+   greater than 2GB because of their incorrect use of signed rather than
+   unsigned 32 bit values.
+
+   To record without a size limit, files are written in the OpenDML (AVI 2.0)
+   format. The file is a sequence of RIFF chunks of about 1GB each: the first
+   one is a normal AVI file, and the following 'AVIX' RIFFs only hold more
+   video and audio chunks. Players that don't know about OpenDML see only the
+   first RIFF, which still has its 'idx1' index.
+
+   All the chunks are indexed by standard indexes ('ix00' for the video and
+   'ix01' for the audio stream), which are written into the 'movi' lists as
+   soon as STD_INDEX_ENTRIES chunks of the stream are collected, and at the end
+   of each RIFF. The super index ('indx') of each stream in the header lists
+   them. As the header has room for SUPER_INDEX_ENTRIES standard indexes per
+   stream, the recording is stopped when they run out, which takes more than
+   a day and a half even with the largest frames.
+
+   The maximum recording duration therefore depends only on the free space on
+   the disk. The size of each encoded video frame depends on the complexity the
+   screen image. The RLE compression is based on scan lines, and performs best
+   when neighboring pixels on the scan line are the same color. Due to overhead
+   in the compression sceme itself, the best it can do is about 1500 bytes on a
    completely black screen. Complex screens where many neighboring pixels have
    different colors result in video frames of around 30k. This is still a
    significant savings over an uncompressed frame which would be 80k.
 
    For complex scenes, therefore, this results in about 8 minutes of video
-   recording per GB, or about 36 minutes when using the full 4GB file size. Less
-   complex video will provide more recording time. For example, recording the
-   unchanging BASIC prompt screen would result in about 6 hours of video.
+   recording per GB. Less complex video will provide more recording time. For
+   example, recording the unchanging BASIC prompt screen would result in about
+   6 hours of video per 4GB.
 
-   The video will automatically be stopped should the recording length approach
-   the file size limit. */
+   Memory use doesn't grow with the length of the recording: only the 'idx1'
+   entries of the first RIFF and the pending standard index entries are kept. */
 
 #define FRAME_INDEX_ALLOC_SIZE 1000
 static int num_frames_allocated;
@@ -79,9 +92,94 @@ static ULONG *frame_indexes;
 #define VIDEO_FRAME_FLAG 0x20000000
 #define AUDIO_FRAME_FLAG 0x40000000
 #define KEYFRAME_FLAG    0x80000000
+/* An entry of FRAME_INDEXES with neither VIDEO_FRAME_FLAG nor AUDIO_FRAME_FLAG
+   is the size of a standard index chunk, which is not listed in 'idx1'. */
+
+/* A new RIFF is started when the current one would grow beyond this size. */
+#define RIFF_SEGMENT_SIZE 0x40000000
+#define STD_INDEX_ENTRIES 16384
+#define SUPER_INDEX_ENTRIES 1024
+/* Sizes of the 'indx' chunk in each stream header and of the 'odml' LIST,
+   including the chunk headers. */
+#define SUPER_INDEX_CHUNK_SIZE (8 + 24 + SUPER_INDEX_ENTRIES * 16)
+#define ODML_LIST_SIZE (12 + 8 + 248)
+/* Set in the size of a standard index entry of a chunk that isn't a keyframe */
+#define STD_INDEX_DELTA_FRAME 0x80000000
+
+typedef struct {
+	CONTAINER_OFFSET_t offset; /* of the standard index chunk */
+	ULONG size; /* of the standard index chunk, including its header */
+	ULONG duration; /* of the indexed chunks, in stream ticks */
+} super_index_entry_t;
+
+typedef struct {
+	const char *chunk_id;
+	const char *index_id;
+	/* Entries of the next standard index: offset of the chunk data from the
+	   'movi' list of the current RIFF, and size of the chunk */
+	ULONG *entries;
+	int num_entries;
+	ULONG chunks_written;
+	ULONG indexed_length; /* Stream length already covered by the super index */
+	super_index_entry_t super_index[SUPER_INDEX_ENTRIES];
+	int super_index_used;
+} stream_t;
+
+static stream_t streams[2];
+static int num_streams;
 
+static int riff_count; /* 1 while writing the first RIFF, then number of RIFFs */
+/* Offset of the current RIFF in the file, which grows beyond what ftell()
+   can report */
+static CONTAINER_OFFSET_t riff_start;
+static ULONG riff_size; /* Bytes of the current RIFF written so far */
+static ULONG movi_start; /* Offset of the 'movi' identifier in the current RIFF */
+static ULONG first_riff_video_frames;
 
-static int num_streams;
+
+/* Returns the length of stream number INDEX in stream ticks: number of frames
+   for video, or the unit of the audio codec's length for audio. */
+static ULONG stream_length(int index)
+{
+#ifdef AUDIO_RECORDING
+	if (index == 1)
+		return audio_out->length;
+#endif
+	return streams[0].chunks_written;
+}
+
+/* AVI_WriteSuperIndex writes the 'indx' chunk of STREAM, always with room for
+   SUPER_INDEX_ENTRIES entries so that the header size doesn't change. */
+static void AVI_WriteSuperIndex(FILE *fp, const stream_t *stream)
+{
+	int i;
+
+	fputs("indx", fp);
+	fputl(24 + SUPER_INDEX_ENTRIES * 16, fp);
+	fputw(4, fp); /* longs per entry */
+	fputc(0, fp); /* index sub type */
+	fputc(0, fp); /* index type: AVI_INDEX_OF_INDEXES */
+	fputl(stream->super_index_used, fp); /* entries in use */
+	fputs(stream->chunk_id, fp);
+	fputl(0, fp); /* reserved */
+	fputl(0, fp);
+	fputl(0, fp);
+	for (i = 0; i < SUPER_INDEX_ENTRIES; i++) {
+		if (i < stream->super_index_used) {
+			const super_index_entry_t *entry = &stream->super_index[i];
+			fputl(entry->offset.low, fp);
+			fputl(entry->offset.high, fp);
+			fputl(entry->size, fp);
+			fputl(entry->duration, fp);
+		}
+		else {
+			fputl(0, fp);
+			fputl(0, fp);
+			fputl(0, fp);
+			fputl(0, fp);
+		}
+	}
+}
 
 
 /* AVI_WriteHeader creates and writes out the file header. Note that this
@@ -106,12 +204,13 @@ static int AVI_WriteHeader(FILE *fp) {
 	fputs("LIST", fp);
 
 	/* total header size includes hdrl identifier plus avih size PLUS the video stream
-	   header which is (strl header LIST + (strh + strf + strn)) */
-	list_size = 4 + 8 + 56 + (12 + (8 + 56 + 8 + 40 + 256*4 + 8 + 16));
+	   header which is (strl header LIST + (strh + strf + indx + strn)) PLUS the
+	   odml LIST */
+	list_size = 4 + 8 + 56 + (12 + (8 + 56 + 8 + 40 + 256*4 + SUPER_INDEX_CHUNK_SIZE + 8 + 16)) + ODML_LIST_SIZE;
 
 #ifdef AUDIO_RECORDING
-	/* if audio is included, add size of audio stream strl header LIST + (strh + strf + strn) */
-	if (num_streams == 2) list_size += 12 + (8 + 56 + 8 + 18 + audio_out->extra_data_size + 8 + 12);
+	/* if audio is included, add size of audio stream strl header LIST + (strh + strf + indx + strn) */
+	if (num_streams == 2) list_size += 12 + (8 + 56 + 8 + 18 + audio_out->extra_data_size + SUPER_INDEX_CHUNK_SIZE + 8 + 12);
 #endif
 
 	fputl(list_size, fp); /* length of header payload */
@@ -128,7 +227,7 @@ static int AVI_WriteHeader(FILE *fp) {
 	fputl(image_codec_width * image_codec_height * 3, fp); /* approximate bytes per second of video + audio FIXME: should likely be (width * height * 3 + audio) * fps */
 	fputl(0, fp); /* reserved */
 	fputl(0x10, fp); /* flags; 0x10 indicates the index at the end of the file */
-	fputl(video_frame_count, fp); /* number of frames in the video */
+	fputl(first_riff_video_frames, fp); /* number of frames in the first RIFF */
 	fputl(0, fp); /* initial frames, always zero for us */
 	fputl(num_streams, fp); /* 2 = video and audio, 1 = video only */
 	fputl(image_codec_width * image_codec_height * 3, fp); /* suggested buffer size */
@@ -144,7 +243,7 @@ static int AVI_WriteHeader(FILE *fp) {
 	/* 12 bytes for video stream strl LIST chuck header; LIST payload size includes the
 	   4 bytes of the 'strl' identifier plus the strh + strf + strn sizes */
 	fputs("LIST", fp);
-	fputl(4 + 8 + 56 + 8 + 40 + 256*4 + 8 + 16, fp);
+	fputl(4 + 8 + 56 + 8 + 40 + 256*4 + SUPER_INDEX_CHUNK_SIZE + 8 + 16, fp);
 	fputs("strl", fp);
 
 	/* Stream header format is document at https://docs.microsoft.com/en-us/previous-versions/windows/desktop/api/avifmt/ns-avifmt-avistreamheader */
@@ -195,6 +294,8 @@ static int AVI_WriteHeader(FILE *fp) {
 		fputc(0, fp);
 	}
 
+	AVI_WriteSuperIndex(fp, &streams[0]);
+
 	/* 8 bytes for stream name indicator */
 	fputs("strn", fp);
 	fputl(16, fp); /* length of name */
@@ -215,7 +316,7 @@ static int AVI_WriteHeader(FILE *fp) {
 		/* 12 bytes for audio stream strl LIST chuck header; LIST payload size includes the
 		4 bytes of the 'strl' identifier plus the strh + strf + strn sizes */
 		fputs("LIST", fp);
-		fputl(4 + 8 + 56 + 8 + 18 + audio_out->extra_data_size + 8 + 12, fp);
+		fputl(4 + 8 + 56 + 8 + 18 + audio_out->extra_data_size + SUPER_INDEX_CHUNK_SIZE + 8 + 12, fp);
 		fputs("strl", fp);
 
 		/* stream header format is same as video above even when used for audio */
@@ -257,6 +358,8 @@ static int AVI_WriteHeader(FILE *fp) {
 			fwrite(audio_out->extra_data, audio_out->extra_data_size, 1, fp);
 		}
 
+		AVI_WriteSuperIndex(fp, &streams[1]);
+
 		/* 8 bytes for stream name indicator */
 		fputs("strn", fp);
 		fputl(12, fp); /* length of name */
@@ -267,6 +370,18 @@ static int AVI_WriteHeader(FILE *fp) {
 	}
 #endif /* AUDIO_RECORDING */
 
+	/* OpenDML extended header, documented in the OpenDML AVI File Format
+	   Extensions. Only the total number of frames is used. */
+	fputs("LIST", fp);
+	fputl(ODML_LIST_SIZE - 8, fp);
+	fputs("odml", fp);
+	fputs("dmlh", fp);
+	fputl(248, fp);
+	fputl(video_frame_count, fp); /* number of frames in all RIFFs */
+	for (i = 0; i < 61; i++) {
+		fputl(0, fp); /* reserved */
+	}
+
 	/* audia/video data */
 
 	/* 8 bytes for audio/video stream LIST chuck header; LIST payload is the
@@ -274,7 +389,7 @@ static int AVI_WriteHeader(FILE *fp) {
 	  frame of video and the corresponding audio. */
 	fputs("LIST", fp);
 	fputl(size_movi, fp); /* length of all video and audio chunks */
-	size_movi = ftell(fp); /* start of movi payload, will finalize after all chunks written */
+	movi_start = ftell(fp); /* start of movi payload, will finalize after all chunks written */
 	fputs("movi", fp);
 
 	return (ftell(fp) == 12 + 8 + list_size + 12);
@@ -287,8 +402,10 @@ static int AVI_WriteHeader(FILE *fp) {
 
    RETURNS: file pointer if successful, NULL if failure during open
    */
-static int AVI_Prepare(FILE *fp)
+static int AVI_Prepare(FILE *fp, const char *filename)
 {
+	int i;
+
 #ifdef AUDIO_RECORDING
 	if (audio_codec) {
 		num_streams = 2;
@@ -299,20 +416,38 @@ static int AVI_Prepare(FILE *fp)
 		num_streams = 1;
 	}
 
+	streams[0].chunk_id = "00dc"; /* stream 0, compressed video frames */
+	streams[0].index_id = "ix00";
+	streams[1].chunk_id = "01wb"; /* stream 1, audio data */
+	streams[1].index_id = "ix01";
+	for (i = 0; i < num_streams; i++) {
+		streams[i].entries = (ULONG *)Util_malloc(STD_INDEX_ENTRIES * 2 * sizeof(ULONG));
+		streams[i].num_entries = 0;
+		streams[i].chunks_written = 0;
+		streams[i].indexed_length = 0;
+		streams[i].super_index_used = 0;
+	}
+
 	/* some variables must exist before the call to WriteHeader */
 	size_riff = 0;
 	size_movi = 0;
+	riff_count = 1;
+	riff_start.low = riff_start.high = 0;
+	first_riff_video_frames = 0;
 	if (!AVI_WriteHeader(fp)) {
 		File_Export_SetErrorMessage("Failed writing AVI header");
 		return 0;
 	}
+	riff_size = ftell(fp);
 
 	/* set up video statistics */
 	frames_written = 0;
 
-	byteswritten = ftell(fp) + 8; /* current size + index header */
+	/* current size + index header */
+	byteswritten.low = riff_size + 8;
+	byteswritten.high = 0;
 
-	/* allocate space for index which is written at the end of the file */
+	/* allocate space for index which is written at the end of the first RIFF */
 	num_frames_allocated = FRAME_INDEX_ALLOC_SIZE;
 	frame_indexes = (ULONG *)Util_malloc(num_frames_allocated * sizeof(ULONG));
 	memset(frame_indexes, 0, num_frames_allocated * sizeof(ULONG));
@@ -320,47 +455,237 @@ static int AVI_Prepare(FILE *fp)
 	return 1;
 }
 
+/* Adds ENTRY to the 'idx1' index of the first RIFF. */
+static void add_frame_index(ULONG entry)
+{
+	frame_indexes[frames_written] = entry;
+	frames_written++;
+	if (frames_written >= num_frames_allocated) {
+		num_frames_allocated += FRAME_INDEX_ALLOC_SIZE;
+		frame_indexes = (ULONG *)Util_realloc(frame_indexes, num_frames_allocated * sizeof(ULONG));
+	}
+}
+
+/* AVI_WriteStdIndex writes the collected standard index entries of STREAM in
+   an 'ix##' chunk at the current position of the 'movi' list, and adds the
+   chunk to the stream's super index.
+
+   RETURNS: TRUE if the index was written, FALSE if not or if the super index
+   is full
+   */
+static int AVI_WriteStdIndex(FILE *fp, stream_t *stream)
+{
+	int i;
+	ULONG size;
+	ULONG length;
+	CONTAINER_OFFSET_t base;
+	super_index_entry_t *entry;
+
+	if (stream->num_entries == 0) return 1;
+	if (stream->super_index_used >= SUPER_INDEX_ENTRIES) return 0;
+
+	/* The standard index format is documented in the OpenDML AVI File Format
+	   Extensions as AVISTDINDEX */
+	size = 24 + stream->num_entries * 8;
+	base = riff_start;
+	CONTAINER_AddOffset(&base, movi_start);
+
+	fputs(stream->index_id, fp);
+	fputl(size, fp);
+	fputw(2, fp); /* longs per entry */
+	fputc(0, fp); /* index sub type */
+	fputc(1, fp); /* index type: AVI_INDEX_OF_CHUNKS */
+	fputl(stream->num_entries, fp); /* entries in use */
+	fputs(stream->chunk_id, fp);
+	fputl(base.low, fp); /* base offset of the entries: the 'movi' list */
+	fputl(base.high, fp);
+	fputl(0, fp); /* reserved */
+	for (i = 0; i < stream->num_entries * 2; i++) {
+		fputl(stream->entries[i], fp);
+	}
+
+	entry = &stream->super_index[stream->super_index_used++];
+	entry->offset = riff_start;
+	CONTAINER_AddOffset(&entry->offset, riff_size);
+	entry->size = 8 + size;
+	length = stream_length(stream - streams);
+	entry->duration = length - stream->indexed_length;
+	stream->indexed_length = length;
+	stream->num_entries = 0;
+
+	if (riff_count == 1) {
+		/* 'idx1' offsets must skip the chunk */
+		add_frame_index(size);
+	}
+	riff_size += 8 + size;
+	/* the entries were counted by AVI_WriteFrame */
+	CONTAINER_AddOffset(&byteswritten, 8 + 24);
+
+	return !ferror(fp);
+}
+
+/* AVI_WriteIndex writes the 'idx1' index of the first RIFF, following its
+   'movi' list. */
+static int AVI_WriteIndex(FILE *fp) {
+	int i;
+	int offset;
+	int size;
+	int index_size;
+	ULONG index;
+	int is_keyframe;
+
+	index_size = 0;
+	for (i = 0; i < frames_written; i++) {
+		if (frame_indexes[i] & (VIDEO_FRAME_FLAG | AUDIO_FRAME_FLAG))
+			index_size += 16;
+	}
+	if (index_size == 0) return 0;
+
+	offset = 4;
+
+	/* The index format used here is tag 'idx1" (index version 1.0) & documented at
+	https://docs.microsoft.com/en-us/previous-versions/windows/desktop/api/Aviriff/ns-aviriff-avioldindex
+	*/
+
+	fputs("idx1", fp);
+	fputl(index_size, fp);
+
+	for (i = 0; i < frames_written; i++) {
+		index = frame_indexes[i];
+		is_keyframe = index & KEYFRAME_FLAG ? 0x10 : 0;
+		size = index & FRAME_SIZE_MASK;
+		if (index & (VIDEO_FRAME_FLAG | AUDIO_FRAME_FLAG)) {
+			if (index & VIDEO_FRAME_FLAG)
+				fputs("00dc", fp); /* stream 0, a compressed video frame */
+			else
+				fputs("01wb", fp); /* stream 1, audio data */
+			fputl(is_keyframe, fp); /* flags: is a keyframe */
+			fputl(offset, fp); /* offset in bytes from start of the 'movi' list */
+			fputl(size, fp); /* size of frame */
+		}
+		offset += size + 8 + (size % 2); /* make sure to word-align next offset */
+	}
+
+	riff_size += 8 + index_size;
+	CONTAINER_AddOffset(&byteswritten, 8 + index_size);
+	return !ferror(fp);
+}
+
+/* AVI_CloseRiff ends the current RIFF: it writes the pending standard indexes
+   and the sizes of the RIFF and its 'movi' list. The first RIFF also gets its
+   'idx1' index, and its sizes are in the header. */
+static int AVI_CloseRiff(FILE *fp)
+{
+	int i;
+
+	for (i = 0; i < num_streams; i++) {
+		if (!AVI_WriteStdIndex(fp, &streams[i])) return 0;
+	}
+
+	if (riff_count == 1) {
+		size_movi = riff_size - movi_start; /* movi payload ends here */
+		if (!AVI_WriteIndex(fp)) {
+			return 0;
+		}
+		size_riff = riff_size - 8;
+		if (!AVI_WriteHeader(fp)) {
+			return 0;
+		}
+	}
+	else {
+		/* Seek relative to the end, as the RIFF may be beyond the range of
+		   fseek(). */
+		if (fseek(fp, -(long)(riff_size - 4), SEEK_CUR) != 0) return 0;
+		fputl(riff_size - 8, fp);
+		if (fseek(fp, movi_start - 12, SEEK_CUR) != 0) return 0;
+		fputl(riff_size - movi_start, fp);
+	}
+	return fseek(fp, 0, SEEK_END) == 0 && !ferror(fp);
+}
+
+/* AVI_StartRiff ends the current RIFF and starts an 'AVIX' RIFF, whose 'movi'
+   list continues the streams. */
+static int AVI_StartRiff(FILE *fp)
+{
+	if (!AVI_CloseRiff(fp)) return 0;
+
+	if (riff_count == 1) {
+		/* only the first RIFF is indexed by 'idx1' */
+		free(frame_indexes);
+		frame_indexes = NULL;
+		num_frames_allocated = 0;
+	}
+	CONTAINER_AddOffset(&riff_start, riff_size);
+	riff_count++;
+
+	fputs("RIFF", fp);
+	fputl(0, fp); /* length of the RIFF minus 8 bytes, written by AVI_CloseRiff */
+	fputs("AVIX", fp);
+	fputs("LIST", fp);
+	fputl(0, fp); /* length of all video and audio chunks */
+	fputs("movi", fp);
+	riff_size = 24;
+	movi_start = 20;
+	CONTAINER_AddOffset(&byteswritten, 24);
+
+	return !ferror(fp);
+}
+
 /* AVI_WriteFrame writes out a single frame of video or audio, and saves the
-   index data for the end-of-file index chunk */
+   index data for the index chunks */
 static int AVI_WriteFrame(FILE *fp, const UBYTE *buf, int size, int frame_type, int is_keyframe) {
 	int padding;
 	int frame_size;
-	int expected_frame_size;
+	stream_t *stream;
 
-	frame_size = ftell(fp);
+	stream = &streams[frame_type == VIDEO_FRAME_FLAG ? 0 : 1];
 
 	/* AVI chunks must be word-aligned, i.e. lengths must be multiples of 2 bytes.
 	   If the size is an odd number, the data is padded with a zero but the length
 	   value still reports the actual length, not the padded length */
 	padding = size % 2;
-	if (frame_type == VIDEO_FRAME_FLAG) {
-		fputs("00dc", fp);
+	frame_size = 8 + size + padding;
+
+	if (riff_size + frame_size > RIFF_SEGMENT_SIZE) {
+		if (!AVI_StartRiff(fp)) {
+			File_Export_SetErrorMessage("Failed starting AVI RIFF");
+			return 0;
+		}
 	}
-	else {
-		fputs("01wb", fp);
+	if (stream->num_entries >= STD_INDEX_ENTRIES && !AVI_WriteStdIndex(fp, stream)) {
+		File_Export_SetErrorMessage("Failed writing AVI index");
+		return 0;
 	}
+
+	fputs(stream->chunk_id, fp);
 	fputl(size, fp);
 	fwrite(buf, 1, size, fp);
 	if (padding) {
 		fputc(0, fp);
 	}
-	expected_frame_size = 8 + size + padding;
 
-	size |= frame_type;
-	if (is_keyframe) size |= KEYFRAME_FLAG;
-	frame_indexes[frames_written] = size;
-	frames_written++;
-	if (frames_written >= num_frames_allocated) {
-		num_frames_allocated += FRAME_INDEX_ALLOC_SIZE;
-		frame_indexes = (ULONG *)Util_realloc(frame_indexes, num_frames_allocated * sizeof(ULONG));
+	stream->entries[stream->num_entries * 2] = riff_size - movi_start + 8;
+	stream->entries[stream->num_entries * 2 + 1] = is_keyframe ? size : size | STD_INDEX_DELTA_FRAME;
+	stream->num_entries++;
+	stream->chunks_written++;
+
+	if (riff_count == 1) {
+		size |= frame_type;
+		if (is_keyframe) size |= KEYFRAME_FLAG;
+		add_frame_index(size);
+		if (frame_type == VIDEO_FRAME_FLAG)
+			first_riff_video_frames++;
+		/* 16 bytes for the 'idx1' entry */
+		CONTAINER_AddOffset(&byteswritten, 16);
 	}
 
-	/* update size limit calculation including the 16 bytes needed for each index entry */
-	frame_size = ftell(fp) - frame_size;
-	byteswritten += frame_size + 16;
+	/* update size calculation including the 8 bytes needed for the standard
+	   index entry */
+	riff_size += frame_size;
+	CONTAINER_AddOffset(&byteswritten, frame_size + 8);
 
-	/* check expected file data written equals the calculated size */
-	return frame_size == expected_frame_size;
+	/* check the frame was written */
+	return !ferror(fp);
 }
 
 /* AVI_VideoFrame adds a video frame to the stream and updates the video
@@ -377,49 +702,16 @@ static int AVI_AudioFrame(FILE *fp, const UBYTE *buf, int bufsize) {
 }
 #endif
 
-static int AVI_WriteIndex(FILE *fp) {
+/* The file size is limited only by the room in the super indexes. Two entries
+   are kept for the standard indexes written while the file is closed. */
+static int AVI_SizeCheck(int size) {
 	int i;
-	int offset;
-	int size;
-	int index_size;
-	int chunk_size;
-	ULONG index;
-	int is_keyframe;
-
-	if (frames_written == 0) return 0;
-
-	chunk_size = ftell(fp);
-	offset = 4;
-	index_size = frames_written * 16;
-
-	/* The index format used here is tag 'idx1" (index version 1.0) & documented at
-	https://docs.microsoft.com/en-us/previous-versions/windows/desktop/api/Aviriff/ns-aviriff-avioldindex
-	*/
 
-	fputs("idx1", fp);
-	fputl(index_size, fp);
-
-	for (i = 0; i < frames_written; i++) {
-		index = frame_indexes[i];
-		is_keyframe = index & KEYFRAME_FLAG ? 0x10 : 0;
-		size = index & FRAME_SIZE_MASK;
-		if (index & VIDEO_FRAME_FLAG)
-			fputs("00dc", fp); /* stream 0, a compressed video frame */
-		else
-			fputs("01wb", fp); /* stream 1, audio data */
-		fputl(is_keyframe, fp); /* flags: is a keyframe */
-		fputl(offset, fp); /* offset in bytes from start of the 'movi' list */
-		fputl(size, fp); /* size of frame */
-		offset += size + 8 + (size % 2); /* make sure to word-align next offset */
+	for (i = 0; i < num_streams; i++) {
+		if (streams[i].super_index_used >= SUPER_INDEX_ENTRIES - 2)
+			return 0;
 	}
-
-	chunk_size = ftell(fp) - chunk_size;
-	byteswritten += chunk_size;
-	return (chunk_size == 8 + index_size);
-}
-
-static int AVI_SizeCheck(int size) {
-	return size < MAX_RIFF_FILE_SIZE;
+	return 1;
 }
 
 /* AVI_Finalize must be called to create a valid AVI file, because the header
@@ -430,25 +722,25 @@ static int AVI_SizeCheck(int size) {
    */
 static int AVI_Finalize(FILE *fp)
 {
-	int result = 1;
+	int result;
+	int i;
 
-	size_movi = ftell(fp) - size_movi; /* movi payload ends here */
-	result = AVI_WriteIndex(fp);
-	if (result > 0) {
-		size_riff = ftell(fp) - 8;
+	result = AVI_CloseRiff(fp);
+	if (result && riff_count > 1) {
+		/* update the super indexes and lengths */
 		result = AVI_WriteHeader(fp);
-
-		if (!result) {
-			Log_print("Failed writing AVI header; file will not be playable.");
-		}
 	}
-	else {
+	if (!result) {
 		Log_print("Failed writing AVI index; file will not be playable.");
 	}
 
 	free(frame_indexes);
 	frame_indexes = NULL;
 	num_frames_allocated = 0;
+	for (i = 0; i < num_streams; i++) {
+		free(streams[i].entries);
+		streams[i].entries = NULL;
+	}
 	return result;
 }
 
@@ -38,7 +38,7 @@
 /* MP3_Prepare just returns because the only thing in a constant bitrate MP3
    file is a concatenation of MP3 frames.
    */
-static int MP3_Prepare(FILE *fp)
+static int MP3_Prepare(FILE *fp, const char *filename)
 {
 	if (strcmp(audio_codec->codec_id, "mp3") != 0) {
 		File_Export_SetErrorMessageArg("Can't store %s in mp3 file", audio_codec->codec_id);
@@ -44,7 +44,7 @@ static int fact_chunk_size;
 
    RETURNS: TRUE if file opened with no problems, FALSE if failure during open
    */
-static int WAV_Prepare(FILE *fp)
+static int WAV_Prepare(FILE *fp, const char *filename)
 {
 	/*
 	The RIFF header:
@@ -147,9 +147,11 @@ static int WAV_Finalize(FILE *fp)
 {
 	int result = TRUE;
 	char aligned = 0;
+	/* WAV_SizeCheck keeps the file below 4GB. */
+	ULONG data_size = byteswritten.low;
 
 	/* A RIFF file's chunks must be word-aligned. So let's align. */
-	if (byteswritten & 1) {
+	if (data_size & 1) {
 		fputc(0, fp);
 		aligned = 1;
 	}
@@ -159,11 +161,11 @@ static int WAV_Finalize(FILE *fp)
 	/* RIFF header's size field must equal the size of all chunks with
 		alignment, so the alignment byte is added. */
 	fseek(fp, 4, SEEK_SET);	/* Seek past RIFF */
-	fputl(byteswritten + 36 + aligned, fp);
+	fputl(data_size + 36 + aligned, fp);
 
 	/* Alignment byte is ignored in the "data" chunk size field. */
 	fseek(fp, 40 + audio_out->extra_data_size + fact_chunk_size, SEEK_SET);
-	fputl(byteswritten, fp);
+	fputl(data_size, fp);
 
 	if (fact_chunk_size) {
 		/* number of samples is needed in non-PCM formats */
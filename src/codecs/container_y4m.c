@@ -0,0 +1,214 @@
+/*
+ * container_y4m.c - support for YUV4MPEG2 video streams
+ *
+ * Copyright (C) 2026 Atari800 development team (see DOC/CREDITS)
+ *
+ * This file is part of the Atari800 emulator project which emulates
+ * the Atari 400, 800, 800XL, 130XE, and 5200 8-bit computers.
+ *
+ * Atari800 is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Atari800 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Atari800; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+/* This file is only compiled when VIDEO_RECORDING is defined. */
+
+#define _POSIX_C_SOURCE 200112L /* for fileno */
+#include "config.h"
+#include <stdio.h>
+#include <string.h>
+#if defined(HAVE_WRITEV) && defined(HAVE_SYS_UIO_H)
+#include <errno.h>
+#include <sys/uio.h>
+#define USE_WRITEV
+#endif
+#include "file_export.h"
+#include "util.h"
+#include "log.h"
+#include "codecs/container.h"
+#include "codecs/container_y4m.h"
+#include "codecs/image.h"
+#include "codecs/video.h"
+#ifdef AUDIO_RECORDING
+#include "codecs/audio.h"
+#endif
+
+/* A YUV4MPEG2 stream is a one line text header followed by the raw frames,
+   each with its own short header. Nothing is ever sought back to, so the file
+   may be a named pipe read by an external encoder, e.g.
+
+       mkfifo atari.y4m; ffmpeg -i atari.y4m out.mkv & atari800 -record atari.y4m
+
+   The format has no place for audio. The samples are written as raw PCM to a
+   companion file of the same name with the extension .pcm; its format is
+   printed when the recording starts. The companion is opened after the video
+   header is written, so a reader of two named pipes must open the video
+   stream first. */
+
+static const char frame_header[] = "FRAME\n";
+
+#ifdef AUDIO_RECORDING
+static FILE *audio_fp = NULL;
+
+/* Stores FILENAME with its extension replaced by .pcm into AUDIO_FILENAME. */
+static int audio_filename(char *audio_filename, const char *filename)
+{
+	const char *dot = strrchr(filename, '.');
+	size_t length = dot != NULL ? (size_t)(dot - filename) : strlen(filename);
+
+	if (length + 5 > FILENAME_MAX)
+		return FALSE;
+	memcpy(audio_filename, filename, length);
+	strcpy(audio_filename + length, ".pcm");
+	return TRUE;
+}
+#endif
+
+#ifdef USE_WRITEV
+/* Writes all COUNT buffers of IOV to FD, continuing after partial writes,
+   which are normal when FD is a pipe. Modifies IOV. */
+static int write_vector(int fd, struct iovec *iov, int count)
+{
+	while (count > 0) {
+		ssize_t written = writev(fd, iov, count);
+		if (written < 0) {
+			if (errno == EINTR)
+				continue;
+			return FALSE;
+		}
+		while (count > 0 && (size_t)written >= iov->iov_len) {
+			written -= iov->iov_len;
+			iov++;
+			count--;
+		}
+		if (count > 0) {
+			iov->iov_base = (char *)iov->iov_base + written;
+			iov->iov_len -= written;
+		}
+	}
+	return TRUE;
+}
+#endif
+
+/* Y4M_Prepare writes the stream header, and opens the companion audio file. */
+static int Y4M_Prepare(FILE *fp, const char *filename)
+{
+	if (strcmp(video_codec->codec_id, "yuv") != 0) {
+		File_Export_SetErrorMessageArg("Can't store %s in y4m file", video_codec->codec_id);
+		return 0;
+	}
+
+	/* The frame rate is given in the same units as the AVI stream rate. */
+	fprintf(fp, "YUV4MPEG2 W%d H%d F%lu:1000000 Ip C444\n",
+	        image_codec_width, image_codec_height, (unsigned long)(fps * 1000000));
+	if (fflush(fp) != 0) {
+		File_Export_SetErrorMessage("Failed writing y4m header");
+		return 0;
+	}
+
+#ifdef AUDIO_RECORDING
+	if (audio_fp) {
+		/* left open by a recording that failed */
+		fclose(audio_fp);
+		audio_fp = NULL;
+	}
+	if (audio_codec) {
+		char pcm_filename[FILENAME_MAX];
+
+		if (!audio_filename(pcm_filename, filename)
+		    || (audio_fp = fopen(pcm_filename, "wb")) == NULL) {
+			File_Export_SetErrorMessage("Can't write audio of y4m file");
+			return 0;
+		}
+		Log_print("Audio of %s: %s, raw %s, %d Hz, %d channel(s)", filename, pcm_filename,
+		          audio_out->sample_size == 2 ? "16 bit signed little-endian" : "8 bit unsigned",
+		          audio_out->sample_rate, audio_out->num_channels);
+	}
+#endif
+	return 1;
+}
+
+#ifdef AUDIO_RECORDING
+/* Y4M_AudioFrame appends the samples to the companion audio file. */
+static int Y4M_AudioFrame(FILE *fp, const UBYTE *buf, int bufsize)
+{
+	if (audio_fp == NULL || (int)fwrite(buf, 1, bufsize, audio_fp) < bufsize) {
+		File_Export_SetErrorMessage("Failed writing y4m audio file");
+		return 0;
+	}
+	return 1;
+}
+#endif
+
+/* Y4M_VideoFrame writes the frame header and the planes. With writev() both go
+   straight from the codec's buffer to the file in one system call, without
+   being copied into the stdio buffer first. The header was flushed already,
+   and nothing else goes through the stdio buffer of FP afterwards. */
+static int Y4M_VideoFrame(FILE *fp, const UBYTE *buf, int bufsize, int is_keyframe)
+{
+#ifdef USE_WRITEV
+	struct iovec iov[2];
+
+	iov[0].iov_base = (void *)frame_header;
+	iov[0].iov_len = sizeof(frame_header) - 1;
+	iov[1].iov_base = (void *)buf;
+	iov[1].iov_len = bufsize;
+	if (!write_vector(fileno(fp), iov, 2)) {
+#else
+	if (fwrite(frame_header, 1, sizeof(frame_header) - 1, fp) < sizeof(frame_header) - 1
+	    || (int)fwrite(buf, 1, bufsize, fp) < bufsize) {
+#endif
+		File_Export_SetErrorMessage("Failed writing to y4m file");
+		return 0;
+	}
+	return 1;
+}
+
+/* Y4M doesn't have a size limit, and the size of a pipe isn't known anyway. */
+static int Y4M_SizeCheck(int size)
+{
+	return 1;
+}
+
+/* Y4M_Finalize closes the companion audio file; the stream itself needs no
+   trailer. */
+static int Y4M_Finalize(FILE *fp)
+{
+	int result = 1;
+
+#ifdef AUDIO_RECORDING
+	if (audio_fp) {
+		if (fclose(audio_fp) != 0) {
+			Log_print("Error closing y4m audio file");
+			result = 0;
+		}
+		audio_fp = NULL;
+	}
+#endif
+	return result;
+}
+
+CONTAINER_t Container_Y4M = {
+	"y4m",
+	"YUV4MPEG2 video stream",
+	&Y4M_Prepare,
+#ifdef AUDIO_RECORDING
+	&Y4M_AudioFrame,
+#else
+	NULL,
+#endif
+	&Y4M_VideoFrame,
+	&Y4M_SizeCheck,
+	&Y4M_Finalize,
+};
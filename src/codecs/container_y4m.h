@@ -0,0 +1,9 @@
+#ifndef CODECS_CONTAINER_Y4M_H_
+#define CODECS_CONTAINER_Y4M_H_
+
+#include "atari.h"
+#include "codecs/container.h"
+
+extern CONTAINER_t Container_Y4M;
+
+#endif /* CODECS_CONTAINER_Y4M_H_ */
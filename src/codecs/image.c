@@ -25,6 +25,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include "screen.h"
+#include "colours.h"
 #include "cfg.h"
 #include "util.h"
 #include "log.h"
@@ -54,7 +55,7 @@ static IMAGE_CODEC_t *known_image_codecs[] = {
 };
 
 
-static IMAGE_CODEC_t *match_image_codec(const char *id)
+IMAGE_CODEC_t *CODECS_IMAGE_Match(const char *id)
 {
 	IMAGE_CODEC_t **v = known_image_codecs;
 	IMAGE_CODEC_t *found = NULL;
@@ -70,24 +71,36 @@ static IMAGE_CODEC_t *match_image_codec(const char *id)
 }
 
 
-void CODECS_IMAGE_SetMargins(void)
+void CODECS_IMAGE_GetScreen(IMAGE_CODEC_SCREEN_t *screen)
 {
 #ifdef SUPPORTS_CHANGE_VIDEOMODE
-	image_codec_left_margin = VIDEOMODE_src_offset_left;
-	image_codec_width = VIDEOMODE_src_offset_left + VIDEOMODE_src_width - image_codec_left_margin;
+	screen->left_margin = VIDEOMODE_src_offset_left;
+	screen->width = VIDEOMODE_src_width;
 #else
-	image_codec_left_margin = Screen_visible_x1;
-	image_codec_width = Screen_visible_x2 - image_codec_left_margin;
+	screen->left_margin = Screen_visible_x1;
+	screen->width = Screen_visible_x2 - Screen_visible_x1;
 #endif
-	image_codec_top_margin = Screen_visible_y1;
-	image_codec_height = Screen_visible_y2 - image_codec_top_margin;
+	screen->top_margin = Screen_visible_y1;
+	screen->height = Screen_visible_y2 - Screen_visible_y1;
+	screen->colours = Colours_table;
+}
+
+void CODECS_IMAGE_SetMargins(void)
+{
+	IMAGE_CODEC_SCREEN_t screen;
+
+	CODECS_IMAGE_GetScreen(&screen);
+	image_codec_left_margin = screen.left_margin;
+	image_codec_top_margin = screen.top_margin;
+	image_codec_width = screen.width;
+	image_codec_height = screen.height;
 }
 
 /* Sets the global image_codec if the filename has an extension that matches a known
    image codec. Also sets the margins so the codec is ready to save images */
 int CODECS_IMAGE_Init(const char *filename)
 {
-	image_codec = match_image_codec(filename);
+	image_codec = CODECS_IMAGE_Match(filename);
 	CODECS_IMAGE_SetMargins();
 	return (image_codec != NULL);
 }
@@ -3,11 +3,24 @@
 
 #include "atari.h"
 
+/* Part of the screen that is saved, and its colours */
+typedef struct {
+	int left_margin;
+	int top_margin;
+	int width;
+	int height;
+	const int *colours; /* 256 entries, in the format of Colours_table */
+} IMAGE_CODEC_SCREEN_t;
+
+#define IMAGE_CODEC_GetR(screen, x) ((UBYTE) ((screen)->colours[x] >> 16))
+#define IMAGE_CODEC_GetG(screen, x) ((UBYTE) ((screen)->colours[x] >> 8))
+#define IMAGE_CODEC_GetB(screen, x) ((UBYTE) (screen)->colours[x])
+
 /* Save current screen (possibly interlaced) to a file */
-typedef int (*IMAGE_CODEC_SaveToFile)(FILE *fp, UBYTE *ptr1, UBYTE *ptr2);
+typedef int (*IMAGE_CODEC_SaveToFile)(FILE *fp, const IMAGE_CODEC_SCREEN_t *screen, UBYTE *ptr1, UBYTE *ptr2);
 
 /* Save current screen (possibly interlaced) to a buffer */
-typedef int (*IMAGE_CODEC_SaveToBuffer)(UBYTE *buf, int bufsize, UBYTE *ptr1, UBYTE *ptr2);
+typedef int (*IMAGE_CODEC_SaveToBuffer)(UBYTE *buf, int bufsize, const IMAGE_CODEC_SCREEN_t *screen, UBYTE *ptr1, UBYTE *ptr2);
 
 typedef struct {
     char *codec_id;
@@ -22,6 +35,11 @@ extern int image_codec_top_margin;
 extern int image_codec_width;
 extern int image_codec_height;
 
+/* Returns the codec matching the extension of FILENAME, or NULL. Unlike
+   CODECS_IMAGE_Init(), it doesn't change image_codec or the margins. */
+IMAGE_CODEC_t *CODECS_IMAGE_Match(const char *filename);
+/* Fills SCREEN with the visible part of the screen and the current colours. */
+void CODECS_IMAGE_GetScreen(IMAGE_CODEC_SCREEN_t *screen);
 void CODECS_IMAGE_SetMargins(void);
 int CODECS_IMAGE_Init(const char *filename);
 int CODECS_IMAGE_SaveScreen(FILE *fp, UBYTE *ptr1, UBYTE *ptr2);
@@ -43,12 +43,13 @@
    format.
 
    fp:          file pointer of file open for writing
+   screen:      part of the screen to save and its colours
    ptr1:        pointer to Screen_atari
    ptr2:        (optional) pointer to another array of size Screen_atari containing
                 the interlaced scan lines to blend with ptr1. Set to NULL if no
 				interlacing.
 */
-static int PCX_SaveScreen(FILE *fp, UBYTE *ptr1, UBYTE *ptr2)
+static int PCX_SaveScreen(FILE *fp, const IMAGE_CODEC_SCREEN_t *screen, UBYTE *ptr1, UBYTE *ptr2)
 {
 	int i;
 	int x;
@@ -63,29 +64,29 @@ static int PCX_SaveScreen(FILE *fp, UBYTE *ptr1, UBYTE *ptr2)
 	fputc(0x8, fp);   /* bits per pixel */
 	fputw(0, fp);     /* XMin */
 	fputw(0, fp);     /* YMin */
-	fputw(image_codec_width - 1, fp); /* XMax */
-	fputw(image_codec_height - 1, fp);        /* YMax */
+	fputw(screen->width - 1, fp); /* XMax */
+	fputw(screen->height - 1, fp);        /* YMax */
 	fputw(0, fp);     /* HRes */
 	fputw(0, fp);     /* VRes */
 	for (i = 0; i < 48; i++)
 		fputc(0, fp); /* EGA color palette */
 	fputc(0, fp);     /* reserved */
 	fputc(ptr2 != NULL ? 3 : 1, fp); /* number of bit planes */
-	fputw(image_codec_width, fp);  /* number of bytes per scan line per color plane */
+	fputw(screen->width, fp);  /* number of bytes per scan line per color plane */
 	fputw(1, fp);     /* palette info */
-	fputw(image_codec_width, fp); /* screen resolution */
-	fputw(image_codec_height, fp);
+	fputw(screen->width, fp); /* screen resolution */
+	fputw(screen->height, fp);
 	for (i = 0; i < 54; i++)
 		fputc(0, fp);  /* unused */
 
-	ptr1 += (Screen_WIDTH * image_codec_top_margin) + image_codec_left_margin;
+	ptr1 += (Screen_WIDTH * screen->top_margin) + screen->left_margin;
 	if (ptr2 != NULL) {
-		ptr2 += (Screen_WIDTH * image_codec_top_margin) + image_codec_left_margin;
+		ptr2 += (Screen_WIDTH * screen->top_margin) + screen->left_margin;
 	}
-	for (y = 0; y < image_codec_height; ) {
+	for (y = 0; y < screen->height; ) {
 		x = 0;
 		do {
-			last = ptr2 != NULL ? (((Colours_table[*ptr1] >> plane) & 0xff) + ((Colours_table[*ptr2] >> plane) & 0xff)) >> 1 : *ptr1;
+			last = ptr2 != NULL ? (((screen->colours[*ptr1] >> plane) & 0xff) + ((screen->colours[*ptr2] >> plane) & 0xff)) >> 1 : *ptr1;
 			count = 0xc0;
 			do {
 				ptr1++;
@@ -93,22 +94,22 @@ static int PCX_SaveScreen(FILE *fp, UBYTE *ptr1, UBYTE *ptr2)
 					ptr2++;
 				count++;
 				x++;
-			} while (last == (ptr2 != NULL ? (((Colours_table[*ptr1] >> plane) & 0xff) + ((Colours_table[*ptr2] >> plane) & 0xff)) >> 1 : *ptr1)
-						&& count < 0xff && x < image_codec_width);
+			} while (last == (ptr2 != NULL ? (((screen->colours[*ptr1] >> plane) & 0xff) + ((screen->colours[*ptr2] >> plane) & 0xff)) >> 1 : *ptr1)
+						&& count < 0xff && x < screen->width);
 			if (count > 0xc1 || last >= 0xc0)
 				fputc(count, fp);
 			fputc(last, fp);
-		} while (x < image_codec_width);
+		} while (x < screen->width);
 
 		if (ptr2 != NULL && plane) {
-			ptr1 -= image_codec_width;
-			ptr2 -= image_codec_width;
+			ptr1 -= screen->width;
+			ptr2 -= screen->width;
 			plane -= 8;
 		}
 		else {
-			ptr1 += Screen_WIDTH - image_codec_width;
+			ptr1 += Screen_WIDTH - screen->width;
 			if (ptr2 != NULL) {
-				ptr2 += Screen_WIDTH - image_codec_width;
+				ptr2 += Screen_WIDTH - screen->width;
 				plane = 16;
 			}
 			y++;
@@ -119,9 +120,9 @@ static int PCX_SaveScreen(FILE *fp, UBYTE *ptr1, UBYTE *ptr2)
 		/* write palette */
 		fputc(0xc, fp);
 		for (i = 0; i < 256; i++) {
-			fputc(Colours_GetR(i), fp);
-			fputc(Colours_GetG(i), fp);
-			fputc(Colours_GetB(i), fp);
+			fputc(IMAGE_CODEC_GetR(screen, i), fp);
+			fputc(IMAGE_CODEC_GetG(screen, i), fp);
+			fputc(IMAGE_CODEC_GetB(screen, i), fp);
 		}
 	}
 
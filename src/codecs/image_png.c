@@ -39,39 +39,74 @@
 #include <png.h>
 
 #ifdef VIDEO_CODEC_PNG
-static int current_png_size = -1;
-static int max_buffer_size = 0;
-static UBYTE *image_buffer = NULL;
+/* Destination of PNG data written to memory. Each call has its own, so
+   several frames can be compressed at once in different threads. */
+typedef struct {
+	UBYTE *buf;
+	int size; /* Number of bytes written, or -1 on overflow */
+	int max_size;
+} png_buffer_t;
 
 static void png_write_fn_callback(png_structp png_ptr, png_bytep data, png_size_t length)
 {
-	if (current_png_size >= 0) {
-		if (current_png_size + length < max_buffer_size) {
-			memcpy(image_buffer + current_png_size, data, length);
-			current_png_size += length;
+	png_buffer_t *buffer = (png_buffer_t *)png_get_io_ptr(png_ptr);
+	if (buffer->size >= 0) {
+		if (buffer->size + length < buffer->max_size) {
+			memcpy(buffer->buf + buffer->size, data, length);
+			buffer->size += length;
 		}
 		else {
 			Log_print("PNG write error: buffer size too small.");
-			current_png_size = -1;
+			buffer->size = -1;
 		}
 	}
 }
 #endif /* VIDEO_CODEC_PNG */
 
-/* PNG_SaveScreen saves the screen data to the file in PNG format, optionally
+/* Writes the rows of a palettised image, choosing the filter of each row.
+   The pixels are colour indexes, so the predicting filters (Sub, Average,
+   Paeth) give no useful differences; the Up filter is used where the row
+   repeats more of the row above than of its own pixels to the left, as in
+   the multi-scanline pixels of most ANTIC modes. Otherwise the row is left
+   unfiltered. */
+static void write_palette_rows(png_structp png_ptr, const IMAGE_CODEC_SCREEN_t *screen, png_bytep *rows)
+{
+	int y;
+	for (y = 0; y < screen->height; y++) {
+		if (y > 0) {
+			png_bytep row = rows[y];
+			png_bytep up = rows[y - 1];
+			int same_up = 0;
+			int same_left = 0;
+			int x;
+			for (x = 0; x < screen->width; x++)
+				same_up += (row[x] == up[x]);
+			for (x = 1; x < screen->width; x++)
+				same_left += (row[x] == row[x - 1]);
+			png_set_filter(png_ptr, PNG_FILTER_TYPE_BASE,
+			               same_up > same_left ? PNG_FILTER_UP : PNG_FILTER_NONE);
+		}
+		png_write_row(png_ptr, rows[y]);
+	}
+}
+
+/* SavePNG saves the screen data to the file in PNG format, optionally
    using interlace if ptr2 is not NULL.
 
    PNG format is a lossless image file format that compresses much better than
    PCX. Because it depends on the external libpng library, it is only compiled
    in atari800 if requested and libpng is found on the system.
 
-   fp:          file pointer of file open for writing
+   fp:          file pointer of file open for writing, or NULL to write to
+                buffer
+   buffer:      (if fp is NULL) the png_buffer_t to receive the data
+   screen:      part of the screen to save and its colours
    ptr1:        pointer to Screen_atari
    ptr2:        (optional) pointer to another array of size Screen_atari containing
                 the interlaced scan lines to blend with ptr1. Set to NULL if no
 				interlacing.
 */
-static int PNG_SaveScreen(FILE *fp, UBYTE *ptr1, UBYTE *ptr2)
+static int SavePNG(FILE *fp, void *buffer, const IMAGE_CODEC_SCREEN_t *screen, UBYTE *ptr1, UBYTE *ptr2)
 {
 	png_structp png_ptr;
 	png_infop info_ptr;
@@ -90,7 +125,7 @@ static int PNG_SaveScreen(FILE *fp, UBYTE *ptr1, UBYTE *ptr2)
 	}
 #ifdef VIDEO_CODEC_PNG
 	if (fp == NULL) {
-		png_set_write_fn(png_ptr, NULL, png_write_fn_callback, NULL);
+		png_set_write_fn(png_ptr, buffer, png_write_fn_callback, NULL);
 	}
 	else
 #endif
@@ -100,7 +135,7 @@ static int PNG_SaveScreen(FILE *fp, UBYTE *ptr1, UBYTE *ptr2)
 
 	png_set_compression_level(png_ptr, FILE_EXPORT_compression_level);
 	png_set_IHDR(
-		png_ptr, info_ptr, image_codec_width, image_codec_height,
+		png_ptr, info_ptr, screen->width, screen->height,
 		8, ptr2 == NULL ? PNG_COLOR_TYPE_PALETTE : PNG_COLOR_TYPE_RGB,
 		PNG_INTERLACE_NONE,
 		PNG_COMPRESSION_TYPE_DEFAULT,
@@ -110,67 +145,70 @@ static int PNG_SaveScreen(FILE *fp, UBYTE *ptr1, UBYTE *ptr2)
 		int i;
 		png_color palette[256];
 		for (i = 0; i < 256; i++) {
-			palette[i].red = Colours_GetR(i);
-			palette[i].green = Colours_GetG(i);
-			palette[i].blue = Colours_GetB(i);
+			palette[i].red = IMAGE_CODEC_GetR(screen, i);
+			palette[i].green = IMAGE_CODEC_GetG(screen, i);
+			palette[i].blue = IMAGE_CODEC_GetB(screen, i);
 		}
 		png_set_PLTE(png_ptr, info_ptr, palette, 256);
-		ptr1 += (Screen_WIDTH * image_codec_top_margin) + image_codec_left_margin;
-		for (i = 0; i < image_codec_height; i++) {
+		ptr1 += (Screen_WIDTH * screen->top_margin) + screen->left_margin;
+		for (i = 0; i < screen->height; i++) {
 			rows[i] = ptr1;
 			ptr1 += Screen_WIDTH;
 		}
+		/* The filters used by write_palette_rows() must be enabled before
+		   the first row. */
+		png_set_filter(png_ptr, PNG_FILTER_TYPE_BASE, PNG_FILTER_NONE | PNG_FILTER_UP);
+		png_write_info(png_ptr, info_ptr);
+		write_palette_rows(png_ptr, screen, rows);
 	}
 	else {
 		png_bytep ptr3;
 		int x;
 		int y;
-		ptr1 += (Screen_WIDTH * image_codec_top_margin) + image_codec_left_margin;
-		ptr2 += (Screen_WIDTH * image_codec_top_margin) + image_codec_left_margin;
-		ptr3 = (png_bytep) Util_malloc(3 * image_codec_width * image_codec_height);
-		for (y = 0; y < image_codec_height; y++) {
+		ptr1 += (Screen_WIDTH * screen->top_margin) + screen->left_margin;
+		ptr2 += (Screen_WIDTH * screen->top_margin) + screen->left_margin;
+		ptr3 = (png_bytep) Util_malloc(3 * screen->width * screen->height);
+		for (y = 0; y < screen->height; y++) {
 			rows[y] = ptr3;
-			for (x = 0; x < image_codec_width; x++) {
-				*ptr3++ = (png_byte) ((Colours_GetR(*ptr1) + Colours_GetR(*ptr2)) >> 1);
-				*ptr3++ = (png_byte) ((Colours_GetG(*ptr1) + Colours_GetG(*ptr2)) >> 1);
-				*ptr3++ = (png_byte) ((Colours_GetB(*ptr1) + Colours_GetB(*ptr2)) >> 1);
+			for (x = 0; x < screen->width; x++) {
+				*ptr3++ = (png_byte) ((IMAGE_CODEC_GetR(screen, *ptr1) + IMAGE_CODEC_GetR(screen, *ptr2)) >> 1);
+				*ptr3++ = (png_byte) ((IMAGE_CODEC_GetG(screen, *ptr1) + IMAGE_CODEC_GetG(screen, *ptr2)) >> 1);
+				*ptr3++ = (png_byte) ((IMAGE_CODEC_GetB(screen, *ptr1) + IMAGE_CODEC_GetB(screen, *ptr2)) >> 1);
 				ptr1++;
 				ptr2++;
 			}
-			ptr1 += Screen_WIDTH - image_codec_width;
-			ptr2 += Screen_WIDTH - image_codec_width;
+			ptr1 += Screen_WIDTH - screen->width;
+			ptr2 += Screen_WIDTH - screen->width;
 		}
+		png_write_info(png_ptr, info_ptr);
+		png_write_image(png_ptr, rows);
 	}
-	png_set_rows(png_ptr, info_ptr, rows);
-	png_write_png(png_ptr, info_ptr, PNG_TRANSFORM_IDENTITY, NULL);
+	png_write_end(png_ptr, info_ptr);
 	png_destroy_write_struct(&png_ptr, &info_ptr);
 	if (ptr2 != NULL)
 		free(rows[0]);
 
-#ifdef VIDEO_CODEC_PNG
-	return current_png_size;
-#else
-	return -1;
-#endif
+	return 1;
+}
+
+static int PNG_SaveScreen(FILE *fp, const IMAGE_CODEC_SCREEN_t *screen, UBYTE *ptr1, UBYTE *ptr2)
+{
+	return SavePNG(fp, NULL, screen, ptr1, ptr2);
 }
 
 #ifdef VIDEO_CODEC_PNG
 /* Instead of saving PNG to a file, this function allows saving the screen to a buffer */
-static int PNG_SaveToBuffer(UBYTE *buf, int bufsize, UBYTE *ptr1, UBYTE *ptr2)
+static int PNG_SaveToBuffer(UBYTE *buf, int bufsize, const IMAGE_CODEC_SCREEN_t *screen, UBYTE *ptr1, UBYTE *ptr2)
 {
-	int result;
-
-	image_buffer = buf;
-	max_buffer_size = bufsize;
-	current_png_size = 0;
-
-	result = PNG_SaveScreen(NULL, ptr1, ptr2);
+	png_buffer_t buffer;
 
-	image_buffer = NULL;
-	max_buffer_size = 0;
-	current_png_size = -1;
+	buffer.buf = buf;
+	buffer.size = 0;
+	buffer.max_size = bufsize;
 
-	return result;
+	if (!SavePNG(NULL, &buffer, screen, ptr1, ptr2))
+		return -1;
+	return buffer.size;
 }
 #endif
 
@@ -10,7 +10,9 @@ typedef int (*VIDEO_CODEC_Init)(int width, int height, int left_margin, int top_
 
 /* Video codec frame creation function. Given the pointer to the screen data and
    whether to produce a keyframe or interframe, store the compressed frame into
-   buf. Return the size of the compressed frame in bytes, or -1 on error. */
+   buf. Return the size of the compressed frame in bytes, or -1 on error.
+   Codecs that don't use interframes must allow calls for different frames
+   from several threads at once. */
 typedef int (*VIDEO_CODEC_CreateFrame)(UBYTE *source, int keyframe, UBYTE *buf, int bufsize);
 
 /* Video codec cleanup function. Free any data allocated in the init function. Return 1 on
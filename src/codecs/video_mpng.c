@@ -30,10 +30,18 @@
 #include "codecs/image_png.h"
 #include "codecs/video_mpng.h"
 
+static IMAGE_CODEC_SCREEN_t mpng_screen;
+
 static int MPNG_Init(int width, int height, int left_margin, int top_margin)
 {
 	int comp_size = width * height;
 
+	CODECS_IMAGE_GetScreen(&mpng_screen);
+	mpng_screen.left_margin = left_margin;
+	mpng_screen.top_margin = top_margin;
+	mpng_screen.width = width;
+	mpng_screen.height = height;
+
 	/* In the worst case, PNG can store uncompressed image. Due to the overhead
 	   in the format the resulting data will be larger than the source data.
 	   Because PNG uses the deflate algorithm, the same calculation is used here
@@ -46,7 +54,7 @@ static int MPNG_Init(int width, int height, int left_margin, int top_margin)
 
 static int MPNG_CreateFrame(UBYTE *source, int keyframe, UBYTE *buf, int bufsize)
 {
-	return Image_Codec_PNG.to_buffer(buf, bufsize, source, NULL);
+	return Image_Codec_PNG.to_buffer(buf, bufsize, &mpng_screen, source, NULL);
 }
 
 static int MPNG_End(void)
@@ -50,6 +50,87 @@ static int video_height;
    
    for a description of the format. */
 
+/* The scans below compare a machine word (8 or 4 pixels) at a time, using
+   unaligned loads through memcpy(), and finish byte by byte. */
+
+#define ONES (~0UL / 255) /* 0x0101...01 */
+#define HIGHS (ONES * 0x80) /* 0x8080...80 */
+
+static inline unsigned long load_word(const UBYTE *p)
+{
+	unsigned long w;
+	memcpy(&w, p, sizeof(w));
+	return w;
+}
+
+/* Returns the number of leading pixels of P equal to C, up to N. */
+static inline int run_length(const UBYTE *p, UBYTE c, int n)
+{
+	unsigned long pattern = ONES * c;
+	int i = 0;
+
+	if (n <= 0 || p[0] != c)
+		return 0; /* the usual case with noisy pictures */
+	while (i + (int)sizeof(unsigned long) <= n && load_word(p + i) == pattern)
+		i += sizeof(unsigned long);
+	while (i < n && p[i] == c)
+		i++;
+	return i;
+}
+
+/* Returns the number of leading pixels of P equal to the ones of Q, up to N. */
+static inline int same_length(const UBYTE *p, const UBYTE *q, int n)
+{
+	int i = 0;
+
+	while (i + (int)sizeof(unsigned long) <= n && load_word(p + i) == load_word(q + i))
+		i += sizeof(unsigned long);
+	while (i < n && p[i] == q[i])
+		i++;
+	return i;
+}
+
+/* Returns the number of trailing pixels before P_END equal to the ones
+   before Q_END, up to N. */
+static inline int same_length_back(const UBYTE *p_end, const UBYTE *q_end, int n)
+{
+	int i = 0;
+
+	while (i + (int)sizeof(unsigned long) <= n
+	       && load_word(p_end - i - sizeof(unsigned long)) == load_word(q_end - i - sizeof(unsigned long)))
+		i += sizeof(unsigned long);
+	while (i < n && p_end[-i - 1] == q_end[-i - 1])
+		i++;
+	return i;
+}
+
+/* Returns the length of the run of different pixels starting at P, which
+   stops before the next pair of matching pixels, or one pixel before the
+   N-th, like
+
+	while (i < n - 1 && p[i] != p[i + 1] && p[i + 1] != p[i + 2]) i++;
+
+   The pixel after the N-th may be read. */
+static inline int literal_length(const UBYTE *p, int n)
+{
+	int j = 0;
+
+	if (n <= 1 || p[0] == p[1] || p[1] == p[2])
+		return 0;
+	/* find the first pair p[j] == p[j + 1], j < n */
+	while (j + (int)sizeof(unsigned long) <= n) {
+		unsigned long x = load_word(p + j) ^ load_word(p + j + 1);
+		if (((x - ONES) & ~x & HIGHS) != 0)
+			break; /* a zero byte: a pair in this word */
+		j += sizeof(unsigned long);
+	}
+	while (j < n && p[j] != p[j + 1])
+		j++;
+	if (j == n)
+		return n - 1;
+	return j == 0 ? 0 : j - 1;
+}
+
 static int compress_line(UBYTE *buf, const UBYTE *ptr) {
 	int extra;
 	int count;
@@ -63,9 +144,7 @@ static int compress_line(UBYTE *buf, const UBYTE *ptr) {
 	do {
 		last = *ptr;
 		run_start = ptr;
-		do {
-			ptr++;
-		} while (last == *ptr && ptr < ptr_end);
+		ptr += 1 + run_length(ptr + 1, last, ptr_end - ptr - 1);
 		count = ptr - run_start;
 		if (count > 1) {
 			/* Run of same color pixels */
@@ -85,9 +164,7 @@ static int compress_line(UBYTE *buf, const UBYTE *ptr) {
 		}
 		else {
 			/* run of different pixels, stopping at next pair of matching pixels */
-			while (ptr < ptr_end - 1 && *ptr != *(ptr+1) && *(ptr+1) != *(ptr+2)) {
-				ptr++;
-			}
+			ptr += literal_length(ptr, ptr_end - ptr);
 			while (run_start < ptr) {
 				count = ptr - run_start;
 				if (count > 254) {
@@ -166,20 +243,24 @@ static int compress_line_delta(UBYTE *buf, const UBYTE *ptr, UBYTE *ref, int *dy
 	ptr_end = ptr + video_width;
 	ref_end = ref + video_width;
 
-	/* right margin won't change, so find it outside the main loop */
-	while (*(ptr_end - 1) == *(ref_end - 1) && ptr < ptr_end) {
-		ptr_end--;
-		ref_end--;
+	/* unchanged line: just add to the skip */
+	if (memcmp(ptr, ref, video_width) == 0) {
+		*dy = *dy + 1;
+		return 0;
 	}
 
+	/* right margin won't change, so find it outside the main loop */
+	count = same_length_back(ptr_end, ref_end, video_width);
+	ptr_end -= count;
+	ref_end -= count;
+
 	while (ptr < ptr_end) {
 		run_start = ptr;
 
 		/* check for next change from reference screen */
-		while (*ptr == *ref && ptr < ptr_end) {
-			ptr++;
-			ref++;
-		}
+		count = same_length(ptr, ref, ptr_end - ptr);
+		ptr += count;
+		ref += count;
 		if (ptr == ptr_end) break; /* no more differences in rest of scan line! */
 
 		/* skipping pixels that are the same as the reference image */
@@ -208,11 +289,9 @@ static int compress_line_delta(UBYTE *buf, const UBYTE *ptr, UBYTE *ref, int *dy
 		/* encode the differences */
 		last = *ptr;
 		run_start = ptr;
-		do {
-			ptr++;
-			ref++;
-		} while (last == *ptr && ptr < ptr_end);
-		count = ptr - run_start;
+		count = 1 + run_length(ptr + 1, last, ptr_end - ptr - 1);
+		ptr += count;
+		ref += count;
 		if (count > 1) {
 			/* Run of same color pixels */
 			while (count > 0) {
@@ -231,10 +310,9 @@ static int compress_line_delta(UBYTE *buf, const UBYTE *ptr, UBYTE *ref, int *dy
 		}
 		else {
 			/* run of different pixels, stopping at next pair of matching pixels */
-			while (ptr < ptr_end - 1 && *ptr != *(ptr+1) && *(ptr+1) != *(ptr+2)) {
-				ptr++;
-				ref++;
-			}
+			count = literal_length(ptr, ptr_end - ptr);
+			ptr += count;
+			ref += count;
 			while (run_start < ptr) {
 				count = ptr - run_start;
 				if (count > 254) {
@@ -0,0 +1,114 @@
+/*
+ * video_yuv.c - Video codec for uncompressed planar YUV 4:4:4
+ *
+ * Copyright (C) 2026 Atari800 development team (see DOC/CREDITS)
+ *
+ * This file is part of the Atari800 emulator project which emulates
+ * the Atari 400, 800, 800XL, 130XE, and 5200 8-bit computers.
+ *
+ * Atari800 is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Atari800 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Atari800; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "codecs/video.h"
+#include "codecs/video_yuv.h"
+#include "colours.h"
+#include "screen.h"
+
+static int video_left_margin;
+static int video_top_margin;
+static int video_width;
+static int video_height;
+
+/* Y, Cb and Cr values of the 256 palette colours */
+static UBYTE y_table[256];
+static UBYTE u_table[256];
+static UBYTE v_table[256];
+
+/* This file implements a codec that doesn't compress at all: each frame is
+   stored as full planes of Y, Cb and Cr samples (ITU-R BT.601, limited range),
+   without subsampling of the chroma. It is the frame format of YUV4MPEG2
+   streams with the C444 colour space, which external encoders like ffmpeg
+   read directly. As there are only 256 colours, the conversion is a table
+   lookup per sample. The codec is used only by the y4m container; it can't be
+   stored in AVI files. */
+
+static int YUV_Init(int width, int height, int left_margin, int top_margin)
+{
+	int i;
+
+	video_width = width;
+	video_height = height;
+	video_left_margin = left_margin;
+	video_top_margin = top_margin;
+
+	/* The palette is taken at the start of the recording, like in the other
+	   codecs. The offset of 128 << 8 keeps the chroma sums positive. */
+	for (i = 0; i < 256; i++) {
+		int r = Colours_GetR(i);
+		int g = Colours_GetG(i);
+		int b = Colours_GetB(i);
+		y_table[i] = (UBYTE)(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+		u_table[i] = (UBYTE)((-38 * r - 74 * g + 112 * b + (128 << 8) + 128) >> 8);
+		v_table[i] = (UBYTE)((112 * r - 94 * g - 18 * b + (128 << 8) + 128) >> 8);
+	}
+
+	return width * height * 3;
+}
+
+static int YUV_CreateFrame(UBYTE *source, int keyframe, UBYTE *buf, int bufsize)
+{
+	int plane_size = video_width * video_height;
+	UBYTE *y_plane = buf;
+	UBYTE *u_plane = buf + plane_size;
+	UBYTE *v_plane = buf + 2 * plane_size;
+	const UBYTE *ptr;
+	int x;
+	int y;
+
+	if (plane_size * 3 > bufsize)
+		return -1;
+
+	ptr = source + Screen_WIDTH * video_top_margin + video_left_margin;
+	for (y = 0; y < video_height; y++) {
+		for (x = 0; x < video_width; x++) {
+			UBYTE c = ptr[x];
+			y_plane[x] = y_table[c];
+			u_plane[x] = u_table[c];
+			v_plane[x] = v_table[c];
+		}
+		y_plane += video_width;
+		u_plane += video_width;
+		v_plane += video_width;
+		ptr += Screen_WIDTH;
+	}
+
+	return plane_size * 3;
+}
+
+static int YUV_End(void)
+{
+	return 1;
+}
+
+VIDEO_CODEC_t Video_Codec_YUV = {
+	"yuv",
+	"Planar YUV 4:4:4",
+	{'I', '4', '4', '4'},
+	{'I', '4', '4', '4'},
+	FALSE,
+	&YUV_Init,
+	&YUV_CreateFrame,
+	&YUV_End,
+};
@@ -37,6 +37,7 @@
 
 #include <string.h>
 #include <stdlib.h>
+#include <limits.h>
 #include "codecs/video_zmbv.h"
 #include "screen.h"
 #include "colours.h"
@@ -57,6 +58,9 @@
 #ifdef HAVE_LIBZ
 #include <zlib.h>
 #endif
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
 
 #define FFMIN(a,b) ((a) > (b) ? (b) : (a))
 #define FFALIGN(x, a) (((x)+(a)-1)&~((a)-1))
@@ -86,80 +90,242 @@ static int zlib_init_ok;
 static z_stream zstream;
 #endif
 static int score_tab[ZMBV_BLOCK * ZMBV_BLOCK * 4 + 1];
-
-
-static int block_cmp(UBYTE *src, int stride, UBYTE *src2, int stride2, int bw, int bh, int *xored)
+static int score_delta[ZMBV_BLOCK * ZMBV_BLOCK];
+
+
+/* Motion estimation tries all vectors within -lrange..urange in both
+   directions. The candidates are numbered in raster order (top-to-bottom,
+   left-to-right), and sets of them are kept as bit masks, so the range may
+   not exceed 2. */
+#define ME_RANGE 2
+
+/* Result of the search for one block: the candidates with the lowest score
+   and the candidates among them whose xored data is nonzero. The choice
+   between the best candidates depends on the vector of the previous block,
+   and is made later in ZMBV_CreateFrame(). */
+typedef struct {
+	ULONG best;
+	ULONG xored;
+} block_search_t;
+
+static block_search_t *block_searches;
+static int blocks_x, blocks_y;
+
+/* Returns the score of the xored values of the blocks SRC and SRC2, or
+   a value above BOUND if it exceeds BOUND. Sets XORED to zero if the blocks
+   are equal. HISTOGRAM must be all zeros, and is left so. */
+static int block_cmp(UBYTE *src, int stride, UBYTE *src2, int stride2, int bw, int bh, int bound, int *xored, UWORD *histogram)
 {
+	UBYTE values[ZMBV_BLOCK * ZMBV_BLOCK];
+	int num_values = 0;
 	int sum = 0;
+	int differ = 0;
 	int i, j;
-	UWORD histogram[256] = {0};
 
-	/* Build frequency histogram of byte values for src[] ^ src2[] */
-	for(j = 0; j < bh; j++){
-		for(i = 0; i < bw; i++){
-			int t = src[i] ^ src2[i];
-			histogram[t]++;
+	/* Only a block of a single xored value can score zero. When the best
+	   score found so far is zero, any other block is rejected at its first
+	   row holding a different value. */
+	if (bound <= 0) {
+		int v = src[0] ^ src2[0];
+		for(j = 0; j < bh; j++){
+			for(i = 0; i < bw; i++)
+				differ |= (src[i] ^ src2[i]) ^ v;
+			if (differ) return 1;
+			src += stride;
+			src2 += stride2;
+		}
+		*xored = (v != 0);
+		return *xored ? score_tab[bw * bh] : 0;
+	}
+
+	/* XOR the blocks into VALUES. The loops over full rows and over VALUES
+	   are simple enough for the compiler to vectorise. */
+	if (bw == ZMBV_BLOCK) {
+		for(j = 0; j < bh; j++){
+			for(i = 0; i < ZMBV_BLOCK; i++)
+				values[num_values + i] = src[i] ^ src2[i];
+			num_values += ZMBV_BLOCK;
+			src += stride;
+			src2 += stride2;
+		}
+	}
+	else {
+		for(j = 0; j < bh; j++){
+			for(i = 0; i < bw; i++)
+				values[num_values++] = src[i] ^ src2[i];
+			src += stride;
+			src2 += stride2;
 		}
-		src += stride;
-		src2 += stride2;
 	}
 
 	/* If not all the xored values were 0, then the blocks are different */
-	*xored = (histogram[0] < bw * bh);
+	for(i = 0; i < num_values; i++)
+		differ |= values[i];
+	*xored = (differ != 0);
 
 	/* Exit early if blocks are equal */
 	if (!*xored) return 0;
 
-	/* Sum the entropy of all values */
-	for(i = 0; i < 256; i++)
-		sum += score_tab[histogram[i]];
+	/* Sum the entropy of all values, by adding the change of the score of
+	   each value as its frequency in the histogram grows */
+	for(i = 0; i < num_values; i++)
+		sum += score_delta[histogram[values[i]]++];
+	for(i = 0; i < num_values; i++)
+		histogram[values[i]] = 0;
 
 	return sum;
 }
 
-static int motion_estimation(UBYTE *src, int sstride, UBYTE *prev, int pstride, int x, int y, int *mx, int *my, int *xored)
+/* Scores candidate vector I for the block SRC. Adds it to SEARCH if the
+   score is no worse than BV, the best score so far. Returns the new best
+   score. */
+static int try_vector(UBYTE *src, int sstride, UBYTE *prev, int pstride, int bw, int bh, int i, int bv, block_search_t *search, UWORD *histogram)
 {
-	int dx, dy, txored, tv, bv, bw, bh;
-	int mx0, my0;
+	int width = lrange + urange + 1;
+	int dx = i % width - lrange;
+	int dy = i / width - lrange;
+	int tv, txored;
+
+	tv = block_cmp(src, sstride, prev + dx + dy * pstride, pstride, bw, bh, bv, &txored, histogram);
+	if(tv < bv){
+		bv = tv;
+		search->best = 0;
+		search->xored = 0;
+	}
+	if(tv == bv){
+		search->best |= 1UL << i;
+		if(txored)
+			search->xored |= 1UL << i;
+	}
+	return bv;
+}
+
+/* Returns the candidate a sequential search would choose among the best
+   ones in SEARCH, if the previous block's vector is not among them. */
+static int first_candidate(block_search_t const *search)
+{
+	int center = lrange * (lrange + urange + 1) + lrange;
+	int i;
+	if (search->best & (1UL << center))
+		return center;
+	for (i = 0; !(search->best & (1UL << i)); i++);
+	return i;
+}
+
+/* Finds the candidates with the lowest score for the block at X, Y. HINT
+   is a candidate likely to be among them, such as the one chosen for the
+   block on the left. */
+static void motion_estimation(UBYTE *src, int sstride, UBYTE *prev, int pstride, int x, int y, int hint, block_search_t *search, UWORD *histogram)
+{
+	int width = lrange + urange + 1;
+	int center = lrange * width + lrange;
+	int i, bv, bw, bh;
 
-	mx0 = *mx;
-	my0 = *my;
 	bw = FFMIN(ZMBV_BLOCK, video_width - x);
 	bh = FFMIN(ZMBV_BLOCK, video_height - y);
+	search->best = 0;
+	search->xored = 0;
+
+	/* Try (0,0). It is chosen whenever it is among the best. */
+	bv = try_vector(src, sstride, prev, pstride, bw, bh, center, INT_MAX, search, histogram);
+	if(!bv) return;
+
+	/* Try the hint, so that a good score is known early and blocks scoring
+	   worse are rejected quickly */
+	if (hint != center)
+		bv = try_vector(src, sstride, prev, pstride, bw, bh, hint, bv, search, histogram);
+
+	/* Try other MVs from top-to-bottom, left-to-right */
+	for(i = 0; i < width * width; i++){
+		if(i != center && i != hint)
+			bv = try_vector(src, sstride, prev, pstride, bw, bh, i, bv, search, histogram);
+	}
+}
+
+/* Picks the motion vector MX, MY for a block from its SEARCH, the same
+   way as a sequential search would: (0,0) first, then the vector of the
+   previous block, then the others in raster order. */
+static void choose_vector(block_search_t const *search, int *mx, int *my, int *xored)
+{
+	int width = lrange + urange + 1;
+	int i = lrange * width + lrange;
+
+	if (!(search->best & (1UL << i)) && (*mx || *my)) {
+		i = (*my + lrange) * width + *mx + lrange;
+	}
+	if (!(search->best & (1UL << i)))
+		i = first_candidate(search);
+	*mx = i % width - lrange;
+	*my = i / width - lrange;
+	*xored = (search->xored & (1UL << i)) != 0;
+}
+
+/* Rows of blocks handed out to threads searching the motion vectors. */
+typedef struct {
+	UBYTE *src;
+	UBYTE *prev;
+	int next_row;
+#ifdef HAVE_PTHREAD
+	pthread_mutex_t mutex;
+#endif
+} search_job_t;
 
-	/* Try (0,0) */
-	bv = block_cmp(src, sstride, prev, pstride, bw, bh, xored);
-	*mx = *my = 0;
-	if(!bv) return 0;
-
-	/* Try previous block's MV (if not 0,0) */
-	if (mx0 || my0){
-		tv = block_cmp(src, sstride, prev + mx0 + my0 * pstride, pstride, bw, bh, &txored);
-		if(tv < bv){
-			bv = tv;
-			*mx = mx0;
-			*my = my0;
-			*xored = txored;
-			if(!bv) return 0;
+static void *search_worker(void *arg)
+{
+	search_job_t *job = (search_job_t *)arg;
+	UWORD histogram[256] = {0};
+	for (;;) {
+		int row, x, y, hint;
+		block_search_t *search;
+#ifdef HAVE_PTHREAD
+		pthread_mutex_lock(&job->mutex);
+#endif
+		row = job->next_row++;
+#ifdef HAVE_PTHREAD
+		pthread_mutex_unlock(&job->mutex);
+#endif
+		if (row >= blocks_y)
+			break;
+		y = row * ZMBV_BLOCK;
+		search = block_searches + row * blocks_x;
+		hint = lrange * (lrange + urange + 1) + lrange;
+		for (x = 0; x < video_width; x += ZMBV_BLOCK, search++) {
+			motion_estimation(job->src + y * Screen_WIDTH + x, Screen_WIDTH,
+			                  job->prev + y * pstride + x, pstride, x, y, hint, search, histogram);
+			hint = first_candidate(search);
 		}
 	}
+	return NULL;
+}
 
-	/* Try other MVs from top-to-bottom, left-to-right */
-	for(dy = -lrange; dy <= urange; dy++){
-		for(dx = -lrange; dx <= urange; dx++){
-			if(!dx && !dy) continue; /* we already tested this block */
-			if(dx == mx0 && dy == my0) continue; /* this one too */
-			tv = block_cmp(src, sstride, prev + dx + dy * pstride, pstride, bw, bh, &txored);
-			if(tv < bv){
-				 bv = tv;
-				 *mx = dx;
-				 *my = dy;
-				 *xored = txored;
-				 if(!bv) return 0;
-			 }
-		 }
+/* Searches the motion vectors of all blocks of SRC against the previous
+   frame. The searches of the blocks are independent, so the rows of
+   blocks are spread over several threads. */
+static void search_frame(UBYTE *src)
+{
+	enum { MAX_THREADS = 4 };
+	search_job_t job;
+#ifdef HAVE_PTHREAD
+	pthread_t threads[MAX_THREADS - 1];
+	int num_threads = 0;
+#endif
+	job.src = src;
+	job.prev = prev_buf_start;
+	job.next_row = 0;
+#ifdef HAVE_PTHREAD
+	if (pthread_mutex_init(&job.mutex, NULL) == 0) {
+		/* The calling thread works too. */
+		while (num_threads < MAX_THREADS - 1 && num_threads < blocks_y - 1
+		       && pthread_create(&threads[num_threads], NULL, search_worker, &job) == 0)
+			++num_threads;
+		search_worker(&job);
+		while (num_threads > 0)
+			pthread_join(threads[--num_threads], NULL);
+		pthread_mutex_destroy(&job.mutex);
+		return;
 	}
-	return bv;
+#endif
+	search_worker(&job);
 }
 
 static int ZMBV_CreateFrame(UBYTE *source, int keyframe, UBYTE *buf, int bufsize)
@@ -169,7 +335,6 @@ static int ZMBV_CreateFrame(UBYTE *source, int keyframe, UBYTE *buf, int bufsize
 	UBYTE *work;
 	int fl;
 	int work_size = 0;
-	int bw, bh;
 	int i, j;
 	int size;
 
@@ -214,23 +379,23 @@ static int ZMBV_CreateFrame(UBYTE *source, int keyframe, UBYTE *buf, int bufsize
 		UBYTE *tsrc;
 		UBYTE *tprev;
 		UBYTE *mv;
+		block_search_t *search = block_searches;
 		int mx = 0, my = 0;
 
-		bw = (video_width + ZMBV_BLOCK - 1) / ZMBV_BLOCK;
-		bh = (video_height + ZMBV_BLOCK - 1) / ZMBV_BLOCK;
+		search_frame(src);
 		mv = work + work_size;
-		memset(work + work_size, 0, (bw * bh * 2 + 3) & ~3);
-		work_size += (bw * bh * 2 + 3) & ~3;
+		memset(work + work_size, 0, (blocks_x * blocks_y * 2 + 3) & ~3);
+		work_size += (blocks_x * blocks_y * 2 + 3) & ~3;
 		/* for now just XOR'ing */
 		for(y = 0; y < video_height; y += ZMBV_BLOCK) {
 			bh2 = FFMIN(video_height - y, ZMBV_BLOCK);
-			for(x = 0; x < video_width; x += ZMBV_BLOCK, mv += 2) {
+			for(x = 0; x < video_width; x += ZMBV_BLOCK, mv += 2, search++) {
 				bw2 = FFMIN(video_width - x, ZMBV_BLOCK);
 
 				tsrc = src + x;
 				tprev = prev + x;
 
-				motion_estimation(tsrc, Screen_WIDTH, tprev, pstride, x, y, &mx, &my, &xored);
+				choose_vector(search, &mx, &my, &xored);
 				mv[0] = (mx * 2) | !!xored;
 				mv[1] = my * 2;
 				tprev += mx + my * pstride;
@@ -286,6 +451,7 @@ static int ZMBV_CreateFrame(UBYTE *source, int keyframe, UBYTE *buf, int bufsize
 static int ZMBV_End(void)
 {
 	free(prev_buf);
+	free(block_searches);
 #ifdef HAVE_LIBZ
 	if (zlib_init_ok) {
 		free(work_buf);
@@ -323,9 +489,11 @@ static int ZMBV_Init(int width, int height, int left_margin, int top_margin)
 	 */
 	for(i = 1; i <= ZMBV_BLOCK * ZMBV_BLOCK; i++)
 		score_tab[i] = -i * log2(i / (double)(ZMBV_BLOCK * ZMBV_BLOCK)) * 256;
+	for(i = 0; i < ZMBV_BLOCK * ZMBV_BLOCK; i++)
+		score_delta[i] = score_tab[i + 1] - score_tab[i];
 
 	/* Motion estimation range: maximum distance is -64..63 */
-	lrange = urange = 2;
+	lrange = urange = ME_RANGE;
 
 	work_size = video_width * video_height + 1024 +
 		((video_width + ZMBV_BLOCK - 1) / ZMBV_BLOCK) * ((video_height + ZMBV_BLOCK - 1) / ZMBV_BLOCK) * 2 + 4;
@@ -350,6 +518,10 @@ static int ZMBV_Init(int width, int height, int left_margin, int top_margin)
 	memset(prev_buf, 0, prev_size);
 	prev_buf_start = prev_buf + prev_offset;
 
+	blocks_x = (video_width + ZMBV_BLOCK - 1) / ZMBV_BLOCK;
+	blocks_y = (video_height + ZMBV_BLOCK - 1) / ZMBV_BLOCK;
+	block_searches = (block_search_t *)Util_malloc(blocks_x * blocks_y * sizeof(block_search_t));
+
 #ifdef HAVE_LIBZ
 	if (FILE_EXPORT_compression_level > 0) {
 		work_buf = (UBYTE *)Util_malloc(work_size);
@@ -70,6 +70,293 @@ int CompFile_ExtractGZ(const char *infilename, FILE *outfp)
 }
 
 
+/* Random access to GZIP files ------------------------------------------- */
+
+/* The file is decompressed lazily. While inflating, an access point is
+   recorded every GZ_SPAN bytes at a deflate block boundary: the position in
+   both streams and the 32 KB of output preceding it, which is all that
+   inflate needs to restart there. Reads decompress from the nearest access
+   point (or continue the current stream) and keep the decompressed data in
+   an LRU cache of GZ_CHUNK-sized chunks. */
+
+#ifdef HAVE_LIBZ
+
+#define GZ_WINSIZE 32768
+#define GZ_SPAN 131072
+#define GZ_CHUNK 4096
+#define GZ_CACHE_CHUNKS 64
+#define GZ_INPUT_SIZE 16384
+
+typedef struct {
+	ULONG out;     /* offset in the decompressed data */
+	ULONG in;      /* offset of the first complete byte in the file */
+	int bits;      /* number of bits of the preceding byte to use */
+	UBYTE *window; /* GZ_WINSIZE bytes of output preceding the point */
+} gz_point_t;
+
+typedef struct {
+	ULONG chunk;   /* chunk number, or (ULONG) -1 if unused */
+	ULONG stamp;   /* time of last use */
+	int length;
+	UBYTE data[GZ_CHUNK];
+} gz_chunk_t;
+
+struct CompFile_GZ {
+	FILE *fp;
+	ULONG size;
+	/* state of the current decompression stream */
+	z_stream strm;
+	int live;      /* TRUE if strm is initialised */
+	int at_end;    /* stream ended or failed */
+	ULONG out;     /* decompressed bytes produced by strm */
+	ULONG in;      /* file offset of strm.next_in */
+	UBYTE input[GZ_INPUT_SIZE];
+	UBYTE window[GZ_WINSIZE]; /* last output, at index out % GZ_WINSIZE */
+	/* access points, in order of out */
+	gz_point_t *points;
+	int n_points;
+	int max_points;
+	gz_chunk_t cache[GZ_CACHE_CHUNKS];
+	ULONG clock;
+};
+
+static void gz_end_stream(CompFile_GZ *gz)
+{
+	if (gz->live)
+		inflateEnd(&gz->strm);
+	gz->live = FALSE;
+}
+
+/* Starts decompressing at access point P, or at the start if P is NULL. */
+static int gz_start_stream(CompFile_GZ *gz, const gz_point_t *p)
+{
+	gz_end_stream(gz);
+	memset(&gz->strm, 0, sizeof(gz->strm));
+	gz->at_end = FALSE;
+	if (p == NULL) {
+		/* 47: automatic detection of the GZIP header */
+		if (inflateInit2(&gz->strm, 47) != Z_OK)
+			return FALSE;
+		gz->live = TRUE;
+		gz->in = 0;
+		gz->out = 0;
+		fseek(gz->fp, 0, SEEK_SET);
+		return TRUE;
+	}
+	if (inflateInit2(&gz->strm, -15) != Z_OK)
+		return FALSE;
+	gz->live = TRUE;
+	gz->in = p->in;
+	gz->out = p->out;
+	fseek(gz->fp, p->in - (p->bits ? 1 : 0), SEEK_SET);
+	if (p->bits) {
+		int c = fgetc(gz->fp);
+		if (c == EOF)
+			return FALSE;
+		inflatePrime(&gz->strm, p->bits, c >> (8 - p->bits));
+	}
+	inflateSetDictionary(&gz->strm, p->window, GZ_WINSIZE);
+	/* Restore the output window for access points recorded later. */
+	{
+		int const idx = p->out % GZ_WINSIZE;
+		memcpy(gz->window + idx, p->window, GZ_WINSIZE - idx);
+		memcpy(gz->window, p->window + GZ_WINSIZE - idx, idx);
+	}
+	return TRUE;
+}
+
+static gz_chunk_t *gz_cache_slot(CompFile_GZ *gz, ULONG chunk)
+{
+	gz_chunk_t *oldest = &gz->cache[0];
+	int i;
+	for (i = 0; i < GZ_CACHE_CHUNKS; i++) {
+		if (gz->cache[i].chunk == chunk)
+			return &gz->cache[i];
+		if (gz->cache[i].stamp < oldest->stamp)
+			oldest = &gz->cache[i];
+	}
+	return oldest;
+}
+
+/* Copies the chunk ending at the current output position to the cache. */
+static void gz_store_chunk(CompFile_GZ *gz)
+{
+	ULONG const chunk = (gz->out - 1) / GZ_CHUNK;
+	gz_chunk_t *slot = gz_cache_slot(gz, chunk);
+	slot->chunk = chunk;
+	slot->stamp = ++gz->clock;
+	slot->length = gz->out - chunk * GZ_CHUNK;
+	memcpy(slot->data, gz->window + (chunk * GZ_CHUNK) % GZ_WINSIZE, slot->length);
+}
+
+static void gz_add_point(CompFile_GZ *gz)
+{
+	gz_point_t *p;
+	int const idx = gz->out % GZ_WINSIZE;
+	if (gz->n_points == gz->max_points) {
+		gz->max_points = gz->max_points == 0 ? 8 : gz->max_points * 2;
+		gz->points = (gz_point_t *) Util_realloc(gz->points, gz->max_points * sizeof(gz_point_t));
+	}
+	p = &gz->points[gz->n_points++];
+	p->out = gz->out;
+	p->in = gz->in;
+	p->bits = gz->strm.data_type & 7;
+	p->window = (UBYTE *) Util_malloc(GZ_WINSIZE);
+	memcpy(p->window, gz->window + idx, GZ_WINSIZE - idx);
+	memcpy(p->window + GZ_WINSIZE - idx, gz->window, idx);
+}
+
+/* Decompresses up to the end of the current chunk. */
+static void gz_inflate_step(CompFile_GZ *gz)
+{
+	unsigned int avail_in;
+	unsigned int avail_out;
+	int ret;
+
+	if (gz->strm.avail_in == 0) {
+		gz->strm.avail_in = (uInt) fread(gz->input, 1, GZ_INPUT_SIZE, gz->fp);
+		gz->strm.next_in = gz->input;
+		if (gz->strm.avail_in == 0) {
+			/* truncated file */
+			gz->at_end = TRUE;
+			if (gz->out % GZ_CHUNK != 0)
+				gz_store_chunk(gz);
+			return;
+		}
+	}
+	/* GZ_CHUNK divides GZ_WINSIZE, so the chunk fits in the window. */
+	avail_in = gz->strm.avail_in;
+	avail_out = GZ_CHUNK - gz->out % GZ_CHUNK;
+	gz->strm.next_out = gz->window + gz->out % GZ_WINSIZE;
+	gz->strm.avail_out = avail_out;
+	ret = inflate(&gz->strm, Z_BLOCK);
+	gz->in += avail_in - gz->strm.avail_in;
+	gz->out += avail_out - gz->strm.avail_out;
+	if (ret != Z_OK && ret != Z_BUF_ERROR)
+		gz->at_end = TRUE;
+
+	/* The end of the stream may be found after the last output. */
+	if ((gz->strm.avail_out != avail_out && gz->out % GZ_CHUNK == 0)
+	    || (gz->at_end && gz->out % GZ_CHUNK != 0))
+		gz_store_chunk(gz);
+	/* At a block boundary other than the end of the stream? */
+	if ((gz->strm.data_type & 128) && !(gz->strm.data_type & 64) && !gz->at_end
+	    && gz->out >= (gz->n_points > 0 ? gz->points[gz->n_points - 1].out : 0) + GZ_SPAN)
+		gz_add_point(gz);
+}
+
+/* Returns the cached chunk number CHUNK, decompressing it if necessary, or
+   NULL if it is past the end of the data. */
+static gz_chunk_t *gz_get_chunk(CompFile_GZ *gz, ULONG chunk)
+{
+	ULONG const start = chunk * GZ_CHUNK;
+	gz_chunk_t *slot = gz_cache_slot(gz, chunk);
+	const gz_point_t *p = NULL;
+	int i;
+
+	if (slot->chunk == chunk) {
+		slot->stamp = ++gz->clock;
+		return slot;
+	}
+	for (i = 0; i < gz->n_points && gz->points[i].out <= start; i++)
+		p = &gz->points[i];
+	/* Restart unless the current stream is the quickest way there. */
+	if (!gz->live || gz->out > start || (p != NULL && p->out > gz->out)) {
+		if (!gz_start_stream(gz, p)) {
+			gz_end_stream(gz);
+			return NULL;
+		}
+	}
+	while (!gz->at_end && gz->out < start + GZ_CHUNK)
+		gz_inflate_step(gz);
+	slot = gz_cache_slot(gz, chunk);
+	return slot->chunk == chunk ? slot : NULL;
+}
+
+#else /* HAVE_LIBZ */
+
+struct CompFile_GZ {
+	int dummy;
+};
+
+#endif /* HAVE_LIBZ */
+
+/* Opens a GZIP compressed file for random access. Returns NULL on failure. */
+CompFile_GZ *CompFile_GZOpen(const char *filename)
+{
+#ifndef HAVE_LIBZ
+	Log_print("This executable cannot decompress ZLIB files");
+	return NULL;
+#else
+	CompFile_GZ *gz;
+	UBYTE buf[4];
+	int i;
+	FILE *fp = fopen(filename, "rb");
+	if (fp == NULL)
+		return NULL;
+	/* The uncompressed size modulo 2^32 is stored at the end of the file. */
+	if (fread(buf, 1, 2, fp) != 2 || buf[0] != 0x1f || buf[1] != 0x8b
+	    || fseek(fp, -4, SEEK_END) != 0 || fread(buf, 1, 4, fp) != 4) {
+		Log_print("ZLIB could not open file %s", filename);
+		fclose(fp);
+		return NULL;
+	}
+	gz = (CompFile_GZ *) Util_malloc(sizeof(CompFile_GZ));
+	memset(gz, 0, sizeof(CompFile_GZ));
+	gz->fp = fp;
+	gz->size = buf[0] + (buf[1] << 8) + (buf[2] << 16) + ((ULONG) buf[3] << 24);
+	for (i = 0; i < GZ_CACHE_CHUNKS; i++)
+		gz->cache[i].chunk = (ULONG) -1;
+	return gz;
+#endif /* HAVE_LIBZ */
+}
+
+/* Returns the size of the decompressed data. */
+ULONG CompFile_GZSize(const CompFile_GZ *gz)
+{
+#ifdef HAVE_LIBZ
+	return gz->size;
+#else
+	return 0;
+#endif
+}
+
+/* Reads SIZE bytes at OFFSET of the decompressed data to BUF.
+   Returns the number of bytes read. */
+int CompFile_GZRead(CompFile_GZ *gz, ULONG offset, void *buf, int size)
+{
+	int done = 0;
+#ifdef HAVE_LIBZ
+	while (done < size) {
+		gz_chunk_t *c = gz_get_chunk(gz, offset / GZ_CHUNK);
+		int skip = offset % GZ_CHUNK;
+		int n;
+		if (c == NULL || skip >= c->length)
+			break;
+		n = c->length - skip;
+		if (n > size - done)
+			n = size - done;
+		memcpy((UBYTE *) buf + done, c->data + skip, n);
+		done += n;
+		offset += n;
+	}
+#endif
+	return done;
+}
+
+void CompFile_GZClose(CompFile_GZ *gz)
+{
+#ifdef HAVE_LIBZ
+	int i;
+	gz_end_stream(gz);
+	for (i = 0; i < gz->n_points; i++)
+		free(gz->points[i].window);
+	free(gz->points);
+	fclose(gz->fp);
+#endif
+	free(gz);
+}
+
 /* DCM decompression ----------------------------------------------------- */
 
 static int fgetw(FILE *fp)
@@ -3,7 +3,16 @@
 
 #include <stdio.h>  /* FILE */
 
+#include "atari.h"  /* ULONG */
+
 int CompFile_ExtractGZ(const char *infilename, FILE *outfp);
+
+/* Random access to GZIP compressed files, decompressed on demand. */
+typedef struct CompFile_GZ CompFile_GZ;
+CompFile_GZ *CompFile_GZOpen(const char *filename);
+ULONG CompFile_GZSize(const CompFile_GZ *gz);
+int CompFile_GZRead(CompFile_GZ *gz, ULONG offset, void *buf, int size);
+void CompFile_GZClose(CompFile_GZ *gz);
 int CompFile_DCMtoATR(FILE *infp, FILE *outfp);
 
 #endif /* COMPFILE_H_ */
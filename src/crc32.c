@@ -22,12 +22,17 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
  */
 
+#include "config.h"
 #include <stdio.h>
+#if !defined(HAVE_LIBZ) && defined(HAVE_PTHREAD)
+#include <pthread.h>
+#endif
 
 #include "crc32.h"
 #include "atari.h"
 
-#define BUF_SIZE 0x400
+/* Large enough to read any ROM image at once. */
+#define BUF_SIZE 0x4000
 
 /* Table contents generated with the following algorithm:
 #define POLYNOMIAL 0xedb88320
@@ -79,8 +84,50 @@ static ULONG table[0x100]= {
 	0xb3667a2e, 0xc4614ab8, 0x5d681b02, 0x2a6f2b94, 0xb40bbe37, 0xc30c8ea1, 0x5a05df1b, 0x2d02ef8d
 };
 
+/* Tables for processing 8 bytes at once ("slice-by-8"). SLICES[K] gives the
+   CRC of a byte followed by K+1 zero bytes. */
+static ULONG slices[7][0x100];
+
+static void InitSlices(void)
+{
+	int i;
+	for (i = 0; i < 0x100; ++i) {
+		ULONG crc = table[i];
+		int k;
+		for (k = 0; k < 7; ++k) {
+			crc = (crc >> 8) ^ table[crc & 0xff];
+			slices[k][i] = crc;
+		}
+	}
+}
+
+#ifdef HAVE_PTHREAD
+static pthread_once_t slices_once = PTHREAD_ONCE_INIT;
+#else
+static int slices_ready = FALSE;
+#endif
+
 ULONG CRC32_Update(ULONG crc, UBYTE const *buf, unsigned int len)
 {
+#ifdef HAVE_PTHREAD
+	/* CRCs may be computed by several threads at once. */
+	pthread_once(&slices_once, InitSlices);
+#else
+	if (!slices_ready) {
+		InitSlices();
+		slices_ready = TRUE;
+	}
+#endif
+	while (len >= 8) {
+		ULONG lo = crc ^ (buf[0] | (buf[1] << 8) | ((ULONG)buf[2] << 16) | ((ULONG)buf[3] << 24));
+		ULONG hi = buf[4] | (buf[5] << 8) | ((ULONG)buf[6] << 16) | ((ULONG)buf[7] << 24);
+		crc = slices[6][lo & 0xff] ^ slices[5][(lo >> 8) & 0xff]
+		      ^ slices[4][(lo >> 16) & 0xff] ^ slices[3][(lo >> 24) & 0xff]
+		      ^ slices[2][hi & 0xff] ^ slices[1][(hi >> 8) & 0xff]
+		      ^ slices[0][(hi >> 16) & 0xff] ^ table[(hi >> 24) & 0xff];
+		buf += 8;
+		len -= 8;
+	}
 	while (len > 0) {
 		crc = (crc >> 8) ^ table[(crc ^ *(buf++)) & 0xff];
 		--len;
@@ -58,6 +58,9 @@
 #ifdef HAVE_DIRENT_H
 #include <dirent.h>
 #endif
+#ifdef HAVE_SYS_INOTIFY_H
+#include <sys/inotify.h>
+#endif
 #ifdef HAVE_SYS_STAT_H
 #include <sys/stat.h>
 #endif
@@ -67,6 +70,7 @@
 #include "cpu.h"
 #include "devices.h"
 #include "esc.h"
+#include "hfile.h"
 #include "log.h"
 #include "memory.h"
 #include "sio.h"
@@ -234,66 +238,174 @@ static int match(const char *pattern, const char *filename)
 
 static char dir_path[FILENAME_MAX];
 static char filename_pattern[FILENAME_MAX];
-static DIR *dp = NULL;
+
+/* Listing of DIR_PATH. Entries are stat()ed when first returned. The listing
+   is reused by the following Devices_OpenDir()s in the same directory, as long
+   as inotify reports no changes in it. */
+typedef struct {
+	char *name;
+	int status_valid;
+#ifdef HAVE_STAT
+	struct stat status;
+#endif
+} dir_entry_t;
+
+static dir_entry_t *dir_entries = NULL;
+static int dir_count = 0;
+static int dir_allocated = 0;
+/* Index of the entry to be returned by Devices_ReadDir(), or -1 */
+static int dir_next = -1;
+/* Directory listed in DIR_ENTRIES, empty if none */
+static char dir_cached_path[FILENAME_MAX] = "";
+#ifdef HAVE_STAT
+/* Modification time of the listed directory. inotify doesn't see changes
+   made by other hosts on network shares, but most of them (new, deleted or
+   renamed files) update the directory's time. */
+static time_t dir_cached_mtime;
+#endif
+
+#ifdef HAVE_SYS_INOTIFY_H
+static int inotify_fd = -1;
+static int inotify_wd = -1;
+
+/* Returns TRUE if the cached directory has changed since it was listed,
+   or if it isn't watched. */
+static int Devices_DirChanged(void)
+{
+	char events[4096];
+	int changed = FALSE;
+#ifdef HAVE_STAT
+	struct stat status;
+#endif
+	if (inotify_fd < 0 || inotify_wd < 0)
+		return TRUE;
+#ifdef HAVE_STAT
+	if (stat(dir_path, &status) != 0 || status.st_mtime != dir_cached_mtime)
+		changed = TRUE;
+#endif
+	/* Any event on the watched directory invalidates the listing. */
+	while (read(inotify_fd, events, sizeof(events)) > 0)
+		changed = TRUE;
+	return changed;
+}
+
+static void Devices_WatchDir(void)
+{
+	if (inotify_fd < 0)
+		inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (inotify_fd < 0)
+		return;
+	if (inotify_wd >= 0)
+		inotify_rm_watch(inotify_fd, inotify_wd);
+	inotify_wd = inotify_add_watch(inotify_fd, dir_path,
+		IN_ATTRIB | IN_CREATE | IN_DELETE | IN_DELETE_SELF | IN_MODIFY
+		| IN_MOVE_SELF | IN_MOVED_FROM | IN_MOVED_TO | IN_CLOSE_WRITE);
+	/* Drop events queued before the listing. */
+	Devices_DirChanged();
+#ifdef HAVE_STAT
+	{
+		struct stat status;
+		if (stat(dir_path, &status) == 0)
+			dir_cached_mtime = status.st_mtime;
+		else {
+			inotify_rm_watch(inotify_fd, inotify_wd);
+			inotify_wd = -1;
+		}
+	}
+#endif
+}
+#else
+#define Devices_DirChanged() TRUE
+#define Devices_WatchDir()
+#endif /* HAVE_SYS_INOTIFY_H */
+
+static void Devices_FreeDir(void)
+{
+	while (dir_count > 0)
+		free(dir_entries[--dir_count].name);
+	dir_cached_path[0] = '\0';
+}
 
 static int Devices_OpenDir(const char *filename)
 {
+	DIR *dp;
+	struct dirent *entry;
+
 	Util_splitpath(filename, dir_path, filename_pattern);
-	if (dp != NULL)
-		closedir(dp);
+	dir_next = -1;
+	if (strcmp(dir_path, dir_cached_path) == 0 && !Devices_DirChanged()) {
+		dir_next = 0;
+		return TRUE;
+	}
+	Devices_FreeDir();
 	dp = opendir(dir_path);
-	return dp != NULL;
+	if (dp == NULL)
+		return FALSE;
+	Devices_WatchDir();
+	while ((entry = readdir(dp)) != NULL) {
+		if (dir_count >= dir_allocated) {
+			dir_allocated = dir_allocated == 0 ? 64 : dir_allocated * 2;
+			dir_entries = (dir_entry_t *)Util_realloc(dir_entries, dir_allocated * sizeof(dir_entry_t));
+		}
+		dir_entries[dir_count].name = Util_strdup(entry->d_name);
+		dir_entries[dir_count].status_valid = FALSE;
+		dir_count++;
+	}
+	closedir(dp);
+	strcpy(dir_cached_path, dir_path);
+	dir_next = 0;
+	return TRUE;
 }
 
 static int Devices_ReadDir(char *fullpath, char *filename, int *isdir,
                           int *readonly, int *size, char *timetext)
 {
-	struct dirent *entry;
+	dir_entry_t *entry;
 	char temppath[FILENAME_MAX];
-#ifdef HAVE_STAT
-	struct stat status;
-#endif
+	if (dir_next < 0)
+		return FALSE;
 	for (;;) {
-		entry = readdir(dp);
-		if (entry == NULL) {
-			closedir(dp);
-			dp = NULL;
+		if (dir_next >= dir_count) {
+			dir_next = -1;
 			return FALSE;
 		}
-		if (entry->d_name[0] == '.') {
+		entry = &dir_entries[dir_next++];
+		if (entry->name[0] == '.') {
 			/* don't match Unix hidden files unless specifically requested */
 			if (filename_pattern[0] != '.')
 				continue;
 			/* never match "." */
-			if (entry->d_name[1] == '\0')
+			if (entry->name[1] == '\0')
 				continue;
 			/* never match ".." */
-			if (entry->d_name[1] == '.' && entry->d_name[2] == '\0')
+			if (entry->name[1] == '.' && entry->name[2] == '\0')
 				continue;
 		}
-		if (match(filename_pattern, entry->d_name))
+		if (match(filename_pattern, entry->name))
 			break;
 	}
 	if (filename != NULL)
-		strcpy(filename, entry->d_name);
-	Util_catpath(temppath, dir_path, entry->d_name);
+		strcpy(filename, entry->name);
+	Util_catpath(temppath, dir_path, entry->name);
 	if (fullpath != NULL)
 		strcpy(fullpath, temppath);
 #ifdef HAVE_STAT
-	if (stat(temppath, &status) == 0) {
+	if (!entry->status_valid)
+		entry->status_valid = stat(temppath, &entry->status) == 0;
+	if (entry->status_valid) {
 		if (isdir != NULL)
-			*isdir = S_ISDIR(status.st_mode);
+			*isdir = S_ISDIR(entry->status.st_mode);
 		if (readonly != NULL)
-			*readonly = (status.st_mode & S_IWRITE) ? FALSE : TRUE;
+			*readonly = (entry->status.st_mode & S_IWRITE) ? FALSE : TRUE;
 		if (size != NULL)
-			*size = (int) status.st_size;
+			*size = (int) entry->status.st_size;
 		if (timetext != NULL) {
 #ifdef HAVE_LOCALTIME
 			struct tm *ft;
 			int hour;
 			char ampm = 'a';
 			{
-				time_t tim = status.st_mtime;
+				time_t tim = entry->status.st_mtime;
 				ft = localtime(&tim);
 			}
 			hour = ft->tm_hour;
@@ -504,7 +616,7 @@ char Devices_h_device_name = 'H';
 char Devices_h_current_dir[4][FILENAME_MAX];
 
 /* stream open via H: device per IOCB */
-static FILE *h_fp[8] = { NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL };
+static HFILE_t *h_fp[8] = { NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL };
 
 /* H: text mode per IOCB */
 static int h_textmode[8];
@@ -558,7 +670,7 @@ void Devices_H_CloseAll(void)
 	int i;
 	for (i = 0; i < 8; i++)
 		if (h_fp[i] != NULL) {
-			Util_fclose(h_fp[i], h_tmpbuf[i]);
+			Util_fclose(HFILE_Close(h_fp[i]), h_tmpbuf[i]);
 			h_fp[i] = NULL;
 		}
 }
@@ -830,7 +942,7 @@ static void Devices_H_Open(void)
 		return;
 
 	if (h_fp[h_iocb] != NULL)
-		Util_fclose(h_fp[h_iocb], h_tmpbuf[h_iocb]);
+		Util_fclose(HFILE_Close(h_fp[h_iocb]), h_tmpbuf[h_iocb]);
 
 #if 0
 	if (devbug)
@@ -979,7 +1091,10 @@ static void Devices_H_Open(void)
 		CPU_SetN;
 		break;
 	}
-	h_fp[h_iocb] = fp;
+	h_fp[h_iocb] = fp != NULL ? HFILE_Open(fp) : NULL;
+	/* Start reading the file while the program processes the OPEN. */
+	if (fp != NULL && (aux1 & 4))
+		HFILE_Prefetch(h_fp[h_iocb]);
 }
 
 static void Devices_H_Close(void)
@@ -989,8 +1104,15 @@ static void Devices_H_Close(void)
 	if (!Devices_GetIOCB())
 		return;
 	if (h_fp[h_iocb] != NULL) {
-		Util_fclose(h_fp[h_iocb], h_tmpbuf[h_iocb]);
+		/* Report the writes behind that failed. */
+		int error = HFILE_Error(h_fp[h_iocb]);
+		Util_fclose(HFILE_Close(h_fp[h_iocb]), h_tmpbuf[h_iocb]);
 		h_fp[h_iocb] = NULL;
+		if (error) {
+			CPU_regY = 144; /* device done error */
+			CPU_SetN;
+			return;
+		}
 	}
 	CPU_regY = 1;
 	CPU_ClrN;
@@ -1005,9 +1127,8 @@ static void Devices_H_Read(void)
 	if (h_fp[h_iocb] != NULL) {
 		int ch;
 		if (h_lastop[h_iocb] != 'r') {
-			if (h_lastop[h_iocb] == 'w')
-				fseek(h_fp[h_iocb], 0, SEEK_CUR);
-			h_lastbyte[h_iocb] = fgetc(h_fp[h_iocb]);
+			/* HFILE switches between writing and reading by itself. */
+			h_lastbyte[h_iocb] = HFILE_Getc(h_fp[h_iocb]);
 			h_lastop[h_iocb] = 'r';
 		}
 		ch = h_lastbyte[h_iocb];
@@ -1021,7 +1142,7 @@ static void Devices_H_Read(void)
 				case 0x0a:
 					if (h_wascr[h_iocb]) {
 						/* ignore LF next to CR */
-						ch = fgetc(h_fp[h_iocb]);
+						ch = HFILE_Getc(h_fp[h_iocb]);
 						if (ch != EOF) {
 							if (ch == 0x0d) {
 								h_wascr[h_iocb] = TRUE;
@@ -1047,8 +1168,8 @@ static void Devices_H_Read(void)
 			CPU_regA = (UBYTE) ch;
 			/* [OSMAN] p. 79: Status should be 3 if next read would yield EOF.
 			   But to set the stream's EOF flag, we need to read the next byte. */
-			h_lastbyte[h_iocb] = fgetc(h_fp[h_iocb]);
-			CPU_regY = feof(h_fp[h_iocb]) ? 3 : 1;
+			h_lastbyte[h_iocb] = HFILE_Getc(h_fp[h_iocb]);
+			CPU_regY = HFILE_Eof(h_fp[h_iocb]) ? 3 : 1;
 			CPU_ClrN;
 		}
 		else {
@@ -1070,13 +1191,15 @@ static void Devices_H_Write(void)
 		return;
 	if (h_fp[h_iocb] != NULL) {
 		int ch;
-		if (h_lastop[h_iocb] == 'r')
-			fseek(h_fp[h_iocb], 0, SEEK_CUR);
 		h_lastop[h_iocb] = 'w';
 		ch = CPU_regA;
 		if (ch == 0x9b && h_textmode[h_iocb])
 			ch = '\n';
-		fputc(ch, h_fp[h_iocb]);
+		if (HFILE_Putc(ch, h_fp[h_iocb]) == EOF) {
+			CPU_regY = 144; /* device done error */
+			CPU_SetN;
+			return;
+		}
 		CPU_regY = 1;
 		CPU_ClrN;
 	}
@@ -1347,7 +1470,7 @@ static void Devices_H_Note(void)
 	if (!Devices_GetIOCB())
 		return;
 	if (h_fp[h_iocb] != NULL) {
-		long pos = ftell(h_fp[h_iocb]);
+		long pos = HFILE_Tell(h_fp[h_iocb]);
 		if (pos >= 0) {
 			int iocb = Devices_IOCB0 + h_iocb * 16;
 			/* In Devices_H_Read one byte is read ahead. Take it into account. */
@@ -1380,7 +1503,7 @@ static void Devices_H_Point(void)
 		int iocb = Devices_IOCB0 + h_iocb * 16;
 		long pos = (MEMORY_dGetByte(iocb + Devices_ICAX4) << 16) +
 			(MEMORY_dGetByte(iocb + Devices_ICAX3) << 8) + (MEMORY_dGetByte(iocb + Devices_ICAX5));
-		if (fseek(h_fp[h_iocb], pos, SEEK_SET) == 0) {
+		if (HFILE_Seek(h_fp[h_iocb], pos) == 0) {
 			CPU_regY = 1;
 			CPU_ClrN;
 		}
@@ -1396,8 +1519,8 @@ static void Devices_H_Point(void)
 	}
 }
 
-static FILE *binfile = NULL;
-static FILE **binf = &binfile;
+static HFILE_t *binfile = NULL;
+static HFILE_t **binf = &binfile;
 static int runBinFile;
 static int initBinFile;
 
@@ -1405,8 +1528,8 @@ static int initBinFile;
 static int Devices_H_BinReadWord(void)
 {
 	UBYTE buf[2];
-	if (fread(buf, 1, 2, *binf) != 2) {
-		fclose(*binf);
+	if (HFILE_Read(buf, 2, *binf) != 2) {
+		fclose(HFILE_Close(*binf));
 		*binf = NULL;
 		if (BINLOAD_start_binloading) {
 			BINLOAD_start_binloading = FALSE;
@@ -1463,9 +1586,9 @@ static void Devices_H_BinLoaderCont(void)
 
 		to++;
 		do {
-			int byte = fgetc(*binf);
+			int byte = HFILE_Getc(*binf);
 			if (byte == EOF) {
-				fclose(*binf);
+				fclose(HFILE_Close(*binf));
 				*binf = NULL;
 				if (runBinFile)
 					CPU_regPC = MEMORY_dGetWordAligned(0x2e0);
@@ -1534,6 +1657,7 @@ static void Devices_H_LoadProceed(int mydos)
 static void Devices_H_Load(int mydos)
 {
 	const char *p;
+	FILE *fp = NULL;
 	UBYTE buf[2];
 	if (devbug)
 		Log_print("LOAD Command");
@@ -1562,28 +1686,29 @@ static void Devices_H_Load(int mydos)
 		if (Devices_GetAtariPath(devnum, r) == 0)
 			return;
 		Util_catpath(host_path, Devices_atari_h_dir[devnum], atari_path);
-		*binf = fopen(host_path, "rb");
-		if (*binf != NULL || *q == '\0')
+		fp = fopen(host_path, "rb");
+		if (fp != NULL || *q == '\0')
 			break;
 		p = q + 1;
 	}
 
-	if (*binf == NULL) {
+	if (fp == NULL) {
 		/* open from the specified location */
 		if (Devices_GetAtariPath(h_devnum, atari_filename) == 0)
 			return;
 		Util_catpath(host_path, Devices_atari_h_dir[h_devnum], atari_path);
-		*binf = fopen(host_path, "rb");
-		if (*binf == NULL) {
+		fp = fopen(host_path, "rb");
+		if (fp == NULL) {
 			CPU_regY = 170;
 			CPU_SetN;
 			return;
 		}
 	}
+	*binf = HFILE_Open(fp);
 
 	/* check header */
-	if (fread(buf, 1, 2, *binf) != 2 || buf[0] != 0xff || buf[1] != 0xff) {
-		fclose(*binf);
+	if (HFILE_Read(buf, 2, *binf) != 2 || buf[0] != 0xff || buf[1] != 0xff) {
+		fclose(HFILE_Close(*binf));
 		*binf = NULL;
 		Log_print("H: load: not valid BIN file");
 		CPU_regY = 180;
@@ -1609,7 +1734,7 @@ static void Devices_H_FileLength(void)
 
 		/* In Devices_H_Read one byte is read ahead. Take it into account. */
 		if (h_lastop[h_iocb] == 'r' && h_lastbyte[h_iocb] != EOF)
-			fseek(h_fp[h_iocb], -1, SEEK_CUR);
+			HFILE_Seek(h_fp[h_iocb], HFILE_Tell(h_fp[h_iocb]) - 1);
 
 		binf = &h_fp[h_iocb];
 		Devices_H_LoadProceed(TRUE);
@@ -1620,17 +1745,7 @@ static void Devices_H_FileLength(void)
 	else {
 		int iocb = Devices_IOCB0 + h_iocb * 16;
 		int filesize;
-#if 0
-		/* old, less portable implementation */
-		struct stat fstatus;
-		fstat(fileno(h_fp[h_iocb]), &fstatus);
-		filesize = fstatus.st_size;
-#else
-		FILE *fp = h_fp[h_iocb];
-		long currentpos = ftell(fp);
-		filesize = Util_flen(fp);
-		fseek(fp, currentpos, SEEK_SET);
-#endif
+		filesize = HFILE_Length(h_fp[h_iocb]);
 		MEMORY_dPutByte(iocb + Devices_ICAX3, (UBYTE) filesize);
 		MEMORY_dPutByte(iocb + Devices_ICAX4, (UBYTE) (filesize >> 8));
 		MEMORY_dPutByte(iocb + Devices_ICAX5, (UBYTE) (filesize >> 16));
@@ -33,7 +33,7 @@
 int PLATFORM_SoundSetup(Sound_setup_t *setup)
 {
 	int playback_freq = setup->freq;
-	int bps = setup->sample_size * 8;
+	int bps = (setup->sample_size > 2 ? 2 : setup->sample_size) * 8;
 	int buffer_samples;
 	int stereo = setup->channels == 2;
 
@@ -22,8 +22,21 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 */
 
+#include "config.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#if defined(HAVE_PTHREAD) && (defined(AUDIO_RECORDING) || defined(VIDEO_RECORDING))
+/* Frames are encoded in a worker thread. */
+#define RECORDING_QUEUE
+#endif
+#if defined(HAVE_PTHREAD) && defined(SCREENSHOTS)
+/* Screenshots can be saved in a worker thread. */
+#define SCREENSHOT_QUEUE
+#endif
+#if defined(RECORDING_QUEUE) || defined(SCREENSHOT_QUEUE)
+#include <pthread.h>
+#endif
 #include "file_export.h"
 #include "screen.h"
 #include "colours.h"
@@ -40,6 +53,7 @@
 
 #ifdef AUDIO_RECORDING
 #include "codecs/audio.h"
+#include "pokeysnd.h"
 #endif
 
 #ifdef VIDEO_RECORDING
@@ -75,6 +89,65 @@ static int video_no_last = -1;
 static int video_no_max = 0;
 #endif /* VIDEO_RECORDING */
 
+#ifdef RECORDING_QUEUE
+int FILE_EXPORT_queue_size = 16;
+int FILE_EXPORT_queue_policy = FILE_EXPORT_QUEUE_BLOCK;
+int FILE_EXPORT_encoder_threads = 4;
+
+static char const * const queue_policy_names[] = { "block", "drop", "grow" };
+
+/* Recording pipeline. The emulation copies each video frame and audio chunk
+   into a slot and queues it; a worker thread encodes the queued slots and
+   adds them to the container, in order. The container and the codecs are
+   only used by the worker while it runs. If encoding or writing fails, the
+   worker discards the rest of the slots, and the emulation closes the file
+   at its next write.
+
+   Video codecs without interframes (e.g. PNG) encode each frame on its own.
+   Then the queued video frames are also encoded by helper threads, ahead of
+   the worker, which adds them to the container in order. */
+enum { SLOT_VIDEO, SLOT_AUDIO };
+
+/* Progress of encoding a video slot by the helper threads. */
+enum { SLOT_NEW, SLOT_ENCODING, SLOT_ENCODED };
+
+#define MAX_ENCODER_THREADS 16
+
+typedef struct slot_t {
+	int type;
+	UBYTE *data;
+	int data_size; /* Allocated size of DATA */
+	int num_samples;
+	int repeat; /* Number of dropped video frames that follow this one */
+	int state;
+	UBYTE *encoded;
+	int encoded_size; /* Allocated size of ENCODED */
+	int encoded_length; /* Size of the encoded frame, or -1 on error */
+	struct slot_t *next;
+} slot_t;
+
+static struct {
+	int active;
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	int parallel; /* Video slots are encoded ahead, by several threads */
+	pthread_t encoders[MAX_ENCODER_THREADS - 1];
+	int num_encoders;
+	slot_t *head; /* Queued slots, oldest first */
+	slot_t *tail;
+	slot_t *free_slots;
+	int num_slots;
+	int queued;
+	int dropped;
+	int stop; /* No more slots will be queued */
+	int failed;
+	/* Statistics of the container, updated after each slot */
+	ULONG frame_count;
+	CONTAINER_OFFSET_t bytes;
+} pipeline;
+#endif /* RECORDING_QUEUE */
+
 #endif /* defined(AUDIO_RECORDING) || defined(VIDEO_RECORDING) */
 
 
@@ -115,6 +188,37 @@ int File_Export_Initialise(int *argc, char *argv[])
 				video_no_max = Util_filenamepattern(argv[++i], video_filename_format, FILENAME_MAX, DEFAULT_VIDEO_FILENAME_FORMAT);
 			else a_m = TRUE;
 		}
+#endif
+#ifdef RECORDING_QUEUE
+		else if (strcmp(argv[i], "-rec-queue") == 0) {
+			if (i_a) {
+				FILE_EXPORT_queue_size = Util_sscandec(argv[++i]);
+				if (FILE_EXPORT_queue_size < 0)
+					a_i = TRUE;
+			}
+			else a_m = TRUE;
+		}
+		else if (strcmp(argv[i], "-rec-policy") == 0) {
+			if (i_a) {
+				int policy = FILE_EXPORT_QUEUE_BLOCK;
+				char *mode = argv[++i];
+				while (policy <= FILE_EXPORT_QUEUE_GROW && strcmp(mode, queue_policy_names[policy]) != 0)
+					policy++;
+				if (policy <= FILE_EXPORT_QUEUE_GROW)
+					FILE_EXPORT_queue_policy = policy;
+				else
+					a_i = TRUE;
+			}
+			else a_m = TRUE;
+		}
+		else if (strcmp(argv[i], "-rec-threads") == 0) {
+			if (i_a) {
+				FILE_EXPORT_encoder_threads = Util_sscandec(argv[++i]);
+				if (FILE_EXPORT_encoder_threads < 1 || FILE_EXPORT_encoder_threads > MAX_ENCODER_THREADS)
+					a_i = TRUE;
+			}
+			else a_m = TRUE;
+		}
 #endif
 		else {
 			if (strcmp(argv[i], "-help") == 0) {
@@ -127,6 +231,14 @@ int File_Export_Initialise(int *argc, char *argv[])
 #endif
 #ifdef VIDEO_RECORDING
 				Log_print("\t-vname <p>       Set filename pattern for video recording");
+#endif
+#ifdef RECORDING_QUEUE
+				Log_print("\t-rec-queue <n>   Encode recordings in a thread, queueing up to n frames");
+				Log_print("\t                 (default 16, 0 encodes them synchronously)");
+				Log_print("\t-rec-policy block|drop|grow");
+				Log_print("\t                 Select what to do when the queue is full (default: block)");
+				Log_print("\t-rec-threads <n> Encode up to n video frames at once with codecs without");
+				Log_print("\t                 interframes, such as png (default 4)");
 #endif
 			}
 			argv[j++] = argv[i];
@@ -164,6 +276,28 @@ int File_Export_ReadConfig(char *string, char *ptr)
 		else return FALSE;
 	}
 #endif
+#ifdef RECORDING_QUEUE
+	else if (strcmp(string, "RECORDING_QUEUE_SIZE") == 0) {
+		int num = Util_sscandec(ptr);
+		if (num >= 0)
+			FILE_EXPORT_queue_size = num;
+		else return FALSE;
+	}
+	else if (strcmp(string, "RECORDING_QUEUE_POLICY") == 0) {
+		int policy = FILE_EXPORT_QUEUE_BLOCK;
+		while (policy <= FILE_EXPORT_QUEUE_GROW && Util_stricmp(ptr, queue_policy_names[policy]) != 0)
+			policy++;
+		if (policy <= FILE_EXPORT_QUEUE_GROW)
+			FILE_EXPORT_queue_policy = policy;
+		else return FALSE;
+	}
+	else if (strcmp(string, "RECORDING_ENCODER_THREADS") == 0) {
+		int num = Util_sscandec(ptr);
+		if (num >= 1 && num <= MAX_ENCODER_THREADS)
+			FILE_EXPORT_encoder_threads = num;
+		else return FALSE;
+	}
+#endif
 #ifdef VIDEO_RECORDING
 	else if (CODECS_VIDEO_ReadConfig(string, ptr)) {
 	}
@@ -181,6 +315,11 @@ void File_Export_WriteConfig(FILE *fp)
 #if defined(HAVE_LIBPNG) || defined(HAVE_LIBZ)
 	fprintf(fp, "COMPRESSION_LEVEL=%d\n", FILE_EXPORT_compression_level);
 #endif
+#ifdef RECORDING_QUEUE
+	fprintf(fp, "RECORDING_QUEUE_SIZE=%d\n", FILE_EXPORT_queue_size);
+	fprintf(fp, "RECORDING_QUEUE_POLICY=%s\n", queue_policy_names[FILE_EXPORT_queue_policy]);
+	fprintf(fp, "RECORDING_ENCODER_THREADS=%d\n", FILE_EXPORT_encoder_threads);
+#endif
 #ifdef VIDEO_RECORDING
 	CODECS_VIDEO_WriteConfig(fp);
 #endif
@@ -224,6 +363,330 @@ void File_Export_SetErrorMessageArg(const char *format, const char *arg)
 	File_Export_SetErrorMessage(msg);
 }
 
+#ifdef AUDIO_RECORDING
+/* Stores NUM_SAMPLES SAMPLES, as produced by POKEYSND_Process, in *BUFFER of
+   *BUFFER_SIZE bytes, enlarging it if needed. Float samples are converted to
+   16 bit, as none of the codecs store floats. */
+static void CopySamples(const UBYTE *samples, int num_samples, UBYTE **buffer, int *buffer_size)
+{
+	int size = num_samples * ((POKEYSND_snd_flags & (POKEYSND_BIT16 | POKEYSND_FLOAT32)) ? 2 : 1);
+	if (size > *buffer_size) {
+		free(*buffer);
+		*buffer = (UBYTE *)Util_malloc(size);
+		*buffer_size = size;
+	}
+	if (POKEYSND_snd_flags & POKEYSND_FLOAT32) {
+		const float *in = (const float *)samples;
+		SWORD *out = (SWORD *)*buffer;
+		int i;
+		for (i = 0; i < num_samples; i++) {
+			float smp = in[i] * 32768.0f;
+			out[i] = smp >= 32767.0f ? 32767 : smp <= -32768.0f ? -32768 : (SWORD)smp;
+		}
+	}
+	else
+		memcpy(*buffer, samples, size);
+}
+#endif /* AUDIO_RECORDING */
+
+#ifdef RECORDING_QUEUE
+#ifdef VIDEO_RECORDING
+/* Encodes the video frame of SLOT into its ENCODED buffer. Called with the
+   mutex unlocked, by the worker or a helper. */
+static void EncodeVideoSlot(slot_t *slot)
+{
+	if (slot->encoded_size < video_buffer_size) {
+		free(slot->encoded);
+		slot->encoded = (UBYTE *)Util_malloc(video_buffer_size);
+		slot->encoded_size = video_buffer_size;
+	}
+	slot->encoded_length = CONTAINER_EncodeVideoFrame(slot->data, slot->encoded, slot->encoded_size);
+}
+
+/* Returns the oldest queued video slot that nobody is encoding yet, or
+   NULL. Called with the mutex locked. */
+static slot_t *NextSlotToEncode(void)
+{
+	slot_t *slot;
+	for (slot = pipeline.head; slot != NULL; slot = slot->next) {
+		if (slot->type == SLOT_VIDEO && slot->state == SLOT_NEW)
+			return slot;
+	}
+	return NULL;
+}
+
+/* Helper thread: encodes queued video slots ahead of the worker. */
+static void *EncoderWorker(void *arg)
+{
+	pthread_mutex_lock(&pipeline.mutex);
+	for (;;) {
+		slot_t *slot = NextSlotToEncode();
+		if (slot == NULL || pipeline.failed) {
+			if (pipeline.stop || pipeline.failed)
+				break;
+			pthread_cond_wait(&pipeline.cond, &pipeline.mutex);
+			continue;
+		}
+		slot->state = SLOT_ENCODING;
+		pthread_mutex_unlock(&pipeline.mutex);
+		EncodeVideoSlot(slot);
+		pthread_mutex_lock(&pipeline.mutex);
+		slot->state = SLOT_ENCODED;
+		pthread_cond_broadcast(&pipeline.cond);
+	}
+	pthread_mutex_unlock(&pipeline.mutex);
+	return NULL;
+}
+#endif /* VIDEO_RECORDING */
+
+/* Encodes SLOT, unless already done, and adds it to the container. Called
+   by the worker. */
+static int EncodeSlot(slot_t *slot)
+{
+#ifdef VIDEO_RECORDING
+	if (slot->type == SLOT_VIDEO) {
+		int i;
+		if (pipeline.parallel && slot->encoded_length < 0)
+			return FALSE;
+		for (i = 0; i <= slot->repeat; i++) {
+			if (pipeline.parallel ? !CONTAINER_AddEncodedVideoFrame(slot->encoded, slot->encoded_length)
+			                      : !CONTAINER_AddVideoFrame(slot->data))
+				return FALSE;
+		}
+		return TRUE;
+	}
+#endif
+#ifdef AUDIO_RECORDING
+	if (slot->type == SLOT_AUDIO)
+		return CONTAINER_AddAudioSamples(slot->data, slot->num_samples);
+#endif
+	return TRUE;
+}
+
+static void *PipelineWorker(void *arg)
+{
+	pthread_mutex_lock(&pipeline.mutex);
+	for (;;) {
+		slot_t *slot;
+		int ok = TRUE;
+		while (pipeline.head == NULL && !pipeline.stop)
+			pthread_cond_wait(&pipeline.cond, &pipeline.mutex);
+		slot = pipeline.head;
+		if (slot == NULL)
+			break;
+#ifdef VIDEO_RECORDING
+		if (pipeline.parallel && slot->type == SLOT_VIDEO) {
+			if (slot->state == SLOT_ENCODING) {
+				/* A helper is encoding it. */
+				pthread_cond_wait(&pipeline.cond, &pipeline.mutex);
+				continue;
+			}
+			if (slot->state == SLOT_NEW && !pipeline.failed) {
+				slot->state = SLOT_ENCODING;
+				pthread_mutex_unlock(&pipeline.mutex);
+				EncodeVideoSlot(slot);
+				pthread_mutex_lock(&pipeline.mutex);
+				slot->state = SLOT_ENCODED;
+			}
+		}
+#endif
+		pipeline.head = slot->next;
+		if (pipeline.head == NULL)
+			pipeline.tail = NULL;
+		pipeline.queued--;
+		/* Only the worker sets FAILED, so it can be read unlocked here. */
+		if (!pipeline.failed) {
+			pthread_mutex_unlock(&pipeline.mutex);
+			ok = EncodeSlot(slot);
+			pthread_mutex_lock(&pipeline.mutex);
+		}
+		if (!ok)
+			pipeline.failed = TRUE;
+		pipeline.frame_count = video_frame_count;
+		pipeline.bytes = byteswritten;
+		slot->next = pipeline.free_slots;
+		pipeline.free_slots = slot;
+		pthread_cond_broadcast(&pipeline.cond);
+	}
+	pthread_mutex_unlock(&pipeline.mutex);
+	return NULL;
+}
+
+static slot_t *NewSlot(void)
+{
+	slot_t *slot = (slot_t *)Util_malloc(sizeof(slot_t));
+	slot->data = NULL;
+	slot->data_size = 0;
+	slot->encoded = NULL;
+	slot->encoded_size = 0;
+	slot->next = NULL;
+	pipeline.num_slots++;
+	return slot;
+}
+
+/* Starts the worker for a newly opened container. If that isn't possible,
+   frames are encoded synchronously. */
+static void PipelineStart(void)
+{
+	int i;
+	pipeline.active = FALSE;
+	if (FILE_EXPORT_queue_size <= 0)
+		return;
+	if (pthread_mutex_init(&pipeline.mutex, NULL) != 0)
+		return;
+	if (pthread_cond_init(&pipeline.cond, NULL) != 0) {
+		pthread_mutex_destroy(&pipeline.mutex);
+		return;
+	}
+	pipeline.head = pipeline.tail = pipeline.free_slots = NULL;
+	pipeline.num_slots = 0;
+	pipeline.queued = 0;
+	pipeline.dropped = 0;
+	pipeline.stop = FALSE;
+	pipeline.failed = FALSE;
+	pipeline.frame_count = 0;
+	pipeline.bytes.low = pipeline.bytes.high = 0;
+	pipeline.parallel = FALSE;
+	pipeline.num_encoders = 0;
+#ifdef VIDEO_RECORDING
+	pipeline.parallel = FILE_EXPORT_encoder_threads > 1 && CONTAINER_VideoFramesIndependent();
+#endif
+	for (i = 0; i < FILE_EXPORT_queue_size; i++) {
+		slot_t *slot = NewSlot();
+		slot->next = pipeline.free_slots;
+		pipeline.free_slots = slot;
+	}
+	if (pthread_create(&pipeline.thread, NULL, PipelineWorker, NULL) == 0) {
+		pipeline.active = TRUE;
+#ifdef VIDEO_RECORDING
+		/* The worker encodes too. */
+		while (pipeline.parallel && pipeline.num_encoders < FILE_EXPORT_encoder_threads - 1
+		       && pthread_create(&pipeline.encoders[pipeline.num_encoders], NULL, EncoderWorker, NULL) == 0)
+			pipeline.num_encoders++;
+#endif
+		return;
+	}
+	while (pipeline.free_slots != NULL) {
+		slot_t *slot = pipeline.free_slots;
+		pipeline.free_slots = slot->next;
+		free(slot);
+	}
+	pthread_cond_destroy(&pipeline.cond);
+	pthread_mutex_destroy(&pipeline.mutex);
+}
+
+/* Waits till the worker encodes all queued slots, and stops it.
+   RETURNS: FALSE if encoding or writing failed */
+static int PipelineStop(void)
+{
+	if (!pipeline.active)
+		return TRUE;
+	pthread_mutex_lock(&pipeline.mutex);
+	pipeline.stop = TRUE;
+	pthread_cond_broadcast(&pipeline.cond);
+	pthread_mutex_unlock(&pipeline.mutex);
+	pthread_join(pipeline.thread, NULL);
+	while (pipeline.num_encoders > 0)
+		pthread_join(pipeline.encoders[--pipeline.num_encoders], NULL);
+	pthread_cond_destroy(&pipeline.cond);
+	pthread_mutex_destroy(&pipeline.mutex);
+	while (pipeline.free_slots != NULL) {
+		slot_t *slot = pipeline.free_slots;
+		pipeline.free_slots = slot->next;
+		free(slot->data);
+		free(slot->encoded);
+		free(slot);
+	}
+	pipeline.active = FALSE;
+	return !pipeline.failed;
+}
+
+/* Returns a slot to be filled with a frame of TYPE, applying the queue policy
+   if there is no free slot. Returns NULL if the frame was dropped or if the
+   worker failed. */
+static slot_t *PipelineGetSlot(int type)
+{
+	slot_t *slot = NULL;
+	pthread_mutex_lock(&pipeline.mutex);
+	while (!pipeline.failed) {
+		slot_t *last_video = NULL;
+		if (pipeline.free_slots != NULL) {
+			slot = pipeline.free_slots;
+			pipeline.free_slots = slot->next;
+			break;
+		}
+		if (FILE_EXPORT_queue_policy == FILE_EXPORT_QUEUE_BLOCK) {
+			pthread_cond_wait(&pipeline.cond, &pipeline.mutex);
+			continue;
+		}
+		if (FILE_EXPORT_queue_policy == FILE_EXPORT_QUEUE_DROP && type == SLOT_VIDEO) {
+			/* Keep the timing by repeating the last queued frame. Audio
+			   is never dropped, and without a queued frame to repeat the
+			   queue grows. */
+			slot_t *s;
+			for (s = pipeline.head; s != NULL; s = s->next) {
+				if (s->type == SLOT_VIDEO)
+					last_video = s;
+			}
+		}
+		if (last_video != NULL) {
+			last_video->repeat++;
+			pipeline.dropped++;
+		}
+		else
+			slot = NewSlot();
+		break;
+	}
+	pthread_mutex_unlock(&pipeline.mutex);
+	if (slot != NULL)
+		slot->type = type;
+	return slot;
+}
+
+static void PipelineQueue(slot_t *slot)
+{
+	slot->repeat = 0;
+	slot->state = SLOT_NEW;
+	slot->next = NULL;
+	pthread_mutex_lock(&pipeline.mutex);
+	if (pipeline.tail != NULL)
+		pipeline.tail->next = slot;
+	else
+		pipeline.head = slot;
+	pipeline.tail = slot;
+	pipeline.queued++;
+	pthread_cond_broadcast(&pipeline.cond);
+	pthread_mutex_unlock(&pipeline.mutex);
+}
+
+/* Checks if the worker failed, in which case stops it and closes the file.
+   RETURNS: TRUE if the worker failed */
+static int PipelineFailed(void)
+{
+	int failed;
+	pthread_mutex_lock(&pipeline.mutex);
+	failed = pipeline.failed;
+	pthread_mutex_unlock(&pipeline.mutex);
+	if (failed) {
+		PipelineStop();
+		CONTAINER_Close(FALSE);
+	}
+	return failed;
+}
+
+int File_Export_GetQueueStats(int *queued, int *slots, int *dropped)
+{
+	if (!pipeline.active)
+		return FALSE;
+	pthread_mutex_lock(&pipeline.mutex);
+	*queued = pipeline.queued;
+	*slots = pipeline.num_slots;
+	*dropped = pipeline.dropped;
+	pthread_mutex_unlock(&pipeline.mutex);
+	return TRUE;
+}
+#endif /* RECORDING_QUEUE */
+
 /* File_Export_IsRecording simply returns true if any multimedia file is
    currently open and able to receive writes.
 
@@ -250,6 +713,10 @@ int File_Export_IsRecording(void)
    */
 int File_Export_StopRecording(void)
 {
+#ifdef RECORDING_QUEUE
+	if (!PipelineStop())
+		return CONTAINER_Close(FALSE);
+#endif
 	return CONTAINER_Close(TRUE);
 }
 
@@ -263,7 +730,12 @@ int File_Export_StartRecording(const char *filename)
 {
 	File_Export_StopRecording();
 
-	return CONTAINER_Open(filename);
+	if (!CONTAINER_Open(filename))
+		return FALSE;
+#ifdef RECORDING_QUEUE
+	PipelineStart();
+#endif
+	return TRUE;
 }
 
 #ifdef AUDIO_RECORDING
@@ -289,13 +761,32 @@ int File_Export_GetNextSoundFile(char *buffer, int bufsize) {
    If using video, there must be a call to File_Export_WriteAudio for each call
    to File_Export_WriteAudio, but the functions may be called in either order.
 
+   With the recording queue, the samples are copied and encoded later.
+
    RETURNS: Non-zero if no error; zero if error */
 int File_Export_WriteAudio(const UBYTE *samples, int num_samples)
 {
+	static UBYTE *converted = NULL;
+	static int converted_size = 0;
 	int result;
 
 	if (!container) return 0;
 	if (!audio_codec || (audio_codec && !container->audio_frame)) return 1;
+#ifdef RECORDING_QUEUE
+	if (pipeline.active) {
+		slot_t *slot = PipelineGetSlot(SLOT_AUDIO);
+		if (slot == NULL)
+			return !PipelineFailed();
+		CopySamples(samples, num_samples, &slot->data, &slot->data_size);
+		slot->num_samples = num_samples;
+		PipelineQueue(slot);
+		return 1;
+	}
+#endif
+	if (POKEYSND_snd_flags & POKEYSND_FLOAT32) {
+		CopySamples(samples, num_samples, &converted, &converted_size);
+		samples = converted;
+	}
 	result = CONTAINER_AddAudioSamples(samples, num_samples);
 	if (!result) {
 		CONTAINER_Close(FALSE);
@@ -320,6 +811,8 @@ int File_Export_GetNextVideoFile(char *buffer, int bufsize) {
    calling File_Export_WriteVideo again, but the audio and video functions may
    be called in either order.
 
+   With the recording queue, the screen is copied and encoded later.
+
    RETURNS: non-zero if successfully added the video frame to the file
    (indicating the size of the video frame in bytes) or 0 if failed when
    creating the video frame or adding it to the file. */
@@ -329,7 +822,22 @@ int File_Export_WriteVideo(void)
 
 	if (!container) return 0;
 	if (!video_codec || (video_codec && !container->video_frame)) return 1;
-	result = CONTAINER_AddVideoFrame();
+#ifdef RECORDING_QUEUE
+	if (pipeline.active) {
+		slot_t *slot = PipelineGetSlot(SLOT_VIDEO);
+		if (slot == NULL)
+			return !PipelineFailed();
+		if (slot->data_size < Screen_WIDTH * Screen_HEIGHT) {
+			free(slot->data);
+			slot->data = (UBYTE *)Util_malloc(Screen_WIDTH * Screen_HEIGHT);
+			slot->data_size = Screen_WIDTH * Screen_HEIGHT;
+		}
+		memcpy(slot->data, Screen_atari, Screen_WIDTH * Screen_HEIGHT);
+		PipelineQueue(slot);
+		return 1;
+	}
+#endif
+	result = CONTAINER_AddVideoFrame((UBYTE *)Screen_atari);
 	if (!result) {
 		CONTAINER_Close(FALSE);
 	}
@@ -347,8 +855,24 @@ int File_Export_WriteVideo(void)
 int File_Export_GetRecordingStats(int *seconds, int *size, char **media_type)
 {
 	if (container) {
-		*seconds = (int)(video_frame_count / fps);
-		*size = byteswritten / 1024;
+		ULONG frames;
+		CONTAINER_OFFSET_t bytes;
+#ifdef RECORDING_QUEUE
+		if (pipeline.active) {
+			/* The worker updates the statistics. */
+			pthread_mutex_lock(&pipeline.mutex);
+			frames = pipeline.frame_count;
+			bytes = pipeline.bytes;
+			pthread_mutex_unlock(&pipeline.mutex);
+		}
+		else
+#endif
+		{
+			frames = video_frame_count;
+			bytes = byteswritten;
+		}
+		*seconds = (int)(frames / fps);
+		*size = CONTAINER_OffsetKB(&bytes);
 		*media_type = description;
 		return 1;
 	}
@@ -367,25 +891,196 @@ int File_Export_GetRecordingStats(int *seconds, int *size, char **media_type)
 
    Returns: TRUE if matched, FALSE if not. */
 int File_Export_ImageTypeSupported(const char *id) {
-	return CODECS_IMAGE_Init(id);
+	return CODECS_IMAGE_Match(id) != NULL;
 }
 
-/* Convenience function to save the current emulated screen to a file.
-
-   Returns: TRUE if matched, FALSE if not. */
-int File_Export_SaveScreen(const char *filename, UBYTE *ptr1, UBYTE *ptr2) {
+static int SaveScreen(const char *filename, IMAGE_CODEC_t *codec, const IMAGE_CODEC_SCREEN_t *screen, UBYTE *ptr1, UBYTE *ptr2)
+{
 	int result = 0;
 	FILE *fp;
 
-	CODECS_IMAGE_Init(filename);
-	if (image_codec) {
+	if (codec) {
 		fp = fopen(filename, "wb");
 		if (fp == NULL)
 			return 0;
-		result = image_codec->to_file(fp, ptr1, ptr2);
+		result = codec->to_file(fp, screen, ptr1, ptr2);
 		fclose(fp);
 	}
 	return result;
 }
 
+/* Saves the screen now, as it is displayed. */
+static int SaveCurrentScreen(const char *filename, UBYTE *ptr1, UBYTE *ptr2)
+{
+	IMAGE_CODEC_SCREEN_t screen;
+
+	CODECS_IMAGE_GetScreen(&screen);
+	return SaveScreen(filename, CODECS_IMAGE_Match(filename), &screen, ptr1, ptr2);
+}
+
+#ifdef SCREENSHOT_QUEUE
+/* Screenshot queue. The emulation copies the screen (and the other field of
+   an interlaced screenshot) into a buffer from a small pool and queues it,
+   together with the codec, the margins and the colours at that moment; a
+   worker thread saves the queued screenshots in order. The worker reads
+   nothing else that the emulation changes. A screenshot saved directly waits
+   for the queue to drain first, so the files are written in order. */
+#define MAX_SCREENSHOTS 8
+
+typedef struct shot_t {
+	char filename[FILENAME_MAX];
+	IMAGE_CODEC_t *codec;
+	IMAGE_CODEC_SCREEN_t screen; /* Its colours point to COLOURS */
+	int colours[256];
+	UBYTE *field1;
+	UBYTE *field2; /* Allocated with the first interlaced screenshot */
+	int interlaced;
+	struct shot_t *next;
+} shot_t;
+
+static struct {
+	int active;
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	shot_t *head; /* Queued screenshots, oldest first */
+	shot_t *tail;
+	shot_t *free_shots;
+	int num_shots;
+	int busy; /* The worker is saving a screenshot */
+	int stop; /* No more screenshots will be queued */
+} shots;
+
+static void *ScreenshotWorker(void *arg)
+{
+	pthread_mutex_lock(&shots.mutex);
+	for (;;) {
+		shot_t *shot;
+		while (shots.head == NULL && !shots.stop)
+			pthread_cond_wait(&shots.cond, &shots.mutex);
+		if (shots.head == NULL)
+			break;
+		shot = shots.head;
+		shots.head = shot->next;
+		if (shots.head == NULL)
+			shots.tail = NULL;
+		shots.busy = TRUE;
+		pthread_mutex_unlock(&shots.mutex);
+		if (!SaveScreen(shot->filename, shot->codec, &shot->screen, shot->field1, shot->interlaced ? shot->field2 : NULL))
+			Log_print("Failed saving to file: %s", shot->filename);
+		pthread_mutex_lock(&shots.mutex);
+		shots.busy = FALSE;
+		shot->next = shots.free_shots;
+		shots.free_shots = shot;
+		pthread_cond_broadcast(&shots.cond);
+	}
+	pthread_mutex_unlock(&shots.mutex);
+	return NULL;
+}
+
+/* Starts the worker thread. Returns FALSE if it couldn't be started. */
+static int ScreenshotStart(void)
+{
+	shots.head = shots.tail = shots.free_shots = NULL;
+	shots.num_shots = 0;
+	shots.busy = FALSE;
+	shots.stop = FALSE;
+	if (pthread_mutex_init(&shots.mutex, NULL) != 0)
+		return FALSE;
+	if (pthread_cond_init(&shots.cond, NULL) != 0) {
+		pthread_mutex_destroy(&shots.mutex);
+		return FALSE;
+	}
+	if (pthread_create(&shots.thread, NULL, ScreenshotWorker, NULL) != 0) {
+		pthread_cond_destroy(&shots.cond);
+		pthread_mutex_destroy(&shots.mutex);
+		return FALSE;
+	}
+	shots.active = TRUE;
+	return TRUE;
+}
+#endif /* SCREENSHOT_QUEUE */
+
+void File_Export_FinishScreenshots(void)
+{
+#ifdef SCREENSHOT_QUEUE
+	if (!shots.active)
+		return;
+	pthread_mutex_lock(&shots.mutex);
+	shots.stop = TRUE;
+	pthread_cond_broadcast(&shots.cond);
+	pthread_mutex_unlock(&shots.mutex);
+	pthread_join(shots.thread, NULL);
+	pthread_cond_destroy(&shots.cond);
+	pthread_mutex_destroy(&shots.mutex);
+	while (shots.free_shots != NULL) {
+		shot_t *shot = shots.free_shots;
+		shots.free_shots = shot->next;
+		free(shot->field1);
+		free(shot->field2);
+		free(shot);
+	}
+	shots.active = FALSE;
+#endif
+}
+
+/* Convenience function to save the current emulated screen to a file.
+
+   Returns: TRUE if matched, FALSE if not. */
+int File_Export_SaveScreen(const char *filename, UBYTE *ptr1, UBYTE *ptr2) {
+	File_Export_FinishScreenshots();
+	return SaveCurrentScreen(filename, ptr1, ptr2);
+}
+
+int File_Export_QueueScreen(const char *filename, UBYTE *ptr1, UBYTE *ptr2)
+{
+#ifdef SCREENSHOT_QUEUE
+	shot_t *shot;
+
+	if (!shots.active && !ScreenshotStart())
+		return SaveCurrentScreen(filename, ptr1, ptr2);
+
+	pthread_mutex_lock(&shots.mutex);
+	while (shots.free_shots == NULL && shots.num_shots >= MAX_SCREENSHOTS)
+		pthread_cond_wait(&shots.cond, &shots.mutex);
+	shot = shots.free_shots;
+	if (shot != NULL)
+		shots.free_shots = shot->next;
+	else
+		shots.num_shots++;
+	pthread_mutex_unlock(&shots.mutex);
+
+	if (shot == NULL) {
+		shot = (shot_t *) Util_malloc(sizeof(shot_t));
+		shot->field1 = (UBYTE *) Util_malloc(Screen_WIDTH * Screen_HEIGHT);
+		shot->field2 = NULL;
+	}
+	Util_strlcpy(shot->filename, filename, FILENAME_MAX);
+	shot->codec = CODECS_IMAGE_Match(filename);
+	CODECS_IMAGE_GetScreen(&shot->screen);
+	memcpy(shot->colours, shot->screen.colours, sizeof(shot->colours));
+	shot->screen.colours = shot->colours;
+	memcpy(shot->field1, ptr1, Screen_WIDTH * Screen_HEIGHT);
+	shot->interlaced = ptr2 != NULL;
+	if (ptr2 != NULL) {
+		if (shot->field2 == NULL)
+			shot->field2 = (UBYTE *) Util_malloc(Screen_WIDTH * Screen_HEIGHT);
+		memcpy(shot->field2, ptr2, Screen_WIDTH * Screen_HEIGHT);
+	}
+	shot->next = NULL;
+
+	pthread_mutex_lock(&shots.mutex);
+	if (shots.tail != NULL)
+		shots.tail->next = shot;
+	else
+		shots.head = shot;
+	shots.tail = shot;
+	pthread_cond_broadcast(&shots.cond);
+	pthread_mutex_unlock(&shots.mutex);
+	return TRUE;
+#else
+	return SaveCurrentScreen(filename, ptr1, ptr2);
+#endif /* SCREENSHOT_QUEUE */
+}
+
 #endif /*def SCREENSHOTS */
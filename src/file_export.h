@@ -36,11 +36,39 @@ int File_Export_WriteVideo(void);
 #endif
 
 int File_Export_GetRecordingStats(int *seconds, int *size, char **media_type);
+
+#ifdef HAVE_PTHREAD
+/* What to do with a video frame when the recording queue is full. */
+enum {
+	FILE_EXPORT_QUEUE_BLOCK, /* Wait for the encoder */
+	FILE_EXPORT_QUEUE_DROP, /* Record a copy of the previous frame instead */
+	FILE_EXPORT_QUEUE_GROW /* Add a slot to the queue */
+};
+/* Number of frames queued for encoding in a worker thread; 0 encodes them
+   synchronously. */
+extern int FILE_EXPORT_queue_size;
+extern int FILE_EXPORT_queue_policy;
+/* Number of threads encoding video frames at once, with codecs that encode
+   every frame on its own. */
+extern int FILE_EXPORT_encoder_threads;
+
+/* Gets the current number of queued frames, the number of allocated queue
+   slots and the number of dropped frames.
+   RETURNS: TRUE if frames are being queued, FALSE if not */
+int File_Export_GetQueueStats(int *queued, int *slots, int *dropped);
+#endif
 #endif /* defined(AUDIO_RECORDING) || defined(VIDEO_RECORDING) */
 
 #ifdef SCREENSHOTS
 int File_Export_ImageTypeSupported(const char *id);
 int File_Export_SaveScreen(const char *filename, UBYTE *ptr1, UBYTE *ptr2);
+/* Like File_Export_SaveScreen(), but copies the screen and returns without
+   waiting for the file to be written, if thread support is available. A
+   failure to write the file is only logged.
+   RETURNS: FALSE if the file could not be written at once */
+int File_Export_QueueScreen(const char *filename, UBYTE *ptr1, UBYTE *ptr2);
+/* Waits till all queued screenshots are written, and frees the queue. */
+void File_Export_FinishScreenshots(void);
 #endif
 
 #endif /* FILE_EXPORT_H_ */
@@ -0,0 +1,565 @@
+/*
+ * hdimage.c - cached access to hard disk images
+ *
+ * Copyright (C) 2026 Atari800 development team (see DOC/CREDITS)
+ *
+ * This file is part of the Atari800 emulator project which emulates
+ * the Atari 400, 800, 800XL, 130XE, and 5200 8-bit computers.
+ *
+ * Atari800 is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Atari800 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Atari800; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/* The image is cached in blocks of BLOCK_SIZE bytes. A block is loaded
+   either by the emulation when it is needed, or ahead of time by the worker
+   thread when the emulation reads sequentially. Writes only modify the cached
+   block and extend its dirty range; the worker writes the dirty ranges back,
+   in the order of their position in the image, when there were no writes for
+   WRITEBACK_DELAY_MS. While a block is being written back, it can be read
+   but not modified. Only the emulation assigns blocks to positions in the
+   image, so a block never changes its position behind its back. */
+
+#define _XOPEN_SOURCE 600
+
+#include "config.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#if defined(HAVE_PTHREAD) && defined(HAVE_PREAD) && defined(HAVE_PWRITE)
+#define HDIMAGE_THREADED
+#include <pthread.h>
+#include <time.h>
+#endif
+
+#include "atari.h"
+#include "hdimage.h"
+#include "util.h"
+
+enum {
+	BLOCK_SIZE = 65536,
+	CACHE_BLOCKS = 128,
+	HASH_SIZE = 256,
+	READAHEAD_BLOCKS = 4,
+	WRITEBACK_DELAY_MS = 200
+};
+
+enum {
+	BLOCK_FREE, /* Not assigned to a position in the image */
+	BLOCK_QUEUED, /* To be loaded by the worker */
+	BLOCK_LOADING, /* Being loaded */
+	BLOCK_VALID
+};
+
+typedef struct block_t {
+	off_t number; /* Position in the image, in blocks */
+	UBYTE *data;
+	int state;
+	int writing; /* The dirty range is being written back */
+	unsigned int dirty_start; /* Modified bytes, none if equal to DIRTY_END */
+	unsigned int dirty_end;
+	ULONG last_use;
+	struct block_t *next; /* In the hash chain */
+} block_t;
+
+struct HDIMAGE_t {
+	FILE *fp;
+	off_t size;
+	block_t blocks[CACHE_BLOCKS];
+	block_t *hash[HASH_SIZE];
+	ULONG use_count;
+	off_t last_read; /* Last block read by the emulation, to detect sequential access */
+	int queued; /* Number of blocks in BLOCK_QUEUED */
+	int dirty; /* Number of blocks with a dirty range */
+	ULONG write_count; /* Incremented with each write, to detect idle time */
+	int error; /* A write-back failed */
+#ifdef HDIMAGE_THREADED
+	int threaded;
+	int quit;
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+#endif
+};
+
+static void Lock(HDIMAGE_t *image)
+{
+#ifdef HDIMAGE_THREADED
+	if (image->threaded)
+		pthread_mutex_lock(&image->mutex);
+#endif
+}
+
+static void Unlock(HDIMAGE_t *image)
+{
+#ifdef HDIMAGE_THREADED
+	if (image->threaded)
+		pthread_mutex_unlock(&image->mutex);
+#endif
+}
+
+/* Waits for a change of state of a block. Called with the mutex locked, and
+   only when a block is busy, which requires the worker. */
+static void WaitForChange(HDIMAGE_t *image)
+{
+#ifdef HDIMAGE_THREADED
+	pthread_cond_wait(&image->cond, &image->mutex);
+#endif
+}
+
+static void Signal(HDIMAGE_t *image)
+{
+#ifdef HDIMAGE_THREADED
+	if (image->threaded)
+		pthread_cond_broadcast(&image->cond);
+#endif
+}
+
+/* Returns the number of bytes read, less than LENGTH at the end of the file
+   or on error. */
+static size_t ReadAt(HDIMAGE_t *image, off_t offset, UBYTE *buf, size_t length)
+{
+#ifdef HAVE_PREAD
+	int fd = fileno(image->fp);
+	size_t done = 0;
+	while (done < length) {
+		ssize_t n = pread(fd, buf + done, length - done, offset + done);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			break;
+		done += n;
+	}
+	return done;
+#else
+	if (fseek(image->fp, (long)offset, SEEK_SET) != 0)
+		return 0;
+	return fread(buf, 1, length, image->fp);
+#endif
+}
+
+static int WriteAt(HDIMAGE_t *image, off_t offset, const UBYTE *buf, size_t length)
+{
+#ifdef HAVE_PWRITE
+	int fd = fileno(image->fp);
+	while (length > 0) {
+		ssize_t n = pwrite(fd, buf, length, offset);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return FALSE;
+		buf += n;
+		offset += n;
+		length -= n;
+	}
+	return TRUE;
+#else
+	return fseek(image->fp, (long)offset, SEEK_SET) == 0
+	       && fwrite(buf, length, 1, image->fp) == 1
+	       && fflush(image->fp) == 0;
+#endif
+}
+
+/* Returns the number of bytes of the image in block NUMBER. */
+static size_t BlockLength(HDIMAGE_t *image, off_t number)
+{
+	off_t left = image->size - number * BLOCK_SIZE;
+	return left < BLOCK_SIZE ? (size_t)left : BLOCK_SIZE;
+}
+
+/* Loads BLOCK, which is in BLOCK_LOADING. Called with the mutex locked. */
+static void LoadBlock(HDIMAGE_t *image, block_t *block)
+{
+	size_t length = BlockLength(image, block->number);
+	size_t done;
+	Unlock(image);
+	done = ReadAt(image, block->number * BLOCK_SIZE, block->data, length);
+	/* Unreadable parts of the image, the parts of a grown image not written
+	   back yet and the rest of the last block read as zeros. */
+	memset(block->data + done, 0, BLOCK_SIZE - done);
+	Lock(image);
+	block->state = BLOCK_VALID;
+	Signal(image);
+}
+
+/* Writes back the dirty range of BLOCK. Called with the mutex locked. */
+static void WriteBackBlock(HDIMAGE_t *image, block_t *block)
+{
+	unsigned int start = block->dirty_start;
+	unsigned int end = block->dirty_end;
+	int ok;
+	block->dirty_start = block->dirty_end = 0;
+	block->writing = TRUE;
+	image->dirty--;
+	Unlock(image);
+	ok = WriteAt(image, block->number * BLOCK_SIZE + start, block->data + start, end - start);
+	Lock(image);
+	if (!ok)
+		image->error = TRUE;
+	block->writing = FALSE;
+	Signal(image);
+}
+
+static int CompareBlocks(const void *a, const void *b)
+{
+	off_t na = (*(block_t *const *)a)->number;
+	off_t nb = (*(block_t *const *)b)->number;
+	return na < nb ? -1 : na > nb;
+}
+
+/* Writes back all dirty blocks, in their order in the image.
+   Called with the mutex locked. */
+static void WriteBack(HDIMAGE_t *image)
+{
+	block_t *dirty[CACHE_BLOCKS];
+	int count = 0;
+	int i;
+	for (i = 0; i < CACHE_BLOCKS; i++) {
+		block_t *block = &image->blocks[i];
+		if (block->dirty_start != block->dirty_end && !block->writing)
+			dirty[count++] = block;
+	}
+	qsort(dirty, count, sizeof(block_t *), CompareBlocks);
+	for (i = 0; i < count; i++) {
+		/* The emulation may have written the block back in the meantime. */
+		if (dirty[i]->dirty_start != dirty[i]->dirty_end && !dirty[i]->writing)
+			WriteBackBlock(image, dirty[i]);
+	}
+}
+
+static block_t *FindBlock(HDIMAGE_t *image, off_t number)
+{
+	block_t *block = image->hash[number % HASH_SIZE];
+	while (block != NULL && block->number != number)
+		block = block->next;
+	return block;
+}
+
+/* Returns an unused block, or the least recently used clean block that
+   isn't busy, removed from the hash table. If CLEAN_ONLY is FALSE, a dirty
+   block may be written back to get one. Returns NULL if none is available.
+   Called by the emulation with the mutex locked. */
+static block_t *TakeBlock(HDIMAGE_t *image, int clean_only)
+{
+	block_t *victim;
+	block_t **link;
+	for (;;) {
+		int i;
+		victim = NULL;
+		for (i = 0; i < CACHE_BLOCKS; i++) {
+			block_t *block = &image->blocks[i];
+			if (block->state == BLOCK_FREE)
+				return block;
+			if (block->state != BLOCK_VALID || block->writing)
+				continue;
+			if (clean_only && block->dirty_start != block->dirty_end)
+				continue;
+			if (victim == NULL || block->last_use < victim->last_use)
+				victim = block;
+		}
+		if (victim == NULL) {
+			if (clean_only)
+				return NULL;
+			/* All blocks are busy. */
+			WaitForChange(image);
+			continue;
+		}
+		if (victim->dirty_start == victim->dirty_end)
+			break;
+		WriteBackBlock(image, victim);
+	}
+	for (link = &image->hash[victim->number % HASH_SIZE]; *link != victim; link = &(*link)->next);
+	*link = victim->next;
+	victim->state = BLOCK_FREE;
+	return victim;
+}
+
+static void AssignBlock(HDIMAGE_t *image, block_t *block, off_t number, int state)
+{
+	block->number = number;
+	block->state = state;
+	block->next = image->hash[number % HASH_SIZE];
+	image->hash[number % HASH_SIZE] = block;
+}
+
+/* Returns block NUMBER loaded in the cache. If FOR_WRITE, also waits till
+   it isn't being written back. Called by the emulation with the mutex
+   locked. */
+static block_t *GetBlock(HDIMAGE_t *image, off_t number, int for_write)
+{
+	block_t *block = FindBlock(image, number);
+	if (block == NULL) {
+		block = TakeBlock(image, FALSE);
+		AssignBlock(image, block, number, BLOCK_LOADING);
+		LoadBlock(image, block);
+	}
+	else if (block->state == BLOCK_QUEUED) {
+		/* Don't wait for the worker to get to it. */
+		block->state = BLOCK_LOADING;
+		image->queued--;
+		LoadBlock(image, block);
+	}
+	while (block->state == BLOCK_LOADING || (for_write && block->writing))
+		WaitForChange(image);
+	block->last_use = ++image->use_count;
+	return block;
+}
+
+/* Queues the blocks following block LAST for loading by the worker.
+   Called by the emulation with the mutex locked. */
+static void ReadAhead(HDIMAGE_t *image, off_t last)
+{
+	off_t number;
+	for (number = last + 1; number <= last + READAHEAD_BLOCKS && number * BLOCK_SIZE < image->size; number++) {
+		block_t *block;
+		if (FindBlock(image, number) != NULL)
+			continue;
+		/* Don't write back anything just for reading ahead. */
+		block = TakeBlock(image, TRUE);
+		if (block == NULL)
+			break;
+		AssignBlock(image, block, number, BLOCK_QUEUED);
+		/* Not to be evicted before it's used. */
+		block->last_use = ++image->use_count;
+		image->queued++;
+	}
+	Signal(image);
+}
+
+#ifdef HDIMAGE_THREADED
+static void *Worker(void *arg)
+{
+	HDIMAGE_t *image = (HDIMAGE_t *)arg;
+	pthread_mutex_lock(&image->mutex);
+	while (!image->quit) {
+		if (image->queued > 0) {
+			/* Read ahead, in order. */
+			block_t *next = NULL;
+			int i;
+			for (i = 0; i < CACHE_BLOCKS; i++) {
+				block_t *block = &image->blocks[i];
+				if (block->state == BLOCK_QUEUED && (next == NULL || block->number < next->number))
+					next = block;
+			}
+			next->state = BLOCK_LOADING;
+			image->queued--;
+			LoadBlock(image, next);
+		}
+		else if (image->dirty >= CACHE_BLOCKS / 4)
+			/* Don't let long runs of writes fill the cache. */
+			WriteBack(image);
+		else if (image->dirty > 0) {
+			/* Write back after the writes stop for a while. */
+			ULONG write_count = image->write_count;
+			struct timespec deadline;
+			clock_gettime(CLOCK_REALTIME, &deadline);
+			deadline.tv_nsec += WRITEBACK_DELAY_MS * 1000000L;
+			if (deadline.tv_nsec >= 1000000000L) {
+				deadline.tv_sec++;
+				deadline.tv_nsec -= 1000000000L;
+			}
+			if (pthread_cond_timedwait(&image->cond, &image->mutex, &deadline) == ETIMEDOUT
+			    && write_count == image->write_count && image->queued == 0)
+				WriteBack(image);
+		}
+		else
+			pthread_cond_wait(&image->cond, &image->mutex);
+	}
+	pthread_mutex_unlock(&image->mutex);
+	return NULL;
+}
+#endif /* HDIMAGE_THREADED */
+
+HDIMAGE_t *HDIMAGE_Open(const char *filename)
+{
+	HDIMAGE_t *image;
+	FILE *fp = fopen(filename, "rb+");
+	int i;
+	if (fp == NULL)
+		return NULL;
+	image = (HDIMAGE_t *)Util_malloc(sizeof(HDIMAGE_t));
+	image->fp = fp;
+#ifdef HAVE_PREAD
+	image->size = lseek(fileno(fp), 0, SEEK_END);
+#else
+	fseek(fp, 0, SEEK_END);
+	image->size = ftell(fp);
+#endif
+	if (image->size < 0)
+		image->size = 0;
+	for (i = 0; i < CACHE_BLOCKS; i++) {
+		block_t *block = &image->blocks[i];
+		block->data = (UBYTE *)Util_malloc(BLOCK_SIZE);
+		block->state = BLOCK_FREE;
+		block->writing = FALSE;
+		block->dirty_start = block->dirty_end = 0;
+		block->last_use = 0;
+		block->next = NULL;
+	}
+	for (i = 0; i < HASH_SIZE; i++)
+		image->hash[i] = NULL;
+	image->use_count = 0;
+	image->last_read = -2;
+	image->queued = 0;
+	image->dirty = 0;
+	image->write_count = 0;
+	image->error = FALSE;
+#ifdef HDIMAGE_THREADED
+	image->threaded = FALSE;
+	image->quit = FALSE;
+	if (pthread_mutex_init(&image->mutex, NULL) == 0) {
+		if (pthread_cond_init(&image->cond, NULL) == 0) {
+			if (pthread_create(&image->thread, NULL, Worker, image) == 0)
+				image->threaded = TRUE;
+			else
+				pthread_cond_destroy(&image->cond);
+		}
+		if (!image->threaded)
+			pthread_mutex_destroy(&image->mutex);
+	}
+#endif
+	return image;
+}
+
+void HDIMAGE_Close(HDIMAGE_t *image)
+{
+	int i;
+#ifdef HDIMAGE_THREADED
+	if (image->threaded) {
+		pthread_mutex_lock(&image->mutex);
+		image->quit = TRUE;
+		pthread_cond_broadcast(&image->cond);
+		pthread_mutex_unlock(&image->mutex);
+		pthread_join(image->thread, NULL);
+		pthread_cond_destroy(&image->cond);
+		pthread_mutex_destroy(&image->mutex);
+		image->threaded = FALSE;
+	}
+#endif
+	HDIMAGE_Flush(image);
+	fclose(image->fp);
+	for (i = 0; i < CACHE_BLOCKS; i++)
+		free(image->blocks[i].data);
+	free(image);
+}
+
+off_t HDIMAGE_Size(HDIMAGE_t *image)
+{
+	return image->size;
+}
+
+size_t HDIMAGE_Read(HDIMAGE_t *image, off_t offset, void *buf, size_t length)
+{
+	UBYTE *p = (UBYTE *)buf;
+	off_t first;
+	off_t last;
+	off_t number;
+	if (offset < 0 || offset >= image->size)
+		return 0;
+	if ((off_t)length > image->size - offset)
+		length = (size_t)(image->size - offset);
+	if (length == 0)
+		return 0;
+	first = offset / BLOCK_SIZE;
+	last = (offset + length - 1) / BLOCK_SIZE;
+	Lock(image);
+	for (number = first; number <= last; number++) {
+		block_t *block = GetBlock(image, number, FALSE);
+		off_t start = number == first ? offset % BLOCK_SIZE : 0;
+		off_t end = number == last ? (offset + length - 1) % BLOCK_SIZE + 1 : BLOCK_SIZE;
+		memcpy(p, block->data + start, end - start);
+		p += end - start;
+	}
+#ifdef HDIMAGE_THREADED
+	if (image->threaded && (first == image->last_read || first == image->last_read + 1))
+		ReadAhead(image, last);
+#endif
+	image->last_read = last;
+	Unlock(image);
+	return length;
+}
+
+int HDIMAGE_Write(HDIMAGE_t *image, off_t offset, const void *buf, size_t length)
+{
+	const UBYTE *p = (const UBYTE *)buf;
+	off_t first;
+	off_t last;
+	off_t number;
+	int result;
+	if (offset < 0)
+		return FALSE;
+	if (length == 0)
+		return TRUE;
+	first = offset / BLOCK_SIZE;
+	last = (offset + length - 1) / BLOCK_SIZE;
+	Lock(image);
+	if ((off_t)length > image->size - offset)
+		/* Grow the image. The last block is already zeroed past the old
+		   end, see LoadBlock. */
+		image->size = offset + length;
+	for (number = first; number <= last; number++) {
+		block_t *block = GetBlock(image, number, TRUE);
+		unsigned int start = number == first ? (unsigned int)(offset % BLOCK_SIZE) : 0;
+		unsigned int end = number == last ? (unsigned int)((offset + length - 1) % BLOCK_SIZE) + 1 : BLOCK_SIZE;
+		memcpy(block->data + start, p, end - start);
+		p += end - start;
+		if (block->dirty_start == block->dirty_end) {
+			block->dirty_start = start;
+			block->dirty_end = end;
+			image->dirty++;
+		}
+		else {
+			if (start < block->dirty_start)
+				block->dirty_start = start;
+			if (end > block->dirty_end)
+				block->dirty_end = end;
+		}
+#ifdef HDIMAGE_THREADED
+		if (!image->threaded)
+#endif
+			WriteBackBlock(image, block);
+	}
+	image->write_count++;
+	Signal(image);
+	result = !image->error;
+	Unlock(image);
+	return result;
+}
+
+int HDIMAGE_Flush(HDIMAGE_t *image)
+{
+	int result;
+	int i;
+	Lock(image);
+	WriteBack(image);
+	/* Wait for the write-backs started by the worker. */
+	for (i = 0; i < CACHE_BLOCKS; i++) {
+		while (image->blocks[i].writing)
+			WaitForChange(image);
+	}
+#ifndef HAVE_PWRITE
+	fflush(image->fp);
+#endif
+#ifdef HAVE_FSYNC
+	if (fsync(fileno(image->fp)) != 0)
+		image->error = TRUE;
+#endif
+	result = !image->error;
+	image->error = FALSE;
+	Unlock(image);
+	return result;
+}
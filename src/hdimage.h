@@ -0,0 +1,32 @@
+#ifndef HDIMAGE_H_
+#define HDIMAGE_H_
+
+#include <stdio.h>
+#include <sys/types.h>
+
+/* Access to hard disk images (IDE, SCSI) through a block cache. Sequential
+   reads are followed by reading ahead, and writes are collected in the cache
+   and written back by a worker thread after a short idle time. Without
+   thread support the cache is write-through. */
+typedef struct HDIMAGE_t HDIMAGE_t;
+
+/* Opens image FILENAME for reading and writing. Returns NULL on error,
+   with errno set. */
+HDIMAGE_t *HDIMAGE_Open(const char *filename);
+/* Writes back all modified data, syncs it to the storage and closes IMAGE. */
+void HDIMAGE_Close(HDIMAGE_t *image);
+
+/* Returns size of the image in bytes. */
+off_t HDIMAGE_Size(HDIMAGE_t *image);
+/* Reads LENGTH bytes at OFFSET into BUF. Returns the number of bytes read,
+   which is less than LENGTH at the end of the image or on error. */
+size_t HDIMAGE_Read(HDIMAGE_t *image, off_t offset, void *buf, size_t length);
+/* Writes LENGTH bytes at OFFSET from BUF. Writing past the end of the image
+   makes it grow, with zeros between the old end and OFFSET. Returns FALSE on
+   error, including failure of the write-back of earlier writes. */
+int HDIMAGE_Write(HDIMAGE_t *image, off_t offset, const void *buf, size_t length);
+/* Writes back all modified data and syncs it to the storage.
+   Returns FALSE on error. */
+int HDIMAGE_Flush(HDIMAGE_t *image);
+
+#endif /* HDIMAGE_H_ */
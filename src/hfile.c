@@ -0,0 +1,340 @@
+/*
+ * hfile.c - buffered host file access for the H: device
+ *
+ * Copyright (C) 2026 Atari800 development team (see DOC/CREDITS)
+ *
+ * This file is part of the Atari800 emulator project which emulates
+ * the Atari 400, 800, 800XL, 130XE, and 5200 8-bit computers.
+ *
+ * Atari800 is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Atari800 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Atari800; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/* Each file has two buffers. The emulation consumes or fills one of them,
+   while the worker thread fills the other one with the following part of the
+   file, or writes it. Only the worker touches the stream while it is busy;
+   every other operation on the stream first waits for the worker and brings
+   the stream's position in line with the bytes consumed (Sync()). */
+
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
+#include "atari.h"
+#include "hfile.h"
+#include "util.h"
+
+enum { BUFFER_SIZE = 16384 };
+
+/* Direction of the buffered access. */
+enum { MODE_NONE, MODE_READ, MODE_WRITE };
+
+/* Work for the worker thread. */
+enum { REQUEST_NONE, REQUEST_READ, REQUEST_WRITE, REQUEST_QUIT };
+
+typedef struct {
+	UBYTE data[BUFFER_SIZE];
+	size_t length; /* Number of valid bytes in DATA */
+	size_t pos; /* Next byte to consume from DATA */
+} buffer_t;
+
+struct HFILE_t {
+	FILE *fp;
+	buffer_t buffers[2];
+	buffer_t *current; /* Consumed/filled by the emulation */
+	buffer_t *next; /* Handed to the worker */
+	int mode;
+	int next_valid; /* NEXT holds (or will hold) the bytes following CURRENT */
+	int eof; /* The stream reached end of file */
+	int last_eof; /* The last HFILE_Getc() returned EOF at end of file */
+	int error; /* A write failed */
+	int write_failed; /* Set by DoRequest(), moved to ERROR by Wait() */
+	int request; /* Work for NEXT; completed when back to REQUEST_NONE */
+#ifdef HAVE_PTHREAD
+	int threaded;
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+#endif
+};
+
+/* Performs the REQUEST on NEXT. Called by the worker with the mutex
+   unlocked, or by the emulation without a worker. */
+static void DoRequest(HFILE_t *file, int request)
+{
+	buffer_t *buffer = file->next;
+	switch (request) {
+	case REQUEST_READ:
+		buffer->length = fread(buffer->data, 1, BUFFER_SIZE, file->fp);
+		buffer->pos = 0;
+		if (buffer->length < BUFFER_SIZE)
+			file->eof = TRUE;
+		break;
+	case REQUEST_WRITE:
+		if (fwrite(buffer->data, 1, buffer->length, file->fp) != buffer->length)
+			file->write_failed = TRUE;
+		buffer->length = 0;
+		break;
+	default:
+		break;
+	}
+}
+
+#ifdef HAVE_PTHREAD
+static void *Worker(void *arg)
+{
+	HFILE_t *file = (HFILE_t *)arg;
+	pthread_mutex_lock(&file->mutex);
+	for (;;) {
+		int request;
+		while (file->request == REQUEST_NONE)
+			pthread_cond_wait(&file->cond, &file->mutex);
+		request = file->request;
+		if (request == REQUEST_QUIT)
+			break;
+		pthread_mutex_unlock(&file->mutex);
+		DoRequest(file, request);
+		pthread_mutex_lock(&file->mutex);
+		file->request = REQUEST_NONE;
+		pthread_cond_broadcast(&file->cond);
+	}
+	pthread_mutex_unlock(&file->mutex);
+	return NULL;
+}
+#endif /* HAVE_PTHREAD */
+
+/* Hands NEXT to the worker. Without a worker, does the work at once. */
+static void Post(HFILE_t *file, int request)
+{
+#ifdef HAVE_PTHREAD
+	if (file->threaded) {
+		pthread_mutex_lock(&file->mutex);
+		file->request = request;
+		pthread_cond_broadcast(&file->cond);
+		pthread_mutex_unlock(&file->mutex);
+		return;
+	}
+#endif
+	DoRequest(file, request);
+}
+
+/* Waits till the worker is done with NEXT. ERROR is only updated here, so
+   that the emulation may check it without locking. */
+static void Wait(HFILE_t *file)
+{
+#ifdef HAVE_PTHREAD
+	if (file->threaded) {
+		pthread_mutex_lock(&file->mutex);
+		while (file->request != REQUEST_NONE)
+			pthread_cond_wait(&file->cond, &file->mutex);
+		pthread_mutex_unlock(&file->mutex);
+	}
+#endif
+	if (file->write_failed)
+		file->error = TRUE;
+}
+
+static void Swap(HFILE_t *file)
+{
+	buffer_t *temp = file->current;
+	file->current = file->next;
+	file->next = temp;
+}
+
+/* Drops the buffers and leaves the stream at the position of the next byte
+   to be consumed. */
+static void Sync(HFILE_t *file)
+{
+	Wait(file);
+	if (file->mode == MODE_READ) {
+		long ahead = (long)(file->current->length - file->current->pos);
+		if (file->next_valid)
+			ahead += (long)file->next->length;
+		/* Also clears the end of file indicator. */
+		fseek(file->fp, -ahead, SEEK_CUR);
+	}
+	else if (file->mode == MODE_WRITE) {
+		if (file->current->length > 0
+		    && fwrite(file->current->data, 1, file->current->length, file->fp) != file->current->length)
+			file->error = TRUE;
+		/* Make the writes visible to other users of the file. */
+		if (fflush(file->fp) != 0)
+			file->error = TRUE;
+	}
+	file->current->length = file->current->pos = 0;
+	file->next->length = file->next->pos = 0;
+	file->next_valid = FALSE;
+	file->eof = FALSE;
+	file->mode = MODE_NONE;
+}
+
+HFILE_t *HFILE_Open(FILE *fp)
+{
+	HFILE_t *file = (HFILE_t *)Util_malloc(sizeof(HFILE_t));
+	file->fp = fp;
+	file->current = &file->buffers[0];
+	file->next = &file->buffers[1];
+	file->current->length = file->current->pos = 0;
+	file->next->length = file->next->pos = 0;
+	file->mode = MODE_NONE;
+	file->next_valid = FALSE;
+	file->eof = FALSE;
+	file->last_eof = FALSE;
+	file->error = FALSE;
+	file->write_failed = FALSE;
+	file->request = REQUEST_NONE;
+#ifdef HAVE_PTHREAD
+	file->threaded = FALSE;
+	if (pthread_mutex_init(&file->mutex, NULL) == 0) {
+		if (pthread_cond_init(&file->cond, NULL) == 0) {
+			if (pthread_create(&file->thread, NULL, Worker, file) == 0)
+				file->threaded = TRUE;
+			else
+				pthread_cond_destroy(&file->cond);
+		}
+		if (!file->threaded)
+			pthread_mutex_destroy(&file->mutex);
+	}
+#endif
+	return file;
+}
+
+FILE *HFILE_Close(HFILE_t *file)
+{
+	FILE *fp = file->fp;
+	Sync(file);
+#ifdef HAVE_PTHREAD
+	if (file->threaded) {
+		Post(file, REQUEST_QUIT);
+		pthread_join(file->thread, NULL);
+		pthread_cond_destroy(&file->cond);
+		pthread_mutex_destroy(&file->mutex);
+	}
+#endif
+	free(file);
+	return fp;
+}
+
+void HFILE_Prefetch(HFILE_t *file)
+{
+	if (file->mode != MODE_READ) {
+		Sync(file);
+		file->mode = MODE_READ;
+	}
+	if (!file->next_valid && !file->eof) {
+		Post(file, REQUEST_READ);
+		file->next_valid = TRUE;
+	}
+}
+
+int HFILE_Getc(HFILE_t *file)
+{
+	if (file->mode == MODE_READ && file->current->pos < file->current->length) {
+		file->last_eof = FALSE;
+		return file->current->data[file->current->pos++];
+	}
+	HFILE_Prefetch(file);
+	if (!file->next_valid) {
+		/* End of file, or a read error. */
+		file->last_eof = file->eof;
+		return EOF;
+	}
+	Wait(file);
+	Swap(file);
+	file->next_valid = FALSE;
+	if (file->current->length == 0) {
+		file->last_eof = file->eof;
+		return EOF;
+	}
+	/* Read the following part while this one is consumed. */
+	HFILE_Prefetch(file);
+	file->last_eof = FALSE;
+	return file->current->data[file->current->pos++];
+}
+
+int HFILE_Eof(HFILE_t *file)
+{
+	return file->last_eof;
+}
+
+size_t HFILE_Read(void *buf, size_t nmemb, HFILE_t *file)
+{
+	UBYTE *p = (UBYTE *)buf;
+	size_t i;
+	for (i = 0; i < nmemb; i++) {
+		int c = HFILE_Getc(file);
+		if (c == EOF)
+			break;
+		p[i] = (UBYTE)c;
+	}
+	return i;
+}
+
+int HFILE_Putc(int c, HFILE_t *file)
+{
+	if (file->mode != MODE_WRITE) {
+		Sync(file);
+		file->mode = MODE_WRITE;
+	}
+	if (file->error) {
+		/* Drop the bytes that can't be written. */
+		file->current->length = 0;
+		return EOF;
+	}
+	file->current->data[file->current->length++] = (UBYTE)c;
+	if (file->current->length >= BUFFER_SIZE) {
+		/* Write the full buffer behind, and continue with the other one. */
+		Wait(file);
+		if (file->error) {
+			file->current->length = 0;
+			return EOF;
+		}
+		Swap(file);
+		Post(file, REQUEST_WRITE);
+	}
+	return (UBYTE)c;
+}
+
+long HFILE_Tell(HFILE_t *file)
+{
+	Sync(file);
+	return ftell(file->fp);
+}
+
+int HFILE_Seek(HFILE_t *file, long pos)
+{
+	Sync(file);
+	file->last_eof = FALSE;
+	return fseek(file->fp, pos, SEEK_SET);
+}
+
+int HFILE_Error(HFILE_t *file)
+{
+	Sync(file);
+	return file->error;
+}
+
+int HFILE_Length(HFILE_t *file)
+{
+	long pos;
+	int length;
+	Sync(file);
+	pos = ftell(file->fp);
+	length = Util_flen(file->fp);
+	fseek(file->fp, pos, SEEK_SET);
+	return length;
+}
@@ -0,0 +1,38 @@
+#ifndef HFILE_H_
+#define HFILE_H_
+
+#include <stdio.h>
+
+/* Buffered access to host files for the H: device. Reads are done ahead and
+   writes behind by a worker thread, so that slow host storage (e.g. network
+   shares) doesn't stall the emulation on every byte. Without thread support
+   the same buffering is done synchronously. */
+typedef struct HFILE_t HFILE_t;
+
+/* Takes over an open stream FP, positioned where the access will start. */
+HFILE_t *HFILE_Open(FILE *fp);
+/* Finishes all pending writes, frees FILE and returns its stream, positioned
+   after the last byte read or written. The caller closes the stream. */
+FILE *HFILE_Close(HFILE_t *file);
+
+/* Starts reading ahead, before the first HFILE_Getc(). */
+void HFILE_Prefetch(HFILE_t *file);
+/* Like fgetc(). */
+int HFILE_Getc(HFILE_t *file);
+/* Returns TRUE if the last HFILE_Getc() reached end of file, like feof(). */
+int HFILE_Eof(HFILE_t *file);
+/* Like fread() with SIZE equal to 1. */
+size_t HFILE_Read(void *buf, size_t nmemb, HFILE_t *file);
+/* Like fputc(), but the bytes are written later. Returns EOF if writing
+   of the previous bytes failed; the following bytes are then dropped. */
+int HFILE_Putc(int c, HFILE_t *file);
+/* Like ftell(). */
+long HFILE_Tell(HFILE_t *file);
+/* Like fseek() with SEEK_SET. */
+int HFILE_Seek(HFILE_t *file, long pos);
+/* Returns length of the file, including the pending writes. */
+int HFILE_Length(HFILE_t *file);
+/* Finishes the pending writes and returns TRUE if any write failed. */
+int HFILE_Error(HFILE_t *file);
+
+#endif /* HFILE_H_ */
@@ -207,15 +207,14 @@ static void ide_reset(struct ide_device *s) {
 }
 
 static int ide_init_drive(struct ide_device *s, char *filename) {
-    if (!(s->file = fopen(filename, "rb+"))) {
+    if (!(s->image = HDIMAGE_Open(filename))) {
         Log_print("%s: %s", filename, strerror(errno));
         return FALSE;
     }
 
     s->blocksize = SECTOR_SIZE;
 
-    fseeko(s->file, 0, SEEK_END);
-    s->filesize = ftello(s->file);
+    s->filesize = HDIMAGE_Size(s->image);
 
     if (IDE_debug)
         fprintf(stderr, "ide: filesize: %"PRId64"\n", (int64_t)s->filesize);
@@ -234,7 +233,7 @@ static int ide_init_drive(struct ide_device *s, char *filename) {
         s->cylinders = 16383;
     else if (s->cylinders < 2) {
         Log_print("%s: image file too small\n", filename);
-        fclose(s->file);
+        HDIMAGE_Close(s->image);
         return FALSE;
     }
 
@@ -396,9 +395,7 @@ static void ide_sector_read(struct ide_device *s) {
         if (n > s->req_nb_sectors)
             n = s->req_nb_sectors;
 
-        if (fseeko(s->file, sector_num * SECTOR_SIZE, SEEK_SET) < 0)
-            goto fail;
-        if (fread(s->io_buffer, n * SECTOR_SIZE, 1, s->file) != 1)
+        if (HDIMAGE_Read(s->image, sector_num * SECTOR_SIZE, s->io_buffer, n * SECTOR_SIZE) != (size_t)(n * SECTOR_SIZE))
             goto fail;
 
         if (IDE_debug) fprintf(stderr, "sector read OK\n");
@@ -428,15 +425,10 @@ static void ide_sector_write(struct ide_device *s) {
     if (n > s->req_nb_sectors)
         n = s->req_nb_sectors;
 
-    if (fseeko(s->file, sector_num * SECTOR_SIZE, SEEK_SET) < 0) {
-        fprintf(stderr, "FSEEKO FAILED\n");
-        goto fail;
-    }
-    if (fwrite(s->io_buffer, n * SECTOR_SIZE, 1, s->file) != 1) {
-        fprintf(stderr, "FWRITE FAILED\n");
+    if (!HDIMAGE_Write(s->image, sector_num * SECTOR_SIZE, s->io_buffer, n * SECTOR_SIZE)) {
+        fprintf(stderr, "WRITE FAILED\n");
         goto fail;
     }
-    fflush(s->file);
 
     s->nsector -= n;
     if (s->nsector == 0) {
@@ -608,7 +600,8 @@ static void ide_command(struct ide_device *s, uint8_t val) {
 
     case WIN_FLUSH_CACHE:
     case WIN_FLUSH_CACHE_EXT:
-        fflush(s->file);
+        if (!HDIMAGE_Flush(s->image))
+            goto abort_cmd;
         break;
 
     case WIN_STANDBY:
@@ -904,7 +897,7 @@ int IDE_Initialise(int *argc, char *argv[]) {
 void IDE_Exit(void)
 {
 	if (IDE_enabled) {
-		fclose(device.file);
+		HDIMAGE_Close(device.image);
 		IDE_enabled = FALSE;
 	}
 }
@@ -8,6 +8,8 @@
 #  include <unistd.h>
 #endif
 
+#include "hdimage.h"
+
 struct ide_device;
 
 typedef void EndTransferFunc(struct ide_device *);
@@ -18,7 +20,7 @@ struct ide_device {
 
     int is_cdrom, is_cf;
 
-    FILE *file;
+    HDIMAGE_t *image;
     off_t filesize;
     int blocksize;
 
@@ -29,20 +29,27 @@
 #include "atari.h"
 #include "cassette.h"
 #include "img_tape.h"
+#include "img_tape_wav.h"
 #include "memory.h"
 #include "sio.h"
 #include "util.h"
 
-enum { MAX_BLOCKS = 2048 };
-
 /* Standard record length, needed by ReadRecord() when reading raw files */
 enum { DEFAULT_BUFFER_SIZE = 132 };
 
 /* Baudrate for all written blocks and for reading from raw files. */
 enum { DEFAULT_BAUDRATE = 600 };
 
+/* Index entry of a data or FSK block. */
+typedef struct {
+	ULONG offset; /* File offset of the block's chunk */
+	int baudrate; /* Baudrate of the block */
+	ULONG time; /* Time from the start of the tape to the start of the block's IRG, in ms */
+} block_t;
+
 struct IMG_TAPE_t {
 	FILE *file; /* Stream for reading/writing of the tape image */
+	IMG_TAPE_WAV_t *wav; /* Decoder of a WAV recording, or NULL */
 	int isCAS; /* Indicates if the file is in CAS format, or a raw binary file */
 	UBYTE *buffer; /* Holds bytes of the last read or currently written data block */
 	size_t buffer_size; /* Size of the space allocated for BUFFER */
@@ -53,8 +60,8 @@ struct IMG_TAPE_t {
 	int block_is_fsk; /* FALSE - current chunk's type  is "data", otherwise "fsk " */
 	int block_length; /* Length of the block currently held in BUFFER */
 	int num_blocks; /* Number of data blocks in the whole file */
-	ULONG block_offsets[MAX_BLOCKS]; /* File offsets for each data block*/
-	int block_baudrates[MAX_BLOCKS]; /* Baudrates for each data block in the file */
+	block_t *blocks; /* Index of all blocks, followed by an entry for the end of the tape */
+	int blocks_allocated; /* Number of entries allocated for BLOCKS */
 	char description[CASSETTE_DESCRIPTION_MAX]; /* Tape description, only for CAS files */
 	int was_writing; /* Indicated if the last operation on the file was writing */
 };
@@ -92,8 +99,28 @@ end of the chunk.
 int IMG_TAPE_FileSupported(UBYTE const start_bytes[4])
 {
 	/* Note: doesn't detect raw binary files. */
-	return start_bytes[0] == 'F' && start_bytes[1] == 'U'
-	    && start_bytes[2] == 'J' && start_bytes[3] == 'I';
+	return (start_bytes[0] == 'F' && start_bytes[1] == 'U'
+	        && start_bytes[2] == 'J' && start_bytes[3] == 'I')
+	    || (start_bytes[0] == 'R' && start_bytes[1] == 'I'
+	        && start_bytes[2] == 'F' && start_bytes[3] == 'F');
+}
+
+/* Enlarge file->blocks to hold (at least) COUNT entries if needed. */
+static void EnlargeIndex(IMG_TAPE_t *file, int count)
+{
+	if (file->blocks_allocated < count) {
+		/* Enlarge the index at least 2 times. */
+		file->blocks_allocated *= 2;
+		if (file->blocks_allocated < count)
+			file->blocks_allocated = count;
+		file->blocks = (block_t *)Util_realloc(file->blocks, file->blocks_allocated * sizeof(block_t));
+	}
+}
+
+/* Returns duration of LENGTH bytes sent at BAUDRATE, in ms. */
+static ULONG BytesDuration(int length, int baudrate)
+{
+	return baudrate > 0 ? (ULONG)length * 10000 / baudrate : 0;
 }
 
 /* Write contents of the file's block buffer to file, as a separate record;
@@ -109,7 +136,7 @@ static int WriteRecord(IMG_TAPE_t *file)
 	if (!file->isCAS)
 		return FALSE;
 	/* always append */
-	if (fseek(file->file, file->block_offsets[file->num_blocks], SEEK_SET) != 0)
+	if (fseek(file->file, file->blocks[file->num_blocks].offset, SEEK_SET) != 0)
 		return FALSE;
 	/* write record header */
 	memcpy(header.identifier, "data", 4);
@@ -120,9 +147,13 @@ static int WriteRecord(IMG_TAPE_t *file)
 	if (fwrite(&header, 1, 8, file->file) != 8)
 		return FALSE;
 	/* Saving is supported only with standard baudrate. */
-	file->block_baudrates[file->num_blocks] = DEFAULT_BAUDRATE;
+	EnlargeIndex(file, file->num_blocks + 2);
+	file->blocks[file->num_blocks].baudrate = DEFAULT_BAUDRATE;
 	file->num_blocks++;
-	file->block_offsets[file->num_blocks] = file->block_offsets[file->num_blocks - 1] + file->block_length + 8;
+	file->blocks[file->num_blocks].offset = file->blocks[file->num_blocks - 1].offset + file->block_length + 8;
+	file->blocks[file->num_blocks].baudrate = DEFAULT_BAUDRATE;
+	file->blocks[file->num_blocks].time = file->blocks[file->num_blocks - 1].time + file->save_gap
+	                                      + BytesDuration(file->block_length, DEFAULT_BAUDRATE);
 	file->current_block = file->num_blocks;
 	/* write record */
 	result = fwrite(file->buffer, 1, file->block_length, file->file) == file->block_length;
@@ -158,6 +189,9 @@ IMG_TAPE_t *IMG_TAPE_Open(char const *filename, int *writable, char const **desc
 		return NULL;
 	}
 	img->description[0] = '\0';
+	img->blocks = NULL;
+	img->blocks_allocated = 0;
+	img->wav = NULL;
 
 	if (fread(&header, 1, 6, img->file) == 6
 		&& header.identifier[0] == 'F'
@@ -169,6 +203,8 @@ IMG_TAPE_t *IMG_TAPE_Open(char const *filename, int *writable, char const **desc
 		UWORD skip;
 		int blocks;
 		int baudrate = DEFAULT_BAUDRATE;
+		ULONG time = 0;
+		ULONG end_offset;
 
 		img->isCAS = TRUE;
 		fseek(img->file, 2L, SEEK_CUR);	/* ignore the aux bytes */
@@ -187,48 +223,91 @@ IMG_TAPE_t *IMG_TAPE_Open(char const *filename, int *writable, char const **desc
 		img->description[length - skip] = '\0';
 		fseek(img->file, skip, SEEK_CUR);
 
-		/* count number of blocks */
+		/* Index the blocks. New records are appended after the last
+		   block, or after the last baud chunk following it. */
 		blocks = 0;
-		img->block_baudrates[0] = DEFAULT_BAUDRATE;
-		img->block_offsets[0] = ftell(img->file);
+		end_offset = ftell(img->file);
 		for (;;) {
+			ULONG offset = ftell(img->file);
+			int is_baud;
+			int is_data;
+			int is_fsk;
 			/* chunk header is always 8 bytes */
 			if (fread(&header, 1, 8, img->file) != 8)
 				break;
 			length = header.length_lo + (header.length_hi << 8);
-			if (header.identifier[0] == 'b' &&
-			    header.identifier[1] == 'a' &&
-			    header.identifier[2] == 'u' &&
-			    header.identifier[3] == 'd') {
-				baudrate=header.aux_lo + (header.aux_hi << 8);
-				img->block_offsets[blocks] += length + 8;
-			}
-			else if ((header.identifier[0] == 'd' &&
+			is_data = header.identifier[0] == 'd' &&
 			          header.identifier[1] == 'a' &&
 			          header.identifier[2] == 't' &&
-			          header.identifier[3] == 'a') ||
-			         (header.identifier[0] == 'f' &&
-			          header.identifier[1] == 's' &&
-			          header.identifier[2] == 'k' &&
-			          header.identifier[3] == ' ')) {
-				img->block_baudrates[blocks] = baudrate;
-				if (++blocks >= MAX_BLOCKS) {
-					--blocks;
-					break;
+			          header.identifier[3] == 'a';
+			is_fsk = header.identifier[0] == 'f' &&
+			         header.identifier[1] == 's' &&
+			         header.identifier[2] == 'k' &&
+			         header.identifier[3] == ' ';
+			is_baud = header.identifier[0] == 'b' &&
+			          header.identifier[1] == 'a' &&
+			          header.identifier[2] == 'u' &&
+			          header.identifier[3] == 'd';
+			if (is_baud)
+				baudrate=header.aux_lo + (header.aux_hi << 8);
+			else if (is_data || is_fsk) {
+				EnlargeIndex(img, blocks + 2);
+				img->blocks[blocks].offset = offset;
+				img->blocks[blocks].baudrate = baudrate;
+				img->blocks[blocks].time = time;
+				blocks++;
+				/* IRG */
+				time += header.aux_lo + (header.aux_hi << 8);
+				if (is_fsk) {
+					/* Add up the signal lengths, given in 1/10 ms. */
+					ULONG tenths = 0;
+					for (; length >= 2; length -= 2) {
+						int lo = fgetc(img->file);
+						int hi = fgetc(img->file);
+						if (hi == EOF)
+							break;
+						tenths += lo | (hi << 8);
+					}
+					time += tenths / 10;
 				}
-				img->block_offsets[blocks] = img->block_offsets[blocks - 1] + length + 8;
+				else
+					time += BytesDuration(length, baudrate);
 			}
 			/* skip possibly present data block */
 			fseek(img->file, length, SEEK_CUR);
+			if (is_baud || is_data || is_fsk)
+				end_offset = ftell(img->file);
 		}
 		img->num_blocks = blocks;
+		EnlargeIndex(img, blocks + 1);
+		img->blocks[blocks].offset = end_offset;
+		img->blocks[blocks].baudrate = baudrate;
+		img->blocks[blocks].time = time;
 		*description = img->description;
 	}
+	else if (fseek(img->file, 0, SEEK_SET) == 0
+	         && (img->wav = IMG_TAPE_WAV_Open(img->file)) != NULL) {
+		/* WAV recording, decoded on the fly. Its blocks are seconds. */
+		img->isCAS = FALSE;
+		img->num_blocks = (IMG_TAPE_WAV_GetLength(img->wav) + 999) / 1000;
+		*writable = FALSE; /* Writing WAV files is not supported */
+		*description = NULL;
+	}
 	else {
 		/* raw file */
 		int file_length = Util_flen(img->file);
+		int i;
+		ULONG time = 0;
 		img->num_blocks = ((file_length + 127) >> 7) + 1;
 		img->isCAS = FALSE;
+		/* Records are played as in ReadNextRecord(). */
+		EnlargeIndex(img, img->num_blocks + 1);
+		for (i = 0; i <= img->num_blocks; i++) {
+			img->blocks[i].offset = i * 128;
+			img->blocks[i].baudrate = DEFAULT_BAUDRATE;
+			img->blocks[i].time = time;
+			time += (i == 0 ? 19200 : 260) + BytesDuration(132, DEFAULT_BAUDRATE);
+		}
 		*writable = FALSE; /* Writing raw files is not supported */
 		*description = NULL;
 	}
@@ -248,8 +327,13 @@ void IMG_TAPE_Close(IMG_TAPE_t *file)
 {
 	if (file->was_writing)
 		CassetteFlush(file);
-	fclose(file->file);
+	if (file->wav != NULL)
+		/* Closes the file too. */
+		IMG_TAPE_WAV_Close(file->wav);
+	else
+		fclose(file->file);
 	free(file->buffer);
+	free(file->blocks);
 	free(file);
 }
 
@@ -299,7 +383,13 @@ IMG_TAPE_t *IMG_TAPE_Create(char const *filename, char const *description)
 	img->block_length = 0;
 	img->current_block = 0;
 	img->num_blocks = 0;
-	img->block_offsets[0] = strlen(description) + 16;
+	img->blocks = NULL;
+	img->blocks_allocated = 0;
+	img->wav = NULL;
+	EnlargeIndex(img, 1);
+	img->blocks[0].offset = strlen(description) + 16;
+	img->blocks[0].baudrate = DEFAULT_BAUDRATE;
+	img->blocks[0].time = 0;
 	img->buffer = (UBYTE *)Util_malloc((img->buffer_size = DEFAULT_BUFFER_SIZE) * sizeof(UBYTE));
 	img->was_writing = TRUE;
 
@@ -337,7 +427,7 @@ static int ReadNextRecord(IMG_TAPE_t *file, int *gap)
 	if (file->isCAS) {
 		CAS_Header header;
 
-		if (fseek(file->file, file->block_offsets[file->current_block], SEEK_SET) != 0
+		if (fseek(file->file, file->blocks[file->current_block].offset, SEEK_SET) != 0
 		    || fread(&header, 1, 8, file->file) < 8)
 			return FALSE;
 
@@ -391,6 +481,8 @@ int IMG_TAPE_Read(IMG_TAPE_t *file, unsigned int *duration, int *is_gap, UBYTE *
 		CassetteFlush(file);
 		file->was_writing = FALSE;
 	}
+	if (file->wav != NULL)
+		return IMG_TAPE_WAV_Read(file->wav, duration, is_gap, byte);
 	if (file->next_blockbyte >= file->block_length) {
 		/* Buffer is exhausted, load next record. */
 		int gap;
@@ -418,7 +510,7 @@ int IMG_TAPE_Read(IMG_TAPE_t *file, unsigned int *duration, int *is_gap, UBYTE *
 		*byte = file->buffer[file->next_blockbyte++];
 		*is_gap = FALSE;
 		/* Next event will be after 10 bits of data gets loaded. */
-		*duration = 10 * 1789790 / (file->isCAS ? file->block_baudrates[file->current_block] : 600);
+		*duration = 10 * 1789790 / file->blocks[file->current_block].baudrate;
 	}
 	return TRUE;
 }
@@ -473,6 +565,10 @@ int IMG_TAPE_Flush(IMG_TAPE_t *file)
 /* Returns position in blocks/samples, counted from 0. */
 unsigned int IMG_TAPE_GetPosition(IMG_TAPE_t *file)
 {
+	if (file->wav != NULL) {
+		unsigned int position = IMG_TAPE_WAV_GetTime(file->wav) / 1000;
+		return position < file->num_blocks ? position : file->num_blocks;
+	}
 	return file->current_block;
 }
 /* Returns size in blocks/samples. */
@@ -481,6 +577,36 @@ unsigned int IMG_TAPE_GetSize(IMG_TAPE_t *file)
 	return file->num_blocks;
 }
 
+ULONG IMG_TAPE_GetBlockTime(IMG_TAPE_t *file, unsigned int position)
+{
+	if (position > file->num_blocks)
+		position = file->num_blocks;
+	if (file->wav != NULL) {
+		ULONG length = IMG_TAPE_WAV_GetLength(file->wav);
+		return (ULONG)position * 1000 < length ? (ULONG)position * 1000 : length;
+	}
+	return file->blocks[position].time;
+}
+
+unsigned int IMG_TAPE_FindBlock(IMG_TAPE_t *file, ULONG time)
+{
+	unsigned int low = 0;
+	unsigned int high = file->num_blocks;
+	if (file->wav != NULL)
+		return time / 1000 < high ? time / 1000 : high;
+	if (time >= file->blocks[high].time)
+		return high;
+	/* Find the last block that starts at or before TIME. */
+	while (high - low > 1) {
+		unsigned int mid = (low + high) / 2;
+		if (file->blocks[mid].time <= time)
+			low = mid;
+		else
+			high = mid;
+	}
+	return low;
+}
+
 void IMG_TAPE_Seek(IMG_TAPE_t *file, unsigned int position)
 {
 	if (file->was_writing) {
@@ -494,10 +620,14 @@ void IMG_TAPE_Seek(IMG_TAPE_t *file, unsigned int position)
 	file->save_gap = 0;
 	file->next_blockbyte = 0;
 	file->block_length = 0;
+	if (file->wav != NULL)
+		IMG_TAPE_WAV_Seek(file->wav, (ULONG)file->current_block * 1000);
 }
 
 int IMG_TAPE_SerinStatus(IMG_TAPE_t *file, int event_time_left)
 {
+	if (file->wav != NULL)
+		return IMG_TAPE_WAV_SerinStatus(file->wav, event_time_left);
 	if (file->was_writing || file->next_blockbyte == 0)
 		return 1;
 	if (file->block_is_fsk) {
@@ -510,8 +640,8 @@ int IMG_TAPE_SerinStatus(IMG_TAPE_t *file, int event_time_left)
 
 		/* exam rate; if time_to_irq < duration of one byte */
 		if (event_time_left <
-			10 * 1789790 / (file->isCAS ? file->block_baudrates[file->current_block] : 600) - 1) {
-			bit = event_time_left / (1789790 / (file->isCAS ? file->block_baudrates[file->current_block] : 600));
+			10 * 1789790 / file->blocks[file->current_block].baudrate - 1) {
+			bit = event_time_left / (1789790 / file->blocks[file->current_block].baudrate);
 		}
 		else {
 			bit = 0;
@@ -537,6 +667,18 @@ int IMG_TAPE_SkipToData(IMG_TAPE_t *file, int ms)
 		file->was_writing = FALSE;
 	}
 
+	if (file->wav != NULL) {
+		ULONG end = IMG_TAPE_WAV_GetTime(file->wav) + ms;
+		while (IMG_TAPE_WAV_GetTime(file->wav) < end) {
+			unsigned int duration;
+			int is_gap;
+			UBYTE byte;
+			if (!IMG_TAPE_WAV_Read(file->wav, &duration, &is_gap, &byte))
+				return FALSE;
+		}
+		return TRUE;
+	}
+
 	while (ms > 0) {
 		if (file->next_blockbyte < file->block_length) {
 			if (file->block_is_fsk) {
@@ -544,11 +686,11 @@ int IMG_TAPE_SkipToData(IMG_TAPE_t *file, int ms)
 				   and skipped as a whole. */
 				file->next_blockbyte = file->block_length;
 			} else {
-				int bytes = ms * (file->isCAS ? file->block_baudrates[file->current_block] : 600) / 1000 / 10;
+				int bytes = ms * file->blocks[file->current_block].baudrate / 1000 / 10;
 				if (bytes > file->block_length - file->next_blockbyte)
 					bytes = file->block_length - file->next_blockbyte;
 				file->next_blockbyte += bytes;
-				ms -= bytes * 10 * 1000 / (file->isCAS ? file->block_baudrates[file->current_block] : 600);
+				ms -= bytes * 10 * 1000 / file->blocks[file->current_block].baudrate;
 			}
 			continue;
 		}
@@ -563,6 +705,39 @@ int IMG_TAPE_SkipToData(IMG_TAPE_t *file, int ms)
 	return TRUE;
 }
 
+/* IMG_TAPE_ReadToMemory() for WAV recordings: reads a record, ended by
+   a gap, into the block buffer and copies it to memory. */
+static int ReadWAVToMemory(IMG_TAPE_t *file, UWORD dest_addr, int length)
+{
+	int read_length = 0;
+	for (;;) {
+		unsigned int duration;
+		int is_gap;
+		UBYTE byte;
+		if (!IMG_TAPE_WAV_Read(file->wav, &duration, &is_gap, &byte)) {
+			if (read_length == 0)
+				return -1;
+			break;
+		}
+		if (is_gap) {
+			/* Gaps longer than a byte separate records. */
+			if (read_length > 0 && duration > 10 * 1789790 / DEFAULT_BAUDRATE)
+				break;
+			continue;
+		}
+		if (read_length <= length) {
+			EnlargeBuffer(file, read_length + 1);
+			file->buffer[read_length] = byte;
+		}
+		read_length++;
+		if (read_length > length)
+			break;
+	}
+	MEMORY_CopyToMem(file->buffer, dest_addr, read_length >= length ? length : read_length);
+	return read_length >= length + 1 &&
+	       file->buffer[length] == SIO_ChkSum(file->buffer, length);
+}
+
 int IMG_TAPE_ReadToMemory(IMG_TAPE_t *file, UWORD dest_addr, int length)
 {
 	int read_length;
@@ -571,6 +746,9 @@ int IMG_TAPE_ReadToMemory(IMG_TAPE_t *file, UWORD dest_addr, int length)
 		file->was_writing = FALSE;
 	}
 
+	if (file->wav != NULL)
+		return ReadWAVToMemory(file, dest_addr, length);
+
 	read_length = file->block_length - file->next_blockbyte;
 
 	if (read_length == 0) {
@@ -71,6 +71,13 @@ int IMG_TAPE_Flush(IMG_TAPE_t *file);
 unsigned int IMG_TAPE_GetPosition(IMG_TAPE_t *file);
 /* Returns the file's size (blocks). */
 unsigned int IMG_TAPE_GetSize(IMG_TAPE_t *file);
+/* Returns time from the start of the tape to the start of block POSITION
+   (counted from 0, including the block's IRG), in milliseconds. For
+   POSITION equal to the file's size, returns the length of the whole tape. */
+ULONG IMG_TAPE_GetBlockTime(IMG_TAPE_t *file, unsigned int position);
+/* Returns the block (counted from 0) that is played TIME milliseconds after
+   the start of the tape, or the file's size if TIME is past its end. */
+unsigned int IMG_TAPE_FindBlock(IMG_TAPE_t *file, ULONG time);
 /* Positions the file at the start of a block given in POSITION (counted from
    0). */
 void IMG_TAPE_Seek(IMG_TAPE_t *file, unsigned int position);
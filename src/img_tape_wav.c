@@ -0,0 +1,592 @@
+/*
+ * img_tape_wav.c - decoding of tape recordings stored as WAV files
+ *
+ * Copyright (C) 2026 Atari800 development team (see DOC/CREDITS)
+ *
+ * This file is part of the Atari800 emulator project which emulates
+ * the Atari 400, 800, 800XL, 130XE, and 5200 8-bit computers.
+ *
+ * Atari800 is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Atari800 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Atari800; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/* The data track of an Atari tape is an FSK signal: 5327 Hz for MARK and
+   3995 Hz for SPACE. Both tones are detected by correlating the signal with
+   them over a sliding window (a sliding Goertzel filter), and the stronger
+   one gives the level of the serial line. Bytes are then decoded from the
+   line like by a UART, with the length of a bit measured on the two 0x55
+   bytes that start each record. */
+
+#include "config.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "img_tape_wav.h"
+#include "util.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define MARK_FREQ 5327.0
+#define SPACE_FREQ 3995.0
+#define CPU_FREQ 1789790.0
+/* Frames read from the file at once. */
+#define CHUNK_FRAMES 4096
+/* Frames mixed with one turn of the tone tables; divides CHUNK_FRAMES. */
+#define TONE_FRAMES 64
+/* Runs of the line level queued for look-ahead; a power of 2. */
+#define RUN_QUEUE_SIZE 64
+/* Bits measured at the start of each record: two 0x55 bytes without the
+   last stop bit. */
+#define SYNC_BITS 19
+/* Longest gap event, in ms. Also the longest MARK run. */
+#define MAX_GAP_MS 100
+
+enum { FORMAT_PCM = 1, FORMAT_FLOAT = 3, FORMAT_EXTENSIBLE = 0xfffe };
+
+/* A period of constant line level. */
+typedef struct {
+	ULONG start; /* in frames */
+	ULONG length; /* in frames */
+	int level; /* 1 - MARK, 0 - SPACE */
+} run_t;
+
+struct IMG_TAPE_WAV_t {
+	FILE *file;
+	ULONG data_offset; /* Offset of the samples in FILE */
+	ULONG num_frames; /* Length of the recording */
+	int rate;
+	int channels;
+	int block_align; /* Size of a frame, in bytes */
+	int bits;
+	int is_float;
+	int channel; /* Decoded channel */
+
+	/* Current chunk of samples. */
+	UBYTE *raw;
+	float *osc[4]; /* Samples mixed with cos/sin of MARK_FREQ and SPACE_FREQ */
+	/* cos/sin of MARK_FREQ and SPACE_FREQ over TONE_FRAMES, from phase 0 */
+	float tone_c[2][TONE_FRAMES];
+	float tone_s[2][TONE_FRAMES];
+	int chunk_length;
+	int chunk_pos;
+	ULONG read_pos; /* Frame at the start of the next chunk */
+
+	/* Correlators. */
+	int window; /* Length of the sliding window, in frames */
+	float *history; /* Last WINDOW mixed samples of each correlator */
+	int history_pos;
+	double sums[4];
+	double peak; /* Decaying peak of the tone power */
+	double peak_decay;
+	double floor; /* Power of the quietest detected tone */
+
+	/* Run-length coding of the line level. */
+	int level;
+	ULONG run_start;
+	ULONG max_run;
+	run_t runs[RUN_QUEUE_SIZE];
+	int run_head;
+	int run_count;
+	int eof;
+
+	/* UART. */
+	double bit_frames; /* Length of a bit, in frames */
+	double event_end; /* End of the last returned event, in frames */
+	double cursor; /* Start bits are searched from here */
+	int pending; /* Indicates that PENDING_BYTE has been decoded, but not returned yet */
+	double pending_start;
+	UBYTE pending_byte;
+	double ticks_per_frame;
+
+	/* Last returned event, for IMG_TAPE_WAV_SerinStatus(). */
+	int last_is_gap;
+	UBYTE last_byte;
+	int last_bit_ticks;
+};
+
+static ULONG GetLE(const UBYTE *p, int bytes)
+{
+	ULONG value = 0;
+	while (--bytes >= 0)
+		value = (value << 8) | p[bytes];
+	return value;
+}
+
+IMG_TAPE_WAV_t *IMG_TAPE_WAV_Open(FILE *file)
+{
+	IMG_TAPE_WAV_t *wav;
+	UBYTE header[40];
+	ULONG file_length;
+	ULONG offset;
+	ULONG data_length;
+	int format = 0;
+	int channels = 0;
+	int rate = 0;
+	int block_align = 0;
+	int bits = 0;
+	int i;
+	int k;
+
+	if (fread(header, 1, 12, file) != 12
+	    || memcmp(header, "RIFF", 4) != 0 || memcmp(header + 8, "WAVE", 4) != 0)
+		return NULL;
+	file_length = Util_flen(file);
+
+	/* Find the format and the samples. */
+	offset = 12;
+	for (;;) {
+		ULONG length;
+		ULONG next;
+		if (fseek(file, offset, SEEK_SET) != 0 || fread(header, 1, 8, file) != 8)
+			return NULL;
+		length = GetLE(header + 4, 4);
+		if (memcmp(header, "data", 4) == 0) {
+			offset += 8;
+			/* Streamed recordings may have an unset length. */
+			if (length > file_length - offset)
+				length = file_length - offset;
+			data_length = length;
+			break;
+		}
+		/* A corrupt length would make the next offset wrap around. */
+		if (length > file_length - offset - 8)
+			return NULL;
+		next = offset + 8 + length + (length & 1);
+		if (next <= offset)
+			return NULL;
+		if (memcmp(header, "fmt ", 4) == 0) {
+			if (length < 16 || fread(header, 1, length < 40 ? length : 40, file) < 16)
+				return NULL;
+			format = GetLE(header, 2);
+			channels = GetLE(header + 2, 2);
+			rate = GetLE(header + 4, 4);
+			block_align = GetLE(header + 12, 2);
+			bits = GetLE(header + 14, 2);
+			/* The sub-format GUID starts with the format tag. */
+			if (format == FORMAT_EXTENSIBLE && length >= 26)
+				format = GetLE(header + 24, 2);
+		}
+		offset = next;
+	}
+	if (!((format == FORMAT_PCM && (bits == 8 || bits == 16 || bits == 24 || bits == 32))
+	      || (format == FORMAT_FLOAT && bits == 32))
+	    || channels < 1 || block_align < channels * bits / 8
+	    /* The tones must be below the Nyquist frequency. */
+	    || rate < 11025)
+		return NULL;
+
+	wav = (IMG_TAPE_WAV_t *)Util_malloc(sizeof(IMG_TAPE_WAV_t));
+	wav->file = file;
+	wav->data_offset = offset;
+	wav->num_frames = data_length / block_align;
+	wav->rate = rate;
+	wav->channels = channels;
+	wav->block_align = block_align;
+	wav->bits = bits;
+	wav->is_float = format == FORMAT_FLOAT;
+	/* In stereo recordings of Atari tapes, the data track is on the right. */
+	wav->channel = channels >= 2 ? 1 : 0;
+
+	wav->raw = (UBYTE *)Util_malloc(CHUNK_FRAMES * block_align);
+	for (k = 0; k < 4; k++)
+		wav->osc[k] = (float *)Util_malloc(CHUNK_FRAMES * sizeof(float));
+	for (k = 0; k < 2; k++) {
+		double step = 2.0 * M_PI * (k == 0 ? MARK_FREQ : SPACE_FREQ) / rate;
+		for (i = 0; i < TONE_FRAMES; i++) {
+			wav->tone_c[k][i] = (float)cos(step * i);
+			wav->tone_s[k][i] = (float)sin(step * i);
+		}
+	}
+	/* A window of 1 ms separates the tones and is shorter than a bit. */
+	wav->window = rate / 1000;
+	wav->history = (float *)Util_malloc(wav->window * 4 * sizeof(float));
+	/* The peak halves in a second. */
+	wav->peak_decay = pow(0.5, 1.0 / rate);
+	wav->max_run = (ULONG)rate * MAX_GAP_MS / 1000;
+	wav->bit_frames = rate / 600.0;
+	wav->ticks_per_frame = CPU_FREQ / rate;
+	IMG_TAPE_WAV_Seek(wav, 0);
+	return wav;
+}
+
+void IMG_TAPE_WAV_Close(IMG_TAPE_WAV_t *wav)
+{
+	int k;
+	fclose(wav->file);
+	free(wav->raw);
+	for (k = 0; k < 4; k++)
+		free(wav->osc[k]);
+	free(wav->history);
+	free(wav);
+}
+
+ULONG IMG_TAPE_WAV_GetLength(IMG_TAPE_WAV_t *wav)
+{
+	return (ULONG)((double)wav->num_frames * 1000 / wav->rate);
+}
+
+ULONG IMG_TAPE_WAV_GetTime(IMG_TAPE_WAV_t *wav)
+{
+	return (ULONG)(wav->event_end * 1000 / wav->rate);
+}
+
+void IMG_TAPE_WAV_Seek(IMG_TAPE_WAV_t *wav, ULONG time)
+{
+	ULONG pos = (ULONG)((double)time * wav->rate / 1000);
+	if (pos > wav->num_frames)
+		pos = wav->num_frames;
+	wav->read_pos = pos;
+	wav->chunk_length = 0;
+	wav->chunk_pos = 0;
+	memset(wav->history, 0, wav->window * 4 * sizeof(float));
+	wav->history_pos = 0;
+	memset(wav->sums, 0, sizeof(wav->sums));
+	wav->peak = 0.0;
+	wav->level = 1;
+	wav->run_start = pos;
+	wav->run_head = 0;
+	wav->run_count = 0;
+	wav->eof = FALSE;
+	wav->event_end = pos;
+	wav->cursor = pos;
+	wav->pending = FALSE;
+	wav->last_is_gap = TRUE;
+}
+
+/* Reads the next chunk of samples and mixes it with both tones.
+   Returns FALSE at the end of the recording. */
+static int ReadChunk(IMG_TAPE_WAV_t *wav)
+{
+	int n = CHUNK_FRAMES;
+	int bytes = wav->bits / 8;
+	UBYTE const *p;
+	float *x = wav->osc[0];
+	int i;
+	int j;
+	int k;
+
+	if (wav->read_pos >= wav->num_frames)
+		return FALSE;
+	if (n > wav->num_frames - wav->read_pos)
+		n = wav->num_frames - wav->read_pos;
+	if (fseek(wav->file, wav->data_offset + wav->read_pos * wav->block_align, SEEK_SET) != 0)
+		return FALSE;
+	n = fread(wav->raw, wav->block_align, n, wav->file);
+	if (n <= 0)
+		return FALSE;
+
+	/* Convert the decoded channel to floats. */
+	p = wav->raw + wav->channel * bytes;
+	for (i = 0; i < n; i++, p += wav->block_align) {
+		if (wav->is_float) {
+			union { ULONG u; float f; } v;
+			v.u = GetLE(p, 4);
+			x[i] = v.f;
+		}
+		else if (bytes == 1)
+			x[i] = (p[0] - 0x80) / 128.0f;
+		else
+			/* Take the 16 most significant bits. */
+			x[i] = (SWORD)GetLE(p + bytes - 2, 2) / 32768.0f;
+	}
+	/* Clear the rest of the last run of TONE_FRAMES frames. */
+	for (i = n; i % TONE_FRAMES != 0; i++)
+		x[i] = 0.0f;
+	for (k = 1; k < 4; k++)
+		memcpy(wav->osc[k], x, i * sizeof(float));
+
+	/* Mix with the tones. The oscillators run from the absolute position,
+	   so they are continuous between chunks and after seeking. Each run of
+	   TONE_FRAMES frames gets the tone tables rotated to its phase, so the
+	   loops have no dependencies between frames and are vectorised. */
+	for (k = 0; k < 2; k++) {
+		double step = 2.0 * M_PI * (k == 0 ? MARK_FREQ : SPACE_FREQ) / wav->rate;
+		float const *tone_c = wav->tone_c[k];
+		float const *tone_s = wav->tone_s[k];
+		for (i = 0; i < n; i += TONE_FRAMES) {
+			double phase = fmod(step * ((double)wav->read_pos + i), 2.0 * M_PI);
+			float const c = (float)cos(phase);
+			float const s = (float)sin(phase);
+			float *out_c = wav->osc[2 * k] + i;
+			float *out_s = wav->osc[2 * k + 1] + i;
+			float rot_c[TONE_FRAMES];
+			float rot_s[TONE_FRAMES];
+			for (j = 0; j < TONE_FRAMES; j++) {
+				rot_c[j] = c * tone_c[j] - s * tone_s[j];
+				rot_s[j] = s * tone_c[j] + c * tone_s[j];
+			}
+			for (j = 0; j < TONE_FRAMES; j++)
+				out_c[j] *= rot_c[j];
+			for (j = 0; j < TONE_FRAMES; j++)
+				out_s[j] *= rot_s[j];
+		}
+	}
+	wav->chunk_length = n;
+	wav->chunk_pos = 0;
+	wav->read_pos += n;
+	return TRUE;
+}
+
+/* Appends a run to the queue. */
+static void PushRun(IMG_TAPE_WAV_t *wav, ULONG end)
+{
+	run_t *run = &wav->runs[(wav->run_head + wav->run_count) & (RUN_QUEUE_SIZE - 1)];
+	run->start = wav->run_start;
+	run->length = end - wav->run_start;
+	run->level = wav->level;
+	wav->run_count++;
+	wav->run_start = end;
+}
+
+/* Makes sure that at least COUNT runs are queued.
+   Returns FALSE if the recording ends before. */
+static int FillRuns(IMG_TAPE_WAV_t *wav, int count)
+{
+	while (wav->run_count < count) {
+		float const *mark_c, *mark_s, *space_c, *space_s;
+		ULONG frame;
+		int i;
+
+		if (wav->eof)
+			return FALSE;
+		if (wav->chunk_pos >= wav->chunk_length && !ReadChunk(wav)) {
+			/* Close the last run. */
+			wav->eof = TRUE;
+			if (wav->run_start < wav->read_pos)
+				PushRun(wav, wav->read_pos);
+			continue;
+		}
+		mark_c = wav->osc[0];
+		mark_s = wav->osc[1];
+		space_c = wav->osc[2];
+		space_s = wav->osc[3];
+		frame = wav->read_pos - wav->chunk_length;
+		for (i = wav->chunk_pos; i < wav->chunk_length && wav->run_count < count; i++) {
+			float *h = wav->history + 4 * wav->history_pos;
+			double mark;
+			double space;
+			double power;
+			int level;
+
+			/* Slide the windows. */
+			wav->sums[0] += mark_c[i] - h[0];
+			wav->sums[1] += mark_s[i] - h[1];
+			wav->sums[2] += space_c[i] - h[2];
+			wav->sums[3] += space_s[i] - h[3];
+			h[0] = mark_c[i];
+			h[1] = mark_s[i];
+			h[2] = space_c[i];
+			h[3] = space_s[i];
+			if (++wav->history_pos >= wav->window)
+				wav->history_pos = 0;
+
+			mark = wav->sums[0] * wav->sums[0] + wav->sums[1] * wav->sums[1];
+			space = wav->sums[2] * wav->sums[2] + wav->sums[3] * wav->sums[3];
+			power = mark > space ? mark : space;
+			wav->peak *= wav->peak_decay;
+			if (power > wav->peak)
+				wav->peak = power;
+			/* Without a tone (20 dB below the recent peak, or a level of
+			   about -60 dBFS) the line stays at MARK. */
+			if (mark >= space || power < wav->peak * 0.01
+			    || power < 1e-6 * wav->window * wav->window)
+				level = 1;
+			else
+				level = 0;
+
+			if (level != wav->level || (level == 1 && frame + i - wav->run_start >= wav->max_run)) {
+				if (frame + i > wav->run_start)
+					PushRun(wav, frame + i);
+				wav->level = level;
+			}
+		}
+		wav->chunk_pos = i;
+	}
+	return TRUE;
+}
+
+static run_t *GetRun(IMG_TAPE_WAV_t *wav, int index)
+{
+	return &wav->runs[(wav->run_head + index) & (RUN_QUEUE_SIZE - 1)];
+}
+
+static void PopRun(IMG_TAPE_WAV_t *wav)
+{
+	wav->run_head = (wav->run_head + 1) & (RUN_QUEUE_SIZE - 1);
+	wav->run_count--;
+}
+
+/* Returns the line level in the middle half of the bit starting at frame
+   START, decided by the level that lasts longer. Bits must be given in
+   order. */
+static int BitLevel(IMG_TAPE_WAV_t *wav, double start)
+{
+	double from = start + wav->bit_frames * 0.25;
+	double to = start + wav->bit_frames * 0.75;
+	double mark = 0.0;
+	int i;
+
+	/* Drop the runs that end before the bit. */
+	for (;;) {
+		run_t *run;
+		if (!FillRuns(wav, 1))
+			return 1;
+		run = GetRun(wav, 0);
+		if (run->start + run->length > from)
+			break;
+		PopRun(wav);
+	}
+	for (i = 0;; i++) {
+		run_t *run;
+		double run_from;
+		double run_to;
+		if (i >= RUN_QUEUE_SIZE || !FillRuns(wav, i + 1))
+			break;
+		run = GetRun(wav, i);
+		if (run->start >= to)
+			break;
+		run_from = run->start > from ? run->start : from;
+		run_to = run->start + run->length < to ? run->start + run->length : to;
+		if (run->level)
+			mark += run_to - run_from;
+	}
+	return mark * 2 >= to - from;
+}
+
+/* Updates the length of a bit if the queued runs starting with the start
+   bit look like the two 0x55 bytes at the start of a record. */
+static void MeasureBit(IMG_TAPE_WAV_t *wav)
+{
+	double total = 0.0;
+	double bit;
+	int i;
+
+	if (!FillRuns(wav, SYNC_BITS))
+		return;
+	for (i = 0; i < SYNC_BITS; i++)
+		total += GetRun(wav, i)->length;
+	bit = total / SYNC_BITS;
+	for (i = 0; i < SYNC_BITS; i++) {
+		ULONG length = GetRun(wav, i)->length;
+		if (length < bit * 0.6 || length > bit * 1.4)
+			return;
+	}
+	/* Accept 150..3000 baud. */
+	if (bit < wav->rate / 3000.0 || bit > wav->rate / 150.0)
+		return;
+	wav->bit_frames = bit;
+}
+
+/* Searches for the next byte, ending the search at frame LIMIT.
+   Returns TRUE and sets PENDING_BYTE and PENDING_START if a byte was found,
+   or returns FALSE at LIMIT or at the end of the recording. */
+static int DecodeByte(IMG_TAPE_WAV_t *wav, double limit)
+{
+	for (;;) {
+		run_t *run;
+		double start;
+		int byte = 0;
+		int i;
+
+		if (!FillRuns(wav, 1))
+			return FALSE;
+		run = GetRun(wav, 0);
+		if (run->start >= limit)
+			return FALSE;
+		if (run->level != 0 || run->start < wav->cursor) {
+			PopRun(wav);
+			continue;
+		}
+		/* A start bit. After a pause it may start a record. */
+		start = run->start;
+		if (start - wav->event_end >= 2 * wav->bit_frames)
+			MeasureBit(wav);
+		if (BitLevel(wav, start) != 0) {
+			/* Too short, ignore. */
+			wav->cursor = start + 1;
+			continue;
+		}
+		for (i = 0; i < 8; i++)
+			byte |= BitLevel(wav, start + wav->bit_frames * (i + 1)) << i;
+		/* The stop bit is not checked, POKEY does not reject bytes without it. */
+		wav->cursor = start + wav->bit_frames * 9.5;
+		wav->pending = TRUE;
+		wav->pending_start = start;
+		wav->pending_byte = (UBYTE)byte;
+		return TRUE;
+	}
+}
+
+/* Ends the current event at frame END and returns its duration in CPU ticks. */
+static unsigned int EndEvent(IMG_TAPE_WAV_t *wav, double end)
+{
+	unsigned int ticks = (unsigned int)(floor(end * wav->ticks_per_frame)
+	                                    - floor(wav->event_end * wav->ticks_per_frame));
+	wav->event_end = end;
+	return ticks;
+}
+
+int IMG_TAPE_WAV_Read(IMG_TAPE_WAV_t *wav, unsigned int *duration, int *is_gap, UBYTE *byte)
+{
+	if (!wav->pending) {
+		double limit = wav->event_end + wav->max_run;
+		if (!DecodeByte(wav, limit)) {
+			if (!wav->eof || wav->run_count > 0) {
+				*duration = EndEvent(wav, limit);
+				*is_gap = wav->last_is_gap = TRUE;
+				return TRUE;
+			}
+			/* The rest of the recording. */
+			if (wav->event_end >= wav->num_frames)
+				return FALSE;
+			*duration = EndEvent(wav, wav->num_frames);
+			*is_gap = wav->last_is_gap = TRUE;
+			return TRUE;
+		}
+	}
+	if (wav->pending_start >= wav->event_end + 1.0) {
+		/* The gap before the byte. */
+		*duration = EndEvent(wav, wav->pending_start);
+		*is_gap = wav->last_is_gap = TRUE;
+		return TRUE;
+	}
+	/* The byte, started at the earliest at the end of the previous one. */
+	wav->pending = FALSE;
+	*duration = EndEvent(wav, (wav->pending_start > wav->event_end ? wav->pending_start : wav->event_end)
+	                          + wav->bit_frames * 10);
+	*is_gap = wav->last_is_gap = FALSE;
+	*byte = wav->last_byte = wav->pending_byte;
+	wav->last_bit_ticks = (int)(wav->bit_frames * wav->ticks_per_frame);
+	return TRUE;
+}
+
+int IMG_TAPE_WAV_SerinStatus(IMG_TAPE_WAV_t *wav, int event_time_left)
+{
+	int bit = 0; /* 0: stop bit, 1: 7th bit, ..., 8: 0th bit, 9: start bit */
+
+	if (wav->last_is_gap || wav->last_bit_ticks <= 0)
+		return 1;
+	if (event_time_left < 10 * wav->last_bit_ticks - 1)
+		bit = event_time_left / wav->last_bit_ticks;
+	/* if stopbit or out of range, return mark tone */
+	if (bit <= 0 || bit > 9)
+		return 1;
+	/* if start bit, return space tone */
+	if (bit == 9)
+		return 0;
+	return (wav->last_byte >> (8 - bit)) & 1;
+}
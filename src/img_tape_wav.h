@@ -0,0 +1,55 @@
+/*
+ * img_tape_wav.h - decoding of tape recordings stored as WAV files
+ *
+ * Copyright (C) 2026 Atari800 development team (see DOC/CREDITS)
+ *
+ * This file is part of the Atari800 emulator project which emulates
+ * the Atari 400, 800, 800XL, 130XE, and 5200 8-bit computers.
+ *
+ * Atari800 is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Atari800 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Atari800; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#ifndef IMG_TAPE_WAV_H_
+#define IMG_TAPE_WAV_H_
+
+#include <stdio.h>
+
+#include "atari.h"
+
+/* Decoder of tape recordings stored as PCM WAV files. The file is read in
+   chunks, so recordings of any length are decoded in constant memory. */
+typedef struct IMG_TAPE_WAV_t IMG_TAPE_WAV_t;
+
+/* Checks if FILE, positioned at its start, is a WAV file that can be
+   decoded. On success returns a decoder that takes over FILE; otherwise
+   returns NULL and FILE is left open. */
+IMG_TAPE_WAV_t *IMG_TAPE_WAV_Open(FILE *file);
+/* Closes the decoder and its file. */
+void IMG_TAPE_WAV_Close(IMG_TAPE_WAV_t *wav);
+/* Decodes the next tape event, like IMG_TAPE_Read(): stores duration of the
+   event (in CPU ticks) in *DURATION, and either sets *IS_GAP to TRUE, or
+   sets *IS_GAP to FALSE and stores the decoded byte in *BYTE.
+   Returns FALSE at the end of the recording. */
+int IMG_TAPE_WAV_Read(IMG_TAPE_WAV_t *wav, unsigned int *duration, int *is_gap, UBYTE *byte);
+/* Returns the length of the recording, in ms. */
+ULONG IMG_TAPE_WAV_GetLength(IMG_TAPE_WAV_t *wav);
+/* Returns the time of the end of the last decoded event, in ms. */
+ULONG IMG_TAPE_WAV_GetTime(IMG_TAPE_WAV_t *wav);
+/* Positions the recording at TIME ms. */
+void IMG_TAPE_WAV_Seek(IMG_TAPE_WAV_t *wav, ULONG time);
+/* Returns state of the serial input line, EVENT_TIME_LEFT CPU ticks
+   before the end of the last decoded event. */
+int IMG_TAPE_WAV_SerinStatus(IMG_TAPE_WAV_t *wav, int event_time_left);
+
+#endif /* IMG_TAPE_WAV_H_ */
@@ -46,6 +46,7 @@
 #endif
 #ifdef EVENT_RECORDING
 #include <zlib.h>
+#include "statesav.h"
 #endif
 
 #ifdef DREAMCAST
@@ -126,17 +127,390 @@ static int max_scanline_counter;
 static int scanline_counter;
 
 #ifdef EVENT_RECORDING
-static gzFile recordfp = NULL; /*output file for input recording*/
-static gzFile playbackfp = NULL; /*input file for playback*/
+/* Input movie (-record, -playback). All numbers are little-endian.
+
+   The file starts with a header of MOVIE_HEADER_SIZE bytes:
+      0  "A8MV"
+      4  version (MOVIE_VERSION)
+      8  number of frames
+     12  keyframe interval: a keyframe precedes each frame whose number is
+         a multiple of it
+     16  offset of the keyframe index, 0 if the recording wasn't finished
+     20  number of keyframes in the index
+   followed by records, each starting with a tag byte:
+     'F' - input of a frame, MOVIE_FRAME_SIZE bytes: 1 key shift,
+           2 console keys, 3 and 4 PLATFORM_PORT(0) and (1), 5 triggers
+           (bit n for trigger n), 6-7 key code, 8-11 Adler-32 of the visible
+           screen of the previous frame
+     'I' - value of INPUT_RecordInt(), MOVIE_INT_SIZE bytes: 4-7 value
+     'K' - keyframe, MOVIE_KEYFRAME_SIZE bytes followed by a state file:
+           4-7 number of the next frame, 8-11 Atari800_nframes,
+           12-15 POKEY random counter, 16-19 length of the state file
+   The index lists the offsets of the 'K' records. A keyframe is saved at
+   the start of INPUT_Frame() and loaded at the same point, so that playback
+   can start at any frame after emulating at most a keyframe interval.
+   Seeking finds the keyframe by the frame numbers in the 'K' records, so
+   the keyframe interval in the header is only informative. */
+#define MOVIE_VERSION 2 /* 1 was the former gzipped text format */
+#define MOVIE_HEADER_SIZE 24
+#define MOVIE_FRAME_SIZE 12
+#define MOVIE_INT_SIZE 8
+#define MOVIE_KEYFRAME_SIZE 20
+
+static FILE *recordfp = NULL; /*output file for input recording*/
+static FILE *playbackfp = NULL; /*input file for playback*/
 static int recording = FALSE;
 static int playingback = FALSE;
 static int playingback_exit_after = TRUE;
+static int playingback_turbo = FALSE;
 static void update_adler32_of_screen(void);
 static unsigned int compute_adler32_of_screen(void);
-static int recording_version;
-#define GZBUFSIZE 256
-static char gzbuf[GZBUFSIZE+1];
-#define EVENT_RECORDING_VERSION 1
+
+static const char *record_filename = NULL; /* -record, opened after parsing the options */
+static ULONG record_keyframe_interval = 3000;
+static ULONG record_frame; /* number of the frame being recorded */
+static ULONG *record_keyframes = NULL; /* offsets of the keyframes */
+static ULONG record_num_keyframes;
+static UBYTE record_buf[MOVIE_FRAME_SIZE];
+
+static ULONG playback_frame; /* number of the frame being played back */
+static ULONG playback_frames; /* length of the movie */
+static ULONG *playback_keyframes = NULL;
+static ULONG playback_num_keyframes;
+static UBYTE playback_buf[MOVIE_FRAME_SIZE];
+static int playback_check_adler32; /* FALSE if the previous frame wasn't played */
+static unsigned int adler32_errors = 0;
+/* Frame to start playing at, set by INPUT_PlaybackSeek() */
+static ULONG seek_frame;
+static int seek_pending = FALSE;
+static int seeking = FALSE; /* emulating from a keyframe up to seek_frame */
+static int turbo_before_playback;
+
+/* Temporary file for the states of keyframes, as StateSav works on files. */
+static char state_filename[FILENAME_MAX];
+
+static void PutULONG(UBYTE *p, ULONG x)
+{
+	p[0] = (UBYTE) x;
+	p[1] = (UBYTE) (x >> 8);
+	p[2] = (UBYTE) (x >> 16);
+	p[3] = (UBYTE) (x >> 24);
+}
+
+static ULONG GetULONG(const UBYTE *p)
+{
+	return p[0] | (p[1] << 8) | ((ULONG) p[2] << 16) | ((ULONG) p[3] << 24);
+}
+
+static int CreateStateFile(void)
+{
+	FILE *fp;
+	if (state_filename[0] != '\0')
+		return TRUE;
+	fp = Util_uniqopen(state_filename, "wb");
+	if (fp == NULL) {
+		Log_print("Cannot create temporary file for keyframes");
+		state_filename[0] = '\0';
+		return FALSE;
+	}
+	fclose(fp);
+	return TRUE;
+}
+
+/* Copies LENGTH bytes from SRC to DEST. */
+static int CopyBytes(FILE *dest, FILE *src, ULONG length)
+{
+	UBYTE buf[4096];
+	while (length > 0) {
+		size_t n = length < sizeof(buf) ? length : sizeof(buf);
+		if (fread(buf, 1, n, src) != n || fwrite(buf, 1, n, dest) != n)
+			return FALSE;
+		length -= n;
+	}
+	return TRUE;
+}
+
+/* Appends a keyframe of the current state to the recording. */
+static int WriteKeyframe(void)
+{
+	UBYTE buf[MOVIE_KEYFRAME_SIZE];
+	long offset = ftell(recordfp);
+	FILE *fp;
+	ULONG length;
+	int ok;
+
+	if (!CreateStateFile() || !StateSav_SaveAtariState(state_filename, "wb", TRUE))
+		return FALSE;
+	fp = fopen(state_filename, "rb");
+	if (fp == NULL)
+		return FALSE;
+	length = Util_flen(fp);
+	Util_rewind(fp);
+	memset(buf, 0, sizeof(buf));
+	buf[0] = 'K';
+	PutULONG(buf + 4, record_frame);
+	PutULONG(buf + 8, Atari800_nframes);
+	PutULONG(buf + 12, POKEY_GetRandomCounter());
+	PutULONG(buf + 16, length);
+	ok = fwrite(buf, sizeof(buf), 1, recordfp) == 1 && CopyBytes(recordfp, fp, length);
+	fclose(fp);
+	if (!ok)
+		return FALSE;
+	record_keyframes = (ULONG *) Util_realloc(record_keyframes, (record_num_keyframes + 1) * sizeof(ULONG));
+	record_keyframes[record_num_keyframes++] = (ULONG) offset;
+	return TRUE;
+}
+
+static int OpenRecording(const char *filename)
+{
+	UBYTE header[MOVIE_HEADER_SIZE];
+	recordfp = fopen(filename, "wb");
+	if (recordfp == NULL)
+		return FALSE;
+	/* The number of frames and the index are filled in when closing. */
+	memset(header, 0, sizeof(header));
+	memcpy(header, "A8MV", 4);
+	PutULONG(header + 4, MOVIE_VERSION);
+	PutULONG(header + 12, record_keyframe_interval);
+	if (fwrite(header, sizeof(header), 1, recordfp) != 1) {
+		fclose(recordfp);
+		return FALSE;
+	}
+	record_frame = 0;
+	record_num_keyframes = 0;
+	recording = TRUE;
+	return TRUE;
+}
+
+static void CloseRecording(void)
+{
+	UBYTE buf[4];
+	long index_offset = ftell(recordfp);
+	ULONG i;
+	int ok = TRUE;
+
+	for (i = 0; i < record_num_keyframes && ok; i++) {
+		PutULONG(buf, record_keyframes[i]);
+		ok = fwrite(buf, 4, 1, recordfp) == 1;
+	}
+	if (ok) {
+		UBYTE header[12];
+		PutULONG(header, record_frame);
+		PutULONG(header + 4, record_keyframe_interval);
+		PutULONG(header + 8, (ULONG) index_offset);
+		ok = fseek(recordfp, 8, SEEK_SET) == 0
+			&& fwrite(header, sizeof(header), 1, recordfp) == 1;
+		PutULONG(buf, record_num_keyframes);
+		ok = ok && fwrite(buf, 4, 1, recordfp) == 1;
+	}
+	if (fclose(recordfp) != 0 || !ok)
+		Log_print("Error writing the recording");
+	recordfp = NULL;
+	recording = FALSE;
+	free(record_keyframes);
+	record_keyframes = NULL;
+}
+
+/* Reads the next record with TAG, skipping keyframes. */
+static int ReadRecord(UBYTE *buf, int tag)
+{
+	for (;;) {
+		int c = getc(playbackfp);
+		if (c == 'K') {
+			UBYTE keyframe[MOVIE_KEYFRAME_SIZE];
+			if (fread(keyframe + 1, MOVIE_KEYFRAME_SIZE - 1, 1, playbackfp) != 1
+			 || fseek(playbackfp, GetULONG(keyframe + 16), SEEK_CUR) != 0)
+				return FALSE;
+			continue;
+		}
+		buf[0] = (UBYTE) c;
+		return c == tag && fread(buf + 1, (c == 'F' ? MOVIE_FRAME_SIZE : MOVIE_INT_SIZE) - 1, 1, playbackfp) == 1;
+	}
+}
+
+/* Builds the keyframe index of a recording that wasn't finished. */
+static int ScanPlayback(void)
+{
+	UBYTE buf[MOVIE_KEYFRAME_SIZE];
+	playback_frames = 0;
+	playback_num_keyframes = 0;
+	for (;;) {
+		long offset = ftell(playbackfp);
+		int c = getc(playbackfp);
+		if (c == EOF)
+			return TRUE;
+		if (c == 'K') {
+			if (fread(buf, MOVIE_KEYFRAME_SIZE - 1, 1, playbackfp) != 1)
+				return TRUE; /* truncated */
+			playback_keyframes = (ULONG *) Util_realloc(playback_keyframes, (playback_num_keyframes + 1) * sizeof(ULONG));
+			playback_keyframes[playback_num_keyframes++] = (ULONG) offset;
+			if (fseek(playbackfp, GetULONG(buf + 15), SEEK_CUR) != 0)
+				return FALSE;
+		}
+		else if (c == 'F' || c == 'I') {
+			int size = c == 'F' ? MOVIE_FRAME_SIZE : MOVIE_INT_SIZE;
+			if (fread(buf, size - 1, 1, playbackfp) != 1)
+				return TRUE;
+			if (c == 'F')
+				playback_frames++;
+		}
+		else
+			return FALSE;
+	}
+}
+
+static int OpenPlayback(const char *filename)
+{
+	UBYTE header[MOVIE_HEADER_SIZE];
+	ULONG index_offset;
+	int ok;
+
+	memset(header, 0, sizeof(header));
+	playbackfp = fopen(filename, "rb");
+	if (playbackfp == NULL) {
+		Log_print("Cannot open playback file");
+		return FALSE;
+	}
+	if (fread(header, sizeof(header), 1, playbackfp) != 1 || memcmp(header, "A8MV", 4) != 0) {
+		if (header[0] == 0x1f && header[1] == 0x8b)
+			Log_print("Playback file is in the old text format, which is no longer supported");
+		else
+			Log_print("Invalid playback file");
+		fclose(playbackfp);
+		return FALSE;
+	}
+	if (GetULONG(header + 4) > MOVIE_VERSION) {
+		Log_print("Newer version of playback file than this version of Atari800 can handle");
+		fclose(playbackfp);
+		return FALSE;
+	}
+	playback_frames = GetULONG(header + 8);
+	index_offset = GetULONG(header + 16);
+	playback_num_keyframes = GetULONG(header + 20);
+	if (index_offset != 0) {
+		ULONG i;
+		ok = fseek(playbackfp, index_offset, SEEK_SET) == 0;
+		playback_keyframes = (ULONG *) Util_malloc((playback_num_keyframes + 1) * sizeof(ULONG));
+		for (i = 0; i < playback_num_keyframes && ok; i++) {
+			UBYTE buf[4];
+			ok = fread(buf, 4, 1, playbackfp) == 1;
+			playback_keyframes[i] = GetULONG(buf);
+		}
+	}
+	else {
+		Log_print("Playback file wasn't closed properly, reading it all");
+		ok = ScanPlayback();
+	}
+	if (!ok || playback_num_keyframes == 0
+	 || fseek(playbackfp, MOVIE_HEADER_SIZE, SEEK_SET) != 0) {
+		Log_print("Invalid playback file");
+		fclose(playbackfp);
+		free(playback_keyframes);
+		playback_keyframes = NULL;
+		return FALSE;
+	}
+	playback_frame = 0;
+	playback_check_adler32 = FALSE;
+	turbo_before_playback = Atari800_turbo;
+	playingback = TRUE;
+	return TRUE;
+}
+
+static void ClosePlayback(void)
+{
+	fclose(playbackfp);
+	playbackfp = NULL;
+	playingback = FALSE;
+	seeking = seek_pending = FALSE;
+	free(playback_keyframes);
+	playback_keyframes = NULL;
+	Atari800_turbo = turbo_before_playback;
+}
+
+static void EndPlayback(void)
+{
+	ClosePlayback();
+	if (playingback_exit_after) { /* exit emulation when not set otherwise */
+		Atari800_ErrExit();
+		exit(adler32_errors > 0 ? 1 : 0); /* return code indicates errors*/
+	}
+}
+
+/* Finds in *N the last keyframe that precedes FRAME, or the first keyframe.
+   Returns FALSE on error. */
+static int FindKeyframe(ULONG frame, ULONG *n)
+{
+	ULONG low = 0;
+	ULONG high = playback_num_keyframes;
+	/* The keyframes are in the order of their frames. */
+	while (high - low > 1) {
+		ULONG mid = low + (high - low) / 2;
+		UBYTE buf[8];
+		if (fseek(playbackfp, playback_keyframes[mid], SEEK_SET) != 0
+		 || fread(buf, sizeof(buf), 1, playbackfp) != 1 || buf[0] != 'K')
+			return FALSE;
+		if (GetULONG(buf + 4) <= frame)
+			low = mid;
+		else
+			high = mid;
+	}
+	*n = low;
+	return TRUE;
+}
+
+/* Restores the state of keyframe number N and positions the playback at
+   its frame. */
+static int ReadKeyframe(ULONG n)
+{
+	UBYTE buf[MOVIE_KEYFRAME_SIZE];
+	FILE *fp;
+	ULONG length;
+	int ok;
+
+	if (fseek(playbackfp, playback_keyframes[n], SEEK_SET) != 0
+	 || fread(buf, sizeof(buf), 1, playbackfp) != 1 || buf[0] != 'K')
+		return FALSE;
+	length = GetULONG(buf + 16);
+	if (!CreateStateFile())
+		return FALSE;
+	fp = fopen(state_filename, "wb");
+	if (fp == NULL)
+		return FALSE;
+	ok = CopyBytes(fp, playbackfp, length);
+	if (fclose(fp) != 0 || !ok || !StateSav_ReadAtariState(state_filename, "rb"))
+		return FALSE;
+	playback_frame = GetULONG(buf + 4);
+	Atari800_nframes = GetULONG(buf + 8);
+	POKEY_SetRandomCounter(GetULONG(buf + 12));
+	/* The screen of the previous frame is not in the state. */
+	playback_check_adler32 = FALSE;
+	return TRUE;
+}
+
+/* Called at the start of INPUT_Frame(). */
+static void MovieFrame(void)
+{
+	if (playingback && seek_pending) {
+		ULONG n;
+		seek_pending = FALSE;
+		if (FindKeyframe(seek_frame, &n) && ReadKeyframe(n)) {
+			seeking = playback_frame < seek_frame;
+			Atari800_turbo = seeking || playingback_turbo || turbo_before_playback;
+		}
+		else {
+			Log_print("Cannot read the keyframe for frame %lu of the playback file", (unsigned long) seek_frame);
+			EndPlayback();
+		}
+	}
+	if (playingback && !ReadRecord(playback_buf, 'F')) {
+		Log_print("Playback file is truncated at frame %lu", (unsigned long) playback_frame);
+		EndPlayback();
+	}
+	if (recording && record_frame % record_keyframe_interval == 0 && !WriteKeyframe()) {
+		Log_print("Error writing keyframe, recording stopped");
+		CloseRecording();
+	}
+}
 #endif
 
 int INPUT_Initialise(int *argc, char *argv[])
@@ -199,47 +573,40 @@ int INPUT_Initialise(int *argc, char *argv[])
 		}
 #ifdef EVENT_RECORDING
 		else if (strcmp(argv[i], "-record") == 0) {
+			if (i_a)
+				record_filename = argv[++i];
+			else a_m = TRUE;
+		}
+		else if (strcmp(argv[i], "-recordkeyframes") == 0) {
 			if (i_a) {
-				char *recfilename = argv[++i];
-				if ((recordfp = gzopen(recfilename, "wb")) == NULL) {
-					Log_print("Cannot open record file");
+				int interval = Util_sscandec(argv[++i]);
+				if (interval <= 0) {
+					Log_print("Invalid keyframe interval");
 					return FALSE;
 				}
-				else {
-					recording = TRUE;
-					gzprintf(recordfp, "Atari800 event recording, version: %d\n", EVENT_RECORDING_VERSION);
-				}
+				record_keyframe_interval = interval;
 			}
 			else a_m = TRUE;
 		}
 		else if (strcmp(argv[i], "-playback") == 0) {
 			if (i_a) {
-				char *pbfilename = argv[++i];
-				if ((playbackfp = gzopen(pbfilename, "rb")) == NULL) {
-					Log_print("Cannot open playback file");
+				if (!OpenPlayback(argv[++i]))
 					return FALSE;
-				}
-				else {
-					playingback = TRUE;
-					gzgets(playbackfp, gzbuf, GZBUFSIZE);
-					if (sscanf(gzbuf, "Atari800 event recording, version: %d\n", &recording_version) != 1) {
-						Log_print("Invalid playback file");
-						playingback = FALSE;
-						gzclose(playbackfp);
-						return FALSE;
-					}
-					else if (recording_version > EVENT_RECORDING_VERSION) {
-						Log_print("Newer version of playback file than this version of Atari800 can handle");
-						playingback = FALSE;
-						gzclose(playbackfp);
-						return FALSE;
-					}
-				}
 			}
 			else a_m = TRUE;
 		} else if (strcmp(argv[i], "-playbacknoexit") == 0) {
 			playingback_exit_after = FALSE;
 		}
+		else if (strcmp(argv[i], "-playbackturbo") == 0) {
+			playingback_turbo = TRUE;
+		}
+		else if (strcmp(argv[i], "-playbackseek") == 0) {
+			if (i_a) {
+				seek_frame = Util_sscandec(argv[++i]);
+				seek_pending = TRUE;
+			}
+			else a_m = TRUE;
+		}
 #endif /* EVENT_RECORDING */
  		else if (strcmp(argv[i], "-directmouse") == 0) {
 			INPUT_direct_mouse = 1;
@@ -275,7 +642,12 @@ int INPUT_Initialise(int *argc, char *argv[])
 				#ifdef EVENT_RECORDING
 					Log_print("\t-record <file>   Record input to <file>");
 					Log_print("\t-playback <file> Playback input from <file>");
+					Log_print("\t-recordkeyframes <n>");
+					Log_print("\t                 Store a keyframe every <n> frames of the recording (default 3000)");
 					Log_print("\t-playbacknoexit  Don't exit the emulator after playback finishes");
+					Log_print("\t-playbackturbo   Play back as fast as possible");
+					Log_print("\t-playbackseek <n>");
+					Log_print("\t                 Start the playback at frame <n>");
 				#endif /* EVENT_RECORDING */
 				
 			}
@@ -300,21 +672,39 @@ int INPUT_Initialise(int *argc, char *argv[])
 	INPUT_CenterMousePointer();
 	*argc = j;
 
+#ifdef EVENT_RECORDING
+	/* Opened only now, so that the header has the final keyframe interval. */
+	if (record_filename != NULL && !OpenRecording(record_filename)) {
+		Log_print("Cannot open record file");
+		return FALSE;
+	}
+	if (playingback) {
+		if (seek_pending && !INPUT_PlaybackSeek(seek_frame)) {
+			Log_print("Playback file has only %lu frames", (unsigned long) playback_frames);
+			return FALSE;
+		}
+		if (playingback_turbo)
+			Atari800_turbo = TRUE;
+	}
+#endif
+
 	return TRUE;
 }
 
 /* For event recording */
 void INPUT_Exit(void) {
 #ifdef EVENT_RECORDING
-	if (recording) {
-		gzclose(recordfp);
-		recording = FALSE;
-	}
-	if (playingback) {
-		gzclose(playbackfp);
-		playingback = FALSE;
+	if (recording)
+		CloseRecording();
+	if (playingback)
+		ClosePlayback();
+#ifdef HAVE_UTIL_UNLINK
+	if (state_filename[0] != '\0') {
+		Util_unlink(state_filename);
+		state_filename[0] = '\0';
 	}
 #endif
+#endif
 }
 
 /* mouse_step is used in Amiga, ST, trak-ball and joystick modes.
@@ -438,6 +828,10 @@ void INPUT_Frame(void)
 
 	scanline_counter = 10000;	/* do nothing in INPUT_Scanline() */
 
+#ifdef EVENT_RECORDING
+	MovieFrame();
+#endif
+
 	/* handle keyboard */
 
 	if (Atari800_keyboard_detached) {
@@ -459,11 +853,18 @@ void INPUT_Frame(void)
 	*/
 #ifdef EVENT_RECORDING
 	if (playingback) {
-		gzgets(playbackfp, gzbuf, GZBUFSIZE);
-		sscanf(gzbuf, "%d %d %d ", &INPUT_key_code, &INPUT_key_shift, &INPUT_key_consol);
+		INPUT_key_shift = playback_buf[1];
+		INPUT_key_consol = playback_buf[2];
+		INPUT_key_code = playback_buf[6] | (playback_buf[7] << 8);
+		if (INPUT_key_code & 0x8000)
+			INPUT_key_code -= 0x10000;
 	}
 	if (recording) {
-		gzprintf(recordfp, "%d %d %d ", INPUT_key_code, INPUT_key_shift, INPUT_key_consol);
+		record_buf[0] = 'F';
+		record_buf[1] = (UBYTE) INPUT_key_shift;
+		record_buf[2] = (UBYTE) INPUT_key_consol;
+		record_buf[6] = (UBYTE) INPUT_key_code;
+		record_buf[7] = (UBYTE) (INPUT_key_code >> 8);
 	}
 #endif
 	i = Atari800_machine_type == Atari800_MACHINE_5200 ? INPUT_key_shift : (INPUT_key_code == AKEY_BREAK);
@@ -543,15 +944,14 @@ void INPUT_Frame(void)
 	/* handle joysticks */
 #ifdef EVENT_RECORDING
 	if (playingback) {
-		gzgets(playbackfp, gzbuf, GZBUFSIZE);
-		sscanf(gzbuf,"%d ",&i);
+		i = playback_buf[3];
 	} else {
 #endif
 		i = PLATFORM_PORT(0);
 #ifdef EVENT_RECORDING
 	}
 	if (recording) {
-		gzprintf(recordfp,"%d ",i);
+		record_buf[3] = (UBYTE) i;
 	}
 #endif
 
@@ -559,15 +959,14 @@ void INPUT_Frame(void)
 	STICK[1] = (i >> 4) & 0x0f;
 #ifdef EVENT_RECORDING
 	if (playingback) {
-		gzgets(playbackfp, gzbuf, GZBUFSIZE);
-		sscanf(gzbuf,"%d ",&i);
+		i = playback_buf[4];
 	} else {
 #endif
 		i = PLATFORM_PORT(1);
 #ifdef EVENT_RECORDING
 	}
 	if (recording) {
-		gzprintf(recordfp,"%d ",i);
+		record_buf[4] = (UBYTE) i;
 	}
 #endif
 	STICK[2] = i & 0x0f;
@@ -601,28 +1000,21 @@ void INPUT_Frame(void)
 		/* Joystick Triggers */
 #ifdef EVENT_RECORDING
 		if(playingback){
-			int trigtemp;
-			gzgets(playbackfp, gzbuf, GZBUFSIZE);
-			sscanf(gzbuf,"%d ",&trigtemp);
-			TRIG_input[i] = trigtemp;
-
+			TRIG_input[i] = (playback_buf[5] >> i) & 1;
 		} else {
 #endif
 			TRIG_input[i] = PLATFORM_TRIG(i);
 #ifdef EVENT_RECORDING
 		}
 		if(recording){
-			gzprintf(recordfp,"%d ",TRIG_input[i]);
+			if (i == 0)
+				record_buf[5] = 0;
+			record_buf[5] |= (TRIG_input[i] & 1) << i;
 		}
 #endif
 		if ((INPUT_joy_autofire[i] == INPUT_AUTOFIRE_FIRE && !TRIG_input[i]) || (INPUT_joy_autofire[i] == INPUT_AUTOFIRE_CONT))
 			TRIG_input[i] = (Atari800_nframes & 2) ? 1 : 0;
 	}
-#ifdef EVENT_RECORDING
-	if(recording){
-		gzprintf(recordfp,"\n");
-	}
-#endif
 
 	/* handle analog joysticks in Atari 5200 */
 	if (Atari800_machine_type != Atari800_MACHINE_5200) {
@@ -886,36 +1278,37 @@ void INPUT_Frame(void)
 static void update_adler32_of_screen(void)
 {
 	unsigned int adler32val = 0;
-	static unsigned int adler32_errors = 0;
 	static int first = TRUE;
 	if (first) { /* don't calculate the first frame */
 		first = FALSE;
 		adler32val = 0;
 	}
-	else if (recording || playingback){
+	else if (recording || (playingback && playback_check_adler32)) {
 		adler32val = compute_adler32_of_screen();
 	}
 
 	if (recording) {
-		gzprintf(recordfp, "%08X \n", adler32val);
+		PutULONG(record_buf + 8, adler32val);
+		if (fwrite(record_buf, MOVIE_FRAME_SIZE, 1, recordfp) != 1) {
+			Log_print("Error writing the recording, recording stopped");
+			CloseRecording();
+		}
+		else
+			record_frame++;
 	}
 	if (playingback) {
-		unsigned int pb_adler32val;
-		gzgets(playbackfp, gzbuf, GZBUFSIZE);
-		sscanf(gzbuf, "%08X ", &pb_adler32val);
-		if (pb_adler32val != adler32val){
+		if (playback_check_adler32 && GetULONG(playback_buf + 8) != adler32val) {
 			Log_print("adler32 does not match");
 			adler32_errors++;
 		}
-		
-	}
-	if (playingback && gzeof(playbackfp)) {
-		playingback = FALSE;
-		gzclose(playbackfp);
-		if (playingback_exit_after) { /* exit emulation when not set otherwise */
-			Atari800_ErrExit();
-			exit(adler32_errors > 0 ? 1 : 0); /* return code indicates errors*/
+		playback_check_adler32 = TRUE;
+		playback_frame++;
+		if (seeking && playback_frame >= seek_frame) {
+			seeking = FALSE;
+			Atari800_turbo = playingback_turbo || turbo_before_playback;
 		}
+		if (playback_frame >= playback_frames)
+			EndPlayback();
 	}
 }
 /* Compute the adler32 value of the visible screen */
@@ -953,7 +1346,13 @@ int INPUT_Playingback(void)
 void INPUT_RecordInt(int i)
 {
 #ifdef EVENT_RECORDING
-	if (recording) gzprintf(recordfp, "%d\n", i);
+	if (recording) {
+		UBYTE buf[MOVIE_INT_SIZE];
+		memset(buf, 0, sizeof(buf));
+		buf[0] = 'I';
+		PutULONG(buf + 4, (ULONG) i);
+		fwrite(buf, sizeof(buf), 1, recordfp);
+	}
 #endif
 }
 
@@ -961,14 +1360,25 @@ int INPUT_PlaybackInt(void)
 {
 	int i = 0;
 #ifdef EVENT_RECORDING
-	if (playingback) {
-		gzgets(playbackfp, gzbuf, GZBUFSIZE);
-		sscanf(gzbuf, "%d", &i);
-	}
+	UBYTE buf[MOVIE_INT_SIZE];
+	if (playingback && ReadRecord(buf, 'I'))
+		i = (int) GetULONG(buf + 4);
 #endif
 	return i;
 }
 
+int INPUT_PlaybackSeek(int frame)
+{
+#ifdef EVENT_RECORDING
+	if (playingback && frame >= 0 && (ULONG) frame < playback_frames) {
+		seek_frame = frame;
+		seek_pending = TRUE;
+		return TRUE;
+	}
+#endif
+	return FALSE;
+}
+
 void INPUT_Scanline(void)
 {
 	if (--scanline_counter == 0) {
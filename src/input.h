@@ -89,5 +89,9 @@ int INPUT_Recording(void);
 int INPUT_Playingback(void);
 void INPUT_RecordInt(int i);
 int INPUT_PlaybackInt(void);
+/* Makes the playback continue at FRAME of the recording, from the next
+   INPUT_Frame(). Returns FALSE if not playing back or FRAME is beyond
+   the end. */
+int INPUT_PlaybackSeek(int frame);
 
 #endif /* INPUT_H_ */
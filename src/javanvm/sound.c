@@ -68,6 +68,11 @@ int PLATFORM_SoundSetup(Sound_setup_t *setup)
 		/* Set buffer_frames automatically. */
 		setup->buffer_frames = Sound_NextPow2(setup->freq * 4 / 50);
 
+	if (setup->sample_size > 2)
+		/* Float samples not supported. */
+		setup->sample_size = 2;
+	if (setup->channels > 2)
+		setup->channels = 2;
 	sconfig[JAVANVM_InitSoundSampleRate] = setup->freq;
 	sconfig[JAVANVM_InitSoundBitsPerSample] = setup->sample_size * 8;
 	sconfig[JAVANVM_InitSoundChannels] = setup->channels;
@@ -321,7 +321,9 @@ UBYTE *libatari800_get_screen_ptr()
 /** Return pointer to sound data
  *
  * If sound is used, each emulated frame will fill the sound buffer with samples
- * at the configured audio sample rate.
+ * at the configured audio sample rate. The format of the samples is given by
+ * \a libatari800_get_sound_sample_size; 32-bit float samples are passed through
+ * exactly as the sound engine produced them.
  *
  * Because the emulation runs at a non-integer frame rate (approximately 59.923
  * frames per second in NTSC, 49.861 fps in PAL), the number of samples is not a
@@ -382,6 +384,7 @@ int libatari800_get_num_sound_channels() {
  *
  * @retval 1 8-bit audio
  * @retval 2 16-bit audio
+ * @retval 4 32-bit float audio (selected with the -audiofloat option)
  */
 int libatari800_get_sound_sample_size() {
 	return Sound_out.sample_size;
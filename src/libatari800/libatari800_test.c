@@ -64,7 +64,7 @@ FILE *wavOpen(const char *szFileName)
 
 	fputs("fmt ", fp);
 	fputl(16, fp);
-	fputw(1, fp);
+	fputw(libatari800_get_sound_sample_size() == 4 ? 3 : 1, fp); /* IEEE float or PCM */
 	fputw(libatari800_get_num_sound_channels(), fp);
 	fputl(libatari800_get_sound_frequency(), fp);
 	fputl(libatari800_get_sound_frequency() * libatari800_get_sound_sample_size(), fp);
@@ -54,6 +54,7 @@
 
 /* mainloop includes */
 #include "antic.h"
+#include "cassette.h"
 #include "devices.h"
 #include "gtia.h"
 #include "pokey.h"
@@ -63,6 +64,9 @@
 #if defined(PBI_XLD) || defined (VOICEBOX)
 #include "votraxsnd.h"
 #endif
+#ifdef SHMEXPORT
+#include "shmexport.h"
+#endif
 
 int PLATFORM_Configure(char *option, char *parameters)
 {
@@ -125,6 +129,8 @@ void LIBATARI800_Frame(void)
 	VOTRAXSND_Frame(); /* for the Votrax */
 #endif
 	Devices_Frame();
+	SIO_Frame();
+	CASSETTE_Frame();
 	INPUT_Frame();
 	GTIA_Frame();
 	ANTIC_Frame(TRUE);
@@ -133,7 +139,13 @@ void LIBATARI800_Frame(void)
 	Screen_DrawDiskLED();
 	Screen_Draw1200LED();
 	POKEY_Frame();
+#ifdef SCREENSHOTS
+	Screen_ScreenshotBurstFrame();
+#endif
 	Sound_Update();
+#ifdef SHMEXPORT
+	SHMEXPORT_Frame();
+#endif
 	Atari800_nframes++;
 }
 
@@ -53,6 +53,10 @@ int PLATFORM_SoundSetup(Sound_setup_t *setup)
 	double refresh_rate;
 	double samples_per_video_frame;
 
+	/* Audio is consumed once per emulated frame rather than in real time, so
+	   the output must not be resampled to follow the fill of the buffer. */
+	Sound_drc_enabled = FALSE;
+
 	refresh_rate = Atari800_tv_mode == Atari800_TV_PAL ? Atari800_FPS_PAL : Atari800_FPS_NTSC;
 	samples_per_video_frame = setup->freq / refresh_rate;
 	setup->buffer_frames = (int)(ceil(samples_per_video_frame));
@@ -61,7 +61,7 @@ static const double pokeymix[61+CONSOLE_VOL] = { /* Nonlinear POKEY mixing array
 
 #define SND_FILTER_SIZE  2048
 
-#define NPOKEYS 2
+#define NPOKEYS 4
 
 
 /* M_PI was not defined in MSVC headers */
@@ -70,6 +70,7 @@ static const double pokeymix[61+CONSOLE_VOL] = { /* Nonlinear POKEY mixing array
 #endif
 
 static int num_cur_pokeys = 0;
+static int num_out_channels = 1;
 
 /* Filter */
 static int pokey_frq; /* Hz - for easier resampling */
@@ -265,8 +266,7 @@ typedef struct stPokeyState
 PokeyState pokey_states[NPOKEYS];
 
 static struct {
-    double s16;
-    double s8;
+    double f; /* POKEYSND_volume as a factor for float samples */
 } volume;
 
 /* Forward declarations for ResetPokeyState */
@@ -1242,8 +1242,8 @@ found:
   return size;
 }
 
-static void mzpokeysnd_process_8(void* sndbuffer, int sndn);
-static void mzpokeysnd_process_16(void* sndbuffer, int sndn);
+static void mzpokeysnd_process(void* sndbuffer, int sndn);
+static void init_mixer(void);
 static void Update_pokey_sound_mz(UWORD addr, UBYTE val, UBYTE chip, UBYTE gain);
 #ifdef CONSOLE_SOUND
 static void Update_consol_sound_mz( int set );
@@ -1258,7 +1258,8 @@ static void Update_consol_sound_mz( int set );
 /*                                                                           */
 /* Inputs:  freq17 - the value for the '1.79MHz' Pokey audio clock           */
 /*          playback_freq - the playback frequency in samples per second     */
-/*          num_pokeys - specifies the number of pokey chips to be emulated  */
+/*          num_pokeys - specifies the number of output channels; the number */
+/*                       of pokey chips is POKEYSND_num_chips                */
 /*                                                                           */
 /* Outputs: Adjusts local globals - no return value                          */
 /*                                                                           */
@@ -1291,7 +1292,7 @@ int MZPOKEYSND_Init(ULONG freq17, int playback_freq, UBYTE num_pokeys,
     POKEYSND_UpdateConsol_ptr = Update_consol_sound_mz;
 #endif
 
-	POKEYSND_Process_ptr = (flags & POKEYSND_BIT16) ? mzpokeysnd_process_16 : mzpokeysnd_process_8;
+	POKEYSND_Process_ptr = mzpokeysnd_process;
 
     switch(playback_freq)
     {
@@ -1384,14 +1385,16 @@ int MZPOKEYSND_Init(ULONG freq17, int playback_freq, UBYTE num_pokeys,
 	if (clear_regs)
 #endif
 	{
-		ResetPokeyState(pokey_states);
-		ResetPokeyState(pokey_states + 1);
+		int i;
+		for (i = 0; i < NPOKEYS; i++)
+			ResetPokeyState(pokey_states + i);
 	}
-	num_cur_pokeys = num_pokeys;
+	num_cur_pokeys = POKEYSND_num_chips;
+	num_out_channels = num_pokeys;
 
 	init_syncsound();
-	volume.s8 = POKEYSND_volume * 0xff / 256.0;
-	volume.s16 = POKEYSND_volume * 0xffff / 256.0;
+	volume.f = POKEYSND_volume * 0xffff / 256.0 / 32768.0;
+	init_mixer();
 
 	return 0; /* OK */
 }
@@ -2280,53 +2283,192 @@ void mzpokeysnd_debugreset(UBYTE chip)
 
 #define MAX_SAMPLE 152
 
-static void mzpokeysnd_process_8(void* sndbuffer, int sndn)
+/******************************************************************
+ Mixing stage
+
+ Each POKEY is first rendered into its own plane of unscaled float
+ samples. The planes are then mixed with the gains in mix_gain into
+ one plane per output channel, interleaved into float frames and
+ finally converted to the output sample format. Every step is a
+ loop over a block of samples without branches, so that the float
+ arithmetic is done 4 samples at a time with SSE where available.
+ Only the 8/16-bit conversion stays scalar, because of the dither.
+ ******************************************************************/
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define MIX_SSE
+#include <xmmintrin.h>
+#endif
+
+#define MIX_BLOCK 256
+#define MIX_MAX_CHANNELS 4
+
+/* Scale of the mixed samples to the -1.0..1.0 float range, excluding the
+   volume. */
+#define MIX_UNIT (1.0 / 2 / MAX_SAMPLE / 4 * M_PI * 0.95)
+/* Factors from the float range to 16-bit and 8-bit samples. */
+#define MIX_TO_S16 32768.0
+#define MIX_TO_S8 (32768.0 * 255.0 / 65535.0)
+
+/* Whether each POKEY goes to its own output channel unchanged. */
+static int mix_direct;
+static float mix_gain[MIX_MAX_CHANNELS][NPOKEYS];
+static float mix_planes[NPOKEYS][MIX_BLOCK];
+static float mix_channels[MIX_MAX_CHANNELS][MIX_BLOCK];
+static float mix_frames[MIX_MAX_CHANNELS * MIX_BLOCK];
+
+/* Sets up mix_gain for mixing num_cur_pokeys POKEYs into num_out_channels
+   channels. POKEYs are assigned to the channels in turn, so with four
+   POKEYs in stereo the 1st and 3rd are on the left, the 2nd and 4th on the
+   right. POKEYs sharing a channel are attenuated to avoid clipping. */
+static void init_mixer(void)
+{
+    int c, i;
+    float gain = (float)(volume.f * MIX_UNIT * num_out_channels / num_cur_pokeys);
+
+    mix_direct = num_cur_pokeys == num_out_channels;
+    for (c = 0; c < MIX_MAX_CHANNELS; c++)
+        for (i = 0; i < NPOKEYS; i++)
+            mix_gain[c][i] = 0.0f;
+    for (i = 0; i < num_cur_pokeys; i++) {
+        if (num_out_channels > num_cur_pokeys)
+            /* One POKEY on more channels. */
+            for (c = i; c < num_out_channels; c += num_cur_pokeys)
+                mix_gain[c][i] = (float)(volume.f * MIX_UNIT);
+        else
+            mix_gain[i % num_out_channels][i] = gain;
+    }
+}
+
+/* Mixes N samples of mix_planes into mix_channels. */
+static void mix_planar(int n)
 {
-    int i;
-    int nsam = sndn;
-    UBYTE *buffer = (UBYTE *) sndbuffer;
+    int c, i, j;
 
-    if(num_cur_pokeys<1)
-        return; /* module was not initialized */
+    for (c = 0; c < num_out_channels; c++) {
+        float *out = mix_channels[c];
+        j = 0;
+#ifdef MIX_SSE
+        for (; j + 4 <= n; j += 4) {
+            __m128 sum = _mm_mul_ps(_mm_loadu_ps(mix_planes[0] + j), _mm_set1_ps(mix_gain[c][0]));
+            for (i = 1; i < num_cur_pokeys; i++)
+                sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(mix_planes[i] + j), _mm_set1_ps(mix_gain[c][i])));
+            _mm_storeu_ps(out + j, sum);
+        }
+#endif
+        for (; j < n; j++) {
+            float sum = mix_planes[0][j] * mix_gain[c][0];
+            for (i = 1; i < num_cur_pokeys; i++)
+                sum += mix_planes[i][j] * mix_gain[c][i];
+            out[j] = sum;
+        }
+    }
+}
 
-    /* if there are two pokeys, then the signal is stereo
-       we assume even sndn */
-    while(nsam >= (int) num_cur_pokeys)
-    {
-        buffer[0] = (UBYTE)floor(generate_sample(pokey_states)
-         * (255.0 / 2 / MAX_SAMPLE / 4 * M_PI * 0.95) + 128 + 0.5 + 0.5 * rand() / RAND_MAX - 0.25);
-        for(i=1; i<num_cur_pokeys; i++)
-        {
-            buffer[i] = (UBYTE)floor(generate_sample(pokey_states + i)
-             * (255.0 / 2 / MAX_SAMPLE / 4 * M_PI * 0.95) + 128 + 0.5 + 0.5 * rand() / RAND_MAX - 0.25);
+/* Interleaves N samples of mix_channels into float frames at OUT. */
+static void mix_interleave(float *out, int n)
+{
+    int j = 0;
+
+    switch (num_out_channels) {
+    case 1:
+        for (; j < n; j++)
+            out[j] = mix_channels[0][j];
+        break;
+    case 2:
+#ifdef MIX_SSE
+        for (; j + 4 <= n; j += 4) {
+            __m128 l = _mm_loadu_ps(mix_channels[0] + j);
+            __m128 r = _mm_loadu_ps(mix_channels[1] + j);
+            _mm_storeu_ps(out + 2 * j, _mm_unpacklo_ps(l, r));
+            _mm_storeu_ps(out + 2 * j + 4, _mm_unpackhi_ps(l, r));
         }
-        buffer += num_cur_pokeys;
-        nsam -= num_cur_pokeys;
+#endif
+        for (; j < n; j++) {
+            out[2 * j] = mix_channels[0][j];
+            out[2 * j + 1] = mix_channels[1][j];
+        }
+        break;
+    default: /* 4 */
+#ifdef MIX_SSE
+        for (; j + 4 <= n; j += 4) {
+            __m128 c0 = _mm_loadu_ps(mix_channels[0] + j);
+            __m128 c1 = _mm_loadu_ps(mix_channels[1] + j);
+            __m128 c2 = _mm_loadu_ps(mix_channels[2] + j);
+            __m128 c3 = _mm_loadu_ps(mix_channels[3] + j);
+            _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+            _mm_storeu_ps(out + 4 * j, c0);
+            _mm_storeu_ps(out + 4 * j + 4, c1);
+            _mm_storeu_ps(out + 4 * j + 8, c2);
+            _mm_storeu_ps(out + 4 * j + 12, c3);
+        }
+#endif
+        for (; j < n; j++) {
+            out[4 * j] = mix_channels[0][j];
+            out[4 * j + 1] = mix_channels[1][j];
+            out[4 * j + 2] = mix_channels[2][j];
+            out[4 * j + 3] = mix_channels[3][j];
+        }
+        break;
     }
 }
 
-static void mzpokeysnd_process_16(void* sndbuffer, int sndn)
+/* Mixes N frames of mix_planes into BUFFER in the output sample format.
+   Returns pointer past the written frames. */
+static UBYTE *mix_output(UBYTE *buffer, int n)
 {
+    int const count = n * num_out_channels;
     int i;
-    int nsam = sndn;
-    SWORD *buffer = (SWORD *) sndbuffer;
+
+    if (n == 0)
+        return buffer;
+    if (mix_direct) {
+        /* Channels equal POKEYs: only apply the gain. */
+        int c;
+        for (c = 0; c < num_out_channels; c++) {
+            float const gain = mix_gain[c][c];
+            for (i = 0; i < n; i++)
+                mix_channels[c][i] = mix_planes[c][i] * gain;
+        }
+    }
+    else
+        mix_planar(n);
+
+    if (POKEYSND_snd_flags & POKEYSND_FLOAT32) {
+        mix_interleave((float *)buffer, n);
+        return buffer + count * 4;
+    }
+    mix_interleave(mix_frames, n);
+    if (POKEYSND_snd_flags & POKEYSND_BIT16) {
+        SWORD *out = (SWORD *)buffer;
+        for (i = 0; i < count; i++)
+            out[i] = (SWORD)floor(mix_frames[i] * MIX_TO_S16
+                                  + 0.5 + 0.5 * rand() / RAND_MAX - 0.25);
+        return buffer + count * 2;
+    }
+    for (i = 0; i < count; i++)
+        buffer[i] = (UBYTE)floor(mix_frames[i] * MIX_TO_S8
+                                 + 128 + 0.5 + 0.5 * rand() / RAND_MAX - 0.25);
+    return buffer + count;
+}
+
+static void mzpokeysnd_process(void* sndbuffer, int sndn)
+{
+    UBYTE *buffer = (UBYTE *) sndbuffer;
+    int nframes = sndn / num_out_channels;
 
     if(num_cur_pokeys<1)
         return; /* module was not initialized */
 
-    /* if there are two pokeys, then the signal is stereo
-       we assume even sndn */
-    while(nsam >= (int) num_cur_pokeys)
+    while (nframes > 0)
     {
-        buffer[0] = (SWORD)floor(generate_sample(pokey_states)
-         * (65535.0 / 2 / MAX_SAMPLE / 4 * M_PI * 0.95) + 0.5 + 0.5 * rand() / RAND_MAX - 0.25);
-        for(i=1; i<num_cur_pokeys; i++)
-        {
-            buffer[i] = (SWORD)floor(generate_sample(pokey_states + i)
-             * (65535.0 / 2 / MAX_SAMPLE / 4 * M_PI * 0.95) + 0.5 + 0.5 * rand() / RAND_MAX - 0.25);
-        }
-        buffer += num_cur_pokeys;
-        nsam -= num_cur_pokeys;
+        int n = nframes > MIX_BLOCK ? MIX_BLOCK : nframes;
+        int i, j;
+        for (i = 0; i < num_cur_pokeys; i++)
+            for (j = 0; j < n; j++)
+                mix_planes[i][j] = (float)generate_sample(pokey_states + i);
+        buffer = mix_output(buffer, n);
+        nframes -= n;
     }
 }
 
@@ -2335,8 +2477,10 @@ static void generate_sync(unsigned int num_ticks)
 	double new_samp_pos;
 	unsigned int ticks;
 	UBYTE *buffer = POKEYSND_process_buffer + POKEYSND_process_buffer_fill;
-	UBYTE *buffer_end = POKEYSND_process_buffer + POKEYSND_process_buffer_length;
-	unsigned int i;
+	unsigned int frames_left = (POKEYSND_process_buffer_length - POKEYSND_process_buffer_fill)
+	                           / (num_out_channels * POKEYSND_SAMPLE_SIZE(POKEYSND_snd_flags));
+	int n = 0;
+	int i;
 
 	for (;;) {
 		double int_part;
@@ -2347,7 +2491,7 @@ static void generate_sync(unsigned int num_ticks)
 			samp_pos -= num_ticks;
 			break;
 		}
-		if (buffer >= buffer_end)
+		if (frames_left == 0)
 			break;
 
 		samp_pos = new_samp_pos;
@@ -2356,22 +2500,15 @@ static void generate_sync(unsigned int num_ticks)
 		for (i = 0; i < num_cur_pokeys; ++i) {
 			/* advance pokey to the new position and produce a sample */
 			advance_ticks(pokey_states + i, ticks);
-			if (POKEYSND_snd_flags & POKEYSND_BIT16) {
-				*((SWORD *)buffer) = (SWORD)floor(
-					interp_read_resam_all(pokey_states + i, samp_pos)
-					* (volume.s16 / 2 / MAX_SAMPLE / 4 * M_PI * 0.95)
-					+ 0.5 + 0.5 * rand() / RAND_MAX - 0.25
-				);
-				buffer += 2;
-			}
-			else
-				*buffer++ = (UBYTE)floor(
-					interp_read_resam_all(pokey_states + i, samp_pos)
-					* (volume.s8 / 2 / MAX_SAMPLE / 4 * M_PI * 0.95)
-					+ 128 + 0.5 + 0.5 * rand() / RAND_MAX - 0.25
-				);
+			mix_planes[i][n] = (float)interp_read_resam_all(pokey_states + i, samp_pos);
+		}
+		frames_left--;
+		if (++n == MIX_BLOCK) {
+			buffer = mix_output(buffer, n);
+			n = 0;
 		}
 	}
+	buffer = mix_output(buffer, n);
 
 	POKEYSND_process_buffer_fill = buffer - POKEYSND_process_buffer;
 	if (num_ticks > 0) {
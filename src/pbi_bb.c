@@ -79,9 +79,12 @@ static void init_bb(void)
 	}
 	D(printf("loaded black box rom image\n"));
 	PBI_BB_enabled = TRUE;
-	if (PBI_SCSI_disk != NULL) fclose(PBI_SCSI_disk);
+	if (PBI_SCSI_disk != NULL) {
+		HDIMAGE_Close(PBI_SCSI_disk);
+		PBI_SCSI_disk = NULL;
+	}
 	if (!Util_filenamenotset(bb_scsi_disk_filename)) {
-		PBI_SCSI_disk = fopen(bb_scsi_disk_filename, "rb+");
+		PBI_SCSI_disk = HDIMAGE_Open(bb_scsi_disk_filename);
 		if (PBI_SCSI_disk == NULL) {
 			Log_print("Error opening BB SCSI disk image:%s", bb_scsi_disk_filename);
 		}
@@ -120,7 +123,7 @@ int PBI_BB_Initialise(int *argc, char *argv[])
 void PBI_BB_Exit(void)
 {
 	if (PBI_SCSI_disk != NULL) {
-		fclose(PBI_SCSI_disk);
+		HDIMAGE_Close(PBI_SCSI_disk);
 		PBI_SCSI_disk = NULL;
 	}
 	free(bb_ram);
@@ -64,9 +64,12 @@ static void init_mio(void)
 	}
 	D(printf("Loaded mio rom image\n"));
 	PBI_MIO_enabled = TRUE;
-	if (PBI_SCSI_disk != NULL) fclose(PBI_SCSI_disk);
+	if (PBI_SCSI_disk != NULL) {
+		HDIMAGE_Close(PBI_SCSI_disk);
+		PBI_SCSI_disk = NULL;
+	}
 	if (!Util_filenamenotset(mio_scsi_disk_filename)) {
-		PBI_SCSI_disk = fopen(mio_scsi_disk_filename, "rb+");
+		PBI_SCSI_disk = HDIMAGE_Open(mio_scsi_disk_filename);
 		if (PBI_SCSI_disk == NULL) {
 			Log_print("Error opening SCSI disk image:%s", mio_scsi_disk_filename);
 		}
@@ -105,7 +108,7 @@ int PBI_MIO_Initialise(int *argc, char *argv[])
 void PBI_MIO_Exit(void)
 {
 	if (PBI_SCSI_disk != NULL) {
-		fclose(PBI_SCSI_disk);
+		HDIMAGE_Close(PBI_SCSI_disk);
 		PBI_SCSI_disk = NULL;
 	}
 	free(mio_ram);
@@ -55,8 +55,16 @@ static int scsi_phase = SCSI_PHASE_SELECTION;
 static int scsi_bufpos = 0;
 static UBYTE scsi_buffer[256];
 static int scsi_count = 0;
+static int scsi_lba = 0;
+/* Error code of the last failed command, for request sense */
+static UBYTE scsi_sense = 0;
+static int scsi_sense_lba = 0;
 
-FILE *PBI_SCSI_disk = NULL;
+#define SCSI_STATUS_GOOD 0x00
+#define SCSI_STATUS_CHECK_CONDITION 0x02
+#define SCSI_SENSE_WRITE_FAULT 0x03
+
+HDIMAGE_t *PBI_SCSI_disk = NULL;
 
 static void scsi_changephase(int phase)
 {
@@ -130,7 +138,12 @@ static void scsi_process_command(void)
 			/* request sense */
 			D(printf("SCSI: request sense\n"));
 			scsi_changephase(SCSI_PHASE_DATAIN);
-			memset(scsi_buffer,0,1);
+			scsi_buffer[0] = scsi_sense;
+			scsi_buffer[1] = (UBYTE) (scsi_sense_lba >> 16);
+			scsi_buffer[2] = (UBYTE) (scsi_sense_lba >> 8);
+			scsi_buffer[3] = (UBYTE) scsi_sense_lba;
+			scsi_sense = 0;
+			scsi_sense_lba = 0;
 			scsi_count = 4;
 			break;
 		case 0x08:
@@ -138,8 +151,7 @@ static void scsi_process_command(void)
 /*			lun = ((scsi_buffer[1]&0xe0)>>5);*/
 			lba = (((scsi_buffer[1]&0x1f)<<16)|(scsi_buffer[2]<<8)|(scsi_buffer[3]));
 			D(printf("SCSI: read lun:%d lba:%d\n",lun,lba));
-			fseek(PBI_SCSI_disk, lba*256, SEEK_SET);
-			scsi_count = fread(scsi_buffer, 1, 256, PBI_SCSI_disk);
+			scsi_count = HDIMAGE_Read(PBI_SCSI_disk, (off_t)lba*256, scsi_buffer, 256);
 			scsi_changephase(SCSI_PHASE_DATAIN);
 			/* scsi_count = 256; */
 			break;
@@ -148,7 +160,7 @@ static void scsi_process_command(void)
 /*			lun = ((scsi_buffer[1]&0xe0)>>5);*/
 			lba = (((scsi_buffer[1]&0x1f)<<16)|(scsi_buffer[2]<<8)|(scsi_buffer[3]));
 			D(printf("SCSI: write lun:%d lba:%d\n",lun,lba));
-			fseek(PBI_SCSI_disk, lba*256, SEEK_SET);
+			scsi_lba = lba;
 			scsi_changephase(SCSI_PHASE_DATAOUT);
 			scsi_count = 256;
 			break;
@@ -188,9 +200,16 @@ static void scsi_nextbyte(void)
 		D(printf("SCSI data out:%2x\n", scsi_byte));
 		scsi_buffer[scsi_bufpos++] = scsi_byte;
 		if (scsi_bufpos >= scsi_count) {
-			fwrite(scsi_buffer, 1, 256, PBI_SCSI_disk);
+			int ok = HDIMAGE_Write(PBI_SCSI_disk, (off_t)scsi_lba*256, scsi_buffer, 256);
 			scsi_changephase(SCSI_PHASE_STATUS);
-			scsi_buffer[0] = 0;
+			if (ok)
+				scsi_buffer[0] = SCSI_STATUS_GOOD;
+			else {
+				Log_print("SCSI: can't write sector %d", scsi_lba);
+				scsi_sense = SCSI_SENSE_WRITE_FAULT;
+				scsi_sense_lba = scsi_lba;
+				scsi_buffer[0] = SCSI_STATUS_CHECK_CONDITION;
+			}
 		}
 	}
 }
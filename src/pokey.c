@@ -70,6 +70,7 @@ UBYTE POKEY_IRQEN;
 UBYTE POKEY_SKSTAT;
 UBYTE POKEY_SKCTL;
 int POKEY_DELAYED_SERIN_IRQ;
+int POKEY_serin_early = FALSE;
 int POKEY_DELAYED_SEROUT_IRQ;
 int POKEY_DELAYED_XMTDONE_IRQ;
 
@@ -86,6 +87,8 @@ static int pot_scanline;
 UBYTE POKEY_poly9_lookup[511];
 UBYTE POKEY_poly17_lookup[16385];
 static ULONG random_scanline_counter;
+/* TRUE if SERIN has been read since the last byte was loaded into it. */
+static int serin_read = FALSE;
 
 ULONG POKEY_GetRandomCounter(void)
 {
@@ -97,12 +100,23 @@ void POKEY_SetRandomCounter(ULONG value)
 	random_scanline_counter = value;
 }
 
+int POKEY_NumChips(void)
+{
+#ifdef STEREO_SOUND
+	if (POKEYSND_quad_enabled && POKEYSND_enable_new_pokey)
+		return POKEY_MAXPOKEYS;
+	if (POKEYSND_stereo_enabled)
+		return 2;
+#endif
+	return 1;
+}
+
 UBYTE POKEY_GetByte(UWORD addr, int no_side_effects)
 {
 	UBYTE byte = 0xff;
 
 #ifdef STEREO_SOUND
-	if (addr & 0x0010 && POKEYSND_stereo_enabled)
+	if (addr & 0x0030 & ((POKEY_NumChips() << 4) - 1))
 		return 0;
 #endif
 	addr &= 0x0f;
@@ -140,6 +154,8 @@ UBYTE POKEY_GetByte(UWORD addr, int no_side_effects)
 		break;
 	case POKEY_OFFSET_SERIN:
 		byte = POKEY_SERIN;
+		if (!no_side_effects)
+			serin_read = TRUE;
 #ifdef DEBUG3
 		printf("SERIO: SERIN read, bytevalue %02x\n", POKEY_SERIN);
 #endif
@@ -179,12 +195,51 @@ static int POKEY_siocheck(void)
 #define POKEYSND_Update(addr, val, chip, gain)
 #endif
 
+#ifdef STEREO_SOUND
+/* Writes BYTE to register OFFSET of POKEY CHIP other than the first one.
+   Only the sound registers exist on these chips. */
+static void PutSoundByte(int chip, UWORD offset, UBYTE byte)
+{
+	switch (offset) {
+	case POKEY_OFFSET_AUDC1:
+	case POKEY_OFFSET_AUDC2:
+	case POKEY_OFFSET_AUDC3:
+	case POKEY_OFFSET_AUDC4:
+		POKEY_AUDC[(offset >> 1) + chip * 4] = byte;
+		break;
+	case POKEY_OFFSET_AUDF1:
+	case POKEY_OFFSET_AUDF2:
+	case POKEY_OFFSET_AUDF3:
+	case POKEY_OFFSET_AUDF4:
+		POKEY_AUDF[(offset >> 1) + chip * 4] = byte;
+		break;
+	case POKEY_OFFSET_AUDCTL:
+		POKEY_AUDCTL[chip] = byte;
+		/* determine the base multiplier for the 'div by n' calculations */
+		if (byte & POKEY_CLOCK_15)
+			POKEY_Base_mult[chip] = POKEY_DIV_15;
+		else
+			POKEY_Base_mult[chip] = POKEY_DIV_64;
+		break;
+	case POKEY_OFFSET_STIMER:
+	case POKEY_OFFSET_SKCTL:
+		break;
+	default:
+		return;
+	}
+	POKEYSND_Update(offset, byte, (UBYTE)chip, SOUND_GAIN);
+}
+#endif /* STEREO_SOUND */
+
 void POKEY_PutByte(UWORD addr, UBYTE byte)
 {
 #ifdef STEREO_SOUND
-	addr &= POKEYSND_stereo_enabled ? 0x1f : 0x0f;
+	addr &= (POKEY_NumChips() << 4) - 1;
 #else
 	addr &= 0x0f;
+#endif
+#ifdef POKEYREC
+	POKEYREC_PutByte(addr, byte);
 #endif
 	switch (addr) {
 	case POKEY_OFFSET_AUDC1:
@@ -303,6 +358,7 @@ void POKEY_PutByte(UWORD addr, UBYTE byte)
 			/* POKEY reset. */
 			/* Stop serial IO. */
 			POKEY_DELAYED_SERIN_IRQ = 0;
+			POKEY_serin_early = FALSE;
 			POKEY_DELAYED_SEROUT_IRQ = 0;
 			POKEY_DELAYED_XMTDONE_IRQ = 0;
 			CASSETTE_ResetPOKEY();
@@ -310,53 +366,9 @@ void POKEY_PutByte(UWORD addr, UBYTE byte)
 		}
 		break;
 #ifdef STEREO_SOUND
-	case POKEY_OFFSET_AUDC1 + POKEY_OFFSET_POKEY2:
-		POKEY_AUDC[POKEY_CHAN1 + POKEY_CHIP2] = byte;
-		POKEYSND_Update(POKEY_OFFSET_AUDC1, byte, 1, SOUND_GAIN);
-		break;
-	case POKEY_OFFSET_AUDC2 + POKEY_OFFSET_POKEY2:
-		POKEY_AUDC[POKEY_CHAN2 + POKEY_CHIP2] = byte;
-		POKEYSND_Update(POKEY_OFFSET_AUDC2, byte, 1, SOUND_GAIN);
-		break;
-	case POKEY_OFFSET_AUDC3 + POKEY_OFFSET_POKEY2:
-		POKEY_AUDC[POKEY_CHAN3 + POKEY_CHIP2] = byte;
-		POKEYSND_Update(POKEY_OFFSET_AUDC3, byte, 1, SOUND_GAIN);
-		break;
-	case POKEY_OFFSET_AUDC4 + POKEY_OFFSET_POKEY2:
-		POKEY_AUDC[POKEY_CHAN4 + POKEY_CHIP2] = byte;
-		POKEYSND_Update(POKEY_OFFSET_AUDC4, byte, 1, SOUND_GAIN);
-		break;
-	case POKEY_OFFSET_AUDCTL + POKEY_OFFSET_POKEY2:
-		POKEY_AUDCTL[1] = byte;
-		/* determine the base multiplier for the 'div by n' calculations */
-		if (byte & POKEY_CLOCK_15)
-			POKEY_Base_mult[1] = POKEY_DIV_15;
-		else
-			POKEY_Base_mult[1] = POKEY_DIV_64;
-
-		POKEYSND_Update(POKEY_OFFSET_AUDCTL, byte, 1, SOUND_GAIN);
-		break;
-	case POKEY_OFFSET_AUDF1 + POKEY_OFFSET_POKEY2:
-		POKEY_AUDF[POKEY_CHAN1 + POKEY_CHIP2] = byte;
-		POKEYSND_Update(POKEY_OFFSET_AUDF1, byte, 1, SOUND_GAIN);
-		break;
-	case POKEY_OFFSET_AUDF2 + POKEY_OFFSET_POKEY2:
-		POKEY_AUDF[POKEY_CHAN2 + POKEY_CHIP2] = byte;
-		POKEYSND_Update(POKEY_OFFSET_AUDF2, byte, 1, SOUND_GAIN);
-		break;
-	case POKEY_OFFSET_AUDF3 + POKEY_OFFSET_POKEY2:
-		POKEY_AUDF[POKEY_CHAN3 + POKEY_CHIP2] = byte;
-		POKEYSND_Update(POKEY_OFFSET_AUDF3, byte, 1, SOUND_GAIN);
-		break;
-	case POKEY_OFFSET_AUDF4 + POKEY_OFFSET_POKEY2:
-		POKEY_AUDF[POKEY_CHAN4 + POKEY_CHIP2] = byte;
-		POKEYSND_Update(POKEY_OFFSET_AUDF4, byte, 1, SOUND_GAIN);
-		break;
-	case POKEY_OFFSET_STIMER + POKEY_OFFSET_POKEY2:
-		POKEYSND_Update(POKEY_OFFSET_STIMER, byte, 1, SOUND_GAIN);
-		break;
-	case POKEY_OFFSET_SKCTL + POKEY_OFFSET_POKEY2:
-		POKEYSND_Update(POKEY_OFFSET_SKCTL, byte, 1, SOUND_GAIN);
+	default:
+		/* Sound registers of the other POKEYs. */
+		PutSoundByte(addr >> 4, addr & 0x0f, byte);
 		break;
 #endif
 	}
@@ -371,6 +383,7 @@ int POKEY_Initialise(int *argc, char *argv[])
 	POKEY_DELAYED_SERIN_IRQ = 0;
 	POKEY_DELAYED_SEROUT_IRQ = 0;
 	POKEY_DELAYED_XMTDONE_IRQ = 0;
+	POKEY_serin_early = FALSE;
 
 	POKEY_KBCODE = 0xff;
 	POKEY_SERIN = 0x00;	/* or 0xff ? */
@@ -474,8 +487,15 @@ void POKEY_Scanline(void)
 
 	random_scanline_counter += ANTIC_LINE_C;
 
+	/* Deliver the next byte as soon as the previous one has been read
+	   and its interrupt acknowledged. */
+	if (POKEY_serin_early && POKEY_DELAYED_SERIN_IRQ > 1 && serin_read && (POKEY_IRQST & 0x20))
+		POKEY_DELAYED_SERIN_IRQ = 1;
+
 	if (POKEY_DELAYED_SERIN_IRQ > 0) {
 		if (--POKEY_DELAYED_SERIN_IRQ == 0) {
+			POKEY_serin_early = FALSE;
+			serin_read = FALSE;
 			/* Load a byte to SERIN - even when the IRQ is disabled. */
 			POKEY_SERIN = SIO_GetByte();
 			if (POKEY_IRQEN & 0x20) {
@@ -674,6 +694,7 @@ void POKEY_StateRead(void)
 	StateSav_ReadINT(&POKEY_DELAYED_SERIN_IRQ, 1);
 	StateSav_ReadINT(&POKEY_DELAYED_SEROUT_IRQ, 1);
 	StateSav_ReadINT(&POKEY_DELAYED_XMTDONE_IRQ, 1);
+	POKEY_serin_early = FALSE;
 
 	StateSav_ReadUBYTE(&POKEY_AUDF[0], 4);
 	StateSav_ReadUBYTE(&POKEY_AUDC[0], 4);
@@ -50,11 +50,18 @@ extern UBYTE POKEY_SKCTL;
 extern int POKEY_DELAYED_SERIN_IRQ;
 extern int POKEY_DELAYED_SEROUT_IRQ;
 extern int POKEY_DELAYED_XMTDONE_IRQ;
+/* If TRUE, the byte scheduled with POKEY_DELAYED_SERIN_IRQ is delivered as
+   soon as the CPU has read SERIN and acknowledged the SERIN interrupt.
+   Cleared whenever a byte is delivered. */
+extern int POKEY_serin_early;
 
 extern UBYTE POKEY_POT_input[8];
 
 ULONG POKEY_GetRandomCounter(void);
 void POKEY_SetRandomCounter(ULONG value);
+/* Number of POKEYs in the memory map, as configured with -stereo and -quad,
+   whether or not the sound output works. */
+int POKEY_NumChips(void);
 UBYTE POKEY_GetByte(UWORD addr, int no_side_effects);
 void POKEY_PutByte(UWORD addr, UBYTE byte);
 int POKEY_Initialise(int *argc, char *argv[]);
@@ -95,7 +102,7 @@ void POKEY_StateRead(void);
 #define POKEY_POLY9_SIZE  0x01ff
 #define POKEY_POLY17_SIZE 0x0001ffff
 
-#define POKEY_MAXPOKEYS         2		/* max number of emulated chips */
+#define POKEY_MAXPOKEYS         4		/* max number of emulated chips */
 
 /* channel/chip definitions */
 #define POKEY_CHAN1       0
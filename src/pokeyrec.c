@@ -25,18 +25,68 @@
 #include "config.h"
 #include "pokeyrec.h"
 #include "pokey.h"
+#include "pokeysnd.h"
+#include "antic.h"
 #include "log.h"
 #include "util.h"
 #include <string.h>
 #include <stdio.h>
 
 static int enabled, counter, interval;
-static char *filename = "pokeyrec.dat", *fmt = "%c";
+static char *filename = NULL, *fmt = "%c";
 static FILE *fp;
 #ifdef STEREO_SOUND
 static int stereo;
 #endif
 
+/* Register stream mode, see pokeyrec.h */
+static int stream, stream_started;
+static unsigned int stream_last_clock;
+
+static void put_le16(unsigned int x) {
+    fputc(x & 0xff, fp);
+    fputc((x >> 8) & 0xff, fp);
+}
+
+static void put_le32(ULONG x) {
+    put_le16(x & 0xffff);
+    put_le16((x >> 16) & 0xffff);
+}
+
+static int stream_pokeys(void) {
+#ifdef STEREO_SOUND
+    if (stereo) return POKEYSND_num_chips > 2 ? POKEYSND_num_chips : 2;
+#endif
+    return 1;
+}
+
+static void write_stream_header(void) {
+    int num_pokeys = stream_pokeys();
+    fwrite(POKEYREC_STREAM_MAGIC, 1, 4, fp);
+    fputc(num_pokeys, fp);
+    fputc(0, fp);
+    put_le16(Atari800_tv_mode);
+    put_le32(POKEYSND_FREQ_17_EXACT);
+}
+
+static void write_stream_event(UBYTE reg, UBYTE value) {
+    unsigned int clock = ANTIC_CPU_CLOCK;
+    unsigned int delta = 0;
+
+    if (stream_started)
+        delta = clock - stream_last_clock;
+    stream_started = 1;
+    stream_last_clock = clock;
+
+    while (delta >= 0x80) {
+        fputc((delta & 0x7f) | 0x80, fp);
+        delta >>= 7;
+    }
+    fputc(delta, fp);
+    fputc(reg, fp);
+    fputc(value, fp);
+}
+
 static void output_pokey_values(int pokeynr) {
     int i;
     for (i=0; i<4; i++) {
@@ -49,6 +99,15 @@ static void output_pokey_values(int pokeynr) {
 void POKEYREC_Recorder(void) {
     if (!enabled) return;
 
+    if (stream) {
+        /* Just start the clock so that the initial silence is kept. */
+        if (!stream_started) {
+            stream_started = 1;
+            stream_last_clock = ANTIC_CPU_CLOCK;
+        }
+        return;
+    }
+
     if (++counter == interval) {
         counter = 0;
         output_pokey_values(0);
@@ -60,6 +119,17 @@ void POKEYREC_Recorder(void) {
     }
 }
 
+/* ADDR is the register address already masked by POKEY_PutByte. */
+void POKEYREC_PutByte(UWORD addr, UBYTE byte) {
+    UBYTE offset = addr & 0x0f;
+
+    if (!enabled || !stream) return;
+    if ((addr >> 4) >= stream_pokeys()) return;
+    /* Only registers that affect sound generation. */
+    if (offset <= POKEY_OFFSET_STIMER || offset == POKEY_OFFSET_SKCTL)
+        write_stream_event(addr & 0x3f, byte);
+}
+
 int POKEYREC_Initialise(int *argc, char *argv[]) {
     int i, j;
 
@@ -79,6 +149,8 @@ int POKEYREC_Initialise(int *argc, char *argv[]) {
             }
         } else if (!strcmp(argv[i], "-pokeyrec-ascii")) {
             fmt = "%02x";
+        } else if (!strcmp(argv[i], "-pokeyrec-stream")) {
+            stream = 1;
         } else if (!strcmp(argv[i], "-pokeyrec-file")) {
             if (!available) goto missing_argument;
             filename = Util_strdup(argv[++i]);
@@ -95,12 +167,15 @@ int POKEYREC_Initialise(int *argc, char *argv[]) {
                                                                     interval);
                 Log_print("\t-pokeyrec-ascii            "
                                 "Store ascii values (default: raw)");
+                Log_print("\t-pokeyrec-stream           "
+                                "Record timestamped register writes instead "
+                                                "(default file: pokeyrec.pks)");
                 Log_print("\t-pokeyrec-file <filename>  "
                                 "Specify output filename "
                                                     "(default: pokeyrec.dat)");
 #ifdef STEREO_SOUND
                 Log_print("\t-pokeyrec-stereo           "
-                                "Record second Pokey, too "
+                                "Record the other Pokeys, too "
                                                     "(default: mono)");
 #endif
             }
@@ -111,10 +186,14 @@ int POKEYREC_Initialise(int *argc, char *argv[]) {
     *argc = j;
 
     if (enabled) {
+        if (filename == NULL)
+            filename = stream ? "pokeyrec.pks" : "pokeyrec.dat";
         if (!(fp = fopen(filename, "wb"))) {
             Log_print("Unable to open '%s' for writing", filename);
             return FALSE;
         }
+        if (stream)
+            write_stream_header();
     }
 
     return TRUE;
@@ -125,5 +204,10 @@ missing_argument:
 }
 
 void POKEYREC_Exit(void) {
-    if (fp) fclose(fp);
+    if (fp) {
+        if (stream)
+            write_stream_event(POKEYREC_STREAM_END, 0);
+        fclose(fp);
+        fp = NULL;
+    }
 }
@@ -1,8 +1,34 @@
 #ifndef POKEYREC_H_
 #define POKEYREC_H_
 
+#include "atari.h"
+
 void POKEYREC_Recorder(void);
+void POKEYREC_PutByte(UWORD addr, UBYTE byte);
 int  POKEYREC_Initialise(int *argc, char *argv[]);
 void POKEYREC_Exit(void);
 
+/* POKEY register stream format, written with -pokeyrec-stream.
+   All multi-byte values are little-endian.
+
+   Header (12 bytes):
+     4 bytes  POKEYREC_STREAM_MAGIC
+     1 byte   number of POKEYs (1, 2 or 4)
+     1 byte   reserved, 0
+     2 bytes  scanlines per frame (262 NTSC, 312 PAL)
+     4 bytes  POKEY main clock in Hz
+
+   Events, until POKEYREC_STREAM_END:
+     varint   CPU cycles since the previous event; 7 bits per byte, least
+              significant first, bit 7 set on all bytes but the last
+     1 byte   register: bits 0-3 = offset from POKEY base, bits 4-5 =
+              POKEY number (0-3)
+     1 byte   value written
+
+   The final event has register POKEYREC_STREAM_END and value 0; its delta
+   gives the length of the trailing part of the recording. */
+#define POKEYREC_STREAM_MAGIC "PKS1"
+#define POKEYREC_STREAM_HEADER_SIZE 12
+#define POKEYREC_STREAM_END 0xff
+
 #endif
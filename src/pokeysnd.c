@@ -33,6 +33,9 @@
 #ifdef AUDIO_RECORDING
 #include "file_export.h"
 #endif
+#ifdef SHMEXPORT
+#include "shmexport.h"
+#endif
 #ifdef __PLUS
 #include "sound_win.h"
 #endif
@@ -136,6 +139,7 @@ static UWORD last_val2 = 0;
 static ULONG snd_freq17 = POKEYSND_FREQ_17_EXACT;
 int POKEYSND_playback_freq = 44100;
 UBYTE POKEYSND_num_pokeys = 1;
+int POKEYSND_num_chips = 1;
 int POKEYSND_snd_flags = 0;
 static int mz_quality = 0;		/* default quality for mzpokeysnd */
 #ifdef __PLUS
@@ -151,6 +155,7 @@ int POKEYSND_bienias_fix = TRUE;  /* when TRUE, high frequencies get emulated: b
 #endif
 #ifndef ASAP
 int POKEYSND_stereo_enabled = FALSE;
+int POKEYSND_quad_enabled = FALSE;
 #endif
 
 int POKEYSND_volume = 0x100;
@@ -158,6 +163,7 @@ int POKEYSND_volume = 0x100;
 /* multiple sound engine interface */
 static void pokeysnd_process_8(void *sndbuffer, int sndn);
 static void pokeysnd_process_16(void *sndbuffer, int sndn);
+static void pokeysnd_process_float(void *sndbuffer, int sndn);
 static void null_pokey_process(void *sndbuffer, int sndn) {}
 void (*POKEYSND_Process_ptr)(void *sndbuffer, int sndn) = null_pokey_process;
 
@@ -224,7 +230,9 @@ static int const CONSOLE_VOL = 32;
 /*                                                                           */
 /* Inputs:  freq17 - the value for the '1.79MHz' Pokey audio clock           */
 /*          playback_freq - the playback frequency in samples per second     */
-/*          num_pokeys - specifies the number of pokey chips to be emulated  */
+/*          num_pokeys - specifies the number of output channels, equal to   */
+/*                       the number of pokey chips to be emulated unless     */
+/*                       POKEYSND_quad_enabled is set                        */
 /*                                                                           */
 /* Outputs: Adjusts local globals - no return value                          */
 /*                                                                           */
@@ -239,6 +247,14 @@ int POKEYSND_DoInit(void)
 	File_Export_StopRecording();
 #endif
 
+	/* Only the MZ engine mixes the chips, see mzpokeysnd.c. It emulates all
+	   the chips in the memory map even if the output has fewer channels. */
+	POKEYSND_num_chips = POKEYSND_num_pokeys;
+#if defined(STEREO_SOUND) && !defined(ASAP)
+	if (POKEYSND_enable_new_pokey && POKEY_NumChips() > POKEYSND_num_chips)
+		POKEYSND_num_chips = POKEY_NumChips();
+#endif
+
 	if (POKEYSND_enable_new_pokey)
 		return MZPOKEYSND_Init(snd_freq17, POKEYSND_playback_freq,
 				POKEYSND_num_pokeys, POKEYSND_snd_flags, mz_quality
@@ -273,7 +289,7 @@ int POKEYSND_Init(ULONG freq17, int playback_freq, UBYTE num_pokeys,
 		unsigned int ticks_per_frame = Atari800_tv_mode*114;
 		unsigned int max_ticks_per_frame = ticks_per_frame + surplus_ticks;
 		double ticks_per_sample = (double)ticks_per_frame / samples_per_frame;
-		POKEYSND_process_buffer_length = POKEYSND_num_pokeys * (unsigned int)ceil((double)max_ticks_per_frame / ticks_per_sample) * ((POKEYSND_snd_flags & POKEYSND_BIT16) ? 2:1);
+		POKEYSND_process_buffer_length = POKEYSND_num_pokeys * (unsigned int)ceil((double)max_ticks_per_frame / ticks_per_sample) * POKEYSND_SAMPLE_SIZE(POKEYSND_snd_flags);
 		free(POKEYSND_process_buffer);
 		POKEYSND_process_buffer = (UBYTE *)Util_malloc(POKEYSND_process_buffer_length);
 		POKEYSND_process_buffer_fill = 0;
@@ -281,7 +297,7 @@ int POKEYSND_Init(ULONG freq17, int playback_freq, UBYTE num_pokeys,
 	}
 
 #if defined(PBI_XLD) || defined (VOICEBOX)
-	VOTRAXSND_Init(playback_freq, num_pokeys, (flags & POKEYSND_BIT16));
+	VOTRAXSND_Init(playback_freq, num_pokeys, flags);
 #endif
 	return POKEYSND_DoInit();
 }
@@ -312,7 +328,7 @@ int POKEYSND_UpdateProcessBuffer(void)
 {
 	int sndn;
 	Update_synchronized_sound();
-	sndn = POKEYSND_process_buffer_fill / ((POKEYSND_snd_flags & POKEYSND_BIT16) ? 2 : 1);
+	sndn = POKEYSND_process_buffer_fill / POKEYSND_SAMPLE_SIZE(POKEYSND_snd_flags);
 	POKEYSND_process_buffer_fill = 0;
 
 #if defined(PBI_XLD) || defined (VOICEBOX)
@@ -320,6 +336,9 @@ int POKEYSND_UpdateProcessBuffer(void)
 #endif
 #if defined(AUDIO_RECORDING)
 	File_Export_WriteAudio((const unsigned char *)POKEYSND_process_buffer, sndn);
+#endif
+#ifdef SHMEXPORT
+	SHMEXPORT_WriteAudio(POKEYSND_process_buffer, sndn);
 #endif
 	return sndn;
 }
@@ -339,12 +358,18 @@ static int pokeysnd_init_rf(ULONG freq17, int playback_freq,
 {
 	UBYTE chan;
 
+	if (num_pokeys > 2)
+		return 1; /* stereo at most */
+
 	POKEYSND_Update_ptr = Update_pokey_sound_rf;
 #ifdef CONSOLE_SOUND
 	POKEYSND_UpdateConsol_ptr = Update_consol_sound_rf;
 #endif
 
-	POKEYSND_Process_ptr = (flags & POKEYSND_BIT16) ? pokeysnd_process_16 : pokeysnd_process_8;
+	if (flags & POKEYSND_FLOAT32)
+		POKEYSND_Process_ptr = pokeysnd_process_float;
+	else
+		POKEYSND_Process_ptr = (flags & POKEYSND_BIT16) ? pokeysnd_process_16 : pokeysnd_process_8;
 
 	/* start all of the polynomial counters at zero */
 	P4 = 0;
@@ -1056,6 +1081,24 @@ static void pokeysnd_process_16(void *sndbuffer, int sndn)
 	}
 }
 
+static void pokeysnd_process_float(void *sndbuffer, int sndn)
+{
+	float *buffer = (float *) sndbuffer;
+	/* Same scale as pokeysnd_process_16, without clipping. */
+	float const scale = POKEYSND_volume / 32768.0f;
+	int i;
+
+	pokeysnd_process_8(buffer, sndn);
+
+	for (i = sndn - 1; i >= 0; i--) {
+#ifndef POKEYSND_SIGNED_SAMPLES
+		buffer[i] = ((int) (((UBYTE *) buffer)[i]) - 0x80) * scale;
+#else
+		buffer[i] = ((int) ((SBYTE *) buffer)[i]) * scale;
+#endif
+	}
+}
+
 static void Generate_sync_rf(unsigned int num_ticks)
 {
 	double new_samp_pos;
@@ -1078,7 +1121,11 @@ static void Generate_sync_rf(unsigned int num_ticks)
 		samp_pos = new_samp_pos;
 		num_ticks -= ticks;
 
-		if (POKEYSND_snd_flags & POKEYSND_BIT16) {
+		if (POKEYSND_snd_flags & POKEYSND_FLOAT32) {
+			pokeysnd_process_float(buffer, POKEYSND_num_pokeys);
+			buffer += 4 * POKEYSND_num_pokeys;
+		}
+		else if (POKEYSND_snd_flags & POKEYSND_BIT16) {
 			pokeysnd_process_16(buffer, POKEYSND_num_pokeys);
 			buffer += 2 * POKEYSND_num_pokeys;
 		}
@@ -78,14 +78,26 @@ extern "C" {
 
 /* init flags */
 #define POKEYSND_BIT16	1
+/* 32-bit float samples in range -1.0..1.0, system-endian. */
+#define POKEYSND_FLOAT32	2
+
+/* Size in bytes of a single sample in the format selected by init FLAGS. */
+#define POKEYSND_SAMPLE_SIZE(flags) (((flags) & POKEYSND_FLOAT32) ? 4 : ((flags) & POKEYSND_BIT16) ? 2 : 1)
 
 extern SLONG POKEYSND_playback_freq;
+/* Number of output channels, normally one per emulated POKEY. */
 extern UBYTE POKEYSND_num_pokeys;
+/* Number of emulated POKEY chips, set by POKEYSND_Init. Differs from
+   POKEYSND_num_pokeys when the chips are mixed to fewer channels. */
+extern int POKEYSND_num_chips;
 extern int POKEYSND_snd_flags;
 extern int POKEYSND_volume;
 
 extern int POKEYSND_enable_new_pokey;
 extern int POKEYSND_stereo_enabled;
+/* Emulate four POKEYs at D200, D210, D220 and D230, mixed to the output
+   channels. Requires the MZ engine. */
+extern int POKEYSND_quad_enabled;
 extern int POKEYSND_console_sound_enabled;
 extern int POKEYSND_bienias_fix;
 
@@ -103,7 +115,8 @@ void POKEYSND_Update(UWORD addr, UBYTE val, UBYTE /*chip*/, UBYTE gain);
 void POKEYSND_UpdateConsol(int set);
 
 /* Fill sndbuffer with sndn samples of audio. Number of bytes written to
-   sndbuffer is sndn with 8-bit sound, and 2*sndn with 16-bit sound. sndn
+   sndbuffer is sndn * POKEYSND_SAMPLE_SIZE(POKEYSND_snd_flags), ie. sndn with
+   8-bit sound, 2*sndn with 16-bit sound and 4*sndn with float sound. sndn
    must be a multiple of POKEYSND_num_pokeys. */
 void POKEYSND_Process(void *sndbuffer, int sndn);
 int POKEYSND_DoInit(void);
@@ -79,6 +79,12 @@ int Screen_show_1200_leds = TRUE;
 static char screenshot_filename_format[FILENAME_MAX];
 static int screenshot_no_last = -1;
 static int screenshot_no_max = 0;
+
+/* Burst of screenshots: one every burst_interval frames, during burst_frames
+   frames (or until exit if 0). */
+static int burst_interval = 0;
+static int burst_frames = 0;
+static int burst_counter = 0;
 #endif /* !SCREENSHOTS */
 
 #if defined(AUDIO_RECORDING) || defined(VIDEO_RECORDING)
@@ -104,6 +110,26 @@ int Screen_Initialise(int *argc, char *argv[])
 				screenshot_no_max = Util_filenamepattern(argv[++i], screenshot_filename_format, FILENAME_MAX, DEFAULT_SCREENSHOT_FILENAME_FORMAT);
 			else a_m = TRUE;
 		}
+		else if (strcmp(argv[i], "-screenshot-burst") == 0) {
+			if (i_a) {
+				burst_interval = Util_sscandec(argv[++i]);
+				if (burst_interval < 0) {
+					Log_print("Invalid screenshot burst interval");
+					return FALSE;
+				}
+			}
+			else a_m = TRUE;
+		}
+		else if (strcmp(argv[i], "-screenshot-burst-frames") == 0) {
+			if (i_a) {
+				burst_frames = Util_sscandec(argv[++i]);
+				if (burst_frames < 0) {
+					Log_print("Invalid screenshot burst duration");
+					return FALSE;
+				}
+			}
+			else a_m = TRUE;
+		}
 #endif
 #if defined(AUDIO_RECORDING) || defined(VIDEO_RECORDING)
 		else if (strcmp(argv[i], "-showstats") == 0) {
@@ -121,6 +147,10 @@ int Screen_Initialise(int *argc, char *argv[])
 				help_only = TRUE;
 #ifdef SCREENSHOTS
 				Log_print("\t-screenshots <p> Set filename pattern for screenshots");
+				Log_print("\t-screenshot-burst <n>");
+				Log_print("\t                 Save a screenshot every n-th frame");
+				Log_print("\t-screenshot-burst-frames <n>");
+				Log_print("\t                 Stop the screenshot burst after n frames");
 #endif
 #if defined(AUDIO_RECORDING) || defined(VIDEO_RECORDING)
 				Log_print("\t-showstats       Show recording stats of video or audio");
@@ -789,10 +819,26 @@ void Screen_DrawMultimediaStats(void)
 		int size_char;
 		int decimal_digits;
 		char *media_description;
+		char queue_stats[64];
 		UBYTE *screen;
 
 		if (File_Export_GetRecordingStats(&elapsed_time, &size, &media_description)) {
-			num = 10 + strlen(media_description) + 2 + 7 + 2 + 6;
+#ifdef HAVE_PTHREAD
+			int queued;
+			int slots;
+			int dropped;
+			if (File_Export_GetQueueStats(&queued, &slots, &dropped)) {
+				/* Frames waiting for the encoder, and frames dropped because
+				   the queue was full */
+				if (dropped > 0)
+					sprintf(queue_stats, "  Q %d OF %d  DROP %d", queued, slots, dropped);
+				else
+					sprintf(queue_stats, "  Q %d OF %d", queued, slots);
+			}
+			else
+#endif
+				queue_stats[0] = '\0';
+			num = 10 + strlen(media_description) + 2 + 7 + 2 + 6 + strlen(queue_stats);
 			screen = (UBYTE *) Screen_atari + Screen_visible_x1 + (Screen_visible_x2 - Screen_visible_x1) / 2 - (num * SMALLFONT_WIDTH) / 2 + (Screen_visible_y2 - SMALLFONT_HEIGHT) * Screen_WIDTH;
 
 			screen = SmallFont_DrawString(screen, "RECORDING ", 0x0f, 0x34);
@@ -845,13 +891,16 @@ void Screen_DrawMultimediaStats(void)
 			SmallFont_DrawChar(screen, size_char, 0x0f, 0x34);
 			screen += SMALLFONT_WIDTH;
 			SmallFont_DrawChar(screen, SMALLFONT_B, 0x0f, 0x34);
+			SmallFont_DrawString(screen + SMALLFONT_WIDTH, queue_stats, 0x0f, 0x34);
 		}
 	}
 }
 #endif /* defined(AUDIO_RECORDING) || defined(VIDEO_RECORDING) */
 
 #ifdef SCREENSHOTS
-int Screen_SaveScreenshot(const char *filename, int interlaced)
+/* Saves the screen to FILENAME. If QUEUE, the file is written later by
+   a worker thread. */
+static int SaveScreenshot(const char *filename, int interlaced, int queue)
 {
 	int result;
 	ULONG *main_screen_atari;
@@ -872,7 +921,10 @@ int Screen_SaveScreenshot(const char *filename, int interlaced)
 	else {
 		ptr2 = NULL;
 	}
-	result = File_Export_SaveScreen(filename, ptr1, ptr2);
+	if (queue)
+		result = File_Export_QueueScreen(filename, ptr1, ptr2);
+	else
+		result = File_Export_SaveScreen(filename, ptr1, ptr2);
 	if (!result) {
 		Log_print("Failed saving to file: %s", filename);
 	}
@@ -883,6 +935,11 @@ int Screen_SaveScreenshot(const char *filename, int interlaced)
 	return result;
 }
 
+int Screen_SaveScreenshot(const char *filename, int interlaced)
+{
+	return SaveScreenshot(filename, interlaced, FALSE);
+}
+
 void Screen_SaveNextScreenshot(int interlaced)
 {
 	char filename[FILENAME_MAX];
@@ -890,7 +947,26 @@ void Screen_SaveNextScreenshot(int interlaced)
 		screenshot_no_max = Util_filenamepattern(DEFAULT_SCREENSHOT_FILENAME_FORMAT, screenshot_filename_format, FILENAME_MAX, NULL);
 	}
 	Util_findnextfilename(screenshot_filename_format, &screenshot_no_last, screenshot_no_max, filename, sizeof(filename), TRUE);
-	Screen_SaveScreenshot(filename, interlaced);
+	SaveScreenshot(filename, interlaced, TRUE);
+}
+
+void Screen_StartScreenshotBurst(int interval, int frames)
+{
+	burst_interval = interval;
+	burst_frames = frames;
+	burst_counter = 0;
+}
+
+void Screen_ScreenshotBurstFrame(void)
+{
+	if (burst_interval <= 0)
+		return;
+	if (burst_counter == 0)
+		Screen_SaveNextScreenshot(FALSE);
+	if (++burst_counter >= burst_interval)
+		burst_counter = 0;
+	if (burst_frames > 0 && --burst_frames == 0)
+		burst_interval = 0;
 }
 #endif /* !SCREENSHOTS */
 
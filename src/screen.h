@@ -54,7 +54,14 @@ void Screen_Draw1200LED(void);
 void Screen_DrawMultimediaStats(void);
 void Screen_FindScreenshotFilename(char *buffer, unsigned bufsize);
 int Screen_SaveScreenshot(const char *filename, int interlaced);
+/* Saves the screen to the next file matching the screenshot filename
+   pattern. The file is written in the background. */
 void Screen_SaveNextScreenshot(int interlaced);
+/* Starts saving a screenshot every INTERVAL-th frame (0 stops it), during
+   FRAMES frames, or until exit if 0. */
+void Screen_StartScreenshotBurst(int interval, int frames);
+/* Takes the screenshot of a burst, if due. Called after each frame. */
+void Screen_ScreenshotBurstFrame(void);
 void Screen_EntireDirty(void);
 
 #endif /* SCREEN_H_ */
@@ -46,6 +46,15 @@ int PLATFORM_SoundSetup(Sound_setup_t *setup)
 	}
 
 	desired.freq = setup->freq;
+#ifdef AUDIO_F32SYS
+	if (setup->sample_size == 4)
+		desired.format = AUDIO_F32SYS;
+	else
+#else
+	/* Float samples not supported by this SDL version. */
+	if (setup->sample_size == 4)
+		setup->sample_size = 2;
+#endif
 	desired.format = setup->sample_size == 2 ? AUDIO_S16SYS : AUDIO_U8;
 	desired.channels = setup->channels;
 
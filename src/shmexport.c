@@ -0,0 +1,255 @@
+/*
+ * shmexport.c - publishing of the emulated frames in shared memory
+ *
+ * Copyright (C) 2026 Atari800 development team (see DOC/CREDITS)
+ *
+ * This file is part of the Atari800 emulator project which emulates
+ * the Atari 400, 800, 800XL, 130XE, and 5200 8-bit computers.
+ *
+ * Atari800 is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Atari800 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Atari800; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#define _POSIX_C_SOURCE 200112L /* for shm_open, ftruncate */
+
+#include "config.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "atari.h"
+#include "colours.h"
+#include "log.h"
+#include "screen.h"
+#include "shmexport.h"
+#include "util.h"
+#ifdef SOUND
+#include "pokeysnd.h"
+#endif
+
+/* Room for the audio of a frame: 96 kHz, 2 channels, 16 bits, 50 frames
+   per second, twice. */
+#define AUDIO_SIZE 16384
+#define MAX_SLOTS 64
+
+static char name[FILENAME_MAX];
+static int num_slots = 4;
+static UBYTE *base = NULL;
+static size_t base_size;
+static SHMEXPORT_header_t *header;
+/* Number of the frame being emulated */
+static ULONG frames;
+/* The slot of FRAMES is being written */
+static int slot_open;
+
+static SHMEXPORT_slot_t *Slot(ULONG n)
+{
+	return (SHMEXPORT_slot_t *) (base + header->header_size + (n % header->num_slots) * header->slot_size);
+}
+
+/* Marks the slot of the current frame as being written, so that readers
+   of the frame it held before notice the change. */
+static SHMEXPORT_slot_t *OpenSlot(void)
+{
+	SHMEXPORT_slot_t *slot = Slot(frames);
+	if (!slot_open) {
+		SHMEXPORT_STORE(slot->seq, 2 * frames + 1);
+		/* No write to the slot may become visible before the new SEQ. */
+		atomic_thread_fence(memory_order_release);
+		slot->audio_length = 0;
+		slot->audio_dropped = 0;
+		slot_open = TRUE;
+	}
+	return slot;
+}
+
+static int Open(void)
+{
+	int fd;
+	ULONG slot_size;
+	ULONG i;
+
+	slot_size = sizeof(SHMEXPORT_slot_t) + Screen_WIDTH * Screen_HEIGHT + AUDIO_SIZE;
+	slot_size = (slot_size + 63) & ~63;
+	base_size = sizeof(SHMEXPORT_header_t) + (size_t) num_slots * slot_size;
+
+	fd = shm_open(name, O_RDWR | O_CREAT, 0600);
+	if (fd < 0) {
+		Log_print("Cannot create shared memory object %s: %s", name, strerror(errno));
+		return FALSE;
+	}
+	if (ftruncate(fd, (off_t) base_size) != 0) {
+		Log_print("Cannot resize shared memory object %s: %s", name, strerror(errno));
+		close(fd);
+		shm_unlink(name);
+		return FALSE;
+	}
+	base = (UBYTE *) mmap(NULL, base_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	/* The mapping stays valid after closing the descriptor. */
+	close(fd);
+	if (base == (UBYTE *) MAP_FAILED) {
+		Log_print("Cannot map shared memory object %s: %s", name, strerror(errno));
+		base = NULL;
+		shm_unlink(name);
+		return FALSE;
+	}
+
+	header = (SHMEXPORT_header_t *) base;
+	/* An object left by a crashed emulator is reused: invalidate it before
+	   changing its layout. */
+	SHMEXPORT_STORE(header->frames, 0);
+	atomic_thread_fence(memory_order_release);
+	memcpy(header->magic, SHMEXPORT_MAGIC, 4);
+	header->version = SHMEXPORT_VERSION;
+	header->header_size = sizeof(SHMEXPORT_header_t);
+	header->slot_size = slot_size;
+	header->num_slots = num_slots;
+	header->width = Screen_WIDTH;
+	header->height = Screen_HEIGHT;
+	header->visible_x1 = Screen_visible_x1;
+	header->visible_y1 = Screen_visible_y1;
+	header->visible_x2 = Screen_visible_x2;
+	header->visible_y2 = Screen_visible_y2;
+	header->audio_size = AUDIO_SIZE;
+	header->reserved[0] = header->reserved[1] = 0;
+	for (i = 0; i < header->num_slots; i++)
+		SHMEXPORT_STORE(Slot(i)->seq, 0);
+	SHMEXPORT_STORE(header->running, 1);
+	frames = 0;
+	slot_open = FALSE;
+	return TRUE;
+}
+
+int SHMEXPORT_Initialise(int *argc, char *argv[])
+{
+	int i;
+	int j;
+
+	for (i = j = 1; i < *argc; i++) {
+		int i_a = (i + 1 < *argc);		/* is argument available? */
+		int a_m = FALSE;			/* error, argument missing! */
+
+		if (strcmp(argv[i], "-shm-export") == 0) {
+			if (i_a) {
+				const char *arg = argv[++i];
+				/* Portable names of shared memory objects start with a slash. */
+				if (arg[0] == '/')
+					Util_strlcpy(name, arg, sizeof(name));
+				else {
+					name[0] = '/';
+					Util_strlcpy(name + 1, arg, sizeof(name) - 1);
+				}
+			}
+			else a_m = TRUE;
+		}
+		else if (strcmp(argv[i], "-shm-export-slots") == 0) {
+			if (i_a) {
+				num_slots = Util_sscandec(argv[++i]);
+				if (num_slots < 2 || num_slots > MAX_SLOTS) {
+					Log_print("Invalid number of shared memory slots, must be 2 to %d", MAX_SLOTS);
+					return FALSE;
+				}
+			}
+			else a_m = TRUE;
+		}
+		else {
+			if (strcmp(argv[i], "-help") == 0) {
+				Log_print("\t-shm-export <name>");
+				Log_print("\t                 Publish the frames and audio in shared memory object <name>");
+				Log_print("\t-shm-export-slots <n>");
+				Log_print("\t                 Keep the last n frames in shared memory (default 4)");
+			}
+			argv[j++] = argv[i];
+		}
+
+		if (a_m) {
+			Log_print("Missing argument for '%s'", argv[i]);
+			return FALSE;
+		}
+	}
+	*argc = j;
+
+	if (name[0] != '\0')
+		return Open();
+	return TRUE;
+}
+
+void SHMEXPORT_Exit(void)
+{
+	if (base == NULL)
+		return;
+	SHMEXPORT_STORE(header->running, 0);
+	munmap(base, base_size);
+	base = NULL;
+	/* Readers keep their mappings. */
+	shm_unlink(name);
+}
+
+void SHMEXPORT_WriteAudio(const UBYTE *samples, int num_samples)
+{
+#ifdef SOUND
+	SHMEXPORT_slot_t *slot;
+	ULONG length;
+	ULONG room;
+
+	if (base == NULL || num_samples <= 0)
+		return;
+	slot = OpenSlot();
+	length = num_samples * POKEYSND_SAMPLE_SIZE(POKEYSND_snd_flags);
+	room = AUDIO_SIZE - slot->audio_length;
+	if (length > room) {
+		slot->audio_dropped += length - room;
+		length = room;
+	}
+	memcpy((UBYTE *) (slot + 1) + Screen_WIDTH * Screen_HEIGHT + slot->audio_length, samples, length);
+	slot->audio_length += length;
+#endif /* SOUND */
+}
+
+void SHMEXPORT_Frame(void)
+{
+	SHMEXPORT_slot_t *slot;
+	UBYTE *palette;
+	int i;
+
+	if (base == NULL)
+		return;
+	slot = OpenSlot();
+	slot->frame = Atari800_nframes;
+#ifdef SOUND
+	slot->sample_rate = POKEYSND_playback_freq;
+	slot->channels = POKEYSND_num_pokeys;
+	slot->sample_size = POKEYSND_SAMPLE_SIZE(POKEYSND_snd_flags);
+#else
+	slot->sample_rate = slot->channels = slot->sample_size = 0;
+#endif
+	slot->reserved = 0;
+	palette = slot->palette;
+	for (i = 0; i < 256; i++) {
+		*palette++ = Colours_GetR(i);
+		*palette++ = Colours_GetG(i);
+		*palette++ = Colours_GetB(i);
+	}
+	memcpy(slot + 1, Screen_atari, Screen_WIDTH * Screen_HEIGHT);
+
+	/* Publish the frame. */
+	SHMEXPORT_STORE(slot->seq, 2 * frames + 2);
+	SHMEXPORT_STORE(header->frames, frames + 1);
+	frames++;
+	slot_open = FALSE;
+}
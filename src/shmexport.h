@@ -0,0 +1,73 @@
+#ifndef SHMEXPORT_H_
+#define SHMEXPORT_H_
+
+#include "atari.h"
+
+/* Publishing of the emulated frames to other processes, with -shm-export.
+   Each completed frame, with its palette and the audio generated during it,
+   is copied into a ring of slots in a POSIX shared memory object. Readers map
+   the object read-only and read the frames in place; see tools/shmreader.h. */
+
+int SHMEXPORT_Initialise(int *argc, char *argv[]);
+void SHMEXPORT_Exit(void);
+/* Adds NUM_SAMPLES samples, as produced by POKEYSND_Process, to the frame
+   being emulated. */
+void SHMEXPORT_WriteAudio(const UBYTE *samples, int num_samples);
+/* Publishes the frame in Screen_atari with the audio added since the
+   previous call. */
+void SHMEXPORT_Frame(void);
+
+/* Layout of the shared memory object. All values are in the native byte
+   order of the machine.
+
+   The header is followed by NUM_SLOTS slots of SLOT_SIZE bytes. Frame N
+   (counting from 0) is stored in slot N % NUM_SLOTS: a SHMEXPORT_slot_t,
+   followed by WIDTH * HEIGHT pixels (Atari colour indexes into PALETTE),
+   followed by AUDIO_SIZE bytes for the audio samples.
+
+   FRAMES is the number of published frames. The SEQ of a slot is 2 * N + 1
+   while frame N is written into it, and 2 * N + 2 when it is complete. A
+   reader that finds the expected SEQ before reading the slot, and still
+   finds it afterwards, has read the whole frame N. FRAMES and SEQ must be
+   read with SHMEXPORT_LOAD(). */
+#define SHMEXPORT_MAGIC "A8FR"
+#define SHMEXPORT_VERSION 1
+
+typedef struct {
+	char magic[4];
+	ULONG version;
+	ULONG header_size; /* Offset of the first slot */
+	ULONG slot_size;
+	ULONG num_slots;
+	ULONG width;
+	ULONG height;
+	/* Visible area: x1 <= x < x2, y1 <= y < y2 */
+	ULONG visible_x1;
+	ULONG visible_y1;
+	ULONG visible_x2;
+	ULONG visible_y2;
+	ULONG audio_size;
+	ULONG frames;
+	ULONG running; /* 0 after the emulator exits */
+	ULONG reserved[2];
+} SHMEXPORT_header_t;
+
+typedef struct {
+	ULONG seq;
+	ULONG frame; /* Atari800_nframes */
+	/* Format of the audio samples, see POKEYSND_snd_flags: 1 - unsigned
+	   8-bit, 2 - signed 16-bit, 4 - float. Channels are interleaved. */
+	ULONG sample_rate;
+	ULONG channels;
+	ULONG sample_size;
+	ULONG audio_length; /* In bytes */
+	ULONG audio_dropped; /* Bytes of audio that didn't fit in AUDIO_SIZE */
+	ULONG reserved;
+	UBYTE palette[256 * 3]; /* R, G, B of each colour */
+} SHMEXPORT_slot_t;
+
+#include <stdatomic.h>
+#define SHMEXPORT_LOAD(var) atomic_load_explicit((atomic_uint *)&(var), memory_order_acquire)
+#define SHMEXPORT_STORE(var, val) atomic_store_explicit((atomic_uint *)&(var), (val), memory_order_release)
+
+#endif /* SHMEXPORT_H_ */
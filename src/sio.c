@@ -29,6 +29,10 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#if defined(HAVE_MMAP) && defined(HAVE_SYS_MMAN_H)
+#include <sys/mman.h>
+#define SIO_USE_MMAP
+#endif
 
 #include "afile.h"
 #include "antic.h"  /* ANTIC_ypos */
@@ -95,16 +99,24 @@ typedef struct tagpro_additional_info_t {
 #define VAPI_CYCLES_MISSING_SECTOR	(2*VAPI_CYCLES_PER_ROT + 14453)
 #define VAPI_CYCLES_BAD_SECTOR_NUM	1521
 
-/* stores dup sector information for VAPI images */
+#define VAPI_TRACKS 40
+#define VAPI_SECTORS_PER_TRACK 18
+#define VAPI_SECTORS (VAPI_TRACKS * VAPI_SECTORS_PER_TRACK)
+
+/* one sector header of a VAPI image, including duplicate sectors */
 typedef struct tagvapi_sec_info_t {
-	int sec_count;
-	unsigned int sec_offset[MAX_VAPI_PHANTOM_SEC];
-	unsigned char sec_status[MAX_VAPI_PHANTOM_SEC];
-	unsigned int sec_rot_pos[MAX_VAPI_PHANTOM_SEC];
+	unsigned int rot_pos;     /* position on the track, in CPU cycles */
+	unsigned int offset;      /* offset of the data in the image */
+	unsigned int weak_offset; /* first byte of weak data, 128 if none */
+	unsigned char status;     /* FDC status, 0xFF if OK */
 } vapi_sec_info_t;
 
+/* Index of all sectors of a VAPI image, built once at mount time. The
+   copies of sector N are sectors[first[N - 1]] .. sectors[first[N] - 1],
+   in the order they appear in the image, so every track is contiguous. */
 typedef struct tagvapi_additional_info_t {
 	vapi_sec_info_t *sectors;
+	int first[VAPI_SECTORS + 1];
 	int sec_stat_buff[4];
 	int vapi_delay_time;
 } vapi_additional_info_t;
@@ -145,11 +157,32 @@ typedef struct tagvapi_sector_header_t {
 } vapi_sector_header_t;
 
 #define VAPI_32(x) (x[0] + (x[1] << 8) + (x[2] << 16) + (x[3] << 24))
+/* type of the chunk giving the first byte of weak data in a sector */
+#define VAPI_CHUNK_WEAK_SECTOR 0x10
 #define VAPI_16(x) (x[0] + (x[1] << 8))
 
 /* Additional Info for all copy protected disk types */
 static void *additional_info[SIO_MAX_DRIVES];
 
+/* Mounted images are kept in memory, mapped with mmap() where available
+   (so read-only pages are shared between instances) or read into a buffer
+   otherwise. Written sectors are marked in a bitmap and written back to
+   disk[] on dismount or after the drive has been idle for
+   FLUSH_DELAY_FRAMES. If an image cannot be loaded, its sectors are
+   accessed through disk[] directly. */
+static UBYTE *image[SIO_MAX_DRIVES];
+static ULONG image_size[SIO_MAX_DRIVES];
+static int image_mapped[SIO_MAX_DRIVES];
+/* current position for ImageRead/ImageWrite, like the file position */
+static ULONG image_pos[SIO_MAX_DRIVES];
+/* one bit per sector, bit 0 of byte 0 is sector 1 */
+static UBYTE *dirty_sectors[SIO_MAX_DRIVES];
+static int dirty_count[SIO_MAX_DRIVES];
+static int flush_timer[SIO_MAX_DRIVES];
+#define FLUSH_DELAY_FRAMES 50
+/* GZIP compressed images are not loaded but decompressed on demand. */
+static CompFile_GZ *gz_image[SIO_MAX_DRIVES];
+
 SIO_UnitStatus SIO_drive_status[SIO_MAX_DRIVES];
 char SIO_filename[SIO_MAX_DRIVES][FILENAME_MAX];
 
@@ -176,11 +209,333 @@ static int DataIndex = 0;
 static int TransferStatus = SIO_NoFrame;
 static int ExpectedBytes = 0;
 
+int SIO_accelerate = FALSE;
+/* TRUE if the data bytes of the current read frame may be sent early. */
+static int accelerate_frame = FALSE;
+/* The device, command and sector of the last read command. */
+static UBYTE last_read_command[4];
+
 int ignore_header_writeprotect = FALSE;
 
+static void SizeOfSector(UBYTE unit, int sector, int *sz, ULONG *ofs);
+
+/* Loads the image opened in disk[unit] into memory. DATA, if not NULL, is
+   the whole file already read into a malloc'ed buffer, which is used
+   instead. On failure the image stays accessible through disk[unit]. */
+static void LoadImage(int unit, UBYTE *data)
+{
+	int length = Util_flen(disk[unit]);
+	if (length <= 0) {
+		free(data);
+		return;
+	}
+	image[unit] = data;
+	image_mapped[unit] = FALSE;
+#ifdef SIO_USE_MMAP
+	if (image[unit] == NULL) {
+		/* Private mapping: writes only reach the file through FlushImage. */
+		void *p = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileno(disk[unit]), 0);
+		if (p != MAP_FAILED) {
+			image[unit] = (UBYTE *) p;
+			image_mapped[unit] = TRUE;
+		}
+	}
+#endif
+	if (image[unit] == NULL) {
+		image[unit] = (UBYTE *) malloc(length);
+		if (image[unit] == NULL)
+			return;
+		Util_rewind(disk[unit]);
+		if (fread(image[unit], 1, length, disk[unit]) != (size_t) length) {
+			free(image[unit]);
+			image[unit] = NULL;
+			return;
+		}
+		image_mapped[unit] = FALSE;
+	}
+	image_size[unit] = (ULONG) length;
+	image_pos[unit] = 0;
+	dirty_sectors[unit] = (UBYTE *) Util_malloc((sectorcount[unit] >> 3) + 1);
+	memset(dirty_sectors[unit], 0, (sectorcount[unit] >> 3) + 1);
+	dirty_count[unit] = 0;
+}
+
+/* Writes the sectors changed in memory back to disk[unit]. */
+static void FlushImage(int unit)
+{
+	int sector;
+	if (dirty_count[unit] == 0)
+		return;
+	for (sector = 1; sector <= sectorcount[unit]; sector++) {
+		if (dirty_sectors[unit][(sector - 1) >> 3] & (1 << ((sector - 1) & 7))) {
+			int size;
+			ULONG offset;
+			/* For ATX images the offset comes from the sector index;
+			   only sectors with a single copy are written. */
+			SizeOfSector((UBYTE) unit, sector, &size, &offset);
+			if (offset + size > image_size[unit])
+				size = offset < image_size[unit] ? image_size[unit] - offset : 0;
+			fseek(disk[unit], offset, SEEK_SET);
+			if (fwrite(image[unit] + offset, 1, size, disk[unit]) < (size_t) size)
+				Log_print("Error writing sector %d of disk %d", sector, unit + 1);
+		}
+	}
+	fflush(disk[unit]);
+	memset(dirty_sectors[unit], 0, (sectorcount[unit] >> 3) + 1);
+	dirty_count[unit] = 0;
+}
+
+static void UnloadImage(int unit)
+{
+	if (image[unit] == NULL)
+		return;
+	FlushImage(unit);
+#ifdef SIO_USE_MMAP
+	if (image_mapped[unit])
+		munmap(image[unit], image_size[unit]);
+	else
+#endif
+		free(image[unit]);
+	image[unit] = NULL;
+	free(dirty_sectors[unit]);
+	dirty_sectors[unit] = NULL;
+}
+
+/* ImageSeek, ImageRead and ImageWrite access the image like fseek, fread
+   and fwrite on disk[unit]. */
+static void ImageSeek(int unit, ULONG offset)
+{
+	if (image[unit] != NULL || gz_image[unit] != NULL)
+		image_pos[unit] = offset;
+	else
+		fseek(disk[unit], offset, SEEK_SET);
+}
+
+static int ImageRead(int unit, UBYTE *buffer, int size)
+{
+	ULONG pos = image_pos[unit];
+	if (gz_image[unit] != NULL) {
+		size = CompFile_GZRead(gz_image[unit], pos, buffer, size);
+		image_pos[unit] = pos + size;
+		return size;
+	}
+	if (image[unit] == NULL)
+		return (int) fread(buffer, 1, size, disk[unit]);
+	if (pos >= image_size[unit])
+		return 0;
+	if (pos + size > image_size[unit])
+		size = image_size[unit] - pos;
+	memcpy(buffer, image[unit] + pos, size);
+	image_pos[unit] = pos + size;
+	return size;
+}
+
+/* Writes SIZE bytes of SECTOR at the current position. */
+static int ImageWrite(int unit, int sector, const UBYTE *buffer, int size)
+{
+	ULONG pos = image_pos[unit];
+	if (gz_image[unit] != NULL)
+		return 0; /* always read-only */
+	if (image[unit] != NULL && pos + size > image_size[unit]) {
+		/* The file grows - let stdio handle it from now on. */
+		UnloadImage(unit);
+		fseek(disk[unit], pos, SEEK_SET);
+	}
+	if (image[unit] == NULL)
+		return (int) fwrite(buffer, 1, size, disk[unit]);
+	memcpy(image[unit] + pos, buffer, size);
+	image_pos[unit] = pos + size;
+	if (!(dirty_sectors[unit][(sector - 1) >> 3] & (1 << ((sector - 1) & 7)))) {
+		dirty_sectors[unit][(sector - 1) >> 3] |= 1 << ((sector - 1) & 7);
+		dirty_count[unit]++;
+	}
+	flush_timer[unit] = FLUSH_DELAY_FRAMES;
+	return size;
+}
+
+void SIO_Frame(void)
+{
+	int i;
+	for (i = 0; i < SIO_MAX_DRIVES; i++)
+		if (dirty_count[i] != 0 && --flush_timer[i] <= 0)
+			FlushImage(i);
+}
+
+void SIO_FlushDisks(void)
+{
+	int i;
+	for (i = 0; i < SIO_MAX_DRIVES; i++)
+		if (image[i] != NULL)
+			FlushImage(i);
+}
+
+/* Adds the sectors of the VAPI track at TRACKOFFSET in DATA to INFO. In
+   PASS 0 only counts the copies of each sector in COUNT, in pass 1 stores
+   the sectors, with COUNT holding the next free index for each sector.
+   Returns FALSE if the track is invalid. */
+static int VAPI_IndexTrack(const UBYTE *data, ULONG length, ULONG trackoffset,
+                           vapi_additional_info_t *info, int *count, int pass)
+{
+	vapi_track_header_t trackheader;
+	vapi_sector_list_header_t sectorlist;
+	ULONG next, seclistdata, trackend, chunk;
+	int sectorcnt, j;
+	/* index in info->sectors of the first sector list entries, for chunks
+	   that refer to them */
+	int list[256];
+
+	if (trackoffset + sizeof(trackheader) > length) {
+		Log_print("VAPI: Bad Track Header");
+		return FALSE;
+	}
+	memcpy(&trackheader, data + trackoffset, sizeof(trackheader));
+	next = VAPI_32(trackheader.next);
+	trackend = (next == 0 || trackoffset + next > length) ? length : trackoffset + next;
+	sectorcnt = VAPI_16(trackheader.sectorcnt);
+	seclistdata = VAPI_32(trackheader.startdata) + trackoffset;
+#ifdef DEBUG_VAPI
+	if (pass == 1)
+		Log_print("Track %d: next %x type %d seccnt %d secdata %x",trackheader.tracknum,
+			trackoffset + next,VAPI_16(trackheader.type),sectorcnt,seclistdata);
+#endif
+	if (VAPI_16(trackheader.type) != 0) {
+		if (pass == 1)
+			Log_print("Unknown VAPI track type Track:%d Type:%d",trackheader.tracknum,VAPI_16(trackheader.type));
+		return TRUE;
+	}
+	if (seclistdata + sizeof(sectorlist) + sectorcnt * sizeof(vapi_sector_header_t) > length) {
+		Log_print("VAPI: Bad Sector List Offset");
+		return FALSE;
+	}
+	if (trackheader.tracknum >= VAPI_TRACKS) {
+		Log_print("VAPI: Bad Track Number %d", trackheader.tracknum);
+		return FALSE;
+	}
+	memcpy(&sectorlist, data + seclistdata, sizeof(sectorlist));
+
+	for (j = 0; j < sectorcnt; j++) {
+		vapi_sector_header_t sectorheader;
+		int n;
+
+		memcpy(&sectorheader, data + seclistdata + sizeof(sectorlist) + j * sizeof(sectorheader),
+		       sizeof(sectorheader));
+		if (sectorheader.sectornum == 0 || sectorheader.sectornum > VAPI_SECTORS_PER_TRACK) {
+			Log_print("VAPI: Bad Sector Index: Track %d Sec Num %d Index %d",
+					trackheader.tracknum,j,sectorheader.sectornum);
+			return FALSE;
+		}
+		n = trackheader.tracknum * VAPI_SECTORS_PER_TRACK + sectorheader.sectornum - 1;
+		if (pass == 0) {
+			if (++count[n] > MAX_VAPI_PHANTOM_SEC) {
+				Log_print("VAPI: Too many Phantom Sectors");
+				return FALSE;
+			}
+		}
+		else {
+			vapi_sec_info_t *sector = &info->sectors[count[n]];
+			double percent_rot = ((double) VAPI_16(sectorheader.sectorpos))/VAPI_BYTES_PER_TRACK;
+			sector->rot_pos = (unsigned int) (percent_rot * VAPI_CYCLES_PER_ROT);
+			sector->offset = VAPI_32(sectorheader.startdata) + trackoffset;
+			sector->status = ~sectorheader.sectorstatus;
+			sector->weak_offset = 128;
+			if (j < 256)
+				list[j] = count[n];
+			count[n]++;
+#ifdef DEBUG_VAPI
+			Log_print("Sector %d status %x position %f %d %d data %x",sectorheader.sectornum,
+				sector->status,percent_rot,sector->rot_pos,
+				VAPI_16(sectorheader.sectorpos),sector->offset);
+#endif
+		}
+	}
+
+	/* Chunks following the sector list: sector data, weak sectors... */
+	if (pass == 1) {
+		chunk = seclistdata + VAPI_32(sectorlist.sizelist);
+		while (chunk + 8 <= trackend) {
+			const UBYTE *c = data + chunk;
+			ULONG size = VAPI_32(c);
+			if (size < 8)
+				break;
+			if (c[4] == VAPI_CHUNK_WEAK_SECTOR && c[5] < sectorcnt)
+				info->sectors[list[c[5]]].weak_offset = VAPI_16((c + 6));
+			chunk += size;
+		}
+	}
+	return TRUE;
+}
+
+/* Builds the sector index of the VAPI image DATA of LENGTH bytes.
+   Returns FALSE if the image is invalid. */
+static int VAPI_BuildIndex(const UBYTE *data, ULONG length, vapi_additional_info_t *info)
+{
+	vapi_file_header_t fileheader;
+	int count[VAPI_SECTORS];
+	int pass;
+
+	if (length < sizeof(fileheader)) {
+		Log_print("VAPI: Bad File Header");
+		return FALSE;
+	}
+	memcpy(&fileheader, data, sizeof(fileheader));
+	if (VAPI_32(fileheader.startdata) > length) {
+		Log_print("VAPI: Bad Track Offset");
+		return FALSE;
+	}
+#ifdef DEBUG_VAPI
+	Log_print("VAPI File Version %d.%d",fileheader.majorver,fileheader.minorver);
+#endif
+	memset(count, 0, sizeof(count));
+	info->sectors = NULL;
+	/* Count the sectors first, so that they can be stored in order. */
+	for (pass = 0; pass < 2; pass++) {
+		ULONG trackoffset = VAPI_32(fileheader.startdata);
+		while (trackoffset > 0 && trackoffset < length) {
+			ULONG next;
+			if (!VAPI_IndexTrack(data, length, trackoffset, info, count, pass)) {
+				free(info->sectors);
+				return FALSE;
+			}
+			next = VAPI_32((data + trackoffset));
+			if (next == 0)
+				break;
+			trackoffset += next;
+		}
+		if (pass == 0) {
+			int n;
+			int total = 0;
+			for (n = 0; n < VAPI_SECTORS; n++) {
+				info->first[n] = total;
+				total += count[n];
+				count[n] = info->first[n];
+			}
+			info->first[VAPI_SECTORS] = total;
+			info->sectors = (vapi_sec_info_t *)Util_malloc((total > 0 ? total : 1) * sizeof(vapi_sec_info_t));
+		}
+	}
+	return TRUE;
+}
+
 int SIO_Initialise(int *argc, char *argv[])
 {
 	int i;
+	int j;
+
+	for (i = j = 1; i < *argc; i++) {
+		if (strcmp(argv[i], "-sioaccel") == 0)
+			SIO_accelerate = TRUE;
+		else if (strcmp(argv[i], "-nosioaccel") == 0)
+			SIO_accelerate = FALSE;
+		else {
+			if (strcmp(argv[i], "-help") == 0) {
+				Log_print("\t-sioaccel        Transfer disk sectors faster when the SIO patch is off");
+				Log_print("\t-nosioaccel      Transfer disk sectors at the real speed");
+			}
+			argv[j++] = argv[i];
+		}
+	}
+	*argc = j;
+
 	for (i = 0; i < SIO_MAX_DRIVES; i++) {
 		strcpy(SIO_filename[i], "Off");
 		SIO_drive_status[i] = SIO_OFF;
@@ -203,8 +558,10 @@ void SIO_Exit(void)
 int SIO_Mount(int diskno, const char *filename, int b_open_readonly)
 {
 	FILE *f = NULL;
+	CompFile_GZ *gz = NULL;
 	SIO_UnitStatus status = SIO_READ_WRITE;
 	struct AFILE_ATR_Header header;
+	UBYTE *data = NULL; /* whole file, if already read */
 
 	/* avoid overruns in SIO_filename[] */
 	if (strlen(filename) >= FILENAME_MAX)
@@ -257,7 +614,25 @@ int SIO_Mount(int diskno, const char *filename, int b_open_readonly)
 		break;
 	case 0x1f:
 		if (header.magic2 == 0x8b) {
-			/* ATZ/ATR.GZ, XFZ/XFD.GZ */
+			/* ATZ/ATR.GZ, XFZ/XFD.GZ - sectors are decompressed when read,
+			   f is kept open but not used */
+			gz = CompFile_GZOpen(filename);
+			if (gz == NULL) {
+				fclose(f);
+				return FALSE;
+			}
+			if (CompFile_GZRead(gz, 0, &header, sizeof(struct AFILE_ATR_Header)) != sizeof(struct AFILE_ATR_Header)) {
+				CompFile_GZClose(gz);
+				fclose(f);
+				return FALSE;
+			}
+			status = SIO_READ_ONLY;
+			if (header.magic1 != 'A' || header.magic2 != 'T' || header.seccountlo != '8' ||
+			    header.seccounthi != 'X')
+				break;
+			/* The ATX parser reads the file directly - extract it. */
+			CompFile_GZClose(gz);
+			gz = NULL;
 			fclose(f);
 			f = Util_tmpopen(sio_tmpbuf[diskno - 1]);
 			if (f == NULL)
@@ -287,6 +662,8 @@ int SIO_Mount(int diskno, const char *filename, int b_open_readonly)
 
 		sectorsize[diskno - 1] = (header.secsizehi << 8) + header.secsizelo;
 		if (sectorsize[diskno - 1] != 128 && sectorsize[diskno - 1] != 256) {
+			if (gz != NULL)
+				CompFile_GZClose(gz);
 			Util_fclose(f, sio_tmpbuf[diskno - 1]);
 			return FALSE;
 		}
@@ -313,8 +690,16 @@ int SIO_Mount(int diskno, const char *filename, int b_open_readonly)
 				   a non-zero byte in bytes 0x190-0x30f of the ATR file */
 				UBYTE buffer[0x180];
 				int i;
-				fseek(f, 0x190, SEEK_SET);
-				if (fread(buffer, 1, 0x180, f) != 0x180) {
+				int length;
+				if (gz != NULL)
+					length = CompFile_GZRead(gz, 0x190, buffer, 0x180);
+				else {
+					fseek(f, 0x190, SEEK_SET);
+					length = (int) fread(buffer, 1, 0x180, f);
+				}
+				if (length != 0x180) {
+					if (gz != NULL)
+						CompFile_GZClose(gz);
 					Util_fclose(f, sio_tmpbuf[diskno - 1]);
 					return FALSE;
 				}
@@ -332,9 +717,6 @@ int SIO_Mount(int diskno, const char *filename, int b_open_readonly)
 		 header.seccounthi == 'X') {
 		int file_length = Util_flen(f);
 		vapi_additional_info_t *info;
-		vapi_file_header_t fileheader;
-		vapi_track_header_t trackheader;
-		int trackoffset, totalsectors;
 
 		/* .atx is read only for now */
 #ifndef VAPI_WRITE_ENABLE
@@ -349,143 +731,23 @@ int SIO_Mount(int diskno, const char *filename, int b_open_readonly)
 		
 		image_type[diskno - 1] = IMAGE_TYPE_VAPI;
 		sectorsize[diskno - 1] = 128;
-		sectorcount[diskno - 1] = 720;
-		fseek(f,0,SEEK_SET);
-		if (fread(&fileheader,1,sizeof(fileheader),f) != sizeof(fileheader)) {
-			Util_fclose(f, sio_tmpbuf[diskno - 1]);
-			Log_print("VAPI: Bad File Header");
-			return(FALSE);
-			}
-		trackoffset = VAPI_32(fileheader.startdata);	
-		if (trackoffset > file_length) {
+		sectorcount[diskno - 1] = VAPI_SECTORS;
+		/* Index the image in memory with a single read. */
+		data = (UBYTE *)Util_malloc(file_length > 0 ? file_length : 1);
+		info = (vapi_additional_info_t *)Util_malloc(sizeof(vapi_additional_info_t));
+		Util_rewind(f);
+		if (fread(data, 1, file_length, f) != (size_t) file_length
+		    || !VAPI_BuildIndex(data, file_length, info)) {
+			free(info);
+			free(data);
 			Util_fclose(f, sio_tmpbuf[diskno - 1]);
-			Log_print("VAPI: Bad Track Offset");
-			return(FALSE);
-			}
-#ifdef DEBUG_VAPI
-		Log_print("VAPI File Version %d.%d",fileheader.majorver,fileheader.minorver);
-#endif
-		/* Read all of the track headers to get the total sector count */
-		totalsectors = 0;
-		while (trackoffset > 0 && trackoffset < file_length) {
-			ULONG next;
-			UWORD tracktype;
-
-			fseek(f,trackoffset,SEEK_SET);
-			if (fread(&trackheader,1,sizeof(trackheader),f) != sizeof(trackheader)) {
-				Util_fclose(f, sio_tmpbuf[diskno - 1]);
-				Log_print("VAPI: Bad Track Header");
-				return(FALSE);
-				}
-			next = VAPI_32(trackheader.next);
-			tracktype = VAPI_16(trackheader.type);
-			if (tracktype == 0) {
-				totalsectors += VAPI_16(trackheader.sectorcnt);
-				}
-			trackoffset += next;
+			return FALSE;
 		}
-
-		info = (vapi_additional_info_t *)Util_malloc(sizeof(vapi_additional_info_t));
+		/* The data read is kept as the image in memory. */
 		additional_info[diskno-1] = info;
-		info->sectors = (vapi_sec_info_t *)Util_malloc(sectorcount[diskno - 1] * 
- 					    sizeof(vapi_sec_info_t));
-		memset(info->sectors, 0, sectorcount[diskno - 1] * 
- 					 sizeof(vapi_sec_info_t));
-
-		/* Now read all the sector data */
-		trackoffset = VAPI_32(fileheader.startdata);
-		while (trackoffset > 0 && trackoffset < file_length) {
-			int sectorcnt, seclistdata,next;
-			vapi_sector_list_header_t sectorlist;
-			vapi_sector_header_t sectorheader;
-			vapi_sec_info_t *sector;
-			UWORD tracktype;
-			int j;
-
-			fseek(f,trackoffset,SEEK_SET);
-			if (fread(&trackheader,1,sizeof(trackheader),f) != sizeof(trackheader)) {
-				free(info->sectors);
-				free(info);
-				Util_fclose(f, sio_tmpbuf[diskno - 1]);
-				Log_print("VAPI: Bad Track Header while reading sectors");
-				return(FALSE);
-				}
-			next = VAPI_32(trackheader.next);
-			sectorcnt = VAPI_16(trackheader.sectorcnt);
-			tracktype = VAPI_16(trackheader.type);
-			seclistdata = VAPI_32(trackheader.startdata) + trackoffset;
-#ifdef DEBUG_VAPI
-			Log_print("Track %d: next %x type %d seccnt %d secdata %x",trackheader.tracknum,
-				trackoffset + next,VAPI_16(trackheader.type),sectorcnt,seclistdata);
-#endif
-			if (tracktype == 0) {
-				if (seclistdata > file_length) {
-					free(info->sectors);
-					free(info);
-					Util_fclose(f, sio_tmpbuf[diskno - 1]);
-					Log_print("VAPI: Bad Sector List Offset");
-					return(FALSE);
-					}
-				fseek(f,seclistdata,SEEK_SET);
-				if (fread(&sectorlist,1,sizeof(sectorlist),f) != sizeof(sectorlist)) {
-					free(info->sectors);
-					free(info);
-					Util_fclose(f, sio_tmpbuf[diskno - 1]);
-					Log_print("VAPI: Bad Sector List");
-					return(FALSE);
-					}
-#ifdef DEBUG_VAPI
-				Log_print("Size sec list %x type %d",VAPI_32(sectorlist.sizelist),sectorlist.type);
-#endif
-				for (j=0;j<sectorcnt;j++) {
-					double percent_rot;
-
-					if (fread(&sectorheader,1,sizeof(sectorheader),f) != sizeof(sectorheader)) {
-						free(info->sectors);
-						free(info);
-						Util_fclose(f, sio_tmpbuf[diskno - 1]);
-						Log_print("VAPI: Bad Sector Header");
-						return(FALSE);
-						}
-					if (sectorheader.sectornum > 18)  {
-						Util_fclose(f, sio_tmpbuf[diskno - 1]);
-						Log_print("VAPI: Bad Sector Index: Track %d Sec Num %d Index %d",
-								trackheader.tracknum,j,sectorheader.sectornum);
-						return(FALSE);
-						}
-					sector = &info->sectors[trackheader.tracknum * 18 + sectorheader.sectornum - 1];
-
-					percent_rot = ((double) VAPI_16(sectorheader.sectorpos))/VAPI_BYTES_PER_TRACK;
-					sector->sec_rot_pos[sector->sec_count] = (unsigned int) (percent_rot * VAPI_CYCLES_PER_ROT);
-					sector->sec_offset[sector->sec_count] = VAPI_32(sectorheader.startdata) + trackoffset;
-					sector->sec_status[sector->sec_count] = ~sectorheader.sectorstatus;
-					sector->sec_count++;
-					if (sector->sec_count > MAX_VAPI_PHANTOM_SEC) {
-						free(info->sectors);
-						free(info);
-						Util_fclose(f, sio_tmpbuf[diskno - 1]);
-						Log_print("VAPI: Too many Phantom Sectors");
-						return(FALSE);
-						}
-#ifdef DEBUG_VAPI
-					Log_print("Sector %d status %x position %f %d %d data %x",sectorheader.sectornum,
-						sector->sec_status[sector->sec_count-1],percent_rot,
-						sector->sec_rot_pos[sector->sec_count-1],
-						VAPI_16(sectorheader.sectorpos),
-						sector->sec_offset[sector->sec_count-1]);				
-#endif				
-				}
-#ifdef DEBUG_VAPI
-				Log_flushlog();
-#endif
-			} else {
-				Log_print("Unknown VAPI track type Track:%d Type:%d",trackheader.tracknum,tracktype);
-			}
-			trackoffset += next;
-		}			
 	}
 	else {
-		int file_length = Util_flen(f);
+		int file_length = gz != NULL ? (int) CompFile_GZSize(gz) : Util_flen(f);
 		/* check for PRO */
 		if ((file_length-16)%(128+12) == 0 &&
 				(header.magic1*256 + header.magic2 == (file_length-16)/(128+12)) &&
@@ -548,12 +810,20 @@ int SIO_Mount(int diskno, const char *filename, int b_open_readonly)
 	strcpy(SIO_filename[diskno - 1], filename);
 	SIO_drive_status[diskno - 1] = status;
 	disk[diskno - 1] = f;
+	gz_image[diskno - 1] = gz;
+	if (gz == NULL)
+		LoadImage(diskno - 1, data);
 	return TRUE;
 }
 
 void SIO_Dismount(int diskno)
 {
 	if (disk[diskno - 1] != NULL) {
+		UnloadImage(diskno - 1);
+		if (gz_image[diskno - 1] != NULL) {
+			CompFile_GZClose(gz_image[diskno - 1]);
+			gz_image[diskno - 1] = NULL;
+		}
 		Util_fclose(disk[diskno - 1], sio_tmpbuf[diskno - 1]);
 		disk[diskno - 1] = NULL;
 		SIO_drive_status[diskno - 1] = SIO_NO_DISK;
@@ -578,10 +848,6 @@ void SIO_DisableDrive(int diskno)
 
 void SIO_SizeOfSector(UBYTE unit, int sector, int *sz, ULONG *ofs)
 {
-	int size;
-	ULONG offset;
-	int header_size = (image_type[unit] == IMAGE_TYPE_ATR ? 16 : 0);
-
 	if (BINLOAD_start_binloading) {
 		if (sz)
 			*sz = 128;
@@ -589,6 +855,14 @@ void SIO_SizeOfSector(UBYTE unit, int sector, int *sz, ULONG *ofs)
 			*ofs = 0;
 		return;
 	}
+	SizeOfSector(unit, sector, sz, ofs);
+}
+
+static void SizeOfSector(UBYTE unit, int sector, int *sz, ULONG *ofs)
+{
+	int size;
+	ULONG offset;
+	int header_size = (image_type[unit] == IMAGE_TYPE_ATR ? 16 : 0);
 
 	if (image_type[unit] == IMAGE_TYPE_PRO) {
 		size = 128;
@@ -596,7 +870,6 @@ void SIO_SizeOfSector(UBYTE unit, int sector, int *sz, ULONG *ofs)
 	}
 	else if (image_type[unit] == IMAGE_TYPE_VAPI) {
 		vapi_additional_info_t *info;
-		vapi_sec_info_t *secinfo;
 
 		size = 128;
 		info = (vapi_additional_info_t *)additional_info[unit];
@@ -604,13 +877,10 @@ void SIO_SizeOfSector(UBYTE unit, int sector, int *sz, ULONG *ofs)
 			offset = 0;
 		else if (sector > sectorcount[unit])
 			offset = 0;
-		else {
-			secinfo = &info->sectors[sector-1];
-			if (secinfo->sec_count == 0  )
-				offset = 0;
-			else
-				offset = secinfo->sec_offset[0];
-		}
+		else if (info->first[sector - 1] == info->first[sector])
+			offset = 0;
+		else
+			offset = info->sectors[info->first[sector - 1]].offset;
 	}
 	else if (sector < 4) {
 		/* special case for first three sectors in ATR and XFD image */
@@ -637,15 +907,23 @@ static int SeekSector(int unit, int sector)
 	SIO_last_sector = sector;
 	snprintf(SIO_status, sizeof(SIO_status), "%d: %d", unit + 1, sector);
 	SIO_SizeOfSector((UBYTE) unit, sector, &size, &offset);
-	fseek(disk[unit], offset, SEEK_SET);
+	ImageSeek(unit, offset);
 
 	return size;
 }
 
+/* Weak bits read back differently every time. */
+static void RandomiseWeakData(UBYTE *buffer, int size)
+{
+	while (size-- > 0)
+		*buffer++ = (UBYTE) rand();
+}
+
 /* Unit counts from zero up */
 int SIO_ReadSector(int unit, int sector, UBYTE *buffer)
 {
 	int size;
+	int weak_offset = -1; /* first byte of weak data read from VAPI image */
 	if (BINLOAD_start_binloading)
 		return BINLOAD_LoaderStart(buffer);
 
@@ -666,7 +944,7 @@ int SIO_ReadSector(int unit, int sector, UBYTE *buffer)
 		unsigned char *count;
 		info = (pro_additional_info_t *)additional_info[unit];
 		count = info->count;
-		if (fread(buffer, 1, 12, disk[unit]) < 12) {
+		if (ImageRead(unit, buffer, 12) < 12) {
 			Log_print("Error in header of .pro image: sector:%d", sector);
 			return 'E';
 		}
@@ -686,7 +964,7 @@ int SIO_ReadSector(int unit, int sector, UBYTE *buffer)
 				}
 				size = SeekSector(unit, sector);
 				/* read sector header */
-				if (fread(buffer, 1, 12, disk[unit]) < 12) {
+				if (ImageRead(unit, buffer, 12) < 12) {
 					Log_print("Error in header2 of .pro image: sector:%d dupnum:%d", sector, dupnum);
 					return 'E';
 				}
@@ -694,7 +972,7 @@ int SIO_ReadSector(int unit, int sector, UBYTE *buffer)
 		}
 		/* bad sector */
 		if (buffer[1] != 0xff) {
-			if (fread(buffer, 1, size, disk[unit]) < size) {
+			if (ImageRead(unit, buffer, size) < size) {
 				Log_print("Error in bad sector of .pro image: sector:%d", sector);
 			}
 			io_success[unit] = sector;
@@ -711,7 +989,7 @@ int SIO_ReadSector(int unit, int sector, UBYTE *buffer)
 		static int lasttrack = 0;
 		unsigned int currpos, time, delay, rotations, bestdelay;
 /*		unsigned char beststatus;*/
-		int fromtrack, trackstostep, j;
+		int fromtrack, trackstostep, j, sec_count;
 
 		info = (vapi_additional_info_t *)additional_info[unit];
 		info->vapi_delay_time = 0;
@@ -728,11 +1006,12 @@ int SIO_ReadSector(int unit, int sector, UBYTE *buffer)
 			return 'E';
 		}
 
-		secinfo = &info->sectors[sector-1];
+		secinfo = &info->sectors[info->first[sector - 1]];
+		sec_count = info->first[sector] - info->first[sector - 1];
 		fromtrack = lasttrack;
 		lasttrack = (sector-1)/18;
 
-		if (secinfo->sec_count == 0) {
+		if (sec_count == 0) {
 #ifdef DEBUG_VAPI
 			Log_print("missing sector:%d", sector);
 #endif
@@ -753,24 +1032,24 @@ int SIO_ReadSector(int unit, int sector, UBYTE *buffer)
 		currpos = time - rotations*VAPI_CYCLES_PER_ROT;
 
 #ifdef DEBUG_VAPI
-		Log_print(" sector:%d sector count :%d time %d", sector,secinfo->sec_count,ANTIC_CPU_CLOCK);
+		Log_print(" sector:%d sector count :%d time %d", sector,sec_count,ANTIC_CPU_CLOCK);
 #endif
 
 		bestdelay = 10 * VAPI_CYCLES_PER_ROT;
 /*		beststatus = 0;*/
-		for (j=0;j<secinfo->sec_count;j++) {
-			if (secinfo->sec_rot_pos[j]  < currpos)
-				delay = (VAPI_CYCLES_PER_ROT - currpos) + secinfo->sec_rot_pos[j];
+		for (j=0;j<sec_count;j++) {
+			if (secinfo[j].rot_pos  < currpos)
+				delay = (VAPI_CYCLES_PER_ROT - currpos) + secinfo[j].rot_pos;
 			else
-				delay = secinfo->sec_rot_pos[j] - currpos; 
+				delay = secinfo[j].rot_pos - currpos; 
 #ifdef DEBUG_VAPI
-			Log_print("%d %d %d %d %d %x",j,secinfo->sec_rot_pos[j],
+			Log_print("%d %d %d %d %d %x",j,secinfo[j].rot_pos,
 					  ((unsigned int) ANTIC_CPU_CLOCK) - ((((unsigned int) ANTIC_CPU_CLOCK)/VAPI_CYCLES_PER_ROT)*VAPI_CYCLES_PER_ROT),
-					  currpos,delay,secinfo->sec_status[j]);
+					  currpos,delay,secinfo[j].status);
 #endif
 			if (delay < bestdelay) {
 				bestdelay = delay;
-/*				beststatus = secinfo->sec_status[j];*/
+/*				beststatus = secinfo[j].status;*/
 				secindex = j;
 			}
 		}
@@ -783,26 +1062,31 @@ int SIO_ReadSector(int unit, int sector, UBYTE *buffer)
 						       VAPI_CYCLES_CMD_ACK_TRANS + VAPI_CYCLES_SECTOR_READ;
 #ifdef DEBUG_VAPI
 		Log_print("Bestdelay = %d VapiDelay = %d",bestdelay,info->vapi_delay_time);
-		if (secinfo->sec_count > 1)
+		if (sec_count > 1)
 			Log_print("duplicate sector:%d dupnum:%d delay:%d",sector, secindex,info->vapi_delay_time);
 #endif
-		fseek(disk[unit],secinfo->sec_offset[secindex],SEEK_SET);
-		info->sec_stat_buff[0] = 0x8 | ((secinfo->sec_status[secindex] == 0xFF) ? 0 : 0x04);
-		info->sec_stat_buff[1] = secinfo->sec_status[secindex];
+		secinfo += secindex;
+		ImageSeek(unit, secinfo->offset);
+		info->sec_stat_buff[0] = 0x8 | ((secinfo->status == 0xFF) ? 0 : 0x04);
+		info->sec_stat_buff[1] = secinfo->status;
 		info->sec_stat_buff[2] = 0xe0;
 		info->sec_stat_buff[3] = 0;
-		if (secinfo->sec_status[secindex] != 0xFF) {
-			if (fread(buffer, 1, size, disk[unit]) < size) {
+		if (secinfo->weak_offset < (unsigned int) size)
+			weak_offset = secinfo->weak_offset;
+		if (secinfo->status != 0xFF) {
+			if (ImageRead(unit, buffer, size) < size) {
 				Log_print("error reading sector:%d", sector);
 			}
+			if (weak_offset >= 0)
+				RandomiseWeakData(buffer + weak_offset, size - weak_offset);
 			io_success[unit] = sector;
 			info->vapi_delay_time += VAPI_CYCLES_PER_ROT + 10000;
 #ifdef DEBUG_VAPI
-			Log_print("bad sector:%d 0x%0X delay:%d", sector, secinfo->sec_status[secindex],info->vapi_delay_time );
+			Log_print("bad sector:%d 0x%0X delay:%d", sector, secinfo->status,info->vapi_delay_time );
 #endif
 			{
 			int i;
-				if (secinfo->sec_status[secindex] == 0xB7) {
+				if (secinfo->status == 0xB7) {
 					for (i=0;i<128;i++) {
 						Log_print("0x%02x",buffer[i]);
 						if (buffer[i] == 0x33)
@@ -816,9 +1100,11 @@ int SIO_ReadSector(int unit, int sector, UBYTE *buffer)
 		Log_flushlog();
 #endif		
 	}
-	if (fread(buffer, 1, size, disk[unit]) < size) {
+	if (ImageRead(unit, buffer, size) < size) {
 		Log_print("incomplete sector num:%d", sector);
 	}
+	if (weak_offset >= 0)
+		RandomiseWeakData(buffer + weak_offset, size - weak_offset);
 	io_success[unit] = 0;
 	return 'C';
 }
@@ -842,21 +1128,21 @@ int SIO_WriteSector(int unit, int sector, const UBYTE *buffer)
 		vapi_sec_info_t *secinfo;
 
 		info = (vapi_additional_info_t *)additional_info[unit];
-		secinfo = &info->sectors[sector-1];
+		secinfo = &info->sectors[info->first[sector - 1]];
 		
-		if (secinfo->sec_count != 1) {
+		if (info->first[sector] - info->first[sector - 1] != 1) {
 			/* No writes to sectors with duplicates or missing sectors */
 			return 'E';
 		}
 		
-		if (secinfo->sec_status[0] != 0xFF) {
+		if (secinfo->status != 0xFF) {
 			/* No writes to bad sectors */
 			return 'E';
 		}
 		
 		size = SeekSector(unit, sector);
-		fseek(disk[unit],secinfo->sec_offset[0],SEEK_SET);
-		fwrite(buffer, 1, size, disk[unit]);
+		ImageSeek(unit, secinfo->offset);
+		ImageWrite(unit, sector, buffer, size);
 		io_success[unit] = 0;
 		return 'C';
 #if 0		
@@ -878,7 +1164,7 @@ int SIO_WriteSector(int unit, int sector, const UBYTE *buffer)
 	} 
 #endif
 	size = SeekSector(unit, sector);
-	fwrite(buffer, 1, size, disk[unit]);
+	ImageWrite(unit, sector, buffer, size);
 	io_success[unit] = 0;
 	return 'C';
 }
@@ -1067,7 +1353,7 @@ int SIO_DriveStatus(int unit, UBYTE *buffer)
 	if (io_success[unit] != 0  && image_type[unit] == IMAGE_TYPE_PRO) {
 		int sector = io_success[unit];
 		SeekSector(unit, sector);
-		if (fread(buffer, 1, 4, disk[unit]) < 4) {
+		if (ImageRead(unit, buffer, 4) < 4) {
 			Log_print("SIO_DriveStatus: failed to read sector header");
 		}
 		return 'C';
@@ -1356,6 +1642,7 @@ static UBYTE Command_Frame(void)
 		TransferStatus = SIO_NoFrame;
 		return 0;
 	}
+	accelerate_frame = FALSE;
 	switch (CommandFrame[1]) {
 	case 0x4e:				/* Read Status */
 #ifdef DEBUG
@@ -1410,6 +1697,11 @@ static UBYTE Command_Frame(void)
 		DataIndex = 0;
 		ExpectedBytes = 2 + realsize;
 		TransferStatus = SIO_ReadFrame;
+		/* Copy protected images depend on the exact timing. A repeated
+		   command is most likely a retry, so send it at the real speed. */
+		accelerate_frame = SIO_accelerate && image_type[unit] != IMAGE_TYPE_PRO
+			&& image_type[unit] != IMAGE_TYPE_VAPI && memcmp(CommandFrame, last_read_command, 4) != 0;
+		memcpy(last_read_command, CommandFrame, 4);
 		/* wait longer before confirmation because bytes could be lost */
 		/* before the buffer was set (see $E9FB & $EA37 in XL-OS) */
 		POKEY_DELAYED_SERIN_IRQ = SIO_SERIN_INTERVAL << 2; 
@@ -1614,6 +1906,9 @@ int SIO_GetByte(void)
 				/* set delay using the expected transfer speed */
 				POKEY_DELAYED_SERIN_IRQ = (DataIndex == 1) ? SIO_SERIN_INTERVAL
 					: ((SIO_SERIN_INTERVAL * POKEY_AUDF[POKEY_CHAN3] - 1) / 0x28 + 1);
+				/* The data bytes may follow as soon as the CPU has taken
+				   the previous one. */
+				POKEY_serin_early = accelerate_frame && DataIndex > 1;
 			}
 		}
 		else {
@@ -1685,6 +1980,8 @@ void SIO_StateSave(void)
 {
 	int i;
 
+	SIO_FlushDisks();
+
 	for (i = 0; i < 8; i++) {
 		StateSav_SaveINT((int *) &SIO_drive_status[i], 1);
 		StateSav_SaveFNAME(SIO_filename[i]);
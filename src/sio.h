@@ -27,6 +27,10 @@ extern int SIO_last_op_time;
 extern int SIO_last_drive; /* 1 .. 8 */
 extern int SIO_last_sector;
 
+/* If TRUE, the data of sector reads is sent as fast as the CPU takes it
+   when the SIO patch is disabled. */
+extern int SIO_accelerate;
+
 int SIO_Mount(int diskno, const char *filename, int b_open_readonly);
 void SIO_Dismount(int diskno);
 void SIO_DisableDrive(int diskno);
@@ -39,6 +43,10 @@ void SIO_PutByte(int byte);
 int SIO_GetByte(void);
 int SIO_Initialise(int *argc, char *argv[]);
 void SIO_Exit(void);
+/* Writes back sectors of mounted images that have been idle long enough. */
+void SIO_Frame(void);
+/* Writes back all changed sectors of mounted images. */
+void SIO_FlushDisks(void);
 
 /* Some defines about the serial I/O timing. Currently fixed! */
 #define SIO_XMTDONE_INTERVAL  15
@@ -22,12 +22,15 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+#include <math.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "sound.h"
 
 #include "atari.h"
+#include "cassette.h"
 #include "log.h"
 #include "platform.h"
 #include "pokeysnd.h"
@@ -48,20 +51,70 @@ Sound_setup_t Sound_out;
 
 static int paused = TRUE;
 
+enum { MAX_SAMPLE_SIZE = 4, /* for float */
+#ifdef STEREO_SOUND
+       MAX_CHANNELS = 4, /* for quad POKEY */
+#else /* !STEREO_SOUND */
+       MAX_CHANNELS = 1,
+#endif /* !STEREO_SOUND */
+       MAX_FRAME_SIZE = MAX_SAMPLE_SIZE * MAX_CHANNELS
+};
+
 #ifndef SOUND_CALLBACK
 static UBYTE *process_buffer = NULL;
 static unsigned int process_buffer_size;
 #endif /* !SOUND_CALLBACK */
 
+/* Lock-free single-producer/single-consumer ring buffer between the emulation
+   (producer, UpdateSyncBuffer) and the audio output (consumer, FillBuffer -
+   possibly called from Sound_Callback in a separate thread). With C11 atomics
+   available neither side ever takes PLATFORM_SoundLock() in the steady state;
+   otherwise the lock is used as before. */
+#if defined(SOUND_CALLBACK) && defined(HAVE_STDATOMIC_H) && !defined(__STDC_NO_ATOMICS__)
+#include <stdatomic.h>
+#define SYNC_LOCK_FREE
+typedef atomic_uint sync_counter_t;
+#define SYNC_LOAD(var) atomic_load_explicit(&(var), memory_order_acquire)
+#define SYNC_STORE(var, val) atomic_store_explicit(&(var), (val), memory_order_release)
+#define SYNC_INC(var) atomic_fetch_add_explicit(&(var), 1, memory_order_relaxed)
+#define SYNC_LOCK()
+#define SYNC_UNLOCK()
+#else /* !SYNC_LOCK_FREE */
+typedef unsigned int sync_counter_t;
+#define SYNC_LOAD(var) (var)
+#define SYNC_STORE(var, val) ((var) = (val))
+#define SYNC_INC(var) ((var)++)
+#define SYNC_LOCK() PLATFORM_SoundLock()
+#define SYNC_UNLOCK() PLATFORM_SoundUnlock()
+#endif /* !SYNC_LOCK_FREE */
+
+enum { CACHE_LINE_SIZE = 64 };
+
 static UBYTE *sync_buffer = NULL;
+/* Size of sync_buffer in bytes - always a power of 2. */
 static unsigned int sync_buffer_size;
-/* Two invariants are held:
-   a) 0 <= sync_read_pos < sync_buffer_size
-   b) sync_read_pos <= sync_write_pos <= sync_buffer_size + sync_read_pos
-   sync_write_pos may be >= sync_buffer_size. In such case the actual write
-   position is sync_write_pos % sync_buffer_size. */
-static unsigned int sync_write_pos;
-static unsigned int sync_read_pos;
+/* Positions in the ring are free-running byte counters; the actual offset in
+   sync_buffer is pos & (sync_buffer_size - 1). The invariant
+   read_pos <= write_pos <= read_pos + sync_buffer_size holds modulo 2^32.
+   Each counter is written by only one side and kept on its own cache line
+   so that the producer and consumer don't false-share. */
+static struct {
+	char pad0[CACHE_LINE_SIZE];
+	/* Written only by the producer. */
+	sync_counter_t write_pos;
+	sync_counter_t overruns;
+	char pad1[CACHE_LINE_SIZE - 2 * sizeof(sync_counter_t)];
+	/* Written only by the consumer. */
+	sync_counter_t read_pos;
+	sync_counter_t underruns;
+	/* Time of last write of audio to output device (either by Sound_Callback
+	   or WriteOut), in microseconds since time_base, modulo 2^32. */
+	sync_counter_t last_write_us;
+	char pad2[CACHE_LINE_SIZE - 3 * sizeof(sync_counter_t)];
+} sync_ring;
+
+/* Reference point for sync_ring.last_write_us. */
+static double time_base;
 
 unsigned int Sound_latency = 20;
 /* Cumulative audio difference. */
@@ -71,20 +124,31 @@ static unsigned int sync_est_fill;
 /* If sync_est_fill goes outside this bounds, emulation speed is adjusted. */
 static unsigned int sync_min_fill;
 static unsigned int sync_max_fill;
-#ifdef SOUND_CALLBACK
-#endif /* SOUND_CALLBACK */
-/* Time of last write of sudio to output device (either by Sound_Callback or
-   WriteOut). */
-double last_audio_write_time;
 
-enum { MAX_SAMPLE_SIZE = 2, /* for 16-bit */
-#ifdef STEREO_SOUND
-       MAX_CHANNELS = 2,
-#else /* !STEREO_SOUND */
-       MAX_CHANNELS = 1,
-#endif /* !STEREO_SOUND */
-       MAX_FRAME_SIZE = MAX_SAMPLE_SIZE * MAX_CHANNELS
-};
+/* Dynamic rate control: instead of changing the emulation speed (see
+   Sound_AdjustSpeed), the POKEY output is resampled with a ratio that
+   deviates from 1.0 by at most DRC_MAX_DEVIATION depending on the fill of
+   sync_buffer. The pitch change is inaudible and the video frame rate stays
+   constant. */
+int Sound_drc_enabled = TRUE;
+static double const DRC_MAX_DEVIATION = 0.005;
+/* Output frames per input frame. */
+static double drc_ratio = 1.0;
+/* Position of the next output frame, in 1/65536 of an input frame, relative to
+   drc_last_frame. */
+static ULONG drc_pos;
+/* The last input frame of the previous call to Resample. Declared as float
+   for alignment of any sample format. */
+static float drc_last_frame[MAX_FRAME_SIZE / sizeof(float)];
+static UBYTE *drc_buffer = NULL;
+static unsigned int drc_buffer_size;
+
+
+/* Returns current time in microseconds since time_base, modulo 2^32. */
+static unsigned int TimeMicros(void)
+{
+	return (unsigned int)fmod((Util_time() - time_base) * 1e6, 4294967296.0);
+}
 
 int Sound_ReadConfig(char *option, char *ptr)
 {
@@ -94,7 +158,7 @@ int Sound_ReadConfig(char *option, char *ptr)
 		return (Sound_desired.freq = Util_sscandec(ptr)) != -1;
 	else if (strcmp(option, "SOUND_BITS") == 0) {
 		int bits = Util_sscandec(ptr);
-		if (bits != 8 && bits != 16)
+		if (bits != 8 && bits != 16 && bits != 32)
 			return FALSE;
 		Sound_desired.sample_size = bits / 8;
 	}
@@ -106,6 +170,8 @@ int Sound_ReadConfig(char *option, char *ptr)
 	}
 	else if (strcmp(option, "SOUND_LATENCY") == 0)
 		return (Sound_latency = Util_sscandec(ptr)) != -1;
+	else if (strcmp(option, "SOUND_DRC") == 0)
+		return (Sound_drc_enabled = Util_sscanbool(ptr)) != -1;
 	else
 		return FALSE;
 	return TRUE;
@@ -118,6 +184,7 @@ void Sound_WriteConfig(FILE *fp)
 	fprintf(fp, "SOUND_BITS=%u\n", Sound_desired.sample_size * 8);
 	fprintf(fp, "SOUND_BUFFER_MS=%u\n", Sound_desired.buffer_ms);
 	fprintf(fp, "SOUND_LATENCY=%u\n", Sound_latency);
+	fprintf(fp, "SOUND_DRC=%u\n", Sound_drc_enabled);
 }
 
 int Sound_Initialise(int *argc, char *argv[])
@@ -153,6 +220,8 @@ int Sound_Initialise(int *argc, char *argv[])
 			Sound_desired.sample_size = 2;
 		else if (strcmp(argv[i], "-audio8") == 0)
 			Sound_desired.sample_size = 1;
+		else if (strcmp(argv[i], "-audiofloat") == 0)
+			Sound_desired.sample_size = 4;
 		else if (strcmp(argv[i], "snd-buflen") == 0) {
 			if (i_a) {
 				int val = Util_sscandec(argv[++i]);
@@ -167,6 +236,10 @@ int Sound_Initialise(int *argc, char *argv[])
 			if (i_a)
 				Sound_latency = Util_sscandec(argv[++i]);
 			else a_m = TRUE;
+		else if (strcmp(argv[i], "-snddrc") == 0)
+			Sound_drc_enabled = TRUE;
+		else if (strcmp(argv[i], "-nosnddrc") == 0)
+			Sound_drc_enabled = FALSE;
 		else {
 			if (strcmp(argv[i], "-help") == 0) {
 				help_only = TRUE;
@@ -176,8 +249,11 @@ int Sound_Initialise(int *argc, char *argv[])
 				Log_print("\t-volume <0 .. 100>   Set sound output volume");
 				Log_print("\t-audio16             Set sound output format to 16-bit");
 				Log_print("\t-audio8              Set sound output format to 8-bit");
+				Log_print("\t-audiofloat          Set sound output format to 32-bit float");
 				Log_print("\t-snd-buflen <ms>     Set length of the hardware sound buffer in milliseconds");
 				Log_print("\t-snddelay <ms>       Set sound latency in milliseconds");
+				Log_print("\t-snddrc              Keep sound in sync by resampling (default)");
+				Log_print("\t-nosnddrc            Keep sound in sync by adjusting emulation speed");
 			}
 			argv[j++] = argv[i];
 		}
@@ -214,6 +290,9 @@ int Sound_Setup(void)
 	Sound_desired.buffer_frames = Sound_desired.freq * Sound_desired.buffer_ms / 1000;
 
 	Sound_out = Sound_desired;
+	/* Set before the audio thread is (re)started, never changed afterwards. */
+	if (time_base == 0.0)
+		time_base = Util_time();
 	if (!(Sound_enabled = PLATFORM_SoundSetup(&Sound_out)))
 		return FALSE;
 
@@ -226,20 +305,32 @@ int Sound_Setup(void)
 		Sound_Exit();
 		return FALSE;
 	}
-	if (Sound_out.channels > MAX_CHANNELS) {
+	if (Sound_out.channels > MAX_CHANNELS || Sound_out.channels == 3
+	    || (Sound_out.channels > 2 && !POKEYSND_enable_new_pokey)) {
 		Log_print("%d channels not supported", Sound_out.channels);
 		Sound_Exit();
 		return FALSE;
 	}
 
-	POKEYSND_stereo_enabled = Sound_out.channels == 2;
 #ifndef SOUND_CALLBACK
 	free(process_buffer);
 	process_buffer_size = Sound_out.buffer_frames * Sound_out.channels * Sound_out.sample_size;
 	process_buffer = Util_malloc(process_buffer_size);
 #endif /* !SOUND_CALLBACK */
 
-	POKEYSND_Init(POKEYSND_FREQ_17_EXACT, Sound_out.freq, Sound_out.channels, Sound_out.sample_size == 2 ? POKEYSND_BIT16 : 0);
+	POKEYSND_Init(POKEYSND_FREQ_17_EXACT, Sound_out.freq, Sound_out.channels,
+	              Sound_out.sample_size == 4 ? POKEYSND_FLOAT32 :
+	              Sound_out.sample_size == 2 ? POKEYSND_BIT16 : 0);
+
+	/* Resampling may produce up to DRC_MAX_DEVIATION more frames, plus one
+	   for rounding. */
+	free(drc_buffer);
+	drc_buffer_size = (unsigned int)(POKEYSND_process_buffer_length * (1.0 + DRC_MAX_DEVIATION))
+	                  + MAX_FRAME_SIZE;
+	drc_buffer = Util_malloc(drc_buffer_size);
+	drc_ratio = 1.0;
+	drc_pos = 0;
+	memset(drc_last_frame, 0, sizeof(drc_last_frame));
 
 	Sound_SetLatency(Sound_latency);
 
@@ -267,6 +358,8 @@ void Sound_Exit(void)
 #endif /* !SOUND_CALLBACK */
 		free(sync_buffer);
 		sync_buffer = NULL;
+		free(drc_buffer);
+		drc_buffer = NULL;
 	}
 }
 
@@ -285,7 +378,7 @@ void Sound_Continue(void)
 		/* start audio output */
 /*		sync_write_pos = sync_read_pos + sync_min_fill;
 		avg_fill = sync_min_fill;*/
-		last_audio_write_time = Util_time();
+		SYNC_STORE(sync_ring.last_write_us, TimeMicros());
 		PLATFORM_SoundContinue();
 		paused = FALSE;
 	}
@@ -294,32 +387,28 @@ void Sound_Continue(void)
 /* Fills buffer BUFFER with SIZE bytes of audio samples. */
 static void FillBuffer(UBYTE *buffer, unsigned int size)
 {
-	unsigned int new_read_pos;
 	static UBYTE last_frame[MAX_FRAME_SIZE];
 	unsigned int bytes_per_frame = Sound_out.channels * Sound_out.sample_size;
-	unsigned int to_write = sync_write_pos - sync_read_pos;
+	unsigned int read_pos = sync_ring.read_pos;
+	unsigned int to_write = SYNC_LOAD(sync_ring.write_pos) - read_pos;
 
 	if (to_write > 0) {
+		unsigned int offset = read_pos & (sync_buffer_size - 1);
 		if (to_write > size)
 			to_write = size;
 
-		new_read_pos = sync_read_pos + to_write;
-
-		if (new_read_pos <= sync_buffer_size)
+		if (offset + to_write <= sync_buffer_size)
 			/* no wrap */
-			memcpy(buffer, sync_buffer + sync_read_pos, to_write);
+			memcpy(buffer, sync_buffer + offset, to_write);
 		else {
 			/* wraps */
-			unsigned int first_part_size = sync_buffer_size - sync_read_pos;
-			memcpy(buffer, sync_buffer + sync_read_pos, first_part_size);
+			unsigned int first_part_size = sync_buffer_size - offset;
+			memcpy(buffer, sync_buffer + offset, first_part_size);
 			memcpy(buffer + first_part_size, sync_buffer, to_write - first_part_size);
 		}
 
-		sync_read_pos = new_read_pos;
-		if (sync_read_pos > sync_buffer_size) {
-			sync_read_pos -= sync_buffer_size;
-			sync_write_pos -= sync_buffer_size;
-		}
+		/* Release the consumed space to the producer. */
+		SYNC_STORE(sync_ring.read_pos, read_pos + to_write);
 		/* Save the last frame as we may need it to fill underflow. */
 		memcpy(last_frame, buffer + to_write - bytes_per_frame, bytes_per_frame);
 	}
@@ -327,6 +416,7 @@ static void FillBuffer(UBYTE *buffer, unsigned int size)
 
 	/* Just repeat the last good frame if underflow. */
 	if (to_write < size) {
+		SYNC_INC(sync_ring.underruns);
 #if DEBUG
 		Log_print("Sound buffer underflow: fill %d, needed %d",
 		          to_write/Sound_out.channels/Sound_out.sample_size,
@@ -344,11 +434,11 @@ void Sound_Callback(UBYTE *buffer, unsigned int size)
 {
 #if DEBUG >= 2
 		Log_print("Callback: fill %u, needed %u",
-		          (sync_write_pos - sync_read_pos) / Sound_out.channels / Sound_out.sample_size,
+		          (SYNC_LOAD(sync_ring.write_pos) - sync_ring.read_pos) / Sound_out.channels / Sound_out.sample_size,
 		          size / Sound_out.channels / Sound_out.sample_size);
 #endif
 	FillBuffer(buffer, size);
-	last_audio_write_time = Util_time();
+	SYNC_STORE(sync_ring.last_write_us, TimeMicros());
 }
 #else /* !SOUND_CALLBACK */
 /* Write audio to output device. */
@@ -359,7 +449,7 @@ static void WriteOut(void)
 	if (avail > 0) {
 #if DEBUG >= 2
 		Log_print("WriteOut: fill %u, needed %u",
-		          (sync_write_pos - sync_read_pos) / Sound_out.channels / Sound_out.sample_size,
+		          (sync_ring.write_pos - sync_ring.read_pos) / Sound_out.channels / Sound_out.sample_size,
 		          avail / Sound_out.channels / Sound_out.sample_size);
 #endif
 		/* On some platforms (eg. NestedVM) avail may be larger than process_buffer_size. */
@@ -369,44 +459,153 @@ static void WriteOut(void)
 			PLATFORM_SoundWrite(process_buffer, len);
 			avail -= len;
 		} while (avail > 0);
-		last_audio_write_time = Util_time();
+		sync_ring.last_write_us = TimeMicros();
 	}
 }
 #endif /* !SOUND_CALLBACK */
 
+/* Resamples NUM_FRAMES frames of POKEY output from IN into drc_buffer, using
+   linear interpolation with ratio drc_ratio. Returns number of bytes written
+   to drc_buffer. */
+static unsigned int Resample(UBYTE const *in, unsigned int num_frames)
+{
+	unsigned int const channels = Sound_out.channels;
+	unsigned int const bytes_per_frame = channels * Sound_out.sample_size;
+	unsigned int const max_frames = drc_buffer_size / bytes_per_frame;
+	ULONG const step = (ULONG)(65536.0 / drc_ratio + 0.5);
+	ULONG const end = (ULONG)num_frames << 16;
+	ULONG pos = drc_pos;
+	unsigned int out_frames = 0;
+	unsigned int c;
+
+	if (num_frames == 0)
+		return 0;
+
+	/* Output frame at POS lies between input frames POS>>16 and (POS>>16)+1,
+	   where frame 0 is drc_last_frame and frame N is IN[N-1]. */
+	if (Sound_out.sample_size == 4) {
+		float const *inf = (float const *)in;
+		float const *lastf = (float const *)drc_last_frame;
+		float *outf = (float *)drc_buffer;
+		for (; pos < end && out_frames < max_frames; pos += step, ++out_frames) {
+			unsigned int i = pos >> 16;
+			float frac = (float)(pos & 0xffff) / 65536.0f;
+			float const *a = i == 0 ? lastf : inf + (i - 1) * channels;
+			float const *b = inf + i * channels;
+			for (c = 0; c < channels; ++c)
+				*outf++ = a[c] + (b[c] - a[c]) * frac;
+		}
+	}
+	else if (Sound_out.sample_size == 2) {
+		SWORD const *in16 = (SWORD const *)in;
+		SWORD const *last16 = (SWORD const *)drc_last_frame;
+		SWORD *out16 = (SWORD *)drc_buffer;
+		for (; pos < end && out_frames < max_frames; pos += step, ++out_frames) {
+			unsigned int i = pos >> 16;
+			int frac = (pos >> 4) & 0xfff;
+			SWORD const *a = i == 0 ? last16 : in16 + (i - 1) * channels;
+			SWORD const *b = in16 + i * channels;
+			for (c = 0; c < channels; ++c)
+				*out16++ = a[c] + (((b[c] - a[c]) * frac) >> 12);
+		}
+	}
+	else {
+#ifdef POKEYSND_SIGNED_SAMPLES
+		SBYTE const *in8 = (SBYTE const *)in;
+		SBYTE const *last8 = (SBYTE const *)drc_last_frame;
+		SBYTE *out8 = (SBYTE *)drc_buffer;
+#else
+		UBYTE const *in8 = in;
+		UBYTE const *last8 = (UBYTE const *)drc_last_frame;
+		UBYTE *out8 = drc_buffer;
+#endif
+		for (; pos < end && out_frames < max_frames; pos += step, ++out_frames) {
+			unsigned int i = pos >> 16;
+			int frac = (pos >> 4) & 0xfff;
+			int a_off = i == 0 ? -1 : (int)((i - 1) * channels);
+			for (c = 0; c < channels; ++c) {
+				int a = a_off < 0 ? last8[c] : in8[a_off + c];
+				*out8++ = a + (((in8[i * channels + c] - a) * frac) >> 12);
+			}
+		}
+	}
+	/* Carry the fractional position over to the next call. If drc_buffer
+	   was full, drop the remaining frames rather than lag behind. */
+	drc_pos = pos < end ? 0 : pos - end;
+	memcpy(drc_last_frame, in + (num_frames - 1) * bytes_per_frame, bytes_per_frame);
+	return out_frames * bytes_per_frame;
+}
+
+/* Updates avg_fill, the smoothed estimate of sync_buffer fill. */
+static void UpdateAvgFill(void)
+{
+	static double const alpha = 2.0/(1.0+40.0);
+	avg_fill = avg_fill + alpha * (sync_est_fill - avg_fill);
+}
+
+/* Updates drc_ratio based on how far avg_fill is from the middle of the
+   [sync_min_fill, sync_max_fill] range. */
+static void UpdateDrcRatio(void)
+{
+	double target = (sync_min_fill + sync_max_fill) / 2.0;
+	double range = sync_max_fill - sync_min_fill;
+	double error;
+
+	UpdateAvgFill();
+	error = range > 0 ? (avg_fill - target) / range : 0.0;
+	if (error > 1.0)
+		error = 1.0;
+	else if (error < -1.0)
+		error = -1.0;
+	/* A too full buffer gives fewer output frames and vice versa. */
+	drc_ratio = 1.0 - DRC_MAX_DEVIATION * error;
+}
+
 static void UpdateSyncBuffer(void)
 {
+	UBYTE const *src;
 	unsigned int bytes_written;
 	unsigned int samples_written;
 	unsigned int fill;
-	unsigned int new_write_pos;
+	unsigned int write_pos;
+	unsigned int offset;
 
-	PLATFORM_SoundLock();
+	SYNC_LOCK();
+	write_pos = sync_ring.write_pos;
 	/* Current fill of the audio buffer. */
-	fill = sync_write_pos - sync_read_pos;
+	fill = write_pos - SYNC_LOAD(sync_ring.read_pos);
 
 	/* Update sync_est_fill. */
 	{
 		unsigned int est_gap;
-		est_gap = (Util_time() - last_audio_write_time)*Sound_out.freq*Sound_out.channels*Sound_out.sample_size;
+		est_gap = (TimeMicros() - SYNC_LOAD(sync_ring.last_write_us))*1e-6*Sound_out.freq*Sound_out.channels*Sound_out.sample_size;
 		if (fill < est_gap)
 			sync_est_fill = 0;
 		else
 			sync_est_fill = fill - est_gap;
 	}
 
-	if (Atari800_turbo && sync_est_fill > sync_max_fill) {
-		PLATFORM_SoundUnlock();
+	if ((Atari800_turbo || CASSETTE_fast_forward) && sync_est_fill > sync_max_fill) {
+		SYNC_UNLOCK();
 		return;
 	}
 
 	/* produce samples from the sound emulation */
 	samples_written = POKEYSND_UpdateProcessBuffer();
-	bytes_written = Sound_out.sample_size * samples_written;
+	if (Sound_drc_enabled) {
+		UpdateDrcRatio();
+		bytes_written = Resample(POKEYSND_process_buffer, samples_written / Sound_out.channels);
+		src = drc_buffer;
+	}
+	else {
+		bytes_written = Sound_out.sample_size * samples_written;
+		src = POKEYSND_process_buffer;
+	}
 
 	/* if there isn't enough room... */
 	if (bytes_written > sync_buffer_size - fill) {
 		/* Overflow of sync_buffer. */
+		SYNC_INC(sync_ring.overruns);
 #if DEBUG
 		Log_print("Sound buffer overflow: free %d, needed %d",
 				  (sync_buffer_size - fill)/Sound_out.channels/Sound_out.sample_size,
@@ -415,42 +614,41 @@ static void UpdateSyncBuffer(void)
 		/* Wait until hardware buffer can be filled, or wait until callback
 		   makes place in the buffer. */
 		do {
-			PLATFORM_SoundUnlock();
+			SYNC_UNLOCK();
 #ifndef __MINT__	/* this does more harm than good on Atari */
 			/* Sleep for the duration of one full HW buffer. */
 			Util_sleep((double)Sound_out.buffer_frames / Sound_out.freq);
 #endif
-			PLATFORM_SoundLock();
+			SYNC_LOCK();
 #ifndef SOUND_CALLBACK
 			WriteOut(); /* Write to audio buffer as much as possible. */
 #endif /* SOUND_CALLBACK */
-			fill = sync_write_pos - sync_read_pos;
+			fill = write_pos - SYNC_LOAD(sync_ring.read_pos);
 		} while (bytes_written > sync_buffer_size - fill);
 	}
-	/* Now bytes_written <= audio_buffer_size + dsp_read_pos - dsp_write_pos) */
+	/* Now bytes_written <= sync_buffer_size - fill */
 
 #if DEBUG >= 2
 	Log_print("UpdateSyncBuffer: est_gap: %f, fill %u, write %u",
-			(Util_time() - last_audio_write_time)*Sound_out.freq,
+			(TimeMicros() - SYNC_LOAD(sync_ring.last_write_us))*1e-6*Sound_out.freq,
 	          fill / Sound_out.channels/Sound_out.sample_size,
 	          bytes_written / Sound_out.channels/Sound_out.sample_size);
 #endif
 	/* now we copy the data into the buffer and adjust the positions */
-	new_write_pos = sync_write_pos + bytes_written;
-	if (new_write_pos/sync_buffer_size == sync_write_pos/sync_buffer_size)
+	offset = write_pos & (sync_buffer_size - 1);
+	if (offset + bytes_written <= sync_buffer_size)
 		/* no wrap */
-		memcpy(sync_buffer + sync_write_pos%sync_buffer_size, POKEYSND_process_buffer, bytes_written);
+		memcpy(sync_buffer + offset, src, bytes_written);
 	else {
 		/* wraps */
-		int first_part_size = sync_buffer_size - sync_write_pos%sync_buffer_size;
-		memcpy(sync_buffer + sync_write_pos%sync_buffer_size, POKEYSND_process_buffer, first_part_size);
-		memcpy(sync_buffer, POKEYSND_process_buffer + first_part_size, bytes_written - first_part_size);
+		unsigned int first_part_size = sync_buffer_size - offset;
+		memcpy(sync_buffer + offset, src, first_part_size);
+		memcpy(sync_buffer, src + first_part_size, bytes_written - first_part_size);
 	}
 
-	sync_write_pos = new_write_pos;
-	if (sync_write_pos > sync_read_pos + sync_buffer_size)
-		sync_write_pos -= sync_buffer_size;
-	PLATFORM_SoundUnlock();
+	/* Publish the new samples to the consumer. */
+	SYNC_STORE(sync_ring.write_pos, write_pos + bytes_written);
+	SYNC_UNLOCK();
 }
 
 void Sound_Update(void)
@@ -471,13 +669,21 @@ void Sound_SetLatency(unsigned int latency)
 		enum { SYNC_BUFFER_FRAGS = 5 };
 		unsigned int bytes_per_frame = Sound_out.channels * Sound_out.sample_size;
 		unsigned int latency_frames = Sound_out.freq*Sound_latency/1000;
+		unsigned int size = (latency_frames + SYNC_BUFFER_FRAGS*Sound_out.buffer_frames) * bytes_per_frame;
+		/* The ring needs a power-of-2 size. A power of 2 is always
+		   a multiple of bytes_per_frame (1, 2 or 4). */
+		if ((size & (size - 1)) != 0)
+			size = Sound_NextPow2(size);
+		/* The buffer is reallocated, so the callback must not run meanwhile. */
 		PLATFORM_SoundLock();
-		sync_buffer_size = (latency_frames + SYNC_BUFFER_FRAGS*Sound_out.buffer_frames) * bytes_per_frame;
+		sync_buffer_size = size;
 		sync_min_fill = latency_frames * bytes_per_frame;
 		sync_max_fill = sync_min_fill + Sound_out.buffer_frames * bytes_per_frame;
 		avg_fill = sync_min_fill;
-		sync_read_pos = 0;
-		sync_write_pos = sync_min_fill;
+		SYNC_STORE(sync_ring.read_pos, 0);
+		SYNC_STORE(sync_ring.write_pos, sync_min_fill);
+		SYNC_STORE(sync_ring.underruns, 0);
+		SYNC_STORE(sync_ring.overruns, 0);
 		free(sync_buffer);
 		sync_buffer = Util_malloc(sync_buffer_size);
 		memset(sync_buffer, 0, sync_buffer_size);
@@ -485,14 +691,24 @@ void Sound_SetLatency(unsigned int latency)
 	}
 }
 
+unsigned int Sound_GetUnderruns(void)
+{
+	return SYNC_LOAD(sync_ring.underruns);
+}
+
+unsigned int Sound_GetOverruns(void)
+{
+	return SYNC_LOAD(sync_ring.overruns);
+}
+
 double Sound_AdjustSpeed(void)
 {
 	double delay_mult = 1.0;
-	static double const alpha = 2.0/(1.0+40.0);
 
-	if (Sound_enabled && !paused) {
+	/* With dynamic rate control the emulation speed is left alone. */
+	if (Sound_enabled && !paused && !Sound_drc_enabled) {
 #if 1
-		avg_fill = avg_fill + alpha * (sync_est_fill - avg_fill);
+		UpdateAvgFill();
 		if (avg_fill < sync_min_fill)
 			delay_mult = 0.95;
 		else if (avg_fill > sync_max_fill)
@@ -14,7 +14,8 @@ void Sound_Continue(void);
 
 /* Nomenclature used:
    Sample - a single portion of one channel of audio signal. Sample size equals
-   1 byte for 8-bit audio and 2 bytes for 16-bit audio.
+   1 byte for 8-bit audio, 2 bytes for 16-bit audio and 4 bytes for float
+   audio.
    Frame - a single portion of samples for all channels of audio signal. Frame
    size equals sample size * number of channels.
    The word "size", unless additionally specified, means size in bytes.
@@ -25,9 +26,11 @@ typedef struct Sound_setup_t {
 	unsigned int freq;
 	/* Number of bytes per each sample, also determines sample format:
 	   1 = unsigned 8-bit format.
-	   2 = signed 16-bit system-endian format. */
+	   2 = signed 16-bit system-endian format.
+	   4 = 32-bit float system-endian format, range -1.0..1.0. */
 	int sample_size;
-	/* Number of audio channels: 1 = mono, 2 = stereo. */
+	/* Number of audio channels: 1 = mono, 2 = stereo, 4 = one channel for
+	   each of four POKEYs. */
 	unsigned int channels;
 	/* Length of the hardware audio buffer in milliseconds. */
 	unsigned int buffer_ms;
@@ -80,11 +83,24 @@ extern unsigned int Sound_latency;
 
 void Sound_SetLatency(unsigned int latency);
 
+/* Number of times the audio output found the sync buffer empty (underrun,
+   heard as a crackle) and the emulation found it full (overrun), since the
+   last call to Sound_Setup or Sound_SetLatency. Use them to tune
+   Sound_latency. */
+unsigned int Sound_GetUnderruns(void);
+unsigned int Sound_GetOverruns(void);
+
 /* Returns a factor (1.0 by default) to adjust the speed of the emulation
  * so that if the sound buffer is too full or too empty. The emulation
- * slows down or speeds up to match the actual speed of sound output. */
+ * slows down or speeds up to match the actual speed of sound output.
+ * Always returns 1.0 when Sound_drc_enabled is set. */
 double Sound_AdjustSpeed(void);
 
+/* Indicates whether dynamic rate control is used to keep the sound buffer
+   filled: the POKEY output is resampled by up to +-0.5% instead of
+   adjusting the emulation speed with Sound_AdjustSpeed. */
+extern int Sound_drc_enabled;
+
 /* Helper function for use when hardware audio buffer size is required to
    equal a power of 2. Returns a power of 2 that is not lower than NUM
    (0 <= NUM < UINT_MAX). */
@@ -68,6 +68,9 @@ int PLATFORM_SoundSetup(Sound_setup_t *setup)
 		return FALSE;
 	}
 
+	if (setup->sample_size > 2)
+		/* Float samples not supported. */
+		setup->sample_size = 2;
 	if (setup->buffer_frames == 0)
 		/* Set buffer_frames automatically. */
 		frag_size = setup->freq / 50;
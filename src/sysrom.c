@@ -30,7 +30,14 @@
 #endif
 #include <stdarg.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#ifdef HAVE_SYS_STAT_H
+#include <sys/stat.h>
+#endif
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
 
 #include "sysrom.h"
 
@@ -281,10 +288,244 @@ static int MatchByName(char const *filename, int len, int only_if_not_set)
 	return -1;
 }
 
+#if defined(HAVE_STAT) && defined(HAVE_SYS_STAT_H)
+#define ROM_CACHE
+#endif
+
+#ifdef ROM_CACHE
+/* Persistent cache of CRCs of ROM image candidates, so that the files in
+   ROM directories don't have to be read at every start. An entry is valid
+   while the file keeps its size and modification time. */
+#define ROM_CACHE_NAME ".atari800.romcache"
+#define ROM_CACHE_HEADER "Atari800 ROM cache 1"
+
+typedef struct rom_cache_entry_t {
+	char *path;
+	int len;
+	long mtime;
+	ULONG crc;
+	int used; /* Looked up or added during this session */
+	struct rom_cache_entry_t *next;
+} rom_cache_entry_t;
+
+enum { ROM_CACHE_HASH_SIZE = 256 };
+static rom_cache_entry_t *rom_cache[ROM_CACHE_HASH_SIZE];
+static char rom_cache_filename[FILENAME_MAX];
+static int rom_cache_loaded = FALSE;
+static int rom_cache_modified = FALSE;
+
+static unsigned int HashPath(char const *path)
+{
+	unsigned int hash = 0;
+	while (*path != '\0')
+		hash = hash * 31 + (unsigned char)*path++;
+	return hash % ROM_CACHE_HASH_SIZE;
+}
+
+static rom_cache_entry_t *FindInCache(char const *path)
+{
+	rom_cache_entry_t *entry = rom_cache[HashPath(path)];
+	while (entry != NULL && strcmp(entry->path, path) != 0)
+		entry = entry->next;
+	return entry;
+}
+
+static rom_cache_entry_t *AddToCache(char const *path, int len, long mtime, ULONG crc)
+{
+	rom_cache_entry_t *entry = FindInCache(path);
+	if (entry == NULL) {
+		unsigned int hash = HashPath(path);
+		entry = (rom_cache_entry_t *)Util_malloc(sizeof(rom_cache_entry_t));
+		entry->path = Util_strdup(path);
+		entry->used = FALSE;
+		entry->next = rom_cache[hash];
+		rom_cache[hash] = entry;
+	}
+	entry->len = len;
+	entry->mtime = mtime;
+	entry->crc = crc;
+	return entry;
+}
+
+/* Reads the cache file, once per session. The cache is kept in the home
+   directory; without one, nothing is cached. */
+static void LoadRomCache(void)
+{
+	char const *home;
+	FILE *fp;
+	char line[FILENAME_MAX + 64];
+
+	if (rom_cache_loaded)
+		return;
+	rom_cache_loaded = TRUE;
+	home = getenv("HOME");
+	if (home == NULL)
+		return;
+	Util_catpath(rom_cache_filename, home, ROM_CACHE_NAME);
+	if ((fp = fopen(rom_cache_filename, "r")) == NULL)
+		return;
+	if (fgets(line, sizeof(line), fp) != NULL) {
+		Util_chomp(line);
+		if (strcmp(line, ROM_CACHE_HEADER) == 0) {
+			while (fgets(line, sizeof(line), fp) != NULL) {
+				unsigned long crc;
+				int len;
+				long mtime;
+				int pos;
+				Util_chomp(line);
+				if (sscanf(line, "%lx %d %ld %n", &crc, &len, &mtime, &pos) >= 3 && line[pos] != '\0')
+					AddToCache(line + pos, len, mtime, (ULONG)crc);
+			}
+		}
+	}
+	fclose(fp);
+}
+
+/* Writes the cache file if anything was added. Entries not used during this
+   session are dropped if their files no longer exist. */
+static void SaveRomCache(void)
+{
+	char temp_filename[FILENAME_MAX];
+	FILE *fp;
+	int i;
+
+	if (!rom_cache_modified || rom_cache_filename[0] == '\0')
+		return;
+	rom_cache_modified = FALSE;
+	/* Replace the file at once, in case more instances start together. */
+	Util_strlcpy(temp_filename, rom_cache_filename, FILENAME_MAX - 4);
+	strcat(temp_filename, ".tmp");
+	if ((fp = fopen(temp_filename, "w")) == NULL)
+		return;
+	fprintf(fp, "%s\n", ROM_CACHE_HEADER);
+	for (i = 0; i < ROM_CACHE_HASH_SIZE; ++i) {
+		rom_cache_entry_t *entry;
+		for (entry = rom_cache[i]; entry != NULL; entry = entry->next) {
+			struct stat status;
+			if (!entry->used && stat(entry->path, &status) != 0)
+				continue;
+			fprintf(fp, "%08lx %d %ld %s\n", (unsigned long)entry->crc, entry->len, entry->mtime, entry->path);
+		}
+	}
+	if (fclose(fp) != 0 || rename(temp_filename, rom_cache_filename) != 0)
+		remove(temp_filename);
+}
+#endif /* ROM_CACHE */
+
+/* A file in a ROM directory with a ROM image size. */
+typedef struct {
+	char *name;
+	int len;
+	long mtime;
+	ULONG crc;
+	int need_crc; /* CRC not known from the cache */
+	int crc_ok; /* CRC is known */
+} candidate_t;
+
+/* Computes CRC of CANDIDATE, which is in DIRECTORY. */
+static void ComputeCandidateCRC(char const *directory, candidate_t *candidate)
+{
+	char full_filename[FILENAME_MAX];
+	FILE *file;
+	Util_catpath(full_filename, directory, candidate->name);
+	if ((file = fopen(full_filename, "rb")) != NULL) {
+		candidate->crc_ok = CRC32_FromFile(file, &candidate->crc);
+		fclose(file);
+	}
+}
+
+/* Candidates handed out to threads computing the CRCs. */
+typedef struct {
+	char const *directory;
+	candidate_t *candidates;
+	int num;
+	int next;
+#ifdef HAVE_PTHREAD
+	pthread_mutex_t mutex;
+#endif
+} crc_job_t;
+
+static void *CRCWorker(void *arg)
+{
+	crc_job_t *job = (crc_job_t *)arg;
+	for (;;) {
+		int i;
+#ifdef HAVE_PTHREAD
+		pthread_mutex_lock(&job->mutex);
+#endif
+		while (job->next < job->num && !job->candidates[job->next].need_crc)
+			++job->next;
+		i = job->next++;
+#ifdef HAVE_PTHREAD
+		pthread_mutex_unlock(&job->mutex);
+#endif
+		if (i >= job->num)
+			break;
+		ComputeCandidateCRC(job->directory, &job->candidates[i]);
+	}
+	return NULL;
+}
+
+/* Computes CRCs of the NUM CANDIDATES which need it. The files are read in
+   parallel, which mostly helps with slow storage. */
+static void ComputeCRCs(char const *directory, candidate_t *candidates, int num, int num_needed)
+{
+	enum { MAX_THREADS = 4 };
+	crc_job_t job;
+#ifdef HAVE_PTHREAD
+	pthread_t threads[MAX_THREADS - 1];
+	int num_threads = 0;
+#endif
+	job.directory = directory;
+	job.candidates = candidates;
+	job.num = num;
+	job.next = 0;
+#ifdef HAVE_PTHREAD
+	if (num_needed > 1 && pthread_mutex_init(&job.mutex, NULL) == 0) {
+		/* The calling thread works too. */
+		while (num_threads < MAX_THREADS - 1 && num_threads < num_needed - 1
+		       && pthread_create(&threads[num_threads], NULL, CRCWorker, &job) == 0)
+			++num_threads;
+		CRCWorker(&job);
+		while (num_threads > 0)
+			pthread_join(threads[--num_threads], NULL);
+		pthread_mutex_destroy(&job.mutex);
+		return;
+	}
+#endif
+	CRCWorker(&job);
+}
+
+/* Gets length and modification time of FILENAME. Returns FALSE if it's not
+   a readable file. */
+static int GetFileInfo(char const *filename, int *len, long *mtime)
+{
+#ifdef ROM_CACHE
+	struct stat status;
+	if (stat(filename, &status) != 0 || !S_ISREG(status.st_mode))
+		return FALSE;
+	*len = status.st_size > 0x7fffffff ? 0x7fffffff : (int)status.st_size;
+	*mtime = (long)status.st_mtime;
+#else
+	FILE *file;
+	if ((file = fopen(filename, "rb")) == NULL)
+		return FALSE;
+	*len = Util_flen(file);
+	*mtime = 0;
+	fclose(file);
+#endif
+	return TRUE;
+}
+
 int SYSROM_FindInDir(char const *directory, int only_if_not_set)
 {
 	DIR *dir;
 	struct dirent *entry;
+	candidate_t *candidates = NULL;
+	int num_candidates = 0;
+	int max_candidates = 0;
+	int num_needed = 0;
+	int i;
 
 	if (only_if_not_set && num_unset_roms == 0)
 		/* No unset ROM paths left. */
@@ -293,37 +534,72 @@ int SYSROM_FindInDir(char const *directory, int only_if_not_set)
 	if ((dir = opendir(directory)) == NULL)
 		return FALSE;
 
+#ifdef ROM_CACHE
+	LoadRomCache();
+#endif
+
+	/* Collect files of ROM image sizes, in directory order. */
 	while ((entry = readdir(dir)) != NULL) {
 		char full_filename[FILENAME_MAX];
-		FILE *file;
+		candidate_t *candidate;
 		int len;
-		int id;
-		ULONG crc;
-		int matched_crc = FALSE;
+		long mtime;
 		Util_catpath(full_filename, directory, entry->d_name);
-		if ((file = fopen(full_filename, "rb")) == NULL)
-			/* Ignore non-readable files (e.g. directories). */
-			continue;
-
-		len = Util_flen(file);
-		/* Don't proceed to CRC computation if the file has invalid size. */
-		if (!IsLengthAllowed(len)){
-			fclose(file);
+		/* Ignore non-readable files (e.g. directories), and don't proceed
+		   to CRC computation if the file has invalid size. */
+		if (!GetFileInfo(full_filename, &len, &mtime) || !IsLengthAllowed(len))
 			continue;
+		if (num_candidates == max_candidates) {
+			max_candidates = max_candidates == 0 ? 16 : max_candidates * 2;
+			candidates = (candidate_t *)Util_realloc(candidates, max_candidates * sizeof(candidate_t));
+		}
+		candidate = &candidates[num_candidates++];
+		candidate->name = Util_strdup(entry->d_name);
+		candidate->len = len;
+		candidate->mtime = mtime;
+		candidate->need_crc = TRUE;
+		candidate->crc_ok = FALSE;
+#ifdef ROM_CACHE
+		{
+			rom_cache_entry_t *cached = FindInCache(full_filename);
+			if (cached != NULL && cached->len == len && cached->mtime == mtime) {
+				candidate->crc = cached->crc;
+				candidate->crc_ok = TRUE;
+				candidate->need_crc = FALSE;
+				cached->used = TRUE;
+			}
 		}
-		Util_rewind(file);
+#endif
+		if (candidate->need_crc)
+			++num_needed;
+	}
+	closedir(dir);
+
+	if (num_needed > 0)
+		ComputeCRCs(directory, candidates, num_candidates, num_needed);
+
+	for (i = 0; i < num_candidates; ++i) {
+		candidate_t *candidate = &candidates[i];
+		char full_filename[FILENAME_MAX];
+		int len = candidate->len;
+		int id;
+		int matched_crc = FALSE;
 
-		if (!CRC32_FromFile(file, &crc)) {
-			fclose(file);
+		if (!candidate->crc_ok)
 			continue;
+		Util_catpath(full_filename, directory, candidate->name);
+#ifdef ROM_CACHE
+		if (candidate->need_crc) {
+			AddToCache(full_filename, len, candidate->mtime, candidate->crc)->used = TRUE;
+			rom_cache_modified = TRUE;
 		}
-		fclose(file);
+#endif
 
 		/* Match ROM image by CRC. */
 		for (id = 0; id < SYSROM_LOADABLE_SIZE; ++id) {
 			if ((!only_if_not_set || SYSROM_roms[id].unset)
 			    && SYSROM_roms[id].size == len
-			    && SYSROM_roms[id].crc32 != CRC_NULL && SYSROM_roms[id].crc32 == crc) {
+			    && SYSROM_roms[id].crc32 != CRC_NULL && SYSROM_roms[id].crc32 == candidate->crc) {
 				strcpy(SYSROM_roms[id].filename, full_filename);
 				ClearUnsetFlag(id);
 				matched_crc = TRUE;
@@ -333,13 +609,13 @@ int SYSROM_FindInDir(char const *directory, int only_if_not_set)
 
 		if (!matched_crc) {
 			/* Match custom ROM image by name. */
-			char *c = entry->d_name;
+			char *c = candidate->name;
 			while (*c != 0) {
 				*c = (char)tolower(*c);
 				++c;
 			}
 
-			id = MatchByName(entry->d_name, len, only_if_not_set);
+			id = MatchByName(candidate->name, len, only_if_not_set);
 			if (id >= 0){
 				strcpy(SYSROM_roms[id].filename, full_filename);
 				ClearUnsetFlag(id);
@@ -347,7 +623,12 @@ int SYSROM_FindInDir(char const *directory, int only_if_not_set)
 		}
 	}
 
-	closedir(dir);
+	for (i = 0; i < num_candidates; ++i)
+		free(candidates[i].name);
+	free(candidates);
+#ifdef ROM_CACHE
+	SaveRomCache();
+#endif
 	return TRUE;
 }
 
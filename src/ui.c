@@ -79,6 +79,7 @@
 #include "bit3.h"
 #endif /* BIT3 */
 #ifdef SOUND
+#include "pokey.h"
 #include "pokeysnd.h"
 #include "sound.h"
 #endif /* SOUND */
@@ -1524,9 +1525,16 @@ static void TapeSliderLabel(char *label, int value, void *user_data)
 		snprintf(label, 10, "%u", (unsigned int)value + 1);
 }
 
+/* Callback function that writes a tape time given in seconds to *LABEL. */
+static void TapeTimeSliderLabel(char *label, int value, void *user_data)
+{
+	snprintf(label, 10, "%d:%02d", value / 60, value % 60);
+}
+
 static void TapeManagement(void)
 {
 	static char position_string[17];
+	static char time_string[20];
 	static char cas_symbol[] = " C:";
 
 	static UI_tMenuItem menu_array[] = {
@@ -1534,7 +1542,9 @@ static void TapeManagement(void)
 		UI_MENU_LABEL("Description:"),
 		UI_MENU_LABEL(CASSETTE_description),
 		UI_MENU_ACTION_PREFIX_TIP(1, "Position: ", position_string, NULL),
+		UI_MENU_ACTION_PREFIX_TIP(5, "Time: ", time_string, NULL),
 		UI_MENU_CHECK(2, "Record:"),
+		UI_MENU_CHECK(4, "Turbo loading:"),
 		UI_MENU_SUBMENU(3, "Make blank tape"),
 		UI_MENU_END
 	};
@@ -1553,31 +1563,41 @@ static void TapeManagement(void)
 			menu_array[0].item = "None";
 			menu_array[0].suffix = "Return:insert";
 			menu_array[3].suffix = "Tape not loaded";
+			menu_array[4].suffix = "Tape not loaded";
 			cas_symbol[0] = ' ';
 			break;
 		case CASSETTE_STATUS_READ_ONLY:
 			menu_array[0].item = CASSETTE_filename;
 			menu_array[0].suffix = "Return:insert Backspace:eject";
 			menu_array[3].suffix = "Return:change Backspace:rewind";
+			menu_array[4].suffix = "Return:change Backspace:rewind";
 			cas_symbol[0] = '*';
 			break;
 		default: /* CASSETTE_STATUS_READ_WRITE */
 			menu_array[0].item = CASSETTE_filename;
 			menu_array[0].suffix = "Ret:insert Bksp:eject Space:read-only";
 			menu_array[3].suffix = "Return:change Backspace:rewind";
+			menu_array[4].suffix = "Return:change Backspace:rewind";
 			cas_symbol[0] = CASSETTE_write_protect ? '*' : ' ';
 			break;
 		}
 
 		SetItemChecked(menu_array, 2, CASSETTE_record);
+		SetItemChecked(menu_array, 4, CASSETTE_turbo);
 
-		if (CASSETTE_status == CASSETTE_STATUS_NONE)
+		if (CASSETTE_status == CASSETTE_STATUS_NONE) {
 			memcpy(position_string, "N/A", 4);
+			memcpy(time_string, "N/A", 4);
+		}
 		else {
+			unsigned int time = CASSETTE_GetTime(position) / 1000;
+			unsigned int length = CASSETTE_GetTime(size + 1) / 1000;
 			if (position > size)
 				snprintf(position_string, sizeof(position_string) - 1, "End/%u blocks", size);
 			else
 				snprintf(position_string, sizeof(position_string) - 1, "%u/%u blocks", position, size);
+			snprintf(time_string, sizeof(time_string) - 1, "%u:%02u/%u:%02u",
+			         time / 60, time % 60, length / 60, length % 60);
 		}
 
 		option = UI_driver->fSelect("Tape Management", 0, option, menu_array, &seltype);
@@ -1625,6 +1645,25 @@ static void TapeManagement(void)
 				break;
 			}
 			break;
+		case 5:
+			if (CASSETTE_status == CASSETTE_STATUS_NONE)
+				break;
+
+			switch (seltype) {
+			case UI_USER_SELECT: { /* Enter */
+					unsigned int length = CASSETTE_GetTime(size + 1) / 1000;
+					int value = UI_driver->fSelectSlider("Position tape",
+					                                     CASSETTE_GetTime(position) / 1000,
+					                                     length, &TapeTimeSliderLabel, NULL);
+					if (value != -1)
+						CASSETTE_SeekTime(value * 1000);
+				}
+				break;
+			case UI_USER_DELETE: /* Backspace */
+				CASSETTE_Seek(1);
+				break;
+			}
+			break;
 		case 2:
 			/* Toggle only if the cassette is mounted. */
 			if (CASSETTE_status != CASSETTE_STATUS_NONE && !CASSETTE_ToggleRecord())
@@ -1633,6 +1672,9 @@ static void TapeManagement(void)
 		case 3:
 			MakeBlankTapeMenu();
 			break;
+		case 4:
+			CASSETTE_turbo = !CASSETTE_turbo;
+			break;
 		default:
 			return;
 		}
@@ -2215,6 +2257,7 @@ static void AtariSettings(void)
 		UI_MENU_SUBMENU_SUFFIX(18, "Enable XEP80:", NULL),
 #endif /* XEP80_EMULATION */
 		UI_MENU_CHECK(3, "SIO patch (fast disk access):"),
+		UI_MENU_CHECK(20, "Accelerated SIO without patch:"),
 		UI_MENU_CHECK(17, "Turbo (F12):"),
 		UI_MENU_CHECK(19, "Slow booting of DOS binary files:"),
 		UI_MENU_CHECK(5, "P: device (printer):"),
@@ -2245,6 +2288,7 @@ static void AtariSettings(void)
 		SetItemChecked(menu_array, 1, CASSETTE_hold_start_on_reboot);
 		SetItemChecked(menu_array, 2, RTIME_enabled);
 		SetItemChecked(menu_array, 3, ESC_enable_sio_patch);
+		SetItemChecked(menu_array, 20, SIO_accelerate);
 #ifdef XEP80_EMULATION
 		FindMenuItem(menu_array, 18)->suffix = xep80_menu_array[XEP80_enabled ? XEP80_port + 1 : 0].item;
 #endif /* XEP80_EMULATION */
@@ -2272,6 +2316,9 @@ static void AtariSettings(void)
 		case 3:
 			ESC_enable_sio_patch = !ESC_enable_sio_patch;
 			break;
+		case 20:
+			SIO_accelerate = !SIO_accelerate;
+			break;
 		case 5:
 			Devices_enable_p_patch = !Devices_enable_p_patch;
 			break;
@@ -3644,6 +3691,7 @@ static int SoundSettings(void)
 		UI_MENU_ACTION(2, "Bit depth:"),
 		UI_MENU_SUBMENU_SUFFIX(3, "Hardware buffer length:", hw_buflen_string),
 		UI_MENU_SUBMENU_SUFFIX(4, "Latency:", latency_string),
+		UI_MENU_CHECK(8, "Dynamic rate control:"),
 #ifdef DREAMCAST
 		UI_MENU_CHECK(0, "Enable sound:"),
 #endif
@@ -3664,7 +3712,7 @@ static int SoundSettings(void)
 		if (update_sound_params) {
 			SetItemChecked(menu_array, 0, Sound_enabled);
 			snprintf(freq_string, sizeof(freq_string), "%i Hz", setup.freq);
-			menu_array[2].suffix = setup.sample_size == 2 ? "16 bit" : "8 bit";
+			menu_array[2].suffix = setup.sample_size == 4 ? "float" : setup.sample_size == 2 ? "16 bit" : "8 bit";
 			if (setup.buffer_ms == 0) {
 				if (Sound_enabled && sound_out_valid) {
 					snprintf(hw_buflen_string, sizeof(hw_buflen_string), "auto (%u ms)", Sound_out.buffer_ms);
@@ -3675,11 +3723,12 @@ static int SoundSettings(void)
 			}
 			else
 				snprintf(hw_buflen_string, sizeof(hw_buflen_string), "%u ms", setup.buffer_ms);
+		}
 #ifdef STEREO_SOUND
-			SetItemChecked(menu_array, 5, setup.channels == 2);
+		SetItemChecked(menu_array, 5, POKEY_NumChips() > 1);
 #endif /* STEREO_SOUND */
-		}
 		snprintf(latency_string, sizeof(latency_string), "%u ms", Sound_latency);
+		SetItemChecked(menu_array, 8, Sound_drc_enabled);
 		SetItemChecked(menu_array, 6, POKEYSND_enable_new_pokey);
 #ifdef CONSOLE_SOUND
 		SetItemChecked(menu_array, 7, POKEYSND_console_sound_enabled);
@@ -3724,7 +3773,7 @@ static int SoundSettings(void)
 			}
 			break;
 		case 2:
-			setup.sample_size = 3 - setup.sample_size; /* Toggle 1<->2 */
+			setup.sample_size = setup.sample_size == 4 ? 1 : setup.sample_size * 2; /* Cycle 1->2->4 */
 			update_sound_params = TRUE;
 			break;
 		case 3:
@@ -3755,9 +3804,16 @@ static int SoundSettings(void)
 			if (UI_driver->fEditString("Enter sound latency", latency_string, sizeof(latency_string)-3))
 				Sound_SetLatency(atoi(latency_string));
 			break;
+		case 8:
+			Sound_drc_enabled = !Sound_drc_enabled;
+			break;
 #ifdef STEREO_SOUND
 		case 5:
-			setup.channels = 3 - setup.channels; /* Toggle 1<->2 */
+			/* Switch between one POKEY and two. Switching off from quad
+			   mode goes back to a single POKEY, too. */
+			POKEYSND_stereo_enabled = POKEY_NumChips() == 1;
+			POKEYSND_quad_enabled = FALSE;
+			setup.channels = POKEYSND_stereo_enabled ? 2 : 1;
 			update_sound_params = TRUE;
 			break;
 #endif
@@ -41,7 +41,7 @@
 #define VTRX_RATE 24500
 
 static double ratio;
-static int bit16;
+static int snd_flags;
 #define VTRX_BLOCK_SIZE 1024
 SWORD *temp_votrax_buffer = NULL;
 SWORD *votrax_buffer = NULL;
@@ -90,11 +90,11 @@ static int votraxsnd_enabled(void)
 }
 
 /* called from POKEYSND_Init */
-void VOTRAXSND_Init(int playback_freq, int n_pokeys, int b16)
+void VOTRAXSND_Init(int playback_freq, int n_pokeys, int flags)
 {
 	static struct Votrax_interface vi;
 	int temp_votrax_buffer_size;
-	bit16 = b16;
+	snd_flags = flags;
 	dsprate = playback_freq;
 	num_pokeys = n_pokeys;
 	if (!votraxsnd_enabled()) return;
@@ -130,7 +130,7 @@ void VOTRAXSND_Init(int playback_freq, int n_pokeys, int b16)
 
 void VOTRAXSND_Reinit(void)
 {
-	if (dsprate) VOTRAXSND_Init(dsprate, num_pokeys, bit16);
+	if (dsprate) VOTRAXSND_Init(dsprate, num_pokeys, snd_flags);
 }
 
 /* process votrax and interpolate samples */
@@ -233,6 +233,19 @@ static void mix8(UBYTE *dst, SWORD *src, int sndn, int volume)
 	}
 }
 
+/* float mixing */
+static void mix_float(float *dst, SWORD *src, int sndn, int volume)
+{
+	float const scale = volume / (128.0f * 32768.0f);
+
+	while (sndn--) {
+		*dst++ += *src++ * scale;
+		if (num_pokeys == 2) {
+			dst++;
+		}
+	}
+}
+
 void VOTRAXSND_Frame(void)
 {
 	if (!votraxsnd_enabled()) return;
@@ -265,9 +278,10 @@ void VOTRAXSND_Process(void *sndbuffer, int sndn)
 	while (sndn > 0) {
 		int amount = ((sndn > VTRX_BLOCK_SIZE) ? VTRX_BLOCK_SIZE : sndn);
 		votrax_process(votrax_buffer, amount, temp_votrax_buffer);
-		if (bit16) mix((SWORD *)sndbuffer, votrax_buffer, amount, POKEYSND_volume >> 3);
+		if (snd_flags & POKEYSND_FLOAT32) mix_float((float *)sndbuffer, votrax_buffer, amount, POKEYSND_volume >> 3);
+		else if (snd_flags & POKEYSND_BIT16) mix((SWORD *)sndbuffer, votrax_buffer, amount, POKEYSND_volume >> 3);
 		else mix8((UBYTE *)sndbuffer, votrax_buffer, amount, POKEYSND_volume >> 3);
-		sndbuffer = (char *) sndbuffer + VTRX_BLOCK_SIZE*(bit16 ? 2 : 1)*((num_pokeys == 2) ? 2: 1);
+		sndbuffer = (char *) sndbuffer + VTRX_BLOCK_SIZE*POKEYSND_SAMPLE_SIZE(snd_flags)*((num_pokeys == 2) ? 2: 1);
 		sndn -= VTRX_BLOCK_SIZE;
 	}
 }
@@ -5,7 +5,8 @@
 #include "votrax.h"
 
 void VOTRAXSND_PutByte(UBYTE byte);
-void VOTRAXSND_Init(int playback_freq, int n_pokeys, int b16);
+/* FLAGS are the POKEYSND_Init flags, selecting the sample format. */
+void VOTRAXSND_Init(int playback_freq, int n_pokeys, int flags);
 void VOTRAXSND_Frame(void);
 void VOTRAXSND_Process(void *sndbuffer, int sndn);
 extern int VOTRAXSND_busy;
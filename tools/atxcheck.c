@@ -0,0 +1,568 @@
+/*
+ * atxcheck.c - check of the ATX (VAPI) disk image emulation
+ *
+ * Copyright (C) 2026 Atari800 development team (see DOC/CREDITS)
+ *
+ * This file is part of the Atari800 emulator project which emulates
+ * the Atari 400, 800, 800XL, 130XE, and 5200 8-bit computers.
+ *
+ * Atari800 is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Atari800 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Atari800; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/* Writes synthetic ATX images and reads them back through the emulated
+   drive: every sector of a disk with a missing, a bad, a duplicate and a
+   weak sector and with its tracks out of order, the copy of the duplicate
+   sector chosen at several disk positions, with the timing of each read,
+   and images with invalid tracks or sectors, which must be refused. Also
+   checks that -sioaccel never speeds up the reads of an ATX image, unlike
+   those of an ATR image, and, if built with VAPI_WRITE_ENABLE, that written
+   sectors reach the file. Prints the checks that fail, and a summary at the
+   end. */
+
+#include "config.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "siohost.h"
+#include "sio.h"
+
+/* Drive timing, in CPU cycles - same as in sio.c */
+#define BYTES_PER_TRACK    26042.0
+#define CYCLES_PER_ROT     372706
+#define CYCLES_TRACK_STEP  35780
+#define CYCLES_HEAD_SETTLE 70134
+#define CYCLES_TRACK_READ_DELTA 1426
+#define CYCLES_CMD_ACK_TRANS 3188
+#define CYCLES_SECTOR_READ 29014
+#define CYCLES_MISSING_SECTOR (2 * CYCLES_PER_ROT + 14453)
+#define CYCLES_BAD_SECTOR  (CYCLES_PER_ROT + 10000)
+
+#define TRACKS 40
+#define SECTORS_PER_TRACK 18
+#define SECTOR_SIZE 128
+
+/* The special sectors of the test disk. */
+#define MISSING_SECTOR 23 /* track 1 */
+#define DUP_SECTOR 39     /* track 2, also at DUP_POS2 */
+#define BAD_SECTOR 61     /* track 3 */
+#define WEAK_SECTOR 75    /* track 4 */
+#define WEAK_OFFSET 64
+#define WRITE_SECTOR 100  /* track 5 */
+#define DUP_POS2 15000
+
+/* One sector header of the image to write. */
+typedef struct {
+	int track;
+	int sector;  /* 1..18 on the track */
+	int pos;     /* Position on the track, 0..BYTES_PER_TRACK */
+	UBYTE status; /* FDC status as stored in the image: 0 if OK */
+	int weak;    /* First weak byte, -1 if none */
+	UBYTE fill;  /* XORed with the sector pattern, to tell copies apart */
+} atx_sector_t;
+
+static const char *image_file = "atxcheck.atx";
+static int checks = 0;
+static int failures = 0;
+
+static void check(int ok, const char *format, ...)
+{
+	checks++;
+	if (!ok) {
+		va_list args;
+		va_start(args, format);
+		printf("FAIL: ");
+		vprintf(format, args);
+		printf("\n");
+		va_end(args);
+		failures++;
+	}
+}
+
+static UBYTE Pattern(int sector, int i)
+{
+	return (UBYTE) (sector * 7 + i);
+}
+
+static void Put16(UBYTE *p, int value)
+{
+	p[0] = (UBYTE) value;
+	p[1] = (UBYTE) (value >> 8);
+}
+
+static void Put32(UBYTE *p, ULONG value)
+{
+	Put16(p, (int) (value & 0xffff));
+	Put16(p + 2, (int) (value >> 16));
+}
+
+/* Writes the image with sectors SECTORS[0..N-1], with the tracks in the
+   order of TRACKS[0..NUM_TRACKS-1] and the sectors of a track in the order
+   of SECTORS. Only the first LENGTH bytes are written, if LENGTH >= 0.
+   Returns FALSE if the file cannot be written. */
+static int WriteImage(const atx_sector_t *sectors, int n, const int *tracks, int num_tracks, long length)
+{
+	UBYTE *image;
+	ULONG size;
+	ULONG pos;
+	FILE *fp;
+	int t;
+	int result;
+
+	image = (UBYTE *) calloc(1, 48 + num_tracks * 64 + n * (16 + SECTOR_SIZE));
+	if (image == NULL)
+		return FALSE;
+	memcpy(image, "AT8X", 4);
+	image[4] = 1; /* version */
+	Put32(image + 28, 48); /* first track */
+	pos = 48;
+	for (t = 0; t < num_tracks; t++) {
+		UBYTE *track = image + pos;
+		ULONG list = 32;
+		ULONG chunk;
+		int count = 0;
+		int i;
+		for (i = 0; i < n; i++)
+			if (sectors[i].track == tracks[t])
+				count++;
+		track[8] = (UBYTE) tracks[t];
+		Put16(track + 10, count);
+		Put32(track + 20, list);
+		/* sector list */
+		Put32(track + list, 8 + 8 * count);
+		track[list + 4] = 1;
+		/* sector data chunk */
+		chunk = list + 8 + 8 * count;
+		Put32(track + chunk, 8 + SECTOR_SIZE * count);
+		count = 0;
+		for (i = 0; i < n; i++) {
+			const atx_sector_t *s = &sectors[i];
+			UBYTE *header = track + list + 8 + 8 * count;
+			ULONG data = chunk + 8 + SECTOR_SIZE * count;
+			int j;
+			if (s->track != tracks[t])
+				continue;
+			header[0] = (UBYTE) s->sector;
+			header[1] = s->status;
+			Put16(header + 2, s->pos);
+			Put32(header + 4, data);
+			for (j = 0; j < SECTOR_SIZE; j++)
+				track[data + j] = Pattern(s->track * SECTORS_PER_TRACK + s->sector, j) ^ s->fill;
+			count++;
+		}
+		/* weak sector chunks, then the end of the track */
+		chunk += 8 + SECTOR_SIZE * count;
+		count = 0;
+		for (i = 0; i < n; i++) {
+			if (sectors[i].track != tracks[t])
+				continue;
+			if (sectors[i].weak >= 0) {
+				Put32(track + chunk, 8);
+				track[chunk + 4] = 0x10;
+				track[chunk + 5] = (UBYTE) count;
+				Put16(track + chunk + 6, sectors[i].weak);
+				chunk += 8;
+			}
+			count++;
+		}
+		chunk += 8;
+		Put32(track, chunk); /* next track */
+		pos += chunk;
+	}
+	size = length >= 0 && (ULONG) length < pos ? (ULONG) length : pos;
+	fp = fopen(image_file, "wb");
+	result = fp != NULL && fwrite(image, 1, size, fp) == size;
+	if (fp != NULL && fclose(fp) != 0)
+		result = FALSE;
+	free(image);
+	if (!result)
+		printf("Cannot write %s\n", image_file);
+	return result;
+}
+
+/* Position of a sector on the track, in CPU cycles. */
+static unsigned int RotPos(int pos)
+{
+	return (unsigned int) (((double) pos) / BYTES_PER_TRACK * CYCLES_PER_ROT);
+}
+
+/* Scanlines between the acknowledge and the completion byte of a read
+   lasting CYCLES. */
+static int Scanlines(unsigned int cycles)
+{
+	return (int) ((cycles + 114 / 2) / 114) - 12;
+}
+
+static int ReadSector(int sector, UBYTE *buffer, int *delay)
+{
+	return siohost_command(0, 0x52, sector, buffer, SECTOR_SIZE, delay);
+}
+
+/* Reads SECTOR with the head over track FROM_TRACK and the disk at
+   position CURRPOS (in cycles) when the drive starts looking for the
+   sector. */
+static int ReadSectorAt(int sector, int from_track, unsigned int currpos, UBYTE *buffer, int *delay)
+{
+	UBYTE dummy[SECTOR_SIZE];
+	int steps = abs((sector - 1) / SECTORS_PER_TRACK - from_track);
+	unsigned int clock = 100 * CYCLES_PER_ROT + currpos - CYCLES_CMD_ACK_TRANS;
+
+	/* Move the head. */
+	siohost_set_clock(0);
+	ReadSector(from_track * SECTORS_PER_TRACK + 1, dummy, NULL);
+	if (steps > 0)
+		clock -= steps * CYCLES_TRACK_STEP + CYCLES_HEAD_SETTLE;
+	siohost_set_clock(clock);
+	return ReadSector(sector, buffer, delay);
+}
+
+/* Returns TRUE if BUFFER holds sector SECTOR XORed with FILL from byte
+   FROM to TO - 1. */
+static int SameData(const UBYTE *buffer, int sector, UBYTE fill, int from, int to)
+{
+	int i;
+	for (i = from; i < to; i++)
+		if (buffer[i] != (Pattern(sector, i) ^ fill))
+			return FALSE;
+	return TRUE;
+}
+
+/* The test disk: all sectors at regular positions, in interleaved order,
+   except for the special ones. Returns the number of sectors. */
+static int MakeDisk(atx_sector_t *disk, int *tracks)
+{
+	static const int interleave[SECTORS_PER_TRACK] = {
+		1, 3, 5, 7, 9, 11, 13, 15, 17, 2, 4, 6, 8, 10, 12, 14, 16, 18
+	};
+	int n = 0;
+	int t;
+	int k;
+	for (t = 0; t < TRACKS; t++) {
+		/* Tracks 4 and 5 are stored in reverse order. */
+		tracks[t] = t == 4 ? 5 : t == 5 ? 4 : t;
+		for (k = 0; k < SECTORS_PER_TRACK; k++) {
+			int sector = t * SECTORS_PER_TRACK + interleave[k];
+			if (sector == MISSING_SECTOR)
+				continue;
+			disk[n].track = t;
+			disk[n].sector = interleave[k];
+			disk[n].pos = 100 + k * 1400;
+			disk[n].status = sector == BAD_SECTOR ? 0x08 /* CRC error */ : 0;
+			disk[n].weak = sector == WEAK_SECTOR ? WEAK_OFFSET : -1;
+			disk[n].fill = 0;
+			n++;
+			if (sector == DUP_SECTOR) {
+				disk[n] = disk[n - 1];
+				disk[n].pos = DUP_POS2;
+				disk[n].fill = 0xff;
+				n++;
+			}
+		}
+	}
+	return n;
+}
+
+/* Position of SECTOR on the test disk, in bytes. */
+static int DiskPos(const atx_sector_t *disk, int n, int sector)
+{
+	int i;
+	for (i = 0; i < n; i++)
+		if (disk[i].track * SECTORS_PER_TRACK + disk[i].sector == sector)
+			return disk[i].pos;
+	return -1;
+}
+
+static void CheckAllSectors(void)
+{
+	UBYTE buffer[SECTOR_SIZE];
+	int sector;
+	for (sector = 1; sector <= TRACKS * SECTORS_PER_TRACK; sector++) {
+		int delay;
+		int result;
+		siohost_set_clock(0);
+		result = ReadSector(sector, buffer, &delay);
+		if (sector == MISSING_SECTOR) {
+			check(result == 'E', "missing sector %d: result %d", sector, result);
+			check(delay == Scanlines(CYCLES_MISSING_SECTOR),
+			      "missing sector %d: delay %d, expected %d", sector, delay, Scanlines(CYCLES_MISSING_SECTOR));
+			continue;
+		}
+		check(result == (sector == BAD_SECTOR ? 'E' : 'C'), "sector %d: result %d", sector, result);
+		if (sector == DUP_SECTOR)
+			check(SameData(buffer, sector, 0, 0, SECTOR_SIZE) || SameData(buffer, sector, 0xff, 0, SECTOR_SIZE),
+			      "sector %d: data of neither copy", sector);
+		else
+			check(SameData(buffer, sector, 0, 0, sector == WEAK_SECTOR ? WEAK_OFFSET : SECTOR_SIZE),
+			      "sector %d: wrong data", sector);
+	}
+}
+
+static void CheckTiming(const atx_sector_t *disk, int n)
+{
+	UBYTE buffer[SECTOR_SIZE];
+	unsigned int dup1 = RotPos(DiskPos(disk, n, DUP_SECTOR));
+	unsigned int dup2 = RotPos(DUP_POS2);
+	unsigned int bad = RotPos(DiskPos(disk, n, BAD_SECTOR));
+	unsigned int read = CYCLES_CMD_ACK_TRANS + CYCLES_SECTOR_READ;
+	int delay;
+	int result;
+
+	/* The copy that comes first under the head is read. */
+	result = ReadSectorAt(DUP_SECTOR, 2, dup1 - 500, buffer, &delay);
+	check(result == 'C' && SameData(buffer, DUP_SECTOR, 0, 0, SECTOR_SIZE), "duplicate sector before copy 1: wrong copy");
+	check(delay == Scanlines(500 + read), "duplicate sector before copy 1: delay %d, expected %d", delay, Scanlines(500 + read));
+	result = ReadSectorAt(DUP_SECTOR, 2, dup1 + 1, buffer, &delay);
+	check(result == 'C' && SameData(buffer, DUP_SECTOR, 0xff, 0, SECTOR_SIZE), "duplicate sector after copy 1: wrong copy");
+	check(delay == Scanlines(dup2 - dup1 - 1 + read), "duplicate sector after copy 1: delay %d, expected %d",
+	      delay, Scanlines(dup2 - dup1 - 1 + read));
+	result = ReadSectorAt(DUP_SECTOR, 2, dup2 + 1, buffer, &delay);
+	check(result == 'C' && SameData(buffer, DUP_SECTOR, 0, 0, SECTOR_SIZE), "duplicate sector after copy 2: wrong copy");
+	check(delay == Scanlines(CYCLES_PER_ROT - dup2 - 1 + dup1 + read), "duplicate sector after copy 2: delay %d, expected %d",
+	      delay, Scanlines(CYCLES_PER_ROT - dup2 - 1 + dup1 + read));
+
+	/* Stepping from track 0 to track 2 */
+	result = ReadSectorAt(DUP_SECTOR, 0, dup2 - 500, buffer, &delay);
+	check(result == 'C' && SameData(buffer, DUP_SECTOR, 0xff, 0, SECTOR_SIZE), "duplicate sector after step: wrong copy");
+	check(delay == Scanlines(500 + 2 * CYCLES_TRACK_STEP + CYCLES_HEAD_SETTLE + CYCLES_TRACK_READ_DELTA + read),
+	      "duplicate sector after step: delay %d, expected %d",
+	      delay, Scanlines(500 + 2 * CYCLES_TRACK_STEP + CYCLES_HEAD_SETTLE + CYCLES_TRACK_READ_DELTA + read));
+
+	/* A bad sector takes another rotation, and its status is reported. */
+	result = ReadSectorAt(BAD_SECTOR, 3, bad - 500, buffer, &delay);
+	check(result == 'E', "bad sector: result %d", result);
+	check(delay == Scanlines(500 + read + CYCLES_BAD_SECTOR), "bad sector: delay %d, expected %d",
+	      delay, Scanlines(500 + read + CYCLES_BAD_SECTOR));
+	result = siohost_command(0, 0x53, 0, buffer, 4, NULL);
+	check(result == 'C' && buffer[0] == 0x0c && buffer[1] == 0xf7,
+	      "bad sector: status %d %02x %02x, expected C 0c f7", result, buffer[0], buffer[1]);
+}
+
+static void CheckWeakSector(void)
+{
+	UBYTE buffer1[SECTOR_SIZE];
+	UBYTE buffer2[SECTOR_SIZE];
+	int same = 0;
+	int tries;
+
+	/* The weak bytes read back differently at least once in a few reads. */
+	siohost_set_clock(0);
+	ReadSector(WEAK_SECTOR, buffer1, NULL);
+	for (tries = 0; tries < 4; tries++) {
+		ReadSector(WEAK_SECTOR, buffer2, NULL);
+		check(SameData(buffer2, WEAK_SECTOR, 0, 0, WEAK_OFFSET), "weak sector: wrong data before the weak bytes");
+		if (memcmp(buffer1 + WEAK_OFFSET, buffer2 + WEAK_OFFSET, SECTOR_SIZE - WEAK_OFFSET) == 0)
+			same++;
+	}
+	check(same < tries, "weak sector: the weak bytes read back the same %d times", same);
+}
+
+#ifdef VAPI_WRITE_ENABLE
+/* Writes a sector and checks that it reaches its place in the file, and
+   that sectors with several copies are not written. */
+static void CheckWrite(void)
+{
+	UBYTE buffer[SECTOR_SIZE];
+	int sector;
+	int result;
+	int i;
+
+	if (!SIO_Mount(1, image_file, FALSE)) {
+		check(FALSE, "test disk refused for writing");
+		return;
+	}
+	for (i = 0; i < SECTOR_SIZE; i++)
+		buffer[i] = Pattern(WRITE_SECTOR, i) ^ 0x55;
+	result = SIO_WriteSector(0, WRITE_SECTOR, buffer);
+	check(result == 'C', "write of sector %d: result %d", WRITE_SECTOR, result);
+	result = SIO_WriteSector(0, DUP_SECTOR, buffer);
+	check(result == 'E', "write of duplicate sector: result %d", result);
+	/* Written back to the file on dismount */
+	SIO_Dismount(1);
+	if (!SIO_Mount(1, image_file, TRUE)) {
+		check(FALSE, "written test disk refused");
+		return;
+	}
+	siohost_set_clock(0);
+	for (sector = WRITE_SECTOR - 1; sector <= WRITE_SECTOR + 1; sector++) {
+		ReadSector(sector, buffer, NULL);
+		check(SameData(buffer, sector, sector == WRITE_SECTOR ? 0x55 : 0, 0, SECTOR_SIZE),
+		      "sector %d: wrong data after writing sector %d", sector, WRITE_SECTOR);
+	}
+	ReadSector(DUP_SECTOR, buffer, NULL);
+	check(SameData(buffer, DUP_SECTOR, 0, 0, SECTOR_SIZE) || SameData(buffer, DUP_SECTOR, 0xff, 0, SECTOR_SIZE),
+	      "duplicate sector: wrong data after writing");
+	SIO_Dismount(1);
+}
+#endif /* VAPI_WRITE_ENABLE */
+
+/* With -sioaccel, every byte read from an ATX image still keeps the real
+   timing, which copy protections depend on. */
+static void CheckAtxAcceleration(void)
+{
+	UBYTE buffer[SECTOR_SIZE];
+	int sector;
+	SIO_accelerate = TRUE;
+	siohost_set_clock(0);
+	for (sector = 10; sector <= 12; sector++) {
+		ReadSector(sector, buffer, NULL);
+		check(siohost_early_bytes == 0, "accelerated ATX sector %d: %d early bytes", sector, siohost_early_bytes);
+	}
+	SIO_accelerate = FALSE;
+}
+
+/* Reference for CheckAtxAcceleration(): with -sioaccel, the data bytes of
+   an ATR image after the first one follow at once, except in a retry. */
+static void CheckAtrAcceleration(void)
+{
+	UBYTE buffer[SECTOR_SIZE];
+	int length = TRACKS * SECTORS_PER_TRACK * SECTOR_SIZE;
+	int result;
+	FILE *fp;
+	int i;
+
+	fp = fopen(image_file, "wb");
+	if (fp == NULL) {
+		printf("Cannot write %s\n", image_file);
+		failures++;
+		return;
+	}
+	memset(buffer, 0, 16);
+	buffer[0] = 0x96; /* ATR header */
+	buffer[1] = 0x02;
+	Put16(buffer + 2, length >> 4);
+	Put16(buffer + 4, SECTOR_SIZE);
+	fwrite(buffer, 1, 16, fp);
+	for (i = 0; i < length; i++)
+		fputc(Pattern(i / SECTOR_SIZE + 1, i % SECTOR_SIZE), fp);
+	fclose(fp);
+	if (!SIO_Mount(1, image_file, TRUE)) {
+		check(FALSE, "ATR image refused");
+		return;
+	}
+	SIO_accelerate = TRUE;
+	siohost_set_clock(0);
+	result = ReadSector(10, buffer, NULL);
+	check(result == 'C' && SameData(buffer, 10, 0, 0, SECTOR_SIZE), "accelerated ATR sector: wrong data");
+	/* The data bytes after the first one and the checksum */
+	check(siohost_early_bytes == SECTOR_SIZE, "accelerated ATR sector: %d early bytes, expected %d",
+	      siohost_early_bytes, SECTOR_SIZE);
+	ReadSector(10, buffer, NULL);
+	check(siohost_early_bytes == 0, "accelerated ATR retry: %d early bytes", siohost_early_bytes);
+	SIO_accelerate = FALSE;
+	ReadSector(11, buffer, NULL);
+	check(siohost_early_bytes == 0, "ATR sector without -sioaccel: %d early bytes", siohost_early_bytes);
+	SIO_Dismount(1);
+}
+
+/* Writes an image of SECTORS and checks that it is mounted or refused as
+   EXPECTED. */
+static void CheckMount(const char *name, const atx_sector_t *sectors, int n, long length, int expected)
+{
+	int tracks[2];
+	int num_tracks = 1;
+	int i;
+	tracks[0] = sectors[0].track;
+	for (i = 1; i < n; i++)
+		if (sectors[i].track != tracks[0]) {
+			tracks[1] = sectors[i].track;
+			num_tracks = 2;
+		}
+	if (!WriteImage(sectors, n, tracks, num_tracks, length)) {
+		failures++;
+		return;
+	}
+	check(SIO_Mount(1, image_file, TRUE) == expected, "%s: %s", name, expected ? "refused" : "mounted");
+	SIO_Dismount(1);
+}
+
+static void CheckInvalidImages(void)
+{
+	atx_sector_t sectors[42];
+	int i;
+	for (i = 0; i < 42; i++) {
+		sectors[i].track = 0;
+		sectors[i].sector = i % SECTORS_PER_TRACK + 1;
+		sectors[i].pos = 100 + (i % SECTORS_PER_TRACK) * 1400;
+		sectors[i].status = 0;
+		sectors[i].weak = -1;
+		sectors[i].fill = 0;
+	}
+	CheckMount("one track", sectors, SECTORS_PER_TRACK, -1, TRUE);
+	CheckMount("truncated sector list", sectors, SECTORS_PER_TRACK, 48 + 32 + 20, FALSE);
+	sectors[SECTORS_PER_TRACK].track = TRACKS;
+	CheckMount("track 40", sectors, SECTORS_PER_TRACK + 1, -1, FALSE);
+	sectors[0].sector = SECTORS_PER_TRACK + 1;
+	CheckMount("sector 19", sectors, SECTORS_PER_TRACK, -1, FALSE);
+	sectors[0].sector = 0;
+	CheckMount("sector 0", sectors, SECTORS_PER_TRACK, -1, FALSE);
+	for (i = 0; i < 42; i++) {
+		sectors[i].track = 0;
+		sectors[i].sector = 1;
+	}
+	CheckMount("41 copies of a sector", sectors, 41, -1, FALSE);
+}
+
+static void usage(void)
+{
+	printf("Usage: atxcheck [options]\n"
+	       "Writes synthetic ATX images and checks how the emulated drive reads them.\n"
+	       "Options:\n"
+	       "\t-o <file>      Name of the image file (default: atxcheck.atx), removed at the end\n"
+	       "\t-v             Print the messages of the drive emulation\n");
+}
+
+int main(int argc, char *argv[])
+{
+	static atx_sector_t disk[TRACKS * SECTORS_PER_TRACK + 1];
+	int tracks[TRACKS];
+	int n;
+	int sio_argc = 1;
+	int i;
+
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+			image_file = argv[++i];
+		else if (strcmp(argv[i], "-v") == 0)
+			siohost_verbose = TRUE;
+		else {
+			usage();
+			return strcmp(argv[i], "-help") == 0 ? 0 : 1;
+		}
+	}
+
+	SIO_Initialise(&sio_argc, argv);
+	n = MakeDisk(disk, tracks);
+	if (!WriteImage(disk, n, tracks, TRACKS, -1))
+		return 1;
+	if (SIO_Mount(1, image_file, TRUE)) {
+		CheckAllSectors();
+		CheckTiming(disk, n);
+		CheckWeakSector();
+		CheckAtxAcceleration();
+		SIO_Dismount(1);
+#ifdef VAPI_WRITE_ENABLE
+		CheckWrite();
+#endif
+	}
+	else
+		check(FALSE, "test disk refused");
+	CheckAtrAcceleration();
+	CheckInvalidImages();
+	remove(image_file);
+
+	printf("%d checks, %d failed\n", checks, failures);
+	return failures == 0 ? 0 : 1;
+}
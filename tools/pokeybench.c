@@ -0,0 +1,496 @@
+/*
+ * pokeybench.c - benchmark and accuracy check of the POKEY sound engines
+ *
+ * Copyright (C) 2002 Michael Borisov
+ * Copyright (C) 2026 Atari800 development team (see DOC/CREDITS)
+ *
+ * This file is part of the Atari800 emulator project which emulates
+ * the Atari 400, 800, 800XL, 130XE, and 5200 8-bit computers.
+ *
+ * Atari800 is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Atari800 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Atari800; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/* Renders a set of register workloads with every combination of the
+   selected engines, numbers of POKEYs, sample formats and rates, and prints
+   one CSV line per combination. Each rendering is compared with a reference
+   rendering: by default the MZ engine at quality 2 with float output, or
+   renderings of an earlier run stored with -save and loaded with -ref. The
+   latter detects any change of the output between two builds. */
+
+#include "config.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "pokeyhost.h"
+#include "antic.h"
+#include "pokey.h"
+#include "pokeysnd.h"
+
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#define HAVE_CYCLE_COUNTER
+static unsigned long long read_cycles(void)
+{
+	unsigned int lo, hi;
+	__asm__ __volatile__("rdtsc" : "=a" (lo), "=d" (hi));
+	return ((unsigned long long)hi << 32) | lo;
+}
+#endif
+
+/* Register workloads. START sets up the registers of a POKEY at the beginning
+   of the rendering, LINE (if not NULL) updates them at every scanline. */
+typedef struct {
+	const char *name;
+	const char *description;
+	void (*start)(int chip);
+	void (*line)(int chip, ULONG line);
+} workload_t;
+
+static void start_tone(int chip)
+{
+	pokeyhost_write(chip, POKEY_OFFSET_AUDF1, (UBYTE)(0x50 + chip));
+	pokeyhost_write(chip, POKEY_OFFSET_AUDC1, 0xaa);
+}
+
+static void start_chord(int chip)
+{
+	pokeyhost_write(chip, POKEY_OFFSET_AUDF1, 0x79);
+	pokeyhost_write(chip, POKEY_OFFSET_AUDC1, 0xa6);
+	pokeyhost_write(chip, POKEY_OFFSET_AUDF2, 0x60);
+	pokeyhost_write(chip, POKEY_OFFSET_AUDC2, 0xa6);
+	pokeyhost_write(chip, POKEY_OFFSET_AUDF3, (UBYTE)(0x51 + chip));
+	pokeyhost_write(chip, POKEY_OFFSET_AUDC3, 0xa6);
+	pokeyhost_write(chip, POKEY_OFFSET_AUDF4, 0x3c);
+	pokeyhost_write(chip, POKEY_OFFSET_AUDC4, 0xa6);
+}
+
+static void start_noise(int chip)
+{
+	pokeyhost_write(chip, POKEY_OFFSET_AUDCTL, chip ? POKEY_POLY9 : 0);
+	pokeyhost_write(chip, POKEY_OFFSET_AUDF1, 0x10);
+	pokeyhost_write(chip, POKEY_OFFSET_AUDC1, 0x88);
+	pokeyhost_write(chip, POKEY_OFFSET_AUDF2, 0x40);
+	pokeyhost_write(chip, POKEY_OFFSET_AUDC2, 0x08);
+	pokeyhost_write(chip, POKEY_OFFSET_AUDF3, 0x07);
+	pokeyhost_write(chip, POKEY_OFFSET_AUDC3, 0x48);
+}
+
+static void start_filter(int chip)
+{
+	/* 16-bit channel 1+2 at 1.79 MHz, channel 3 high-passed by channel 1. */
+	pokeyhost_write(chip, POKEY_OFFSET_AUDCTL, POKEY_CH1_179 | POKEY_CH1_CH2 | POKEY_CH1_FILTER);
+	pokeyhost_write(chip, POKEY_OFFSET_AUDF1, 0x34);
+	pokeyhost_write(chip, POKEY_OFFSET_AUDF2, (UBYTE)(0x12 + chip));
+	pokeyhost_write(chip, POKEY_OFFSET_AUDC2, 0xa8);
+	pokeyhost_write(chip, POKEY_OFFSET_AUDF3, 0x20);
+	pokeyhost_write(chip, POKEY_OFFSET_AUDC3, 0xa8);
+}
+
+static void line_sweep(int chip, ULONG line)
+{
+	pokeyhost_write(chip, POKEY_OFFSET_AUDF1, (UBYTE)(line >> 2));
+	if ((line & 0x3f) == 0)
+		pokeyhost_write(chip, POKEY_OFFSET_AUDC1, (UBYTE)(0xa0 | ((line >> 6) & 0x0f)));
+}
+
+static void line_digi(int chip, ULONG line)
+{
+	/* 4-bit samples of a sine wave written in volume-only mode. */
+	static const UBYTE sine[16] = { 8, 11, 13, 15, 15, 15, 13, 11, 8, 5, 3, 1, 0, 1, 3, 5 };
+	pokeyhost_write(chip, POKEY_OFFSET_AUDC1, (UBYTE)(0x10 | sine[(line >> chip) & 0x0f]));
+}
+
+static const workload_t workloads[] = {
+	{ "tone", "single pure tone", start_tone, NULL },
+	{ "chord", "four pure tones", start_chord, NULL },
+	{ "noise", "poly5/poly9/poly17 noise", start_noise, NULL },
+	{ "filter", "joined 1.79 MHz channels and high-pass filter", start_filter, NULL },
+	{ "sweep", "frequency changed every scanline", start_tone, line_sweep },
+	{ "digi", "volume-only sample playback every scanline", NULL, line_digi }
+};
+#define NUM_WORKLOADS ((int)(sizeof(workloads) / sizeof(workloads[0])))
+
+/* Engine configurations: RF, and MZ at quality 0..2. */
+static const char * const engine_names[] = { "rf", "mz0", "mz1", "mz2" };
+#define NUM_ENGINES 4
+#define REFERENCE_ENGINE 3
+
+#define MAX_LIST 16
+
+static int sel_engines[MAX_LIST] = { 0, 1, 2, 3 };
+static int n_engines = 4;
+static int sel_workloads[MAX_LIST] = { 0, 1, 2, 3, 4, 5 };
+static int n_workloads = NUM_WORKLOADS;
+static int sel_pokeys[MAX_LIST] = { 1, 2 };
+static int n_pokeys = 2;
+static int sel_bits[MAX_LIST] = { 8, 16 };
+static int n_bits = 2;
+static int sel_rates[MAX_LIST] = { 22050, 44100, 48000 };
+static int n_rates = 3;
+static double seconds = 5.0;
+static int trials = 3;
+static const char *ref_dir = NULL;
+static const char *save_dir = NULL;
+static double max_dev_db = 0.0;
+static int check_dev = FALSE;
+
+/* Raw output of one rendering. */
+typedef struct {
+	UBYTE *data;
+	unsigned int size;
+	unsigned int allocated;
+} output_t;
+
+static void collect(UBYTE const *buffer, unsigned int size, void *user)
+{
+	output_t *out = (output_t *)user;
+	if (out->size + size > out->allocated) {
+		out->allocated = (out->size + size) * 2;
+		out->data = realloc(out->data, out->allocated);
+		if (out->data == NULL) {
+			fprintf(stderr, "Out of memory\n");
+			exit(1);
+		}
+	}
+	memcpy(out->data + out->size, buffer, size);
+	out->size += size;
+}
+
+static int flags_for_bits(int bits)
+{
+	return bits == 32 ? POKEYSND_FLOAT32 : bits == 16 ? POKEYSND_BIT16 : 0;
+}
+
+/* Renders SECONDS of workload W with ENGINE into OUT. Returns the CPU time
+   spent in the sound engine, or a negative value if the configuration is not
+   supported. CYCLES receives the number of CPU clock cycles, if available. */
+static double render(int engine, const workload_t *w, int pokeys, int bits, int rate,
+                     output_t *out, double *cycles)
+{
+	ULONG const lines = (ULONG)(seconds * POKEYSND_FREQ_17_EXACT / ANTIC_LINE_C);
+	ULONG line;
+	clock_t start;
+	double time;
+	int chip;
+#ifdef HAVE_CYCLE_COUNTER
+	unsigned long long start_cycles;
+#endif
+
+	if (pokeyhost_init(engine == 0 ? POKEYHOST_ENGINE_RF : POKEYHOST_ENGINE_MZ,
+	                   engine == 0 ? 0 : engine - 1, rate, pokeys, flags_for_bits(bits)) != 0)
+		return -1.0;
+	/* MZ dithers 8/16-bit samples using rand(). */
+	srand(1);
+	out->size = 0;
+
+	start = clock();
+#ifdef HAVE_CYCLE_COUNTER
+	start_cycles = read_cycles();
+#endif
+	for (chip = 0; chip < pokeys; chip++)
+		if (w->start != NULL)
+			w->start(chip);
+	if (w->line == NULL)
+		pokeyhost_advance(lines * ANTIC_LINE_C, collect, out);
+	else {
+		for (line = 0; line < lines; line++) {
+			for (chip = 0; chip < pokeys; chip++)
+				w->line(chip, line);
+			pokeyhost_advance(ANTIC_LINE_C, collect, out);
+		}
+	}
+#ifdef HAVE_CYCLE_COUNTER
+	*cycles = (double)(read_cycles() - start_cycles);
+#else
+	*cycles = -1.0;
+#endif
+	time = (double)(clock() - start) / CLOCKS_PER_SEC;
+	return time;
+}
+
+/* Converts SIZE bytes of BITS-bit samples in IN to floats. Returns the
+   number of samples, stored in *RESULT (to be freed by the caller). */
+static unsigned int to_float(UBYTE const *in, unsigned int size, int bits, float **result)
+{
+	unsigned int n = size / (bits / 8);
+	unsigned int i;
+	float *f = malloc((n + 1) * sizeof(float));
+	if (f == NULL) {
+		fprintf(stderr, "Out of memory\n");
+		exit(1);
+	}
+	for (i = 0; i < n; i++) {
+		if (bits == 32)
+			f[i] = ((float const *)in)[i];
+		else if (bits == 16)
+			f[i] = ((SWORD const *)in)[i] / 32768.0f;
+		else
+#ifdef POKEYSND_SIGNED_SAMPLES
+			f[i] = ((SBYTE const *)in)[i] / 128.0f;
+#else
+			f[i] = (in[i] - 0x80) / 128.0f;
+#endif
+	}
+	*result = f;
+	return n;
+}
+
+/* Returns RMS of the difference of A and B. The DC offset is removed, as the
+   engines differ in where they place silence. */
+static double rms_deviation(float const *a, unsigned int n_a, float const *b, unsigned int n_b)
+{
+	unsigned int n = n_a < n_b ? n_a : n_b;
+	unsigned int i;
+	double sum = 0.0;
+	double sum2 = 0.0;
+	if (n == 0)
+		return 0.0;
+	for (i = 0; i < n; i++) {
+		double d = a[i] - b[i];
+		sum += d;
+		sum2 += d * d;
+	}
+	sum /= n;
+	sum2 = sum2 / n - sum * sum;
+	return sum2 > 0.0 ? sqrt(sum2) : 0.0;
+}
+
+static void config_name(char *buf, size_t size, const char *dir, int engine,
+                        const workload_t *w, int pokeys, int bits, int rate)
+{
+	snprintf(buf, size, "%s/%s-%s-%dp-%db-%d.f32", dir, engine_names[engine],
+	         w->name, pokeys, bits, rate);
+}
+
+/* Reads the float rendering stored in FILENAME. Returns the number of
+   samples, or 0 on error. */
+static unsigned int load_floats(const char *filename, float **result)
+{
+	FILE *fp = fopen(filename, "rb");
+	long size;
+	unsigned int n;
+	if (fp == NULL) {
+		perror(filename);
+		return 0;
+	}
+	fseek(fp, 0, SEEK_END);
+	size = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	n = (unsigned int)(size / sizeof(float));
+	*result = malloc((n + 1) * sizeof(float));
+	if (*result == NULL || fread(*result, sizeof(float), n, fp) != n) {
+		fprintf(stderr, "%s: read error\n", filename);
+		n = 0;
+	}
+	fclose(fp);
+	return n;
+}
+
+static void save_floats(const char *filename, float const *data, unsigned int n)
+{
+	FILE *fp = fopen(filename, "wb");
+	if (fp == NULL || fwrite(data, sizeof(float), n, fp) != n)
+		perror(filename);
+	if (fp != NULL)
+		fclose(fp);
+}
+
+/* Runs the benchmark for one workload, number of POKEYs and rate. Returns
+   the number of failed configurations. */
+static int bench(const workload_t *w, int pokeys, int rate)
+{
+	output_t out = { NULL, 0, 0 };
+	float *ref = NULL;
+	unsigned int n_ref = 0;
+	int failures = 0;
+	int e, b;
+
+	if (ref_dir == NULL) {
+		double cycles;
+		if (render(REFERENCE_ENGINE, w, pokeys, 32, rate, &out, &cycles) >= 0.0)
+			n_ref = to_float(out.data, out.size, 32, &ref);
+	}
+
+	for (e = 0; e < n_engines; e++) {
+		for (b = 0; b < n_bits; b++) {
+			int const engine = sel_engines[e];
+			int const bits = sel_bits[b];
+			double best_time = -1.0;
+			double best_cycles = -1.0;
+			double samples_per_s, dev;
+			float *f;
+			unsigned int n;
+			char filename[FILENAME_MAX];
+			int t;
+
+			for (t = 0; t < trials; t++) {
+				double cycles;
+				double time = render(engine, w, pokeys, bits, rate, &out, &cycles);
+				if (time < 0.0)
+					break;
+				if (best_time < 0.0 || time < best_time) {
+					best_time = time;
+					best_cycles = cycles;
+				}
+			}
+			if (best_time < 0.0) {
+				printf("%s,%s,%d,%d,%d,,,,,,unsupported\n", engine_names[engine],
+				       w->name, pokeys, bits, rate);
+				continue;
+			}
+
+			n = to_float(out.data, out.size, bits, &f);
+			if (ref_dir != NULL) {
+				free(ref);
+				ref = NULL;
+				config_name(filename, sizeof(filename), ref_dir, engine, w, pokeys, bits, rate);
+				n_ref = load_floats(filename, &ref);
+			}
+			if (save_dir != NULL) {
+				config_name(filename, sizeof(filename), save_dir, engine, w, pokeys, bits, rate);
+				save_floats(filename, f, n);
+			}
+			dev = rms_deviation(f, n, ref, n_ref);
+			free(f);
+
+			samples_per_s = best_time > 0.0 ? n / best_time : 0.0;
+			printf("%s,%s,%d,%d,%d,%u,%.0f,", engine_names[engine], w->name,
+			       pokeys, bits, rate, n, samples_per_s);
+			if (best_cycles >= 0.0 && n > 0)
+				printf("%.1f", best_cycles / n);
+			printf(",%.1f,%.3g,%.1f,", best_time > 0.0 ? seconds / best_time : 0.0,
+			       dev, dev > 0.0 ? 20.0 * log10(dev) : -999.0);
+			if (n_ref == 0)
+				printf("noref\n");
+			else if (check_dev && dev > 0.0 && 20.0 * log10(dev) > max_dev_db) {
+				printf("deviation\n");
+				failures++;
+			}
+			else
+				printf("ok\n");
+			fflush(stdout);
+		}
+	}
+	free(ref);
+	free(out.data);
+	return failures;
+}
+
+/* Parses comma-separated list ARG of integers or, if NAMES is not NULL,
+   names from NAMES, into LIST. Returns the number of items or 0 on error. */
+static int parse_list(char *arg, int *list, const char * const *names, int n_names)
+{
+	int n = 0;
+	char *item;
+	for (item = strtok(arg, ","); item != NULL; item = strtok(NULL, ",")) {
+		if (n >= MAX_LIST)
+			return 0;
+		if (names == NULL)
+			list[n] = atoi(item);
+		else {
+			int i;
+			for (i = 0; i < n_names && strcmp(item, names[i]) != 0; i++);
+			if (i == n_names) {
+				fprintf(stderr, "Unknown item '%s'\n", item);
+				return 0;
+			}
+			list[n] = i;
+		}
+		n++;
+	}
+	return n;
+}
+
+static void usage(void)
+{
+	int i;
+	printf("Usage: pokeybench [options]\n"
+	       "Benchmarks the POKEY sound engines and prints CSV results.\n"
+	       "Options (lists are comma-separated):\n"
+	       "\t-e <engines>   Engines from rf, mz0, mz1, mz2 (default: all)\n"
+	       "\t-w <loads>     Workloads (default: all)\n"
+	       "\t-p <pokeys>    Numbers of POKEYs, 1, 2 or 4 (default: 1,2)\n"
+	       "\t-b <bits>      Sample formats: 8, 16 or 32 (float) (default: 8,16)\n"
+	       "\t-r <rates>     Sample rates in Hz (default: 22050,44100,48000)\n"
+	       "\t-t <seconds>   Length of each rendering (default: %g)\n"
+	       "\t-n <trials>    Renderings per configuration, the fastest counts (default: %d)\n"
+	       "\t-save <dir>    Store the renderings in directory <dir>\n"
+	       "\t-ref <dir>     Compare with renderings stored by -save instead of with\n"
+	       "\t               MZ quality 2 float output\n"
+	       "\t-maxdev <dB>   Fail if RMS deviation from the reference exceeds <dB>\n"
+	       "Workloads:\n", seconds, trials);
+	for (i = 0; i < NUM_WORKLOADS; i++)
+		printf("\t%-14s %s\n", workloads[i].name, workloads[i].description);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *workload_names[NUM_WORKLOADS];
+	int failures = 0;
+	int i, j, k;
+
+	for (i = 0; i < NUM_WORKLOADS; i++)
+		workload_names[i] = workloads[i].name;
+
+	for (i = 1; i < argc; i++) {
+		int i_a = i + 1 < argc;
+		int ok = TRUE;
+		if (strcmp(argv[i], "-e") == 0 && i_a)
+			ok = (n_engines = parse_list(argv[++i], sel_engines, engine_names, NUM_ENGINES)) > 0;
+		else if (strcmp(argv[i], "-w") == 0 && i_a)
+			ok = (n_workloads = parse_list(argv[++i], sel_workloads, workload_names, NUM_WORKLOADS)) > 0;
+		else if (strcmp(argv[i], "-p") == 0 && i_a)
+			ok = (n_pokeys = parse_list(argv[++i], sel_pokeys, NULL, 0)) > 0;
+		else if (strcmp(argv[i], "-b") == 0 && i_a) {
+			ok = (n_bits = parse_list(argv[++i], sel_bits, NULL, 0)) > 0;
+			for (j = 0; j < n_bits; j++)
+				if (sel_bits[j] != 8 && sel_bits[j] != 16 && sel_bits[j] != 32)
+					ok = FALSE;
+		}
+		else if (strcmp(argv[i], "-r") == 0 && i_a)
+			ok = (n_rates = parse_list(argv[++i], sel_rates, NULL, 0)) > 0;
+		else if (strcmp(argv[i], "-t") == 0 && i_a)
+			ok = (seconds = atof(argv[++i])) > 0.0;
+		else if (strcmp(argv[i], "-n") == 0 && i_a)
+			ok = (trials = atoi(argv[++i])) > 0;
+		else if (strcmp(argv[i], "-save") == 0 && i_a)
+			save_dir = argv[++i];
+		else if (strcmp(argv[i], "-ref") == 0 && i_a)
+			ref_dir = argv[++i];
+		else if (strcmp(argv[i], "-maxdev") == 0 && i_a) {
+			max_dev_db = atof(argv[++i]);
+			check_dev = TRUE;
+		}
+		else {
+			usage();
+			return strcmp(argv[i], "-help") == 0 ? 0 : 1;
+		}
+		if (!ok) {
+			fprintf(stderr, "Invalid argument of %s\n", argv[i - 1]);
+			return 1;
+		}
+	}
+
+	printf("engine,workload,pokeys,bits,rate,samples,samples_per_s,cycles_per_sample,"
+	       "realtime,rms_dev,rms_dev_db,status\n");
+	for (i = 0; i < n_workloads; i++)
+		for (j = 0; j < n_pokeys; j++)
+			for (k = 0; k < n_rates; k++)
+				failures += bench(&workloads[sel_workloads[i]], sel_pokeys[j], sel_rates[k]);
+
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,213 @@
+/*
+ * pokeyhost.c - run the POKEY sound engines outside of the emulator
+ *
+ * Copyright (C) 2026 Atari800 development team (see DOC/CREDITS)
+ *
+ * This file is part of the Atari800 emulator project which emulates
+ * the Atari 400, 800, 800XL, 130XE, and 5200 8-bit computers.
+ *
+ * Atari800 is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Atari800 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Atari800; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "config.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "pokeyhost.h"
+#include "antic.h"
+#include "gtia.h"
+#include "pokey.h"
+#include "pokeysnd.h"
+#include "log.h"
+#include "util.h"
+#ifdef AUDIO_RECORDING
+#include "file_export.h"
+#endif
+#if defined(PBI_XLD) || defined (VOICEBOX)
+#include "votraxsnd.h"
+#endif
+
+#ifndef SOUND_GAIN /* same default as in pokey.c */
+#define SOUND_GAIN 4
+#endif
+
+/* Emulator state referenced by the sound engines. */
+int Atari800_tv_mode = Atari800_TV_PAL;
+unsigned int ANTIC_screenline_cpu_clock = 0;
+int ANTIC_xpos = 0;
+#ifdef NEW_CYCLE_EXACT
+int ANTIC_cur_screen_pos = ANTIC_NOT_DRAWING;
+const int *ANTIC_cpu2antic_ptr = NULL;
+#endif
+int GTIA_speaker = 0;
+UBYTE POKEY_AUDF[4 * POKEY_MAXPOKEYS];
+UBYTE POKEY_AUDC[4 * POKEY_MAXPOKEYS];
+UBYTE POKEY_AUDCTL[POKEY_MAXPOKEYS];
+int POKEY_Base_mult[POKEY_MAXPOKEYS];
+UBYTE POKEY_poly9_lookup[POKEY_POLY9_SIZE];
+UBYTE POKEY_poly17_lookup[16385];
+
+/* Same as in pokey.c */
+int POKEY_NumChips(void)
+{
+#ifdef STEREO_SOUND
+	if (POKEYSND_quad_enabled && POKEYSND_enable_new_pokey)
+		return POKEY_MAXPOKEYS;
+	if (POKEYSND_stereo_enabled)
+		return 2;
+#endif
+	return 1;
+}
+
+#ifdef AUDIO_RECORDING
+int File_Export_StopRecording(void)
+{
+	return TRUE;
+}
+
+int File_Export_WriteAudio(const UBYTE *samples, int num_samples)
+{
+	return TRUE;
+}
+#endif /* AUDIO_RECORDING */
+
+#ifdef SHMEXPORT
+void SHMEXPORT_WriteAudio(const UBYTE *samples, int num_samples)
+{
+}
+#endif
+
+#if defined(PBI_XLD) || defined (VOICEBOX)
+void VOTRAXSND_Init(int playback_freq, int n_pokeys, int flags)
+{
+}
+
+void VOTRAXSND_Process(void *sndbuffer, int sndn)
+{
+}
+#endif
+
+void Log_print(const char *format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	vfprintf(stderr, format, args);
+	va_end(args);
+	fputc('\n', stderr);
+}
+
+void *Util_malloc(size_t size)
+{
+	void *ptr = malloc(size);
+	if (ptr == NULL) {
+		fprintf(stderr, "Fatal error: out of memory\n");
+		exit(1);
+	}
+	return ptr;
+}
+
+int pokeyhost_init(int engine, int quality, int rate, int num_pokeys, int flags)
+{
+	int i;
+	ULONG reg;
+
+	/* Same as in POKEY_Initialise */
+	for (i = 0; i < 4 * POKEY_MAXPOKEYS; i++) {
+		POKEY_AUDC[i] = 0;
+		POKEY_AUDF[i] = 0;
+	}
+	for (i = 0; i < POKEY_MAXPOKEYS; i++) {
+		POKEY_AUDCTL[i] = 0;
+		POKEY_Base_mult[i] = POKEY_DIV_64;
+	}
+	reg = 0x1ff;
+	for (i = 0; i < 511; i++) {
+		reg = ((((reg >> 5) ^ reg) & 1) << 8) + (reg >> 1);
+		POKEY_poly9_lookup[i] = (UBYTE) reg;
+	}
+	reg = 0x1ffff;
+	for (i = 0; i < 16385; i++) {
+		reg = ((((reg >> 5) ^ reg) & 0xff) << 9) + (reg >> 8);
+		POKEY_poly17_lookup[i] = (UBYTE) (reg >> 1);
+	}
+
+	if (num_pokeys < 1 || num_pokeys > POKEY_MAXPOKEYS)
+		return 1;
+	/* MZ POKEY seems to segfault or remain silent with rate < 8009 Hz
+	   (see Sound_Setup) and neither engine supports rate > 65535 Hz. */
+	if (rate < (engine == POKEYHOST_ENGINE_MZ ? 8192 : 1000) || rate > 65535)
+		return 1;
+
+	ANTIC_screenline_cpu_clock = 0;
+	ANTIC_xpos = 0;
+	POKEYSND_enable_new_pokey = engine == POKEYHOST_ENGINE_MZ;
+	POKEYSND_stereo_enabled = num_pokeys >= 2;
+	/* More than two POKEYs are mixed to stereo output. */
+	POKEYSND_quad_enabled = num_pokeys > 2;
+	if (num_pokeys > 2) {
+		if (engine != POKEYHOST_ENGINE_MZ)
+			return 1;
+		num_pokeys = 2;
+	}
+	POKEYSND_SetMzQuality(quality);
+	return POKEYSND_Init(POKEYSND_FREQ_17_EXACT, rate, num_pokeys, flags);
+}
+
+void pokeyhost_write(int chip, UBYTE reg, UBYTE value)
+{
+	/* Mirrors the sound part of POKEY_PutByte. */
+	switch (reg) {
+	case POKEY_OFFSET_AUDC1:
+	case POKEY_OFFSET_AUDC2:
+	case POKEY_OFFSET_AUDC3:
+	case POKEY_OFFSET_AUDC4:
+		POKEY_AUDC[(reg >> 1) + chip * 4] = value;
+		break;
+	case POKEY_OFFSET_AUDF1:
+	case POKEY_OFFSET_AUDF2:
+	case POKEY_OFFSET_AUDF3:
+	case POKEY_OFFSET_AUDF4:
+		POKEY_AUDF[(reg >> 1) + chip * 4] = value;
+		break;
+	case POKEY_OFFSET_AUDCTL:
+		POKEY_AUDCTL[chip] = value;
+		POKEY_Base_mult[chip] = (value & POKEY_CLOCK_15) ? POKEY_DIV_15 : POKEY_DIV_64;
+		break;
+	case POKEY_OFFSET_STIMER:
+	case POKEY_OFFSET_SKCTL:
+		break;
+	default:
+		return;
+	}
+	POKEYSND_Update(reg, value, chip, SOUND_GAIN);
+}
+
+void pokeyhost_advance(unsigned int cycles, pokeyhost_output_t output, void *user)
+{
+	/* POKEYSND_process_buffer holds samples for one frame only. */
+	unsigned int const max_step = Atari800_tv_mode * ANTIC_LINE_C;
+	unsigned int const sample_size = POKEYSND_SAMPLE_SIZE(POKEYSND_snd_flags);
+
+	while (cycles > 0) {
+		unsigned int step = cycles > max_step ? max_step : cycles;
+		int samples;
+		ANTIC_screenline_cpu_clock += step;
+		cycles -= step;
+		samples = POKEYSND_UpdateProcessBuffer();
+		if (samples > 0)
+			output(POKEYSND_process_buffer, samples * sample_size, user);
+	}
+}
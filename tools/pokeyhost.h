@@ -0,0 +1,33 @@
+#ifndef POKEYHOST_H_
+#define POKEYHOST_H_
+
+/* Minimal emulator environment that lets the POKEY sound engines
+   (pokeysnd.c and mzpokeysnd.c) run outside of the emulator. The engines
+   keep their state in globals, so only one instance can exist per process. */
+
+#include "atari.h"
+
+enum {
+	POKEYHOST_ENGINE_RF, /* Ron Fries' pokeysnd_rf */
+	POKEYHOST_ENGINE_MZ  /* Michael Borisov's MZPOKEYSND */
+};
+
+/* Called with each portion of generated samples. SIZE is in bytes. */
+typedef void (*pokeyhost_output_t)(UBYTE const *buffer, unsigned int size, void *user);
+
+/* Resets all POKEY registers and initialises ENGINE (QUALITY is used by the
+   MZ engine only, 0..2) for NUM_POKEYS chips producing RATE Hz output in
+   the sample format selected by POKEYSND init FLAGS (POKEYSND_BIT16,
+   POKEYSND_FLOAT32). Returns 0 on success. */
+int pokeyhost_init(int engine, int quality, int rate, int num_pokeys, int flags);
+
+/* Writes VALUE to sound register REG (0..15) of POKEY CHIP at the current
+   point in time. */
+void pokeyhost_write(int chip, UBYTE reg, UBYTE value);
+
+/* Advances the emulated time by CYCLES CPU cycles (POKEYSND_FREQ_17_EXACT
+   per second), passing the samples
+   generated meanwhile to OUTPUT. */
+void pokeyhost_advance(unsigned int cycles, pokeyhost_output_t output, void *user);
+
+#endif /* POKEYHOST_H_ */
@@ -0,0 +1,322 @@
+/*
+ * pokeyrender.c - render POKEY register streams (-pokeyrec-stream) to WAV
+ *
+ * Copyright (C) 2026 Atari800 development team (see DOC/CREDITS)
+ *
+ * This file is part of the Atari800 emulator project which emulates
+ * the Atari 400, 800, 800XL, 130XE, and 5200 8-bit computers.
+ *
+ * Atari800 is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Atari800 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Atari800; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/* The streams are replayed through the emulator's sound engines without
+   emulating the rest of the machine, so rendering runs as fast as the engine
+   can generate samples. The engines keep global state, so multiple streams
+   are rendered in parallel by separate worker processes. */
+
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#ifdef HAVE_FORK
+#include <sys/types.h>
+#include <sys/wait.h>
+#endif
+
+#include "pokeyhost.h"
+#include "pokeyrec.h"
+#include "pokeysnd.h"
+
+static int engine = POKEYHOST_ENGINE_MZ;
+static int quality = 0;
+static int rate = 44100;
+static int bit16 = TRUE;
+static const char *output_name = NULL;
+
+typedef struct {
+	FILE *fp;
+	ULONG data_size;
+} wav_t;
+
+static void put_le16(unsigned int x, FILE *fp)
+{
+	fputc(x & 0xff, fp);
+	fputc((x >> 8) & 0xff, fp);
+}
+
+static void put_le32(ULONG x, FILE *fp)
+{
+	put_le16(x & 0xffff, fp);
+	put_le16((x >> 16) & 0xffff, fp);
+}
+
+static void write_wav_header(FILE *fp, int channels, ULONG data_size)
+{
+	int sample_size = bit16 ? 2 : 1;
+	fputs("RIFF", fp);
+	put_le32(data_size + 36, fp);
+	fputs("WAVEfmt ", fp);
+	put_le32(16, fp);
+	put_le16(1, fp); /* PCM */
+	put_le16(channels, fp);
+	put_le32(rate, fp);
+	put_le32(rate * channels * sample_size, fp);
+	put_le16(channels * sample_size, fp);
+	put_le16(sample_size * 8, fp);
+	fputs("data", fp);
+	put_le32(data_size, fp);
+}
+
+static void write_samples(UBYTE const *buffer, unsigned int size, void *user)
+{
+	wav_t *wav = (wav_t *)user;
+#ifdef WORDS_BIGENDIAN
+	if (bit16) {
+		unsigned int i;
+		for (i = 0; i < size; i += 2) {
+			fputc(buffer[i + 1], wav->fp);
+			fputc(buffer[i], wav->fp);
+		}
+	}
+	else
+#endif
+	fwrite(buffer, 1, size, wav->fp);
+	wav->data_size += size;
+}
+
+/* Reads a varint as written by pokeyrec.c. Returns FALSE at end of file. */
+static int read_varint(FILE *fp, ULONG *value)
+{
+	int shift = 0;
+	int c;
+	*value = 0;
+	do {
+		if ((c = fgetc(fp)) == EOF || shift > 28)
+			return FALSE;
+		*value |= (ULONG)(c & 0x7f) << shift;
+		shift += 7;
+	} while (c & 0x80);
+	return TRUE;
+}
+
+static char *wav_name(const char *name)
+{
+	char *result = malloc(strlen(name) + 5);
+	char *dot;
+	strcpy(result, name);
+	dot = strrchr(result, '.');
+	if (dot != NULL && strchr(dot, '/') == NULL)
+		*dot = '\0';
+	strcat(result, ".wav");
+	return result;
+}
+
+/* Renders stream IN_NAME to WAV file OUT_NAME. Returns 0 on success. */
+static int render(const char *in_name, const char *out_name)
+{
+	FILE *in;
+	UBYTE header[POKEYREC_STREAM_HEADER_SIZE];
+	int num_pokeys;
+	int channels;
+	wav_t wav;
+	ULONG delta;
+	clock_t start;
+	double cpu_time;
+	int result = 0;
+
+	if ((in = fopen(in_name, "rb")) == NULL) {
+		perror(in_name);
+		return 1;
+	}
+	if (fread(header, 1, sizeof(header), in) != sizeof(header)
+	    || memcmp(header, POKEYREC_STREAM_MAGIC, 4) != 0) {
+		fprintf(stderr, "%s: not a POKEY register stream\n", in_name);
+		fclose(in);
+		return 1;
+	}
+	num_pokeys = header[4];
+	Atari800_tv_mode = header[6] | (header[7] << 8);
+	if (Atari800_tv_mode != Atari800_TV_PAL && Atari800_tv_mode != Atari800_TV_NTSC)
+		Atari800_tv_mode = Atari800_TV_PAL;
+	if (pokeyhost_init(engine, quality, rate, num_pokeys, bit16 ? POKEYSND_BIT16 : 0) != 0) {
+		fprintf(stderr, "%s: unsupported parameters\n", in_name);
+		fclose(in);
+		return 1;
+	}
+	if ((wav.fp = fopen(out_name, "wb")) == NULL) {
+		perror(out_name);
+		fclose(in);
+		return 1;
+	}
+	/* Streams of four POKEYs are mixed to stereo. */
+	channels = POKEYSND_num_pokeys;
+	wav.data_size = 0;
+	write_wav_header(wav.fp, channels, 0);
+
+	start = clock();
+	while (read_varint(in, &delta)) {
+		int reg = fgetc(in);
+		int value = fgetc(in);
+		if (value == EOF) {
+			fprintf(stderr, "%s: truncated stream\n", in_name);
+			break;
+		}
+		pokeyhost_advance(delta, write_samples, &wav);
+		if (reg == POKEYREC_STREAM_END)
+			break;
+		pokeyhost_write((reg >> 4) & 3, (UBYTE)(reg & 0x0f), (UBYTE)value);
+	}
+	cpu_time = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+	fseek(wav.fp, 0, SEEK_SET);
+	write_wav_header(wav.fp, channels, wav.data_size);
+	if (ferror(wav.fp)) {
+		perror(out_name);
+		result = 1;
+	}
+	fclose(wav.fp);
+	fclose(in);
+
+	{
+		double seconds = (double)wav.data_size / (channels * (bit16 ? 2 : 1)) / rate;
+		printf("%s: %.1f s of audio in %.2f s (%.0fx real time)\n", out_name,
+		       seconds, cpu_time, cpu_time > 0 ? seconds / cpu_time : 0.0);
+	}
+	return result;
+}
+
+/* Renders every JOBS-th of the N_FILES FILES, starting at FIRST. Returns the
+   number of failures. */
+static int render_share(char **files, int n_files, int first, int jobs)
+{
+	int failures = 0;
+	int i;
+	for (i = first; i < n_files; i += jobs) {
+		char *out_name = output_name != NULL ? (char *)output_name : wav_name(files[i]);
+		if (render(files[i], out_name) != 0)
+			failures++;
+		if (out_name != output_name)
+			free(out_name);
+		fflush(stdout);
+	}
+	return failures;
+}
+
+static int default_jobs(void)
+{
+#if defined(HAVE_UNISTD_H) && defined(_SC_NPROCESSORS_ONLN)
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+	if (n > 0)
+		return (int)n;
+#endif
+	return 1;
+}
+
+static void usage(void)
+{
+	printf("Usage: pokeyrender [options] stream.pks...\n"
+	       "Renders POKEY register streams recorded with atari800 -pokeyrec -pokeyrec-stream\n"
+	       "to WAV files named after the streams.\n"
+	       "Options:\n"
+	       "\t-r <rate>      Output sample rate in Hz (default: 44100)\n"
+	       "\t-8, -16        Output 8-bit or 16-bit samples (default: 16-bit)\n"
+	       "\t-e <mz|rf>     Sound engine: high fidelity (mz) or Ron Fries' (rf) (default: mz)\n"
+	       "\t-q <0..2>      Quality of the mz engine (default: 0)\n"
+	       "\t-j <n>         Number of streams rendered in parallel (default: %d)\n"
+	       "\t-o <file>      Output file name (only with a single stream)\n",
+	       default_jobs());
+}
+
+int main(int argc, char *argv[])
+{
+	int jobs = default_jobs();
+	int i;
+	int failures = 0;
+
+	for (i = 1; i < argc && argv[i][0] == '-'; i++) {
+		int i_a = i + 1 < argc;
+		if (strcmp(argv[i], "-r") == 0 && i_a)
+			rate = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-8") == 0)
+			bit16 = FALSE;
+		else if (strcmp(argv[i], "-16") == 0)
+			bit16 = TRUE;
+		else if (strcmp(argv[i], "-e") == 0 && i_a) {
+			++i;
+			if (strcmp(argv[i], "mz") == 0)
+				engine = POKEYHOST_ENGINE_MZ;
+			else if (strcmp(argv[i], "rf") == 0)
+				engine = POKEYHOST_ENGINE_RF;
+			else {
+				fprintf(stderr, "Unknown engine '%s'\n", argv[i]);
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "-q") == 0 && i_a)
+			quality = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-j") == 0 && i_a)
+			jobs = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-o") == 0 && i_a)
+			output_name = argv[++i];
+		else {
+			usage();
+			return strcmp(argv[i], "-help") == 0 ? 0 : 1;
+		}
+	}
+	argc -= i;
+	argv += i;
+	if (argc == 0) {
+		usage();
+		return 1;
+	}
+	if (output_name != NULL && argc > 1) {
+		fprintf(stderr, "-o can only be used with a single stream\n");
+		return 1;
+	}
+	if (jobs > argc)
+		jobs = argc;
+	if (jobs < 1)
+		jobs = 1;
+
+#ifdef HAVE_FORK
+	if (jobs > 1) {
+		int started = 0;
+		while (started < jobs) {
+			pid_t pid = fork();
+			if (pid == 0)
+				exit(render_share(argv, argc, started, jobs) == 0 ? 0 : 1);
+			if (pid < 0)
+				break;
+			started++;
+		}
+		/* Render whatever could not be given to a worker. */
+		for (i = started; i < jobs; i++)
+			failures += render_share(argv, argc, i, jobs);
+		while (started-- > 0) {
+			int status;
+			if (wait(&status) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+				failures++;
+		}
+	}
+	else
+#endif
+		failures = render_share(argv, argc, 0, 1);
+
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,206 @@
+/*
+ * shmcheck.c - check of the frames published with -shm-export
+ *
+ * Copyright (C) 2026 Atari800 development team (see DOC/CREDITS)
+ *
+ * This file is part of the Atari800 emulator project which emulates
+ * the Atari 400, 800, 800XL, 130XE, and 5200 8-bit computers.
+ *
+ * Atari800 is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Atari800 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Atari800; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/* Follows the frames published by a running emulator and checks that they
+   arrive in order, with consistent audio, and that the seqlock protocol
+   catches the frames overwritten while being read. Prints one line per
+   frame with -v, and a summary at the end. Start it after the emulator:
+       atari800 -shm-export a8 &
+       shmcheck a8 */
+
+#define _POSIX_C_SOURCE 200112L /* for nanosleep */
+
+#include "config.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "shmreader.h"
+
+static ULONG checksum(ULONG sum, const UBYTE *data, ULONG length)
+{
+	/* Adler-32 */
+	ULONG a = sum & 0xffff;
+	ULONG b = sum >> 16;
+	ULONG i;
+	for (i = 0; i < length; i++) {
+		a = (a + data[i]) % 65521;
+		b = (b + a) % 65521;
+	}
+	return (b << 16) | a;
+}
+
+static void wait_ms(int ms)
+{
+	struct timespec ts;
+	ts.tv_sec = ms / 1000;
+	ts.tv_nsec = (ms % 1000) * 1000000L;
+	nanosleep(&ts, NULL);
+}
+
+static void usage(void)
+{
+	printf("Usage: shmcheck [options] <name>\n"
+	       "Reads the frames published by atari800 -shm-export <name> and checks them.\n"
+	       "Options:\n"
+	       "\t-frames <n>    Stop after n frames (default: until the emulator exits)\n"
+	       "\t-timeout <s>   Fail if no frame arrives for s seconds (default: 5)\n"
+	       "\t-v             Print the checksums of each frame\n");
+}
+
+int main(int argc, char *argv[])
+{
+	const char *name = NULL;
+	ULONG max_frames = 0;
+	int timeout = 5;
+	int verbose = FALSE;
+	SHMREADER_t *reader;
+	const SHMEXPORT_header_t *header;
+	SHMREADER_frame_t frame;
+	ULONG index;
+	ULONG received = 0;
+	ULONG missed = 0;
+	ULONG torn = 0;
+	ULONG errors = 0;
+	ULONG audio_bytes = 0;
+	ULONG last_frame = 0;
+	ULONG sample_rate = 0;
+	int idle_ms = 0;
+	int i;
+
+	for (i = 1; i < argc; i++) {
+		int i_a = i + 1 < argc;
+		int ok = TRUE;
+		if (strcmp(argv[i], "-frames") == 0 && i_a)
+			ok = (max_frames = strtoul(argv[++i], NULL, 10)) > 0;
+		else if (strcmp(argv[i], "-timeout") == 0 && i_a)
+			ok = (timeout = atoi(argv[++i])) > 0;
+		else if (strcmp(argv[i], "-v") == 0)
+			verbose = TRUE;
+		else if (argv[i][0] != '-' && name == NULL)
+			name = argv[i];
+		else {
+			usage();
+			return strcmp(argv[i], "-help") == 0 ? 0 : 1;
+		}
+		if (!ok) {
+			fprintf(stderr, "Invalid argument of %s\n", argv[i - 1]);
+			return 1;
+		}
+	}
+	if (name == NULL) {
+		usage();
+		return 1;
+	}
+
+	reader = SHMREADER_Open(name);
+	if (reader == NULL) {
+		fprintf(stderr, "Cannot open %s: %s\n", name, strerror(errno));
+		return 1;
+	}
+	header = SHMREADER_Header(reader);
+	printf("%s: %lux%lu, visible %lu,%lu-%lu,%lu, %lu slots\n", name,
+	       (unsigned long) header->width, (unsigned long) header->height,
+	       (unsigned long) header->visible_x1, (unsigned long) header->visible_y1,
+	       (unsigned long) header->visible_x2, (unsigned long) header->visible_y2,
+	       (unsigned long) header->num_slots);
+
+	/* Start with the oldest frame still available. */
+	index = SHMREADER_Frames(reader);
+	index = index > header->num_slots ? index - header->num_slots : 0;
+
+	while (max_frames == 0 || received < max_frames) {
+		ULONG pixel_sum;
+		ULONG audio_sum;
+		ULONG frames = SHMREADER_Frames(reader);
+		/* Skip the frames already overwritten. */
+		if (frames - index > header->num_slots && frames - index < 0x80000000U) {
+			missed += frames - header->num_slots - index;
+			index = frames - header->num_slots;
+		}
+		switch (SHMREADER_Get(reader, index, &frame)) {
+		case SHMREADER_NOT_YET:
+			if (!SHMREADER_Running(reader) && SHMREADER_Frames(reader) == frames)
+				goto done;
+			if (idle_ms >= timeout * 1000) {
+				fprintf(stderr, "No frame for %d seconds\n", timeout);
+				errors++;
+				goto done;
+			}
+			wait_ms(1);
+			idle_ms++;
+			continue;
+		case SHMREADER_OVERWRITTEN:
+			missed++;
+			index++;
+			continue;
+		default:
+			break;
+		}
+		idle_ms = 0;
+		pixel_sum = checksum(1, frame.pixels, header->width * header->height);
+		pixel_sum = checksum(pixel_sum, frame.palette, 256 * 3);
+		audio_sum = checksum(1, frame.audio, frame.audio_length);
+		if (!SHMREADER_Check(reader, &frame)) {
+			/* Overwritten while checksumming: the data is not valid. */
+			torn++;
+			index++;
+			continue;
+		}
+		if (received > 0 && frame.frame <= last_frame) {
+			fprintf(stderr, "Frame %lu after frame %lu\n", (unsigned long) frame.frame, (unsigned long) last_frame);
+			errors++;
+		}
+		if (frame.audio_length > 0) {
+			if (frame.channels == 0 || frame.sample_size == 0
+			    || frame.audio_length % (frame.channels * frame.sample_size) != 0) {
+				fprintf(stderr, "Frame %lu: %lu bytes of audio in %lu-byte samples\n",
+				        (unsigned long) frame.frame, (unsigned long) frame.audio_length,
+				        (unsigned long) (frame.channels * frame.sample_size));
+				errors++;
+			}
+			if (sample_rate != 0 && frame.sample_rate != sample_rate) {
+				fprintf(stderr, "Frame %lu: sample rate changed to %lu\n",
+				        (unsigned long) frame.frame, (unsigned long) frame.sample_rate);
+				errors++;
+			}
+			sample_rate = frame.sample_rate;
+		}
+		if (verbose)
+			printf("%lu %08lx %lu %08lx\n", (unsigned long) frame.frame, (unsigned long) pixel_sum,
+			       (unsigned long) frame.audio_length, (unsigned long) audio_sum);
+		last_frame = frame.frame;
+		audio_bytes += frame.audio_length;
+		received++;
+		index++;
+	}
+
+done:
+	printf("%lu frames received, %lu missed, %lu torn, %lu bytes of audio at %lu Hz, %lu errors\n",
+	       (unsigned long) received, (unsigned long) missed, (unsigned long) torn,
+	       (unsigned long) audio_bytes, (unsigned long) sample_rate, (unsigned long) errors);
+	SHMREADER_Close(reader);
+	return errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,152 @@
+/*
+ * shmreader.c - reading of the frames published with -shm-export
+ *
+ * Copyright (C) 2026 Atari800 development team (see DOC/CREDITS)
+ *
+ * This file is part of the Atari800 emulator project which emulates
+ * the Atari 400, 800, 800XL, 130XE, and 5200 8-bit computers.
+ *
+ * Atari800 is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Atari800 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Atari800; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#define _POSIX_C_SOURCE 200112L /* for shm_open */
+
+#include "config.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "shmreader.h"
+
+struct SHMREADER_t {
+	const UBYTE *base;
+	size_t size;
+	const SHMEXPORT_header_t *header;
+};
+
+static const SHMEXPORT_slot_t *Slot(SHMREADER_t *reader, ULONG index)
+{
+	const SHMEXPORT_header_t *header = reader->header;
+	return (const SHMEXPORT_slot_t *) (reader->base + header->header_size + (index % header->num_slots) * header->slot_size);
+}
+
+SHMREADER_t *SHMREADER_Open(const char *name)
+{
+	char path[FILENAME_MAX];
+	SHMREADER_t *reader;
+	struct stat st;
+	const SHMEXPORT_header_t *header;
+	int fd;
+
+	/* Accept the name without the leading slash, like -shm-export. */
+	if (name[0] != '/' && strlen(name) + 2 <= sizeof(path)) {
+		path[0] = '/';
+		strcpy(path + 1, name);
+		name = path;
+	}
+	fd = shm_open(name, O_RDONLY, 0);
+	if (fd < 0)
+		return NULL;
+	if (fstat(fd, &st) != 0) {
+		close(fd);
+		return NULL;
+	}
+	if ((size_t) st.st_size < sizeof(SHMEXPORT_header_t)) {
+		close(fd);
+		errno = EINVAL;
+		return NULL;
+	}
+	reader = (SHMREADER_t *) malloc(sizeof(SHMREADER_t));
+	if (reader == NULL) {
+		close(fd);
+		return NULL;
+	}
+	reader->size = st.st_size;
+	reader->base = (const UBYTE *) mmap(NULL, reader->size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (reader->base == (const UBYTE *) MAP_FAILED) {
+		free(reader);
+		return NULL;
+	}
+	header = reader->header = (const SHMEXPORT_header_t *) reader->base;
+	if (memcmp(header->magic, SHMEXPORT_MAGIC, 4) != 0
+	    || header->version != SHMEXPORT_VERSION
+	    || header->header_size + (size_t) header->num_slots * header->slot_size > reader->size
+	    || header->slot_size < sizeof(SHMEXPORT_slot_t) + header->width * header->height + header->audio_size) {
+		SHMREADER_Close(reader);
+		errno = EINVAL;
+		return NULL;
+	}
+	return reader;
+}
+
+void SHMREADER_Close(SHMREADER_t *reader)
+{
+	munmap((void *) reader->base, reader->size);
+	free(reader);
+}
+
+const SHMEXPORT_header_t *SHMREADER_Header(SHMREADER_t *reader)
+{
+	return reader->header;
+}
+
+ULONG SHMREADER_Frames(SHMREADER_t *reader)
+{
+	return SHMEXPORT_LOAD(reader->header->frames);
+}
+
+int SHMREADER_Running(SHMREADER_t *reader)
+{
+	return SHMEXPORT_LOAD(reader->header->running) != 0;
+}
+
+int SHMREADER_Get(SHMREADER_t *reader, ULONG index, SHMREADER_frame_t *frame)
+{
+	const SHMEXPORT_slot_t *slot;
+	ULONG seq;
+
+	/* Unsigned arithmetic copes with the wrap-around of the counters. */
+	if (SHMREADER_Frames(reader) - index - 1 >= 0x80000000U)
+		return SHMREADER_NOT_YET;
+	slot = Slot(reader, index);
+	seq = SHMEXPORT_LOAD(slot->seq);
+	if (seq != 2 * index + 2)
+		return SHMREADER_OVERWRITTEN;
+	frame->index = index;
+	frame->frame = slot->frame;
+	frame->palette = slot->palette;
+	frame->pixels = (const UBYTE *) (slot + 1);
+	frame->audio = frame->pixels + reader->header->width * reader->header->height;
+	frame->audio_length = slot->audio_length;
+	if (frame->audio_length > reader->header->audio_size)
+		frame->audio_length = reader->header->audio_size; /* torn read */
+	frame->sample_rate = slot->sample_rate;
+	frame->channels = slot->channels;
+	frame->sample_size = slot->sample_size;
+	/* The fields may have been read while the slot was being overwritten. */
+	return SHMREADER_Check(reader, frame) ? SHMREADER_OK : SHMREADER_OVERWRITTEN;
+}
+
+int SHMREADER_Check(SHMREADER_t *reader, const SHMREADER_frame_t *frame)
+{
+	/* Complete the reads of the frame before reading SEQ again. */
+	atomic_thread_fence(memory_order_acquire);
+	return SHMEXPORT_LOAD(Slot(reader, frame->index)->seq) == 2 * frame->index + 2;
+}
@@ -0,0 +1,49 @@
+#ifndef SHMREADER_H_
+#define SHMREADER_H_
+
+#include "shmexport.h"
+
+/* Reading of the frames published by the emulator with -shm-export. The
+   frames are read in place in the shared memory: a frame got with
+   SHMREADER_Get() may be overwritten by the emulator at any time, so after
+   using its data check it with SHMREADER_Check(). */
+typedef struct SHMREADER_t SHMREADER_t;
+
+typedef struct {
+	ULONG index; /* Number of the published frame, counting from 0 */
+	ULONG frame; /* Frame number in the emulator */
+	const UBYTE *pixels; /* width * height colour indexes */
+	const UBYTE *palette; /* R, G, B of each of 256 colours */
+	const UBYTE *audio;
+	ULONG audio_length; /* In bytes */
+	ULONG sample_rate;
+	ULONG channels;
+	ULONG sample_size; /* 1 - unsigned 8-bit, 2 - signed 16-bit, 4 - float */
+} SHMREADER_frame_t;
+
+/* Results of SHMREADER_Get(). */
+enum {
+	SHMREADER_OK,
+	SHMREADER_NOT_YET, /* The frame hasn't been published yet */
+	SHMREADER_OVERWRITTEN /* The frame has been overwritten by a later one */
+};
+
+/* Attaches to shared memory object NAME, as given to -shm-export.
+   Returns NULL on error, with errno set (EINVAL if it isn't a frame
+   export). */
+SHMREADER_t *SHMREADER_Open(const char *name);
+void SHMREADER_Close(SHMREADER_t *reader);
+
+/* Returns the header with the dimensions of the frames. */
+const SHMEXPORT_header_t *SHMREADER_Header(SHMREADER_t *reader);
+/* Returns the number of frames published so far. */
+ULONG SHMREADER_Frames(SHMREADER_t *reader);
+/* Returns FALSE once the emulator has exited. */
+int SHMREADER_Running(SHMREADER_t *reader);
+/* Gets frame INDEX into FRAME. */
+int SHMREADER_Get(SHMREADER_t *reader, ULONG index, SHMREADER_frame_t *frame);
+/* Returns TRUE if FRAME hasn't been overwritten since SHMREADER_Get(), so
+   that everything read from it is valid. */
+int SHMREADER_Check(SHMREADER_t *reader, const SHMREADER_frame_t *frame);
+
+#endif /* SHMREADER_H_ */
@@ -0,0 +1,211 @@
+/*
+ * siohost.c - run the disk drive emulation outside of the emulator
+ *
+ * Copyright (C) 2026 Atari800 development team (see DOC/CREDITS)
+ *
+ * This file is part of the Atari800 emulator project which emulates
+ * the Atari 400, 800, 800XL, 130XE, and 5200 8-bit computers.
+ *
+ * Atari800 is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Atari800 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Atari800; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "config.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "siohost.h"
+#include "antic.h"
+#include "binload.h"
+#include "cassette.h"
+#include "compfile.h"
+#include "cpu.h"
+#include "log.h"
+#include "memory.h"
+#include "pokey.h"
+#include "sio.h"
+#include "statesav.h"
+
+int siohost_verbose = FALSE;
+int siohost_early_bytes = 0;
+
+/* Emulator state referenced by sio.c. */
+unsigned int ANTIC_screenline_cpu_clock = 0;
+int ANTIC_xpos = 0;
+int ANTIC_ypos = 0;
+#ifdef NEW_CYCLE_EXACT
+int ANTIC_cur_screen_pos = ANTIC_NOT_DRAWING;
+const int *ANTIC_cpu2antic_ptr = NULL;
+#endif
+UBYTE CPU_regA;
+UBYTE CPU_regP;
+UWORD CPU_regPC;
+UBYTE CPU_regY;
+UBYTE MEMORY_mem[65536 + 2];
+UBYTE POKEY_AUDF[4 * POKEY_MAXPOKEYS];
+int POKEY_DELAYED_SERIN_IRQ;
+int POKEY_serin_early;
+int BINLOAD_start_binloading = FALSE;
+
+/* Only the plain disk images are supported: no cassette, no compressed
+   images, no state saving. */
+int BINLOAD_LoaderStart(UBYTE *buffer)
+{
+	return 'E';
+}
+
+int CASSETTE_AddGap(int gaptime)
+{
+	return FALSE;
+}
+
+int CASSETTE_GetByte(void)
+{
+	return 0;
+}
+
+void CASSETTE_PutByte(int byte)
+{
+}
+
+int CASSETTE_ReadToMemory(UWORD dest_addr, int length)
+{
+	return FALSE;
+}
+
+int CASSETTE_WriteFromMemory(UWORD src_addr, int length)
+{
+	return FALSE;
+}
+
+int CompFile_DCMtoATR(FILE *infp, FILE *outfp)
+{
+	return FALSE;
+}
+
+int CompFile_ExtractGZ(const char *infilename, FILE *outfp)
+{
+	return FALSE;
+}
+
+CompFile_GZ *CompFile_GZOpen(const char *filename)
+{
+	return NULL;
+}
+
+ULONG CompFile_GZSize(const CompFile_GZ *gz)
+{
+	return 0;
+}
+
+int CompFile_GZRead(CompFile_GZ *gz, ULONG offset, void *buf, int size)
+{
+	return 0;
+}
+
+void CompFile_GZClose(CompFile_GZ *gz)
+{
+}
+
+void MEMORY_CopyFromMem(UWORD from, UBYTE *to, int size)
+{
+	memcpy(to, MEMORY_mem + from, size);
+}
+
+void MEMORY_CopyToMem(const UBYTE *from, UWORD to, int size)
+{
+	memcpy(MEMORY_mem + to, from, size);
+}
+
+void POKEY_PutByte(UWORD addr, UBYTE byte)
+{
+}
+
+void StateSav_SaveINT(const int *data, int num)
+{
+}
+
+void StateSav_ReadINT(int *data, int num)
+{
+}
+
+void StateSav_SaveFNAME(const char *filename)
+{
+}
+
+void StateSav_ReadFNAME(char *filename)
+{
+}
+
+void Atari800_ErrExit(void)
+{
+	exit(1);
+}
+
+void Log_print(const char *format, ...)
+{
+	va_list args;
+	if (!siohost_verbose)
+		return;
+	va_start(args, format);
+	vfprintf(stderr, format, args);
+	va_end(args);
+	fputc('\n', stderr);
+}
+
+void siohost_set_clock(unsigned int cycles)
+{
+	ANTIC_screenline_cpu_clock = cycles;
+	ANTIC_xpos = 0;
+}
+
+/* Receives a byte from the drive, like POKEY when the byte is due. */
+static int GetByte(void)
+{
+	if (POKEY_serin_early)
+		siohost_early_bytes++;
+	POKEY_serin_early = FALSE;
+	return SIO_GetByte();
+}
+
+int siohost_command(int unit, int cmd, int sector, UBYTE *buffer, int size, int *delay)
+{
+	UBYTE frame[5];
+	int result;
+	int i;
+
+	frame[0] = (UBYTE) (0x31 + unit);
+	frame[1] = (UBYTE) cmd;
+	frame[2] = (UBYTE) sector;
+	frame[3] = (UBYTE) (sector >> 8);
+	frame[4] = SIO_ChkSum(frame, 4);
+	siohost_early_bytes = 0;
+	POKEY_serin_early = FALSE;
+	SIO_SwitchCommandFrame(TRUE);
+	for (i = 0; i < 5; i++)
+		SIO_PutByte(frame[i]);
+	SIO_SwitchCommandFrame(FALSE);
+	if (GetByte() != 'A')
+		return -1;
+	if (delay != NULL)
+		*delay = POKEY_DELAYED_SERIN_IRQ;
+	result = GetByte();
+	for (i = 0; i < size; i++)
+		buffer[i] = (UBYTE) GetByte();
+	if (size > 0 && GetByte() != SIO_ChkSum(buffer, size))
+		return -1;
+	return result;
+}
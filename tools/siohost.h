@@ -0,0 +1,27 @@
+#ifndef SIOHOST_H_
+#define SIOHOST_H_
+
+/* Minimal emulator environment that lets the disk drive emulation (sio.c)
+   run outside of the emulator. Commands are sent to the drives through the
+   serial protocol, as by the OS with the SIO patch off. */
+
+#include "atari.h"
+
+/* If FALSE (the default), the messages logged by sio.c are not printed. */
+extern int siohost_verbose;
+
+/* Number of bytes of the last command that followed the previous byte at
+   once, with an accelerated transfer (see -sioaccel). */
+extern int siohost_early_bytes;
+
+/* Sets the CPU clock at which the following command is sent. */
+void siohost_set_clock(unsigned int cycles);
+
+/* Sends command CMD for SECTOR to drive UNIT (counted from 0) and receives
+   the SIZE bytes of data that follow, if any, into BUFFER. DELAY, if not
+   NULL, receives the number of scanlines between the acknowledge and the
+   completion byte. Returns the completion byte ('C' or 'E'), or -1 if the
+   drive didn't acknowledge the command or the data checksum was wrong. */
+int siohost_command(int unit, int cmd, int sector, UBYTE *buffer, int size, int *delay);
+
+#endif /* SIOHOST_H_ */